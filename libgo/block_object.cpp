@@ -8,6 +8,8 @@
 namespace co
 {
 
+void (*BlockObject::switch_out_hook)(BlockObject*) = nullptr;
+
 BlockObject::BlockObject(std::size_t init_wakeup, std::size_t max_wakeup)
     : wakeup_(init_wakeup), max_wakeup_(max_wakeup)
 {
@@ -46,10 +48,14 @@ void BlockObject::CoBlockWait()
     tk->block_ = this;
     tk->state_ = TaskState::sys_block;
 	tk->block_timeout_ = MininumTimeDurationType::zero();
-    tk->is_block_timeout_ = false;
     ++ tk->block_sequence_;
+    tk->block_deadline_ = (std::numeric_limits<long long>::max)();
+    tk->block_state_ = MakeBlockState(tk->block_sequence_, ebs_prepare);
     DebugPrint(dbg_syncblock, "wait to switch. task(%s)", tk->DebugInfo());
+    if (switch_out_hook)
+        switch_out_hook(this);
     g_Scheduler.CoYield();
+    tk->block_ = nullptr;
 }
 
 bool BlockObject::CoBlockWaitTimed(MininumTimeDurationType timeo)
@@ -76,11 +82,23 @@ bool BlockObject::CoBlockWaitTimed(MininumTimeDurationType timeo)
     tk->state_ = TaskState::sys_block;
     ++tk->block_sequence_;
     tk->block_timeout_ = timeo;
-    tk->is_block_timeout_ = false;
+    tk->block_deadline_ = SteadyNowCount() + timeo.count();
+    tk->block_state_ = MakeBlockState(tk->block_sequence_, ebs_prepare);
     DebugPrint(dbg_syncblock, "wait to switch. task(%s)", tk->DebugInfo());
+    if (switch_out_hook)
+        switch_out_hook(this);
     g_Scheduler.CoYield();
+    tk->block_ = nullptr;
+
+    if ((tk->block_state_ & ebs_mask) != ebs_timeout)
+        return true;
 
-    return !tk->is_block_timeout_;
+    // 超时定时器没有访问等待队列, 由协程自己摘除节点.
+    // 如果Wakeup已经pop出了这个节点, 它在CAS失败后会跳过, erase返回false.
+    lock.lock();
+    wait_queue_.erase(&tk->block_node_);
+    DebugPrint(dbg_syncblock, "wait timeout. task(%s)", tk->DebugInfo());
+    return false;
 }
 
 bool BlockObject::TryBlockWait()
@@ -97,57 +115,92 @@ bool BlockObject::TryBlockWait()
 bool BlockObject::Wakeup()
 {
     std::unique_lock<LFLock> lock(lock_);
-    Task* tk = wait_queue_.pop();
-    if (!tk) {
-        if (wakeup_ >= max_wakeup_) {
-            DebugPrint(dbg_syncblock, "wakeup failed.");
-            return false;
+    Task* tk = nullptr;
+    for (;;) {
+        BlockWaitNode* node = wait_queue_.pop();
+        if (!node) {
+            if (wakeup_ >= max_wakeup_) {
+                DebugPrint(dbg_syncblock, "wakeup failed.");
+                return false;
+            }
+
+            ++wakeup_;
+            DebugPrint(dbg_syncblock, "wakeup to %lu.", (long unsigned)wakeup_);
+            return true;
         }
 
-        ++wakeup_;
-        DebugPrint(dbg_syncblock, "wakeup to %lu.", (long unsigned)wakeup_);
-        return true;
+        // 节点在队列中时协程一定还没有返回(超时的协程需要持有lock_才能摘除节点),
+        // 所以这里访问Task是安全的. CAS失败说明已经超时, 跳过.
+        tk = node->tk_;
+        uint64_t state = tk->block_state_;
+        if ((state & ebs_mask) == ebs_waiting &&
+                tk->block_state_.compare_exchange_strong(state, (state & ~(uint64_t)ebs_mask) | ebs_woken))
+            break;
+
+        DebugPrint(dbg_syncblock, "skip timeout task(%s).", tk->DebugInfo());
     }
     lock.unlock();
 
-    tk->block_ = nullptr;
-    if (tk->block_timer_) { // block cancel timer必须在lock之外, 因为里面会lock
-        if (g_Scheduler.BlockCancelTimer(tk->block_timer_))
-            tk->DecrementRef();
-        tk->block_timer_.reset();
-    }
     DebugPrint(dbg_syncblock, "wakeup task(%s).", tk->DebugInfo());
     g_Scheduler.AddTaskRunnable(tk);
     return true;
 }
-void BlockObject::CancelWait(Task* tk, uint32_t block_sequence, bool in_timer)
+
+uint64_t BlockObject::MakeBlockState(uint32_t block_sequence, eBlockState state)
 {
-    std::unique_lock<LFLock> lock(lock_);
-    if (tk->block_ != this) {
-        DebugPrint(dbg_syncblock, "cancelwait task(%s) failed. tk->block_ is not this!", tk->DebugInfo());
-        return;
-    }
+    return ((uint64_t)block_sequence << 32) | state;
+}
 
-    if (tk->block_sequence_ != block_sequence) {
-        DebugPrint(dbg_syncblock, "cancelwait task(%s) failed. tk->block_sequence_ = %u, block_sequence = %u.",
-                tk->DebugInfo(), tk->block_sequence_, block_sequence);
-        return;
-    }
+long long BlockObject::SteadyNowCount()
+{
+    return std::chrono::time_point_cast<MininumTimeDurationType>(
+            std::chrono::steady_clock::now()).time_since_epoch().count();
+}
 
-    if (!wait_queue_.erase(tk)) {
-        DebugPrint(dbg_syncblock, "cancelwait task(%s) erase failed.", tk->DebugInfo());
-        return;
+void BlockObject::ArmWaitTimer(Task* tk, long long deadline)
+{
+    // 已有更早触发的定时器时不必再设置, 它触发时会按新的截止时间重新设置.
+    long long timer_at = tk->block_timer_at_;
+    while (deadline < timer_at) {
+        if (!tk->block_timer_at_.compare_exchange_weak(timer_at, deadline))
+            continue;
+
+        // 定时器只持有Task的弱引用: 等待被唤醒后协程结束时, Task和协程栈不必等到超时才释放.
+        TaskTimerHandle* handle = tk->GetTimerHandle();
+        handle->IncrementRef();
+        g_Scheduler.ExpireAt(std::chrono::steady_clock::time_point(MininumTimeDurationType(deadline)), [=]{
+                    handle->Run([=](Task* tk){ OnWaitTimer(tk, deadline); });
+                    handle->DecrementRef();
+                });
+        return ;
     }
-    lock.unlock();
+}
 
-    tk->block_ = nullptr;
-    if (!in_timer && tk->block_timer_) { // block cancel timer必须在lock之外, 因为里面会lock
-        g_Scheduler.BlockCancelTimer(tk->block_timer_);
-        tk->block_timer_.reset();
+void BlockObject::OnWaitTimer(Task* tk, long long timer_at)
+{
+    long long expected = timer_at;
+    tk->block_timer_at_.compare_exchange_strong(expected, (std::numeric_limits<long long>::max)());
+
+    // 必须先清除block_timer_at_再检查状态, 保证与AddWaitTask并发时至少有一方会设置定时器.
+    for (;;)
+    {
+        uint64_t state = tk->block_state_;
+        if ((state & ebs_mask) != ebs_waiting)
+            return ;
+
+        long long deadline = tk->block_deadline_;
+        if (deadline > SteadyNowCount()) {
+            ArmWaitTimer(tk, deadline);
+            return ;
+        }
+
+        if (tk->block_state_.compare_exchange_strong(state, (state & ~(uint64_t)ebs_mask) | ebs_timeout)) {
+            DebugPrint(dbg_syncblock, "wait timeout, wakeup task(%s). seq=%u",
+                    tk->DebugInfo(), (uint32_t)(state >> 32));
+            g_Scheduler.AddTaskRunnable(tk);
+            return ;
+        }
     }
-    tk->is_block_timeout_ = true;
-    DebugPrint(dbg_syncblock, "cancelwait task(%s).", tk->DebugInfo());
-    g_Scheduler.AddTaskRunnable(tk);
 }
 
 bool BlockObject::IsWakeup()
@@ -161,31 +214,28 @@ bool BlockObject::AddWaitTask(Task* tk)
     std::unique_lock<LFLock> lock(lock_);
     if (wakeup_) {
         --wakeup_;
+        tk->block_state_ = MakeBlockState(tk->block_sequence_, ebs_woken);
         return false;
     }
 
-    wait_queue_.push(tk);
+    tk->block_node_.tk_ = tk;
+    wait_queue_.push(&tk->block_node_);
+    tk->block_state_ = MakeBlockState(tk->block_sequence_, ebs_waiting);
+    MininumTimeDurationType timeout = tk->block_timeout_;
+    long long deadline = tk->block_deadline_;
     DebugPrint(dbg_syncblock, "add wait task(%s). timeout=%ld", tk->DebugInfo(),
-            (long int)std::chrono::duration_cast<std::chrono::milliseconds>(tk->block_timeout_).count());
-
-    // 带超时的, 增加定时器
-	if (MininumTimeDurationType::zero() != tk->block_timeout_) {
-        uint32_t seq = tk->block_sequence_;
-        tk->IncrementRef();
-        tk->block_timer_ = g_Scheduler.ExpireAt(tk->block_timeout_, [=]{
-                    // 此定时器超过block_object生命期时会crash或死锁,
-                    // 所以wakeup或cancelwait时一定要kill此定时器
-                    if (tk->block_sequence_ == seq) {
-                        DebugPrint(dbg_syncblock,
-                            "wait timeout, will cancelwait task(%s). this=%p, tk->block_=%p, seq=%u, timeout=%ld",
-                            tk->DebugInfo(), this, tk->block_, seq,
-                            (long int)std::chrono::duration_cast<std::chrono::milliseconds>(tk->block_timeout_).count());
-                        this->CancelWait(tk, seq, true);
-                    }
-                    tk->DecrementRef();
-                });
-    }
+            (long int)std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
+    if (MininumTimeDurationType::zero() == timeout)
+        return true;
 
+    // 带超时的, 设置定时器.
+    // 定时器只持有Task的弱引用, 不访问BlockObject; 被唤醒后也不取消(不必争抢定时器的锁),
+    // 到期时通过block_state_中的序号和block_deadline_判断等待是否真的超时.
+    // 解锁后协程可能已被唤醒并结束, 所以先增加引用计数.
+    tk->IncrementRef();
+    lock.unlock();
+    ArmWaitTimer(tk, deadline);
+    tk->DecrementRef();
     return true;
 }
 
@@ -14,7 +14,7 @@ protected:
     friend class Processer;
     std::size_t wakeup_;        // ǰź
     std::size_t max_wakeup_;    // Ի۵ź
-    TSQueue<Task, false> wait_queue_;   // ȴźŵЭ̶
+    TSQueue<BlockWaitNode, false> wait_queue_;   // ȴźŵЭ̶
     LFLock lock_;
 
 public:
@@ -51,8 +51,32 @@ public:
 
     bool IsWakeup();
 
+    // õͬ: ЭѱΪȴг֮ǰ, ʱΪnullptr.
+    // ڹ߳Эглѵʱ.
+    static void (*switch_out_hook)(BlockObject*);
+
 private:
-    void CancelWait(Task* tk, uint32_t block_sequence, bool in_timer = false);
+    // ȴ״̬(Task::block_state_ĵλ)
+    enum eBlockState : uint64_t
+    {
+        ebs_prepare = 0,    // Эг, ûмȴ
+        ebs_waiting = 1,
+        ebs_woken = 2,
+        ebs_timeout = 3,
+        ebs_mask = 3,
+    };
+
+    static uint64_t MakeBlockState(uint32_t block_sequence, eBlockState state);
+
+    static long long SteadyNowCount();
+
+    // óʱʱ. ÿЭͬһʱֻͨһʱʱ, ʱȡ,
+    // ʱЭڽеĵȴûֹʱ, ͰµĽֹʱ.
+    static void ArmWaitTimer(Task* tk, long long deadline);
+
+    // ʱʱص, ֻ޸Task״̬, BlockObject.
+    // ʱЭ̱ѺԼӵȴժڵ.
+    static void OnWaitTimer(Task* tk, long long timer_at);
 
     bool AddWaitTask(Task* tk);
 };
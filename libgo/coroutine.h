@@ -42,6 +42,44 @@ inline TimerId co_timer_add(Arg const& duration_or_timepoint, F const& callback)
     return g_Scheduler.ExpireAt(duration_or_timepoint, callback);
 }
 
+// The timer may be triggered at any time in [deadline, deadline + slack],
+// so timers with overlapping slack windows share one wakeup.
+template <typename Arg, typename F, typename Rep, typename Period>
+inline TimerId co_timer_add(Arg const& duration_or_timepoint, F const& callback,
+        std::chrono::duration<Rep, Period> const& slack) {
+    return g_Scheduler.ExpireAt(duration_or_timepoint, callback,
+            std::chrono::duration_cast<MininumTimeDurationType>(slack));
+}
+
+// co_timer_add_periodic will returns timer_id;
+// The callback is called every period until the timer is cancelled.
+//   ePeriodicMode::fixed_rate:  ticks follow the original schedule, missed ticks are skipped.
+//   ePeriodicMode::fixed_delay: next tick is one period after the callback returns.
+template <typename Duration, typename F>
+inline TimerId co_timer_add_periodic(Duration const& period, F const& callback,
+        ePeriodicMode mode = ePeriodicMode::fixed_rate) {
+    return g_Scheduler.ExpireEvery(period, callback, mode);
+}
+
+// co_timer_add_go will returns timer_id;
+// The callback runs in a new coroutine, so it may block or do hooked IO.
+// The coroutine is dispatched to the thread which added the timer by default.
+// Like go, the coroutine records the file and line which added the timer.
+struct __go_timer
+{
+    __go_timer(const char* file, int lineno) : file_(file), lineno_(lineno) {}
+
+    template <typename Arg, typename F>
+    inline TimerId operator()(Arg const& duration_or_timepoint, F const& callback,
+            int dispatch = egod_local_thread)
+    {
+        return g_Scheduler.ExpireAtGo(duration_or_timepoint, callback, dispatch, file_, lineno_);
+    }
+
+    const char* file_;
+    int lineno_;
+};
+
 // co_timer_cancel will returns boolean type;
 //   if cancel successfully it returns true,
 //   else it returns false;
@@ -98,6 +136,7 @@ using ::co::egod_local_thread;
 #define go ::co::__go(__FILE__, __LINE__)-
 #define go_stack(size) ::co::__go(__FILE__, __LINE__, size)-
 #define go_dispatch(dispatch) ::co::__go(__FILE__, __LINE__, 0, dispatch)-
+#define co_timer_add_go ::co::__go_timer(__FILE__, __LINE__)
 
 #define co_yield do { g_Scheduler.CoYield(); } while (0)
 
@@ -121,6 +160,7 @@ using ::co::co_chan;
 // co timer *
 typedef ::co::TimerId co_timer_id;
 using ::co::co_timer_add;
+using ::co::co_timer_add_periodic;
 using ::co::co_timer_cancel;
 using ::co::co_timer_block_cancel;
 
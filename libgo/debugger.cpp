@@ -1,5 +1,9 @@
 #include "debugger.h"
 #include "scheduler.h"
+#if __linux__
+#include "file_io.h"
+#include "uring_wait.h"
+#endif
 
 namespace co
 {
@@ -21,6 +25,7 @@ std::string CoDebugger::GetAllInfo()
     s += "\nCurrentProcessID: " + std::to_string(GetCurrentProcessID());
     s += "\nTimerCount: " + std::to_string(GetTimerCount());
     s += "\nSleepTimerCount: " + std::to_string(GetSleepTimerCount());
+    s += "\nTimerSavedWakeups: " + std::to_string(GetTimerSavedWakeups());
     s += "\n--------------------------------------------";
     s += "\nTask Map:";
     auto vm = GetTasksStateInfo();
@@ -37,6 +42,12 @@ std::string CoDebugger::GetAllInfo()
 #if __linux__
     s += "\n" + GetFdInfo();
     s += "\nEpollWait:" + std::to_string(GetEpollWaitCount());
+    s += "\nEpollCtl:" + std::to_string(GetEpollCtlCount());
+    s += "\nHookSyscall:" + std::to_string(GetHookSyscallCount());
+    s += "\nUringSubmit:" + std::to_string(GetUringSubmitCount());
+    s += "\nUringComplete:" + std::to_string(GetUringCompleteCount());
+    s += "\n" + GetReactorInfo();
+    s += "\n" + GetFileOpInfo();
 #endif
 
     s += "\n--------------------------------------------";
@@ -85,6 +96,10 @@ uint64_t CoDebugger::GetSleepTimerCount()
 {
     return g_Scheduler.sleep_wait_.timer_mgr_.Size();
 }
+uint64_t CoDebugger::GetTimerSavedWakeups()
+{
+    return g_Scheduler.timer_mgr_.GetSavedWakeups();
+}
 std::map<SourceLocation, uint32_t> CoDebugger::GetTasksInfo()
 {
     return Task::GetStatInfo();
@@ -109,7 +124,67 @@ std::string CoDebugger::GetFdInfo()
 // 获取等待epoll的协程数量
 uint32_t CoDebugger::GetEpollWaitCount()
 {
-    return g_Scheduler.io_wait_.wait_io_sentries_.size();
+    return g_Scheduler.io_wait_.wait_io_sentries_.size() + g_Scheduler.io_wait_.wait_task_count_;
+}
+
+// 获取reactor调用epoll_ctl的次数
+uint64_t CoDebugger::GetEpollCtlCount()
+{
+    return g_Scheduler.io_wait_.epoll_ctl_count_;
+}
+
+// 获取hook中发起的io系统调用次数
+uint64_t CoDebugger::GetHookSyscallCount()
+{
+    return g_Scheduler.io_wait_.hook_syscall_count_;
+}
+
+// 获取提交给io_uring的操作数和收割的完成事件数
+uint64_t CoDebugger::GetUringSubmitCount()
+{
+    return IoUring::GetSubmitCount();
+}
+uint64_t CoDebugger::GetUringCompleteCount()
+{
+    return IoUring::GetCompleteCount();
+}
+
+// 获取每个调度线程的reactor信息
+std::string CoDebugger::GetReactorInfo()
+{
+    IoWait & io_wait = g_Scheduler.io_wait_;
+    std::string s = "Reactors:";
+    for (std::size_t i = 0; i < io_wait.GetReactorCount(); ++i) {
+        IoWait::Reactor *r = io_wait.reactors_[i];
+        if (!r) continue;
+        s += "\n  [" + std::to_string(i) + "] fds:" + std::to_string(r->fd_count)
+            + " triggers:" + std::to_string(r->trigger_count)
+            + " polling:" + std::to_string((int)r->polling);
+    }
+    for (std::size_t i = 0; i < io_wait.GetNetpollerCount(); ++i) {
+        IoWait::Reactor *r = io_wait.reactors_[IoWait::kMaxReactors + i];
+        if (!r) continue;
+        s += "\n  [netpoller " + std::to_string(i) + "] fds:" + std::to_string(r->fd_count)
+            + " triggers:" + std::to_string(r->trigger_count);
+    }
+    return s;
+}
+
+// 获取协程中各类文件元数据操作的调用次数和耗时
+std::string CoDebugger::GetFileOpInfo()
+{
+    FileIoPool & pool = FileIoPool::getInstance();
+    std::string s = "FileOps:";
+    for (int i = 0; i < (int)eFileOp::count; ++i) {
+        FileOpStat const& stat = pool.GetStat((eFileOp)i);
+        uint64_t calls = stat.calls;
+        if (!calls) continue;
+        s += "\n  " + std::string(FileIoPool::GetOpName((eFileOp)i))
+            + " calls:" + std::to_string(calls)
+            + " avg_us:" + std::to_string(stat.total_us / calls)
+            + " max_us:" + std::to_string(stat.max_us);
+    }
+    return s;
 }
 #endif
 
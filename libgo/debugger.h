@@ -82,6 +82,9 @@ public:
 
     uint64_t GetSleepTimerCount();
 
+    // wakeups saved by coalescing timers in the same slack window
+    uint64_t GetTimerSavedWakeups();
+
     std::map<SourceLocation, uint32_t> GetTasksInfo();
     std::vector<std::map<SourceLocation, uint32_t>> GetTasksStateInfo();
 
@@ -90,6 +93,22 @@ public:
     std::string GetFdInfo();
 
     uint32_t GetEpollWaitCount();
+
+    // epoll_ctl syscalls issued by the reactor
+    uint64_t GetEpollCtlCount();
+
+    // read/write/poll syscalls issued by the hooks in coroutines
+    uint64_t GetHookSyscallCount();
+
+    // ops submitted to / completions reaped from io_uring by all threads
+    uint64_t GetUringSubmitCount();
+    uint64_t GetUringCompleteCount();
+
+    // fd count and triggered events of every per-thread reactor
+    std::string GetReactorInfo();
+
+    // calls and latency of the file metadata ops hooked in coroutines
+    std::string GetFileOpInfo();
 #endif
 
     object_counts_result_t GetDebuggerObjectCounts();
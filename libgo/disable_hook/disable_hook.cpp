@@ -8,7 +8,13 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <netdb.h>
+#include <sys/wait.h>
+#include <stdlib.h>
 #include <time.h>
+#include <stdio.h>
 #include "linux_glibc_hook.h"
 #endif
 
@@ -27,17 +33,44 @@ extern "C" {
 connect_t connect_f = &connect;
 read_t read_f = &read;
 readv_t readv_f = &readv;
+pread_t pread_f = &pread;
 recv_t recv_f = &recv;
 recvfrom_t recvfrom_f = &recvfrom;
 recvmsg_t recvmsg_f = &recvmsg;
+recvmmsg_t recvmmsg_f = &recvmmsg;
 write_t write_f = &write;
 writev_t writev_f = &writev;
+pwrite_t pwrite_f = &pwrite;
 send_t send_f = &send;
 sendto_t sendto_f = &sendto;
 sendmsg_t sendmsg_f = &sendmsg;
+sendmmsg_t sendmmsg_f = &sendmmsg;
+sendfile_t sendfile_f = &sendfile;
+sendfile64_t sendfile64_f = &sendfile64;
+splice_t splice_f = &splice;
+tee_t tee_f = &tee;
+vmsplice_t vmsplice_f = &vmsplice;
 poll_t poll_f = &poll;
 select_t select_f = &select;
+epoll_wait_t epoll_wait_f = &epoll_wait;
+epoll_pwait_t epoll_pwait_f = &epoll_pwait;
 accept_t accept_f = &accept;
+accept4_t accept4_f = &accept4;
+getaddrinfo_t getaddrinfo_f = &getaddrinfo;
+gethostbyname_t gethostbyname_f = &gethostbyname;
+waitpid_t waitpid_f = &waitpid;
+system_t system_f = &system;
+popen_t popen_f = &popen;
+pclose_t pclose_f = &pclose;
+pthread_mutex_lock_t pthread_mutex_lock_f = &pthread_mutex_lock;
+pthread_mutex_unlock_t pthread_mutex_unlock_f = &pthread_mutex_unlock;
+pthread_cond_wait_t pthread_cond_wait_f = &pthread_cond_wait;
+pthread_cond_timedwait_t pthread_cond_timedwait_f = &pthread_cond_timedwait;
+#if __GLIBC_PREREQ(2, 30)
+pthread_cond_clockwait_t pthread_cond_clockwait_f = &pthread_cond_clockwait;
+#endif
+pthread_cond_signal_t pthread_cond_signal_f = &pthread_cond_signal;
+pthread_cond_broadcast_t pthread_cond_broadcast_f = &pthread_cond_broadcast;
 sleep_t sleep_f = &sleep;
 usleep_t usleep_f = &usleep;
 nanosleep_t nanosleep_f = &nanosleep;
@@ -49,6 +82,18 @@ setsockopt_t setsockopt_f = &setsockopt;
 dup_t dup_f = &dup;
 dup2_t dup2_f = &dup2;
 dup3_t dup3_f = &dup3;
+open_t open_f = &open;
+#if __GLIBC_PREREQ(2, 33)
+stat_t stat_f = &stat;
+#else
+stat_t stat_f = NULL;
+#endif
+fsync_t fsync_f = &fsync;
+fdatasync_t fdatasync_f = &fdatasync;
+rename_t rename_f = &rename;
+unlink_t unlink_f = &unlink;
+opendir_t opendir_f = &opendir;
+readdir_t readdir_f = &readdir;
 
 } //extern "C"
 
@@ -0,0 +1,101 @@
+#include "addr_wait.h"
+#include <mutex>
+#include <stdint.h>
+
+namespace co
+{
+
+AddrWait& AddrWait::getInstance()
+{
+    static AddrWait obj;
+    return obj;
+}
+
+AddrWait::Bucket& AddrWait::GetBucket(void* addr)
+{
+    // 同步对象通常按8字节或更大对齐, 去掉低位后散列
+    uintptr_t h = (uintptr_t)addr >> 3;
+    h ^= h >> 8;
+    return buckets_[h % kBuckets];
+}
+
+void AddrWait::Unlink(Bucket & bucket, Waiter* w)
+{
+    if (w->prev_)
+        w->prev_->next_ = w->next_;
+    else
+        bucket.head_ = w->next_;
+    if (w->next_)
+        w->next_->prev_ = w->prev_;
+    else
+        bucket.tail_ = w->prev_;
+    w->prev_ = w->next_ = nullptr;
+    w->queued_ = false;
+}
+
+void AddrWait::Enqueue(Waiter* w, void* addr)
+{
+    Bucket & bucket = GetBucket(addr);
+    std::unique_lock<LFLock> lock(bucket.lock_);
+    w->addr_ = addr;
+    w->prev_ = bucket.tail_;
+    w->next_ = nullptr;
+    if (bucket.tail_)
+        bucket.tail_->next_ = w;
+    else
+        bucket.head_ = w;
+    bucket.tail_ = w;
+    w->queued_ = true;
+
+    // 与Wake中的fence配对: 调用者随后检查的条件(例如trylock)与唤醒方的修改不会同时错过对方
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+}
+
+bool AddrWait::Cancel(Waiter* w)
+{
+    Bucket & bucket = GetBucket(w->addr_);
+    std::unique_lock<LFLock> lock(bucket.lock_);
+    if (!w->queued_)
+        return false;
+
+    Unlink(bucket, w);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool AddrWait::Wait(Waiter* w, MininumTimeDurationType timeout)
+{
+    if (timeout.count() < 0)
+        w->signal_.CoBlockWait();
+    else if (timeout.count() > 0)
+        w->signal_.CoBlockWaitTimed(timeout);
+
+    // 唤醒方在桶锁内调用Wakeup, 这里总是再加一次桶锁, 确保返回后w不再被访问.
+    // 超时与唤醒同时发生时按唤醒处理, 以免丢失这次唤醒.
+    return !Cancel(w);
+}
+
+int AddrWait::Wake(void* addr, int n)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0)
+        return 0;
+
+    Bucket & bucket = GetBucket(addr);
+    std::unique_lock<LFLock> lock(bucket.lock_);
+    int woken = 0;
+    Waiter* w = bucket.head_;
+    while (w && woken < n) {
+        Waiter* next = w->next_;
+        if (w->addr_ == addr) {
+            Unlink(bucket, w);
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+            w->signal_.Wakeup();
+            ++woken;
+        }
+        w = next;
+    }
+    return woken;
+}
+
+} //namespace co
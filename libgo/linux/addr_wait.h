@@ -0,0 +1,66 @@
+/************************************************
+ * 按同步对象的地址等待的协程队列, 供pthread_mutex_t、pthread_cond_t的hook使用.
+ * 只有协程会在这里挂起, 任何线程都可以按地址唤醒.
+ * 等待者按地址散列到固定数量的桶中, 不需要为每个同步对象分配内存.
+*************************************************/
+#pragma once
+#include <atomic>
+#include "spinlock.h"
+#include "block_object.h"
+
+namespace co
+{
+
+class AddrWait
+{
+public:
+    struct Waiter
+    {
+        void* addr_ = nullptr;
+        Waiter* prev_ = nullptr;
+        Waiter* next_ = nullptr;
+        bool queued_ = false;
+        BlockObject signal_{0, 1};
+    };
+
+    static AddrWait& getInstance();
+
+    // 加入addr的等待队列.
+    // 之后需要再检查一次等待的条件, 不再需要等待时调用Cancel, 否则调用Wait.
+    void Enqueue(Waiter* w, void* addr);
+
+    // 离开等待队列
+    // @return: 已经被唤醒(不在队列中)时返回false
+    bool Cancel(Waiter* w);
+
+    // 挂起当前协程直到被唤醒或超时, 返回时w已经不在队列中, 也不会再被访问.
+    // @timeout: 负数表示不超时
+    // @return: 是否被唤醒
+    bool Wait(Waiter* w, MininumTimeDurationType timeout);
+
+    // 唤醒addr上的至多n个等待者, 没有协程在等待时只有一次原子读.
+    // @return: 唤醒的数量
+    int Wake(void* addr, int n);
+
+private:
+    struct Bucket
+    {
+        LFLock lock_;
+        Waiter* head_ = nullptr;
+        Waiter* tail_ = nullptr;
+    };
+
+    static const std::size_t kBuckets = 256;
+
+    AddrWait() = default;
+
+    Bucket& GetBucket(void* addr);
+
+    static void Unlink(Bucket & bucket, Waiter* w);
+
+private:
+    Bucket buckets_[kBuckets];
+    std::atomic<long> waiters_{0};
+};
+
+} //namespace co
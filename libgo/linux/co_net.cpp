@@ -0,0 +1,287 @@
+#include "co_net.h"
+#include <vector>
+#include "io_mode.h"
+
+namespace co
+{
+
+ssize_t uring_result(FdCtxPtr const& fd_ctx, int res, int timeout_errno)
+{
+    if (res >= 0)
+        return res;
+
+    if (res == -ECANCELED)  // 超时或fd被close
+        errno = fd_ctx->closed() ? EBADF : timeout_errno;
+    else
+        errno = -res;
+    return -1;
+}
+
+int poll_wait(Task* tk, struct pollfd *fds, nfds_t nfds, FdCtxPtr const* fd_ctxs, int timeout)
+{
+    // create io-sentry
+    IoSentryPtr io_sentry = MakeShared<IoSentry>(tk, fds, nfds);
+
+    // add file descriptor into epoll or poll.
+    bool added = false;
+    for (nfds_t i = 0; i < nfds; ++i) {
+        fds[i].revents = 0;     // clear revents
+        pollfd & pfd = io_sentry->watch_fds_[i];
+        if (pfd.fd < 0)
+            continue;
+
+        FdCtxPtr const& fd_ctx = fd_ctxs[i];
+        if (!fd_ctx || fd_ctx->closed()) {
+            // bad file descriptor
+            pfd.revents = POLLNVAL;
+            continue;
+        }
+
+        if (!fd_ctx->add_into_reactor(pfd.events, io_sentry)) {
+            // TODO: 兼容文件fd
+            pfd.revents = POLLNVAL;
+            continue;
+        }
+
+        added = true;
+    }
+
+    if (!added) {
+        errno = 0;
+        return nfds;
+    }
+
+    // set timer
+    if (timeout > 0)
+        io_sentry->timer_ = g_Scheduler.ExpireAt(
+                std::chrono::milliseconds(timeout),
+                [io_sentry]{
+                    g_Scheduler.GetIoWait().IOBlockTriggered(io_sentry);
+                });
+
+    // save io-sentry
+    tk->io_sentry_ = io_sentry;
+
+    // yield
+    g_Scheduler.GetIoWait().CoSwitch();
+
+    // clear task->io_sentry_ reference count
+    tk->io_sentry_.reset();
+
+    if (io_sentry->timer_) {
+        g_Scheduler.CancelTimer(io_sentry->timer_);
+        io_sentry->timer_.reset();
+    }
+
+    int n = 0;
+    for (nfds_t i = 0; i < nfds; ++i) {
+        fds[i].revents = io_sentry->watch_fds_[i].revents;
+        if (fds[i].revents) ++n;
+    }
+    errno = 0;
+    return n;
+}
+
+short fd_wait(Task* tk, FdCtxPtr const& fd_ctx, short event, int timeout)
+{
+    IoWait & io_wait = g_Scheduler.GetIoWait();
+    uint32_t seq = io_wait.PrepareTaskWait(tk, timeout);
+    if (!fd_ctx->add_into_reactor(event, tk, seq))
+        return POLLNVAL;
+
+    short revents = io_wait.TaskSwitch(tk);
+    fd_ctx->del_from_reactor(event, tk, seq);
+    return revents;
+}
+
+// 探测前记录就绪序号, 探测到未就绪后清除边缘触发的就绪缓存.
+// 等待结束后fd仍留在epoll中(见del_from_reactor), 循环poll同一批fd时只有就绪的fd需要epoll_ctl.
+int poll_mode(Task* tk, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    std::vector<FdCtxPtr> fd_ctxs(nfds);
+    std::vector<uint32_t> ready_seqs(nfds);
+    for (nfds_t i = 0; i < nfds; ++i) {
+        if (fds[i].fd < 0) continue;
+        fd_ctxs[i] = FdManager::getInstance().get_fd_ctx(fds[i].fd);
+        if (fd_ctxs[i])
+            ready_seqs[i] = fd_ctxs[i]->ready_seq();
+    }
+
+    g_Scheduler.GetIoWait().CountHookSyscall();
+    int res = poll_f(fds, nfds, 0);
+    if (res != 0)
+        return res;
+
+    for (nfds_t i = 0; i < nfds; ++i)
+        if (fd_ctxs[i])
+            fd_ctxs[i]->clear_ready(fds[i].events, ready_seqs[i]);
+
+    return poll_wait(tk, fds, nfds, fd_ctxs.data(), timeout);
+}
+
+namespace net
+{
+
+ssize_t read(int fd, void *buf, size_t count, int timeout_ms)
+{
+    return read_write_mode(fd, read_f, "read", POLLIN, SO_RCVTIMEO, timeout_ms,
+            UringOp{eUringOpcode::read, fd, buf, (uint32_t)count, (uint64_t)-1, nullptr, 0}, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt, int timeout_ms)
+{
+    return read_write_mode(fd, readv_f, "readv", POLLIN, SO_RCVTIMEO, timeout_ms,
+            UringOp{eUringOpcode::readv, fd, iov, (uint32_t)iovcnt, (uint64_t)-1, nullptr, 0}, iov, iovcnt);
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags, int timeout_ms)
+{
+    return read_write_mode(sockfd, recv_f, "recv", POLLIN, SO_RCVTIMEO, timeout_ms,
+            UringOp{eUringOpcode::recv, sockfd, buf, (uint32_t)len, 0, nullptr, flags}, buf, len, flags);
+}
+
+ssize_t write(int fd, const void *buf, size_t count, int timeout_ms)
+{
+    return read_write_mode(fd, write_f, "write", POLLOUT, SO_SNDTIMEO, timeout_ms,
+            UringOp{eUringOpcode::write, fd, buf, (uint32_t)count, (uint64_t)-1, nullptr, 0}, buf, count);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt, int timeout_ms)
+{
+    return read_write_mode(fd, writev_f, "writev", POLLOUT, SO_SNDTIMEO, timeout_ms,
+            UringOp{eUringOpcode::writev, fd, iov, (uint32_t)iovcnt, (uint64_t)-1, nullptr, 0}, iov, iovcnt);
+}
+
+ssize_t send(int sockfd, const void *buf, size_t len, int flags, int timeout_ms)
+{
+    return read_write_mode(sockfd, send_f, "send", POLLOUT, SO_SNDTIMEO, timeout_ms,
+            UringOp{eUringOpcode::send, sockfd, buf, (uint32_t)len, 0, nullptr, flags}, buf, len, flags);
+}
+
+// accept到的新连接轮流归属到各个调度线程的reactor, 避免都集中在执行accept的线程上.
+// @flags: accept4的flags
+static int on_accepted(int fd, int flags)
+{
+    if (fd >= 0 && g_Scheduler.IsCoroutine()) {
+        FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+        if (fd_ctx && fd_ctx->is_socket()) {
+            if (flags & SOCK_NONBLOCK)
+                fd_ctx->set_user_nonblock(true);
+            fd_ctx->set_reactor(g_Scheduler.GetIoWait().ChooseReactor());
+        }
+    }
+    return fd;
+}
+
+int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int timeout_ms)
+{
+    int fd = read_write_mode(sockfd, accept_f, "accept", POLLIN, SO_RCVTIMEO, timeout_ms,
+            UringOp{eUringOpcode::accept, sockfd, addr, 0, 0, addrlen, 0}, addr, addrlen);
+    return on_accepted(fd, 0);
+}
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags, int timeout_ms)
+{
+    // io_uring的multishot accept由监听socket上的所有调用者共享, 带flags时只使用epoll.
+    int fd = read_write_mode(sockfd, accept4_f, "accept4", POLLIN, SO_RCVTIMEO, timeout_ms,
+            UringOp{flags ? eUringOpcode::none : eUringOpcode::accept,
+                sockfd, addr, 0, 0, addrlen, 0},
+            addr, addrlen, flags);
+    return on_accepted(fd, flags);
+}
+
+int connect(int fd, const struct sockaddr *addr, socklen_t addrlen, int timeout_ms)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    if (!tk)
+        return connect_f(fd, addr, addrlen);
+
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+    if (!fd_ctx || fd_ctx->closed()) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (fd_ctx->user_nonblock())
+        return connect_f(fd, addr, addrlen);
+
+    int n = -1;
+    bool in_progress = false;
+    if (IoUring::IsEnabled()) {
+        // 非阻塞的connect一定会EINPROGRESS, 直接提交给io_uring, 由内核等待连接完成.
+        int res = IoUring::CoSubmit(fd_ctx,
+                UringOp{eUringOpcode::connect, fd, addr, 0, addrlen, nullptr, 0},
+                timeout_ms);
+        if (res == -EINPROGRESS) {
+            // 老版本内核对O_NONBLOCK的fd直接返回EINPROGRESS, 使用poll等待连接完成.
+            in_progress = true;
+            errno = EINPROGRESS;
+        } else if (res != -EAGAIN)  // -EAGAIN: sq已满, 使用epoll
+            return uring_result(fd_ctx, res, ETIMEDOUT);
+    }
+
+    if (!in_progress)
+        n = connect_f(fd, addr, addrlen);
+
+    if (n == 0) {
+        DebugPrint(dbg_hook, "continue task(%s) connect completed immediately. fd=%d",
+                tk->DebugInfo(), fd);
+        return 0;
+    } else if (n != -1 || errno != EINPROGRESS) {
+        return n;
+    }
+
+    // EINPROGRESS. use poll for wait connect complete.
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    int poll_res = net::poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms);
+    if (poll_res == -1)
+        return -1;
+    if (poll_res == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    // 连接失败时revents带有POLLERR/POLLHUP, 以SO_ERROR作为错误码
+
+    int error = 0;
+    socklen_t len = sizeof(int);
+    if (-1 == getsockopt_f(fd, SOL_SOCKET, SO_ERROR, &error, &len))
+        return -1;
+
+    if (!error)
+        return 0;
+    else {
+        errno = error;
+        return -1;
+    }
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout_ms)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    if (!tk || timeout_ms == 0)
+        return poll_f(fds, nfds, timeout_ms);
+
+    // 全部是负数fd时, 等价于sleep
+    nfds_t negative_fd_n = 0;
+    for (nfds_t i = 0; i < nfds; ++i)
+        if (fds[i].fd < 0)
+            ++ negative_fd_n;
+
+    if (nfds == negative_fd_n) {
+        g_Scheduler.SleepSwitch(timeout_ms);
+        return 0;
+    }
+
+    return poll_mode(tk, fds, nfds, timeout_ms);
+}
+
+int close(int fd)
+{
+    return FdManager::getInstance().close(fd);
+}
+
+} //namespace net
+} //namespace co
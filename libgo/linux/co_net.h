@@ -0,0 +1,52 @@
+/************************************************
+ * 显式的协程socket接口: 不依赖hook, DISABLE_HOOK编译时(静态链接、sanitizer等
+ *     不能替换libc符号的场景)协程仍然可以进行非阻塞IO.
+ * 在协程中调用时, fd未就绪只挂起当前协程; 不在协程中时等同于直接调用libc.
+ * 开启hook时, 被hook的read/write/accept/connect/poll等就是对这些接口的封装.
+ *
+ * 经过这里的socket会被设置为O_NONBLOCK并记录在FdManager中:
+ *     - 之后对它的读写都应该使用这些接口(开启hook时直接调用libc函数即可);
+ *     - 关闭时需要调用co::net::close, 否则fd号被复用时会查到旧的上下文.
+*************************************************/
+#pragma once
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace co
+{
+namespace net
+{
+
+// @timeout_ms: 毫秒. 负数表示使用socket上设置的SO_RCVTIMEO/SO_SNDTIMEO(默认不超时),
+//              0表示不等待. 超时返回-1, errno为EAGAIN(connect为ETIMEDOUT).
+
+ssize_t read(int fd, void *buf, size_t count, int timeout_ms = -1);
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt, int timeout_ms = -1);
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags, int timeout_ms = -1);
+
+ssize_t write(int fd, const void *buf, size_t count, int timeout_ms = -1);
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt, int timeout_ms = -1);
+
+ssize_t send(int sockfd, const void *buf, size_t len, int flags, int timeout_ms = -1);
+
+// accept到的新连接轮流归属到各个调度线程的reactor
+int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int timeout_ms = -1);
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags, int timeout_ms = -1);
+
+// @timeout_ms: 负数表示不超时
+int connect(int fd, const struct sockaddr *addr, socklen_t addrlen, int timeout_ms = -1);
+
+// 与poll相同, 全部是负数fd时等价于sleep
+int poll(struct pollfd *fds, nfds_t nfds, int timeout_ms);
+
+// 关闭fd并唤醒在它上面等待的协程
+int close(int fd);
+
+} //namespace net
+} //namespace co
@@ -0,0 +1,654 @@
+#include "dns_resolver.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <random>
+#include "scheduler.h"
+#include "co_net.h"
+
+namespace co
+{
+
+static const uint16_t kTypeA = 1;
+static const uint16_t kTypeSOA = 6;
+static const uint16_t kTypeAAAA = 28;
+
+static const uint32_t kMaxTtl = 3600;           // 缓存时间上限(秒)
+static const uint32_t kMaxNegativeTtl = 300;    // 不存在的域名的缓存时间上限(秒)
+static const uint32_t kDefaultNegativeTtl = 5;  // 应答中没有SOA记录时
+static const std::size_t kMaxCacheEntries = 10000;
+
+// 一次查询的应答
+struct DnsReply
+{
+    bool received = false;
+    int rcode = -1;
+    std::vector<DnsAddress> addrs;
+    uint32_t ttl = kMaxTtl;                     // 应答中记录的最小TTL
+    uint32_t negative_ttl = kDefaultNegativeTtl;
+};
+
+static std::string ToLower(std::string s)
+{
+    for (auto & c : s)
+        if (c >= 'A' && c <= 'Z')
+            c = c - 'A' + 'a';
+    return s;
+}
+
+static bool ParseAddress(std::string const& s, DnsAddress & addr)
+{
+    if (inet_pton(AF_INET, s.c_str(), &addr.v4) == 1) {
+        addr.family = AF_INET;
+        return true;
+    }
+    if (inet_pton(AF_INET6, s.c_str(), &addr.v6) == 1) {
+        addr.family = AF_INET6;
+        return true;
+    }
+    return false;
+}
+
+static bool ParseServer(std::string const& s, sockaddr_in6 & server)
+{
+    std::string host = s;
+    int port = 53;
+    if (!s.empty() && s[0] == '[') {
+        std::size_t end = s.find(']');
+        if (end == std::string::npos)
+            return false;
+        host = s.substr(1, end - 1);
+        if (end + 1 < s.size()) {
+            if (s[end + 1] != ':') return false;
+            port = atoi(s.c_str() + end + 2);
+        }
+    } else if (std::count(s.begin(), s.end(), ':') == 1) {
+        std::size_t pos = s.find(':');
+        host = s.substr(0, pos);
+        port = atoi(s.c_str() + pos + 1);
+    }
+
+    DnsAddress addr;
+    if (port <= 0 || port > 65535 || !ParseAddress(host, addr))
+        return false;
+
+    memset(&server, 0, sizeof(server));
+    if (addr.family == AF_INET) {
+        sockaddr_in* sin = (sockaddr_in*)&server;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        sin->sin_addr = addr.v4;
+    } else {
+        server.sin6_family = AF_INET6;
+        server.sin6_port = htons(port);
+        server.sin6_addr = addr.v6;
+    }
+    return true;
+}
+
+// 文件的inode、大小和修改时间, 用于判断是否需要重新加载.
+// 使用fopen和fstat: 它们在libc内部直接调用系统调用, 不会进入文件IO线程池.
+static std::string FileVersion(std::string const& path)
+{
+    FILE* f = fopen(path.c_str(), "re");
+    if (!f) return "";
+
+    struct stat st;
+    char buf[128] = "";
+    if (fstat(fileno(f), &st) == 0)
+        snprintf(buf, sizeof(buf), "%lu:%ld:%ld.%ld", (unsigned long)st.st_ino, (long)st.st_size,
+                (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    fclose(f);
+    return buf;
+}
+
+// 按行读取文件, 去掉注释后按空白分割
+template <typename F>
+static void ForEachLine(std::string const& path, F const& fn)
+{
+    FILE* f = fopen(path.c_str(), "re");
+    if (!f) return ;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char* comment = strpbrk(line, "#;");
+        if (comment) *comment = '\0';
+
+        std::vector<std::string> words;
+        char* save = nullptr;
+        for (char* w = strtok_r(line, " \t\r\n", &save); w; w = strtok_r(nullptr, " \t\r\n", &save))
+            words.push_back(w);
+        if (!words.empty())
+            fn(words);
+    }
+    fclose(f);
+}
+
+static void LoadResolvConf(std::string const& path, DnsResolver::Config & cfg)
+{
+    ForEachLine(path, [&](std::vector<std::string> const& words) {
+                if (words[0] == "nameserver" && words.size() > 1) {
+                    // 与glibc一致, 最多使用3个nameserver. 端口固定为53, IPv6地址加上[]再解析
+                    std::string const& host = words[1];
+                    sockaddr_in6 server;
+                    if (cfg.servers.size() < 3 && ParseServer(
+                                host.find(':') == std::string::npos ? host : "[" + host + "]", server))
+                        cfg.servers.push_back(server);
+                } else if (words[0] == "search" || words[0] == "domain") {
+                    cfg.search.assign(words.begin() + 1, words.end());
+                } else if (words[0] == "options") {
+                    for (std::size_t i = 1; i < words.size(); ++i) {
+                        std::string const& opt = words[i];
+                        if (opt.compare(0, 6, "ndots:") == 0)
+                            cfg.ndots = (std::min)(atoi(opt.c_str() + 6), 15);
+                        else if (opt.compare(0, 8, "timeout:") == 0)
+                            cfg.timeout_ms = (std::max)(atoi(opt.c_str() + 8), 1) * 1000;
+                        else if (opt.compare(0, 9, "attempts:") == 0)
+                            cfg.attempts = (std::max)((std::min)(atoi(opt.c_str() + 9), 5), 1);
+                    }
+                }
+            });
+
+    for (auto & s : cfg.search)
+        s = ToLower(s);
+}
+
+static void LoadHosts(std::string const& path, DnsResolver::Config & cfg)
+{
+    ForEachLine(path, [&](std::vector<std::string> const& words) {
+                DnsAddress addr;
+                if (words.size() < 2 || !ParseAddress(words[0], addr))
+                    return ;
+
+                for (std::size_t i = 1; i < words.size(); ++i)
+                    cfg.hosts[ToLower(words[i])].push_back(addr);
+            });
+}
+
+// 没有nsswitch.conf时glibc按"dns files"查找, 与内置的解析顺序不同
+static void LoadNsswitch(std::string const& path, DnsResolver::Config & cfg)
+{
+    ForEachLine(path, [&](std::vector<std::string> const& words) {
+                if (words[0] == "hosts:")
+                    cfg.nss_files_dns = words.size() == 3 && words[1] == "files" && words[2] == "dns";
+            });
+}
+
+// ---------------------------- 报文 ----------------------------
+static bool BuildQuery(std::string const& name, uint16_t id, uint16_t qtype, std::string & out)
+{
+    out.clear();
+    const uint8_t header[12] = {(uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00,    // RD
+        0, 1, 0, 0, 0, 0, 0, 0};
+    out.append((const char*)header, sizeof(header));
+
+    std::size_t begin = 0;
+    while (begin < name.size()) {
+        std::size_t end = name.find('.', begin);
+        if (end == std::string::npos) end = name.size();
+        std::size_t len = end - begin;
+        if (len == 0 || len > 63)
+            return false;
+        out.push_back((char)len);
+        out.append(name, begin, len);
+        begin = end + 1;
+    }
+    out.push_back('\0');
+    if (out.size() - sizeof(header) > 255)
+        return false;
+
+    const uint8_t tail[4] = {(uint8_t)(qtype >> 8), (uint8_t)qtype, 0, 1};   // IN
+    out.append((const char*)tail, sizeof(tail));
+    return true;
+}
+
+static uint16_t Read16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t Read32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool SkipName(const uint8_t* msg, std::size_t len, std::size_t & pos)
+{
+    while (pos < len) {
+        uint8_t c = msg[pos];
+        if (c == 0) {
+            ++pos;
+            return true;
+        }
+        if ((c & 0xC0) == 0xC0) {   // 压缩指针
+            pos += 2;
+            return pos <= len;
+        }
+        if (c & 0xC0)
+            return false;
+        pos += 1 + c;
+    }
+    return false;
+}
+
+// @return: 报文格式错误时返回false
+static bool ParseReply(const uint8_t* msg, std::size_t len, uint16_t qtype, DnsReply & reply)
+{
+    if (len < 12) return false;
+
+    uint16_t flags = Read16(msg + 2);
+    int qdcount = Read16(msg + 4), ancount = Read16(msg + 6), nscount = Read16(msg + 8);
+    reply.rcode = flags & 0xF;
+
+    std::size_t pos = 12;
+    for (int i = 0; i < qdcount; ++i) {
+        if (!SkipName(msg, len, pos)) return false;
+        pos += 4;
+    }
+
+    for (int i = 0; i < ancount + nscount; ++i) {
+        if (!SkipName(msg, len, pos) || pos + 10 > len) return false;
+        uint16_t type = Read16(msg + pos);
+        uint16_t cls = Read16(msg + pos + 2);
+        uint32_t ttl = Read32(msg + pos + 4);
+        uint16_t rdlen = Read16(msg + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) return false;
+
+        const uint8_t* rdata = msg + pos;
+        if (i < ancount) {
+            // CNAME链中的记录也计入TTL
+            reply.ttl = (std::min)(reply.ttl, ttl);
+            if (cls == 1 && type == qtype && type == kTypeA && rdlen == 4) {
+                DnsAddress addr;
+                addr.family = AF_INET;
+                memcpy(&addr.v4, rdata, 4);
+                reply.addrs.push_back(addr);
+            } else if (cls == 1 && type == qtype && type == kTypeAAAA && rdlen == 16) {
+                DnsAddress addr;
+                addr.family = AF_INET6;
+                memcpy(&addr.v6, rdata, 16);
+                reply.addrs.push_back(addr);
+            }
+        } else if (type == kTypeSOA) {
+            // 否定应答的缓存时间: SOA记录的TTL与MINIMUM字段中较小的一个(RFC 2308)
+            std::size_t p = pos;
+            if (SkipName(msg, len, p) && SkipName(msg, len, p) && p + 20 <= pos + rdlen)
+                reply.negative_ttl = (std::min)(ttl, Read32(msg + p + 16));
+        }
+        pos += rdlen;
+    }
+    return true;
+}
+
+static uint16_t NextQueryId()
+{
+    static thread_local std::mt19937 rng(std::random_device{}());
+    return (uint16_t)rng();
+}
+
+static socklen_t ServerLen(sockaddr_in6 const& server)
+{
+    return server.sin6_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+}
+
+// 距离截止时间的毫秒数, 已经超时返回0(不再等待)
+static int LeftMs(std::chrono::steady_clock::time_point deadline)
+{
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+    return (std::max)(left, 0);
+}
+
+// 在截止时间前收满len字节. socket是非阻塞的, MSG_WAITALL不能保证收满.
+static bool RecvAll(int fd, void* buf, std::size_t len, std::chrono::steady_clock::time_point deadline)
+{
+    std::size_t pos = 0;
+    while (pos < len) {
+        ssize_t n = net::recv(fd, (char*)buf + pos, len - pos, 0, LeftMs(deadline));
+        if (n <= 0) return false;
+        pos += n;
+    }
+    return true;
+}
+
+// 应答被截断时改用TCP重新查询
+// 使用co::net的接口, DISABLE_HOOK时同样只挂起当前协程.
+static bool TcpExchange(sockaddr_in6 const& server, std::string const& query,
+        uint16_t qtype, int timeout_ms, DnsReply & reply)
+{
+    int fd = socket(server.sin6_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool ok = false;
+    std::string msg;
+    msg.push_back((char)(query.size() >> 8));
+    msg.push_back((char)query.size());
+    msg += query;
+    uint8_t len_buf[2];
+    if (net::connect(fd, (const sockaddr*)&server, ServerLen(server), timeout_ms) == 0
+            && net::send(fd, msg.data(), msg.size(), MSG_NOSIGNAL, LeftMs(deadline)) == (ssize_t)msg.size()
+            && RecvAll(fd, len_buf, 2, deadline)) {
+        std::vector<uint8_t> buf(Read16(len_buf));
+        if (!buf.empty() && RecvAll(fd, &buf[0], buf.size(), deadline)
+                && Read16(&buf[0]) == Read16((const uint8_t*)query.data()))
+            ok = ParseReply(&buf[0], buf.size(), qtype, reply);
+    }
+    net::close(fd);
+    reply.received = ok;
+    return ok;
+}
+
+// 向一个nameserver同时发出几个查询, 等待全部应答或超时.
+// @return: 是否收到了全部应答
+static bool Exchange(sockaddr_in6 const& server, std::string const& name,
+        std::vector<uint16_t> const& qtypes, int timeout_ms, std::vector<DnsReply> & replies)
+{
+    int fd = socket(server.sin6_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return false;
+
+    // connect之后只会收到这个nameserver的应答
+    if (net::connect(fd, (const sockaddr*)&server, ServerLen(server)) == -1) {
+        net::close(fd);
+        return false;
+    }
+
+    std::vector<std::string> queries(qtypes.size());
+    std::vector<uint16_t> ids(qtypes.size());
+    for (std::size_t i = 0; i < qtypes.size(); ++i) {
+        ids[i] = NextQueryId();
+        if (!BuildQuery(name, ids[i], qtypes[i], queries[i]))
+            replies[i].received = true;     // 非法的域名, 按不存在处理
+        else
+            net::send(fd, queries[i].data(), queries[i].size(), 0, 0);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::size_t done = std::count_if(replies.begin(), replies.end(),
+            [](DnsReply const& r){ return r.received; });
+    uint8_t buf[1500];
+    while (done < qtypes.size()) {
+        int left = LeftMs(deadline);
+        if (left <= 0) break;
+
+        pollfd pfd = {fd, POLLIN, 0};
+        if (net::poll(&pfd, 1, left) <= 0) break;
+
+        ssize_t n = net::recv(fd, buf, sizeof(buf), 0, 0);
+        if (n < 12) {
+            if (n == -1 && errno != EAGAIN && errno != EINTR) break;   // 如ICMP端口不可达
+            continue;
+        }
+
+        // 不是应答或者不匹配查询ID的报文直接丢弃
+        if (!(buf[2] & 0x80)) continue;
+        for (std::size_t i = 0; i < qtypes.size(); ++i) {
+            if (replies[i].received || ids[i] != Read16(buf))
+                continue;
+
+            if (buf[2] & 0x02) {    // TC
+                // 截断的应答不会再从UDP收到, TCP失败时直接换下一个nameserver
+                if (!TcpExchange(server, queries[i], qtypes[i], timeout_ms, replies[i])) {
+                    net::close(fd);
+                    return false;
+                }
+            } else if (ParseReply(buf, n, qtypes[i], replies[i])) {
+                replies[i].received = true;
+            }
+            if (replies[i].received)
+                ++done;
+            break;
+        }
+    }
+    net::close(fd);
+    return done == qtypes.size();
+}
+
+// ---------------------------- DnsResolver ----------------------------
+DnsResolver& DnsResolver::getInstance()
+{
+    static DnsResolver *obj = new DnsResolver;
+    return *obj;
+}
+
+void DnsResolver::SetConfigFiles(std::string const& resolv_conf, std::string const& hosts,
+        std::string const& nsswitch)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    resolv_conf_ = resolv_conf;
+    hosts_ = hosts;
+    nsswitch_ = nsswitch;
+    config_.reset();
+}
+
+bool DnsResolver::IsNssCompatible()
+{
+    return GetConfig()->nss_files_dns;
+}
+
+bool DnsResolver::SetNameServers(std::vector<std::string> const& servers)
+{
+    std::vector<sockaddr_in6> addrs(servers.size());
+    for (std::size_t i = 0; i < servers.size(); ++i)
+        if (!ParseServer(servers[i], addrs[i]))
+            return false;
+
+    std::unique_lock<LFLock> lock(lock_);
+    servers_.swap(addrs);
+    config_.reset();
+    return true;
+}
+
+void DnsResolver::ClearCache()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    cache_.clear();
+}
+
+DnsStat const& DnsResolver::GetStat()
+{
+    return stat_;
+}
+
+DnsResolver::ConfigPtr DnsResolver::GetConfig()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::string resolv_conf, hosts, nsswitch;
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        if (config_ && now < next_check_)
+            return config_;
+
+        next_check_ = now + std::chrono::seconds(1);
+        resolv_conf = resolv_conf_;
+        hosts = hosts_;
+        nsswitch = nsswitch_;
+    }
+
+    std::string version = FileVersion(resolv_conf) + "|" + FileVersion(hosts)
+        + "|" + FileVersion(nsswitch);
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        if (config_ && version == config_version_)
+            return config_;
+    }
+
+    std::shared_ptr<Config> cfg = std::make_shared<Config>();
+    LoadResolvConf(resolv_conf, *cfg);
+    LoadHosts(hosts, *cfg);
+    LoadNsswitch(nsswitch, *cfg);
+
+    std::unique_lock<LFLock> lock(lock_);
+    if (!servers_.empty())
+        cfg->servers = servers_;
+    if (cfg->servers.empty()) {
+        // 与glibc一致, 没有配置nameserver时使用本机
+        sockaddr_in6 server;
+        ParseServer("127.0.0.1", server);
+        cfg->servers.push_back(server);
+    }
+    config_ = cfg;
+    config_version_ = version;
+    return config_;
+}
+
+DnsResolver::Entry DnsResolver::Query(ConfigPtr const& cfg, std::string const& name, int family)
+{
+    // 与glibc一致: 点数不少于ndots时先按绝对域名查询, 否则先加search域
+    std::vector<std::string> candidates;
+    if (name.back() == '.') {
+        candidates.push_back(name.substr(0, name.size() - 1));
+    } else {
+        bool absolute_first = (int)std::count(name.begin(), name.end(), '.') >= cfg->ndots;
+        if (absolute_first) candidates.push_back(name);
+        for (auto & domain : cfg->search)
+            candidates.push_back(name + "." + domain);
+        if (!absolute_first) candidates.push_back(name);
+    }
+
+    std::vector<uint16_t> qtypes;
+    if (family != AF_INET6) qtypes.push_back(kTypeA);
+    if (family != AF_INET) qtypes.push_back(kTypeAAAA);
+
+    Entry entry;
+    entry.error = EAI_AGAIN;
+    bool answered = false;      // 有nameserver明确答复了域名不存在或没有地址
+    uint32_t negative_ttl = kMaxNegativeTtl;
+    for (auto & candidate : candidates) {
+        bool done = false;
+        for (int attempt = 0; attempt < cfg->attempts && !done; ++attempt) {
+            for (auto & server : cfg->servers) {
+                std::vector<DnsReply> replies(qtypes.size());
+                stat_.queries += qtypes.size();
+                if (!Exchange(server, candidate, qtypes, cfg->timeout_ms, replies))
+                    continue;
+
+                // SERVFAIL、REFUSED等, 换下一个nameserver
+                bool server_failed = false;
+                for (auto & r : replies)
+                    if (r.rcode != 0 && r.rcode != 3)
+                        server_failed = true;
+                if (server_failed)
+                    continue;
+
+                done = true;
+                uint32_t ttl = kMaxTtl;
+                for (auto & r : replies) {
+                    entry.addrs.insert(entry.addrs.end(), r.addrs.begin(), r.addrs.end());
+                    ttl = (std::min)(ttl, r.addrs.empty() ? r.negative_ttl : r.ttl);
+                }
+
+                if (!entry.addrs.empty()) {
+                    entry.error = 0;
+                    entry.expire = std::chrono::steady_clock::now() + std::chrono::seconds(ttl);
+                    return entry;
+                }
+
+                answered = true;
+                negative_ttl = (std::min)(negative_ttl, ttl);
+                break;
+            }
+        }
+    }
+
+    if (answered) {
+        entry.error = EAI_NONAME;
+        entry.expire = std::chrono::steady_clock::now() + std::chrono::seconds(negative_ttl);
+    } else {
+        // nameserver都没有应答, 不缓存
+        entry.expire = std::chrono::steady_clock::now();
+    }
+    return entry;
+}
+
+int DnsResolver::Resolve(std::string const& name, int family, std::vector<DnsAddress> & addrs)
+{
+    addrs.clear();
+    if (name.empty() || name == ".")
+        return EAI_NONAME;
+    if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6)
+        return EAI_FAMILY;
+
+    std::string lname = ToLower(name);
+    ConfigPtr cfg = GetConfig();
+
+    // hosts文件中只有另一种协议的地址时, 继续查询DNS
+    auto hit = cfg->hosts.find(lname.back() == '.' ? lname.substr(0, lname.size() - 1) : lname);
+    if (hit != cfg->hosts.end()) {
+        for (auto & addr : hit->second)
+            if (family == AF_UNSPEC || family == addr.family)
+                addrs.push_back(addr);
+        if (!addrs.empty())
+            return 0;
+    }
+
+    std::string key = lname + "/" + std::to_string(family);
+    PendingPtr pending;
+    bool leader = false;
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        auto now = std::chrono::steady_clock::now();
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            if (now < it->second.expire) {
+                ++stat_.cache_hits;
+                addrs = it->second.addrs;
+                return it->second.error;
+            }
+            cache_.erase(it);
+        }
+
+        PendingPtr & slot = pending_[key];
+        if (!slot) {
+            slot = std::make_shared<Pending>();
+            slot->by_.lock();
+            leader = true;
+        }
+        pending = slot;
+    }
+
+    if (!leader) {
+        // 等待发起查询的协程完成
+        ++stat_.coalesced;
+        pending->by_.lock();
+        pending->by_.unlock();
+        addrs = pending->result.addrs;
+        return pending->result.error;
+    }
+
+    Entry entry = Query(cfg, lname, family);
+    DebugPrint(dbg_hook, "dns resolve %s family=%d returns %d, %d addresses",
+            name.c_str(), family, entry.error, (int)entry.addrs.size());
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        auto now = std::chrono::steady_clock::now();
+        if (entry.expire > now) {
+            if (cache_.size() >= kMaxCacheEntries) {
+                for (auto it = cache_.begin(); it != cache_.end();)
+                    if (it->second.expire <= now)
+                        it = cache_.erase(it);
+                    else
+                        ++it;
+                if (cache_.size() >= kMaxCacheEntries)
+                    cache_.clear();
+            }
+            cache_[key] = entry;
+        }
+        pending_.erase(key);
+        pending->result = entry;
+    }
+    pending->by_.unlock();
+
+    addrs = entry.addrs;
+    return entry.error;
+}
+
+} //namespace co
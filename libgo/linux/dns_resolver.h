@@ -0,0 +1,120 @@
+/************************************************
+ * 协程中的域名解析: glibc的getaddrinfo/gethostbyname同步收发UDP,
+ *     nameserver响应慢或丢包时会阻塞整个调度线程数秒.
+ * 内置的DNS客户端使用被hook的socket收发, 等待期间只挂起当前协程.
+ * 依次查找hosts文件、共享缓存(按记录的TTL过期)、resolv.conf中的nameserver,
+ *     同一个域名正在查询时, 其他协程等待这一次查询的结果, 不再重复发出.
+ * 只实现了nsswitch中的files和dns, 不经过NSS模块, 也不按gai.conf排序.
+ *     因此hook只在开启enable_dns_resolver、且nsswitch.conf的hosts恰好为"files dns"时使用它.
+*************************************************/
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <atomic>
+#include <netinet/in.h>
+#include "spinlock.h"
+#include "co_mutex.h"
+
+namespace co
+{
+
+// 解析得到的一个地址
+struct DnsAddress
+{
+    int family;         // AF_INET or AF_INET6
+    union {
+        in_addr v4;
+        in6_addr v6;
+    };
+};
+
+struct DnsStat
+{
+    std::atomic<uint64_t> queries{0};       // 发给nameserver的查询数
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> coalesced{0};     // 等待其他协程正在进行的查询
+};
+
+class DnsResolver
+{
+public:
+    static DnsResolver& getInstance();
+
+    // 解析域名, 在协程中调用时只挂起当前协程.
+    // 同时查询IPv4和IPv6时, IPv4地址在前.
+    // @family: AF_INET, AF_INET6 or AF_UNSPEC
+    // @return: 0或EAI_*错误码
+    int Resolve(std::string const& name, int family, std::vector<DnsAddress> & addrs);
+
+    // 配置文件路径, 默认为/etc/resolv.conf、/etc/hosts和/etc/nsswitch.conf. 文件修改后自动重新加载.
+    void SetConfigFiles(std::string const& resolv_conf, std::string const& hosts,
+            std::string const& nsswitch = "/etc/nsswitch.conf");
+
+    // nsswitch.conf中hosts的配置是否恰好为"files dns", 即: 内置的解析与glibc查找的数据源一致.
+    bool IsNssCompatible();
+
+    // 替换resolv.conf中的nameserver, 格式为"ip"、"ip:port"或"[ipv6]:port".
+    // 为空时恢复使用resolv.conf中的nameserver.
+    // @return: 有无法解析的地址时返回false, 不做修改
+    bool SetNameServers(std::vector<std::string> const& servers);
+
+    void ClearCache();
+
+    DnsStat const& GetStat();
+
+public:
+    struct Config
+    {
+        std::vector<sockaddr_in6> servers;  // IPv4地址保存为sockaddr_in
+        std::vector<std::string> search;
+        int ndots = 1;
+        int timeout_ms = 5000;              // 每次查询等待一个nameserver的时间
+        int attempts = 2;
+        std::unordered_map<std::string, std::vector<DnsAddress>> hosts;
+        bool nss_files_dns = false;
+    };
+    typedef std::shared_ptr<const Config> ConfigPtr;
+
+    struct Entry
+    {
+        int error = 0;
+        std::vector<DnsAddress> addrs;
+        std::chrono::steady_clock::time_point expire;
+    };
+
+    // 正在进行的查询, 查询结束前by_ 一直被发起查询的协程锁住
+    struct Pending
+    {
+        CoMutex by_;
+        Entry result;
+    };
+    typedef std::shared_ptr<Pending> PendingPtr;
+
+private:
+    DnsResolver() = default;
+
+    // hosts、resolv.conf和nsswitch.conf至多每秒检查一次是否被修改
+    ConfigPtr GetConfig();
+
+    // 按search域依次查询
+    Entry Query(ConfigPtr const& cfg, std::string const& name, int family);
+
+private:
+    LFLock lock_;
+    std::string resolv_conf_ = "/etc/resolv.conf";
+    std::string hosts_ = "/etc/hosts";
+    std::string nsswitch_ = "/etc/nsswitch.conf";
+    std::vector<sockaddr_in6> servers_;     // SetNameServers设置的nameserver
+    ConfigPtr config_;
+    std::chrono::steady_clock::time_point next_check_;
+    std::string config_version_;
+
+    std::unordered_map<std::string, Entry> cache_;
+    std::unordered_map<std::string, PendingPtr> pending_;
+    DnsStat stat_;
+};
+
+} //namespace co
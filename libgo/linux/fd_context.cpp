@@ -1,11 +1,17 @@
 #include <sys/epoll.h>
 #include <sys/stat.h>
 #include <sys/fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <assert.h>
 #include "fd_context.h"
 #include "task.h"
 #include "scheduler.h"
 #include "linux_glibc_hook.h"
+#include "uring_wait.h"
 
 namespace co {
 
@@ -31,6 +37,69 @@ bool IoSentry::switch_state_to_triggered()
     return std::atomic_compare_exchange_strong(&io_state_, &expected, (long)triggered);
 }
 
+TaskWaiter::TaskWaiter(IoSentryPtr const& sentry)
+    : tk_(sentry->task_ptr_.get()), sentry_(sentry)
+{
+}
+
+void TaskWaiterSet::insert(value_type const& w)
+{
+    value_type* kv = find(w.tk_);
+    if (kv) {
+        *kv = w;
+        return ;
+    }
+
+    if (!first_.tk_) {
+        first_ = w;
+        return ;
+    }
+
+    if (!more_)
+        more_ = new std::vector<value_type>;
+    more_->push_back(w);
+}
+TaskWaiterSet::value_type* TaskWaiterSet::find(Task* tk)
+{
+    if (first_.tk_ == tk && tk) return &first_;
+    if (more_)
+        for (auto & kv : *more_)
+            if (kv.tk_ == tk)
+                return &kv;
+    return nullptr;
+}
+bool TaskWaiterSet::erase(Task* tk)
+{
+    value_type* kv = find(tk);
+    if (!kv) return false;
+
+    // 用最后一项填补空位
+    value_type* last = (more_ && !more_->empty()) ? &more_->back() : &first_;
+    if (kv != last)
+        *kv = std::move(*last);
+    if (last == &first_) {
+        first_ = value_type();
+    } else {
+        more_->pop_back();
+        if (more_->empty()) {
+            delete more_;
+            more_ = nullptr;
+        }
+    }
+    return true;
+}
+std::size_t TaskWaiterSet::size() const
+{
+    if (!first_.tk_) return 0;
+    return 1 + (more_ ? more_->size() : 0);
+}
+void TaskWaiterSet::clear()
+{
+    first_ = value_type();
+    delete more_;
+    more_ = nullptr;
+}
+
 FileDescriptorCtx::FileDescriptorCtx(int fd)
     : fd_(fd)
 {
@@ -40,7 +109,9 @@ FileDescriptorCtx::~FileDescriptorCtx()
 {
     assert(i_tasks_.empty());
     assert(o_tasks_.empty());
-    assert(io_tasks_.empty());
+    assert(!extra_ || extra_->io_tasks_.empty());
+    assert(!extra_ || extra_->e_tasks_.empty());
+    assert(!extra_ || extra_->uring_tasks_.empty());
     assert(pending_events_ == 0);
     assert(closed_);
     DebugPrint(dbg_fd_ctx, "fd(%p:%d) context destruct", this, fd_);
@@ -50,34 +121,61 @@ bool FileDescriptorCtx::re_initialize()
     if (is_initialize())
         return true;
 
-    recv_o_ = timeval{0, 0};
-    send_o_ = timeval{0, 0};
+    recv_o_ = send_o_ = 0;
+    bool is_tty = false;
     struct stat fd_stat;
     if (-1 == fstat(fd_, &fd_stat)) {
         is_initialize_ = false;
         is_socket_ = false;
+        is_regular_file_ = false;
+        is_pollable_ = false;
     } else {
         is_initialize_ = true;
         is_socket_ = S_ISSOCK(fd_stat.st_mode);
+        is_regular_file_ = S_ISREG(fd_stat.st_mode) || S_ISBLK(fd_stat.st_mode);
+        // eventfd、timerfd、signalfd、inotify等匿名inode没有文件类型.
+        // 字符设备中只有终端可以epoll, /dev/null等仍然直接读写.
+        is_tty = S_ISCHR(fd_stat.st_mode) && isatty(fd_);
+        is_pollable_ = is_socket_ || is_tty || S_ISFIFO(fd_stat.st_mode)
+            || (fd_stat.st_mode & S_IFMT) == 0;
     }
 
+    user_nonblock_ = false;
     if (is_socket_) {
         int flags = fcntl_f(fd_, F_GETFL, 0);
         if (!(flags & O_NONBLOCK))
             fcntl_f(fd_, F_SETFL, flags | O_NONBLOCK);
 
         sys_nonblock_ = true;
+    } else if (is_pollable_) {
+        // 非socket的fd可能是其他库创建的(如EFD_NONBLOCK的eventfd), 保留用户原有的设置.
+        int flags = fcntl_f(fd_, F_GETFL, 0);
+        user_nonblock_ = !!(flags & O_NONBLOCK);
+
+        // 终端和继承来的标准输入输出与其他进程共享O_NONBLOCK标志, 不修改它,
+        // hook中先等到就绪再调用.
+        if (fd_ > 2 && !is_tty) {
+            if (!(flags & O_NONBLOCK))
+                fcntl_f(fd_, F_SETFL, flags | O_NONBLOCK);
+            sys_nonblock_ = true;
+        } else {
+            sys_nonblock_ = false;
+        }
     } else {
         sys_nonblock_ = false;
-        recv_o_ = send_o_ = timeval{0, 0};
+        recv_o_ = send_o_ = 0;
     }
 
-    user_nonblock_ = false;
     closed_ = false;
     pending_events_ = 0;
+    edge_triggered_ = is_socket_ && g_Scheduler.GetOptions().epoll_edge_triggered;
+    et_owner_pid_ = -1;
+    ready_events_ = POLLIN | POLLOUT;
+    zc_enabled_ = zc_fallback_ = false;
+    zc_sent_ = zc_done_ = 0;
     DebugPrint(dbg_fd_ctx, "fd(%p:%d) context construct. "
-            "is_socket(%d) sys_nonblock(%d) user_nonblock(%d)",
-            this, fd_, (int)is_socket_, (int)sys_nonblock_, (int)user_nonblock_);
+            "is_socket(%d) is_pollable(%d) sys_nonblock(%d) user_nonblock(%d)",
+            this, fd_, (int)is_socket_, (int)is_pollable_, (int)sys_nonblock_, (int)user_nonblock_);
 
     return is_initialize();
 }
@@ -90,6 +188,14 @@ bool FileDescriptorCtx::is_socket()
 {
     return is_socket_;
 }
+bool FileDescriptorCtx::is_regular_file()
+{
+    return is_regular_file_;
+}
+bool FileDescriptorCtx::is_pollable()
+{
+    return is_pollable_;
+}
 bool FileDescriptorCtx::closed()
 {
     return closed_;
@@ -101,28 +207,57 @@ int FileDescriptorCtx::close(bool call_syscall)
     DebugPrint(dbg_fd_ctx, "close fd(%p:%d) call_syscall:%d", this, fd_, (int)call_syscall);
     closed_ = true;
     set_pending_events(0);
+    if (edge_triggered_ && et_owner_pid_ == getpid() && !call_syscall) {
+        // 不关闭fd时, 需要手动从epoll中移除
+        g_Scheduler.GetIoWait().reactor_ctl(GetEpollFd(), EPOLL_CTL_DEL, fd_, 0, is_pollable());
+    }
+    {
+        std::unique_lock<LFLock> fd_lock(epoll_fd_mtx_);
+        if (reactor_ != -1 && owner_pid_ == getpid())
+            g_Scheduler.GetIoWait().OnReactorChanged(reactor_, -1);
+        reactor_ = -1;
+    }
+    et_owner_pid_ = -1;
+    ready_events_ = POLLIN | POLLOUT;
     int ret = 0;
     if (call_syscall)
         ret = close_f(fd_);
 
-    TaskWSet *tasks_arr[3] = {&i_tasks_, &o_tasks_, &io_tasks_};
-    for (int i = 0; i < 3; ++i)
+    TaskWSet *tasks_arr[4] = {&i_tasks_, &o_tasks_,
+        extra_ ? &extra_->io_tasks_ : nullptr, extra_ ? &extra_->e_tasks_ : nullptr};
+    for (int i = 0; i < 4; ++i)
     {
+        if (!tasks_arr[i]) continue;
         TaskWSet & tasks = *tasks_arr[i];
-        for (auto &kv : tasks)
+        tasks.for_each([this](TaskWSet::value_type & kv)
         {
-            IoSentryPtr sptr = kv.second.lock();
-            if (!sptr) continue;
+            if (kv.expired()) return;
             DebugPrint(dbg_fd_ctx, "close fd(%p:%d) trigger task(%s)", this, fd_,
-                    sptr->task_ptr_->DebugInfo());
-            for (auto &pfd : sptr->watch_fds_)
-                if (pfd.fd == fd_)
-                    pfd.revents = POLLNVAL;
-            g_Scheduler.GetIoWait().IOBlockTriggered(sptr);
-        }
+                    kv.tk_->DebugInfo());
+            trigger_waiter(kv, POLLNVAL);
+        });
         tasks.clear();
     }
 
+    if (!extra_)
+        return ret;
+
+    // 已提交给io_uring的操作持有file引用, 需要取消掉, 协程会以-ECANCELED被唤醒.
+    extra_->uring_tasks_.for_each([this](TaskWSet::value_type & kv)
+    {
+        IoSentryPtr sptr = kv.sentry_.lock();
+        if (!sptr) return;
+        DebugPrint(dbg_fd_ctx, "close fd(%p:%d) cancel uring task(%s)", this, fd_,
+                sptr->task_ptr_->DebugInfo());
+        sptr->uring_->Cancel((uint64_t)sptr.get());
+    });
+    extra_->uring_tasks_.clear();
+
+    if (extra_->uring_accept_) {
+        extra_->uring_accept_->Close();
+        extra_->uring_accept_.reset();
+    }
+
     return ret;
 }
 void FileDescriptorCtx::set_user_nonblock(bool b)
@@ -143,19 +278,19 @@ bool FileDescriptorCtx::sys_nonblock()
 }
 void FileDescriptorCtx::set_time_o(int type, timeval const& tv)
 {
+    // 不足1毫秒的非零超时按1毫秒计
+    long long ms = (long long)tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+    int v = (int)(std::min)(ms, (long long)INT_MAX);
     std::unique_lock<std::mutex> lock(lock_);
     if (type == SO_RCVTIMEO)
-        recv_o_ = tv;
+        recv_o_ = v;
     else
-        send_o_ = tv;
+        send_o_ = v;
 }
-void FileDescriptorCtx::get_time_o(int type, timeval *tv)
+int FileDescriptorCtx::get_time_o(int type)
 {
     std::unique_lock<std::mutex> lock(lock_);
-    if (type == SO_RCVTIMEO)
-        *tv = recv_o_;
-    else
-        *tv = send_o_;
+    return type == SO_RCVTIMEO ? recv_o_ : send_o_;
 }
 bool FileDescriptorCtx::add_into_reactor(int poll_events, IoSentryPtr sentry)
 {
@@ -166,20 +301,40 @@ bool FileDescriptorCtx::add_into_reactor(int poll_events, IoSentryPtr sentry)
             "task(%s) add_into_reactor fd(%p:%d) poll_events(%d) pending_events(%d)",
             sentry->task_ptr_->DebugInfo(), this, fd_, poll_events, pending_events_);
 
+    return add_into_reactor_locked(poll_events, TaskWaiter(sentry));
+}
+bool FileDescriptorCtx::add_into_reactor(int poll_events, Task* tk, uint32_t io_sequence)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed()) return false;
+
+    DebugPrint(dbg_fd_ctx,
+            "task(%s) add_into_reactor fd(%p:%d) poll_events(%d) pending_events(%d) seq(%u)",
+            tk->DebugInfo(), this, fd_, poll_events, pending_events_, io_sequence);
+
+    return add_into_reactor_locked(poll_events, TaskWaiter(tk, io_sequence, poll_events));
+}
+bool FileDescriptorCtx::add_into_reactor_locked(int poll_events, TaskWaiter const& w)
+{
+    if (edge_triggered_)
+        return add_into_reactor_et(poll_events, w);
+
     TaskWSet &tk_set = ChooseSet(poll_events);
 
     poll_events &= (POLLIN | POLLOUT);  // strip err, hup, rdhup ...
+    if (!poll_events)
+        poll_events = POLLERR;  // 只等待错误事件时也需要留在epoll中
     if (poll_events & ~pending_events_) {
         uint32_t events = pending_events_ | poll_events;
         if (!pending_events_) {
             // 之前不再epoll中, 使用ADD添加
             if (-1 == g_Scheduler.GetIoWait().reactor_ctl(GetEpollFd(),
-                        EPOLL_CTL_ADD, fd_, events, is_socket()))
+                        EPOLL_CTL_ADD, fd_, events, is_pollable()))
                 return false;
         } else {
             // 之前在epoll中, 使用MOD修改关注的事件
             int res = g_Scheduler.GetIoWait().reactor_ctl(GetEpollFd(), 
-                    EPOLL_CTL_MOD, fd_, events, is_socket());
+                    EPOLL_CTL_MOD, fd_, events, is_pollable());
             if (res == -1) {
                 if (errno == ENOENT) {
                     assert(false);  // add和del之间有锁在控制, 不应该走到这里.
@@ -194,10 +349,10 @@ bool FileDescriptorCtx::add_into_reactor(int poll_events, IoSentryPtr sentry)
     }
 
     // add_into_reactor只会在协程中执行, 执行即表示旧的已失效, 所以可以直接覆盖.
-    tk_set[sentry->task_ptr_.get()] = sentry;
+    tk_set.insert(w);
     return true;
 }
-void FileDescriptorCtx::del_from_reactor(int poll_events, Task* tk)
+void FileDescriptorCtx::del_from_reactor(int poll_events, Task* tk, uint32_t io_sequence)
 {
     std::unique_lock<std::mutex> lock(lock_);
     if (closed()) return;
@@ -206,34 +361,50 @@ void FileDescriptorCtx::del_from_reactor(int poll_events, Task* tk)
             "del_from_reactor fd(%p:%d) poll_events(%d) pending_events(%d)",
             this, fd_, poll_events, pending_events_);
 
+    // IoSentry可能在其他线程(reactor或定时器)上最后析构, 此时协程可能已经开始了下一次等待,
+    // 并用新的等待者覆盖了这一项, 所以只删除已失效的sentry或者同一次快速路径的等待.
+    TaskWSet &tk_set = ChooseSet(poll_events);
+    TaskWSet::value_type* kv = tk_set.find(tk);
+    if (!kv) return ;
+    if (io_sequence ? kv->io_sequence_ != io_sequence : !kv->expired()) return ;
+
+    if (edge_triggered_) {
+        // 常驻在epoll中, 不需要修改关注的事件
+        tk_set.erase(tk);
+        return ;
+    }
+
     if (!pending_events_) return;
 
-    TaskWSet &tk_set = ChooseSet(poll_events);
-    if (!tk_set.erase(tk)) return ;
-
-    // 同一个fd允许被多个协程等待, 但不会被很多个协程等待, 所以此处可以遍历.
-    // 2016-04-13 16:35:34 @yyz IoSentry析构时会来删除对应的weak_ptr
-//    clear_expired_sentry();
-    if (!tk_set.empty()) return ;
-
-    // 所在等待队列空了, 检测是否可以减少监听的事件
-    int del_event = 0;
-    if (&tk_set == &i_tasks_) {
-        // POLLIN event
-        if (io_tasks_.empty())
-            del_event = POLLIN;
-    } else if (&tk_set == &o_tasks_) {
-        if (io_tasks_.empty())
-            del_event = POLLOUT;
-    } else if (&tk_set == &io_tasks_) {
-        if (i_tasks_.empty())
-            del_event |= POLLIN;
-        if (o_tasks_.empty())
-            del_event |= POLLOUT;
-    }
-
-    if (del_event)
-        del_events(del_event);
+    tk_set.erase(tk);
+
+    // 等待队列空了也不减少监听的事件: 超时返回、或者poll因为其他fd就绪而返回的协程,
+    // 下次再等待这个fd时(例如循环poll大量的fd)不需要重新epoll_ctl.
+    // 没有等待者时事件到来, 由reactor_trigger移除; close时随fd一起移除.
+}
+bool FileDescriptorCtx::add_into_uring(IoSentryPtr sentry)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed()) return false;
+
+    extra().uring_tasks_.insert(TaskWaiter(sentry));
+    return true;
+}
+void FileDescriptorCtx::del_from_uring(Task* tk)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (extra_)
+        extra_->uring_tasks_.erase(tk);
+}
+std::shared_ptr<UringAccept> FileDescriptorCtx::get_uring_accept()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed()) return std::shared_ptr<UringAccept>();
+
+    Extra & ex = extra();
+    if (!ex.uring_accept_)
+        ex.uring_accept_ = MakeShared<UringAccept>(fd_);
+    return ex.uring_accept_;
 }
 void FileDescriptorCtx::del_events(int poll_events)
 {
@@ -245,7 +416,7 @@ void FileDescriptorCtx::del_events(int poll_events)
     if (new_pending_event) {
         // 还有事件要监听, MOD
         if (-1 == g_Scheduler.GetIoWait().reactor_ctl(GetEpollFd(), 
-                    EPOLL_CTL_MOD, fd_, new_pending_event, is_socket()))
+                    EPOLL_CTL_MOD, fd_, new_pending_event, is_pollable()))
         {
             DebugPrint(dbg_fd_ctx, "fd(%p:%d) epoll_ctl_mod(events:%d) error:%s",
                     this, fd_, new_pending_event, strerror(errno));
@@ -253,7 +424,7 @@ void FileDescriptorCtx::del_events(int poll_events)
     } else {
         // 没有需要监听的事件了, 可以DEL了
         if (-1 == g_Scheduler.GetIoWait().reactor_ctl(GetEpollFd(), 
-                    EPOLL_CTL_DEL, fd_, 0, is_socket())) {
+                    EPOLL_CTL_DEL, fd_, 0, is_pollable())) {
             DebugPrint(dbg_fd_ctx, "fd(%p:%d) epoll_ctl_del error:%s", this, fd_,
                     strerror(errno));
         }
@@ -264,17 +435,19 @@ void FileDescriptorCtx::del_events(int poll_events)
 
 void FileDescriptorCtx::clear_expired_sentry()
 {
-    TaskWSet *tasks_arr[3] = {&i_tasks_, &o_tasks_, &io_tasks_};
-    for (int i = 0; i < 3; ++i)
+    TaskWSet *tasks_arr[4] = {&i_tasks_, &o_tasks_,
+        extra_ ? &extra_->io_tasks_ : nullptr, extra_ ? &extra_->e_tasks_ : nullptr};
+    for (int i = 0; i < 4; ++i)
     {
+        if (!tasks_arr[i]) continue;
         TaskWSet & tasks = *tasks_arr[i];
-        auto it = tasks.begin();
-        while (it != tasks.end()) {
-            if (it->second.expired())
-                it = tasks.erase(it);
-            else
-                ++it;
-        }
+        std::vector<Task*> expired;
+        tasks.for_each([&](TaskWSet::value_type & kv) {
+                    if (kv.expired())
+                        expired.push_back(kv.tk_);
+                });
+        for (Task* tk : expired)
+            tasks.erase(tk);
     }
 }
 
@@ -286,27 +459,41 @@ void FileDescriptorCtx::reactor_trigger(int poll_events, TriggerSet & output)
     DebugPrint(dbg_fd_ctx,
             "reactor_trigger fd(%p:%d) poll_events(%d) pending_events(%d)",
             this, fd_, poll_events, pending_events_);
+    ++trigger_count_;
+
+    if ((poll_events & POLLERR) && zc_sent_ != zc_done_)
+        poll_events = reactor_trigger_zerocopy(poll_events, output);
+
+    if (edge_triggered_) {
+        reactor_trigger_et(poll_events, output);
+        return ;
+    }
 
     if (poll_events & ~(POLLIN | POLLOUT)) {
         // has error
         DebugPrint(dbg_fd_ctx, "fd(%p:%d) trigger with error", this, fd_);
         trigger_task_list(i_tasks_, poll_events, output);
         trigger_task_list(o_tasks_, poll_events, output);
-        trigger_task_list(io_tasks_, poll_events, output);
-        del_events(POLLIN | POLLOUT);
+        if (extra_) {
+            trigger_task_list(extra_->io_tasks_, poll_events, output);
+            trigger_task_list(extra_->e_tasks_, poll_events, output);
+        }
+        del_events(POLLIN | POLLOUT | POLLERR);
     } else {
         if (poll_events & POLLIN) {
             // readable
             DebugPrint(dbg_fd_ctx, "fd(%p:%d) trigger with readable", this, fd_);
             trigger_task_list(i_tasks_, poll_events, output);
-            trigger_task_list(io_tasks_, poll_events, output);
+            if (extra_)
+                trigger_task_list(extra_->io_tasks_, poll_events, output);
         } 
         
         if (poll_events & POLLOUT) {
             // writable
             DebugPrint(dbg_fd_ctx, "fd(%p:%d) trigger with writable", this, fd_);
             trigger_task_list(o_tasks_, poll_events, output);
-            trigger_task_list(io_tasks_, poll_events, output);
+            if (extra_)
+                trigger_task_list(extra_->io_tasks_, poll_events, output);
         }
 
         del_events(poll_events);
@@ -317,10 +504,18 @@ void FileDescriptorCtx::trigger_task_list(TaskWSet & tasks,
         int events, TriggerSet & output)
 {
     auto self = this->shared_from_this();
-    for (auto & kv : tasks)
+    tasks.for_each([&](TaskWSet::value_type & kv)
     {
-        IoSentryPtr sptr = kv.second.lock();
-        if (!sptr) continue;
+        if (kv.io_sequence_) {
+            // 协程移除自己之前需要持有lock_, 此时Task一定还在, 增加引用计数后交给reactor.
+            kv.tk_->IncrementRef();
+            output.tasks_.push_back(TriggerSet::TaskTrigger{kv.tk_, kv.io_sequence_,
+                    (short)(events & (kv.events_ | ~(POLLIN | POLLOUT)))});
+            return;
+        }
+
+        IoSentryPtr sptr = kv.sentry_.lock();
+        if (!sptr) return;
 
         for (auto &pfd : sptr->watch_fds_)
             if (pfd.fd == fd_) {
@@ -332,24 +527,127 @@ void FileDescriptorCtx::trigger_task_list(TaskWSet & tasks,
                     pfd.revents = events & ~POLLOUT;
                 else
                     pfd.revents = events;
+
+                // 边缘触发时同时关注了读写, 只返回等待的事件
+                pfd.revents &= pfd.events | ~(POLLIN | POLLOUT);
             }
-        output.insert(sptr);
-    }
+        output.sentries_.push_back(std::move(sptr));
+    });
 
     tasks.clear();
 }
+void FileDescriptorCtx::trigger_waiter(TaskWaiter const& w, int revents)
+{
+    if (w.io_sequence_) {
+        g_Scheduler.GetIoWait().TaskTriggered(w.tk_, w.io_sequence_, revents);
+        return ;
+    }
+
+    IoSentryPtr sptr = w.sentry_.lock();
+    if (!sptr) return;
+
+    for (auto &pfd : sptr->watch_fds_)
+        if (pfd.fd == fd_)
+            pfd.revents = revents;
+    g_Scheduler.GetIoWait().IOBlockTriggered(sptr);
+}
+
+bool FileDescriptorCtx::add_into_reactor_et(int poll_events, TaskWaiter const& w)
+{
+    // 首次等待时注册, 以后一直留在epoll中直到close.
+    int epoll_fd = GetEpollFd();
+    if (et_owner_pid_ != owner_pid_) {
+        if (-1 == g_Scheduler.GetIoWait().reactor_ctl(epoll_fd, EPOLL_CTL_ADD, fd_,
+                    POLLIN | POLLOUT, is_pollable(), true)) {
+            // 没有注册成功就收不到事件, 缓存的未就绪状态不再可信.
+            et_owner_pid_ = -1;
+            ready_events_ |= POLLIN | POLLOUT;
+            return false;
+        }
+
+        et_owner_pid_ = owner_pid_;
+        // 注册时已经就绪的事件会由epoll报告一次, 之前的就绪缓存作废.
+        ready_events_ &= ~(POLLIN | POLLOUT);
+        DebugPrint(dbg_fd_ctx, "fd(%p:%d) add to epoll with edge-triggered", this, fd_);
+    }
+
+    // 上次返回EAGAIN之后到来的就绪事件不会再触发, 直接唤醒.
+    // 就绪状态保留到下一次EAGAIN, 错误事件一直保留到close.
+    int ready = ready_events_ & ((poll_events & (POLLIN | POLLOUT)) | POLLERR | POLLHUP);
+    if (ready) {
+        DebugPrint(dbg_fd_ctx, "fd(%p:%d) already ready(%d)", this, fd_, ready);
+        trigger_waiter(w, ready);
+        return true;
+    }
+
+    ChooseSet(poll_events).insert(w);
+    return true;
+}
+void FileDescriptorCtx::reactor_trigger_et(int poll_events, TriggerSet & output)
+{
+    ready_events_ |= poll_events;
+    ++ready_seq_;
+
+    if (poll_events & ~(POLLIN | POLLOUT)) {
+        DebugPrint(dbg_fd_ctx, "fd(%p:%d) trigger with error", this, fd_);
+        trigger_task_list(i_tasks_, poll_events, output);
+        trigger_task_list(o_tasks_, poll_events, output);
+        if (extra_) {
+            trigger_task_list(extra_->io_tasks_, poll_events, output);
+            trigger_task_list(extra_->e_tasks_, poll_events, output);
+        }
+        return ;
+    }
+
+    if (poll_events & POLLIN) {
+        trigger_task_list(i_tasks_, poll_events, output);
+        if (extra_)
+            trigger_task_list(extra_->io_tasks_, poll_events, output);
+    }
+
+    if (poll_events & POLLOUT) {
+        trigger_task_list(o_tasks_, poll_events, output);
+        if (extra_)
+            trigger_task_list(extra_->io_tasks_, poll_events, output);
+    }
+}
+bool FileDescriptorCtx::maybe_ready(int poll_events)
+{
+    if (!edge_triggered_) return true;
+    return ready_events_ & ((poll_events & (POLLIN | POLLOUT)) | POLLERR | POLLHUP);
+}
+uint32_t FileDescriptorCtx::ready_seq()
+{
+    return ready_seq_;
+}
+void FileDescriptorCtx::clear_ready(int poll_events, uint32_t seq)
+{
+    if (!edge_triggered_) return;
 
+    std::unique_lock<std::mutex> lock(lock_);
+    // 未注册到epoll时收不到边缘事件, 不能清除.
+    if (closed() || et_owner_pid_ == -1 || ready_seq_ != seq) return;
+    ready_events_ &= ~(poll_events & (POLLIN | POLLOUT));
+}
 FileDescriptorCtx::TaskWSet& FileDescriptorCtx::ChooseSet(int events)
 {
     events &= (POLLIN | POLLOUT);
-    if (events == POLLIN) {
+    if (!events) {
+        return extra().e_tasks_;
+    } else if (events == POLLIN) {
         return i_tasks_;
     } else if (events == POLLOUT) {
         return o_tasks_;
     } else {
-        return io_tasks_;
+        return extra().io_tasks_;
     }
 }
+FileDescriptorCtx::Extra& FileDescriptorCtx::extra()
+{
+    if (!extra_)
+        extra_.reset(new Extra);
+    return *extra_;
+}
 void FileDescriptorCtx::set_pending_events(int events)
 {
     DebugPrint(dbg_fd_ctx, "fd(%p:%d) switch pending from (%d) to (%d)",
@@ -360,125 +658,446 @@ int FileDescriptorCtx::GetEpollFd()
 {
     if (epoll_fd_ == -1 || owner_pid_ != getpid()) {
         std::unique_lock<LFLock> lock(epoll_fd_mtx_);
-        if (epoll_fd_ == -1 || owner_pid_ != getpid())
-            epoll_fd_ = g_Scheduler.GetIoWait().GetEpollFd();
-        owner_pid_ = getpid();
+        pid_t pid = getpid();
+        if (epoll_fd_ == -1 || owner_pid_ != pid) {
+            // 首次注册时归属于当前线程的reactor(netpoller模式下为专用轮询线程的reactor).
+            // fork后子进程中只有当前线程, 重新选择.
+            IoWait & io_wait = g_Scheduler.GetIoWait();
+            bool choose = reactor_ == -1 || owner_pid_ != pid;
+            int index = choose ? (int)io_wait.GetRegisterReactor() : reactor_;
+            // 先取epoll fd再计数: reactor首次创建epoll时会清零它的fd数量.
+            epoll_fd_ = io_wait.GetEpollFd(index);
+            if (choose) {
+                io_wait.OnReactorChanged(owner_pid_ == pid ? reactor_ : -1, index);
+                reactor_ = index;
+            }
+        }
+        owner_pid_ = pid;
     }
     return epoll_fd_;
 }
+int FileDescriptorCtx::reactor()
+{
+    return reactor_;
+}
+bool FileDescriptorCtx::set_reactor(std::size_t index)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed()) return false;
+
+    std::unique_lock<LFLock> fd_lock(epoll_fd_mtx_);
+    pid_t pid = getpid();
+    if (reactor_ == (int)index && owner_pid_ == pid) return true;
+
+    IoWait & io_wait = g_Scheduler.GetIoWait();
+    int epoll_fd = io_wait.GetEpollFd(index);
+    if (epoll_fd_ != -1 && owner_pid_ == pid) {
+        // 已经注册到旧的epoll中, 迁移期间的事件可能在两边各触发一次, 对等待者无害.
+        uint32_t events = 0;
+        if (edge_triggered_)
+            events = et_owner_pid_ == pid ? (POLLIN | POLLOUT) : 0;
+        else
+            events = pending_events_;
+
+        if (events) {
+            if (-1 == io_wait.reactor_ctl(epoll_fd, EPOLL_CTL_ADD, fd_, events,
+                        is_pollable(), edge_triggered_))
+                return false;
+            io_wait.reactor_ctl(epoll_fd_, EPOLL_CTL_DEL, fd_, 0, is_pollable());
+        }
+    }
+
+    DebugPrint(dbg_fd_ctx, "fd(%p:%d) move from reactor(%d) to reactor(%d)",
+            this, fd_, reactor_, (int)index);
+    io_wait.OnReactorChanged(owner_pid_ == pid ? reactor_ : -1, index);
+    reactor_ = index;
+    epoll_fd_ = epoll_fd;
+    owner_pid_ = pid;
+    return true;
+}
+// 错误队列中还可能有icmp错误、发送时间戳, 或者用户自己的零拷贝通知.
+// recvmsg(MSG_ERRQUEUE)会忽略MSG_PEEK, 读出的条目无法放回, 这些socket上不能代为读取.
+static bool user_errqueue(int fd)
+{
+    int v = 0;
+    socklen_t len = sizeof(v);
+    if (0 == getsockopt_f(fd, SOL_SOCKET, SO_ZEROCOPY, &v, &len) && v)
+        return true;
+
+    v = 0, len = sizeof(v);
+    if (0 == getsockopt_f(fd, SOL_IP, IP_RECVERR, &v, &len) && v)
+        return true;
+
+    v = 0, len = sizeof(v);
+    if (0 == getsockopt_f(fd, SOL_IPV6, IPV6_RECVERR, &v, &len) && v)
+        return true;
+
+    v = 0, len = sizeof(v);
+    if (0 == getsockopt_f(fd, SOL_SOCKET, SO_TIMESTAMPING, &v, &len) &&
+            (v & (SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                  SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_ACK)))
+        return true;
+
+    return false;
+}
+bool FileDescriptorCtx::enable_zerocopy()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed() || !is_socket_ || zc_fallback_) return false;
+    if (zc_enabled_) return true;
+
+    if (user_errqueue(fd_)) {
+        DebugPrint(dbg_fd_ctx, "fd(%p:%d) error queue is used by user", this, fd_);
+        zc_fallback_ = true;
+        return false;
+    }
+
+    int one = 1;
+    if (-1 == setsockopt_f(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one))) {
+        DebugPrint(dbg_fd_ctx, "fd(%p:%d) set SO_ZEROCOPY error:%s", this, fd_, strerror(errno));
+        zc_fallback_ = true;
+        return false;
+    }
+
+    zc_enabled_ = true;
+    return true;
+}
+uint32_t FileDescriptorCtx::add_zerocopy_send()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    return ++zc_sent_;
+}
+void FileDescriptorCtx::cancel_zerocopy_send()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    --zc_sent_;
+}
+bool FileDescriptorCtx::add_zerocopy_waiter(uint32_t seq, IoSentryPtr sentry)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed()) return false;
+
+    // reactor可能已经读走了通知, 和它在同一个锁内检查, 不会漏掉唤醒.
+    reap_zerocopy();
+    if ((int32_t)(zc_done_ - seq) >= 0) return false;
+
+    DebugPrint(dbg_fd_ctx, "task(%s) wait zerocopy fd(%p:%d) seq(%u) done(%u)",
+            sentry->task_ptr_->DebugInfo(), this, fd_, seq, zc_done_);
+    return add_into_reactor_locked(0, TaskWaiter(sentry));
+}
+void FileDescriptorCtx::release_zerocopy()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (closed() || (zc_fallback_ && zc_sent_ == zc_done_)) return;
+    release_zerocopy_locked();
+}
+void FileDescriptorCtx::release_zerocopy_locked()
+{
+    DebugPrint(dbg_fd_ctx, "fd(%p:%d) release zerocopy sent(%u) done(%u)",
+            this, fd_, zc_sent_, zc_done_);
+    zc_fallback_ = true;
+    zc_done_ = zc_sent_;
+    if (!extra_) return;
+
+    extra_->e_tasks_.for_each([this](TaskWSet::value_type & kv)
+    {
+        if (kv.expired()) return;
+        trigger_waiter(kv, 0);
+    });
+    extra_->e_tasks_.clear();
+}
+bool FileDescriptorCtx::reap_zerocopy()
+{
+    if (zc_sent_ == zc_done_) return false;
+
+    bool reaped = false;
+    for (;;) {
+        char control[128];
+        msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (-1 == recvmsg_f(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT))
+            break;
+
+        for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            sock_extended_err *serr = (sock_extended_err*)CMSG_DATA(cm);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+                // 绕过hook设置了其他错误来源, 之后的条目留给用户
+                release_zerocopy_locked();
+                return true;
+            }
+
+            // 一条通知覆盖[ee_info, ee_data]范围内的发送
+            zc_done_ += serr->ee_data - serr->ee_info + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                zc_fallback_ = true;
+            reaped = true;
+        }
+    }
+
+    DebugPrint(dbg_fd_ctx, "fd(%p:%d) reap zerocopy sent(%u) done(%u) fallback(%d)",
+            this, fd_, zc_sent_, zc_done_, (int)zc_fallback_);
+    return reaped;
+}
+int FileDescriptorCtx::reactor_trigger_zerocopy(int poll_events, TriggerSet & output)
+{
+    if (!reap_zerocopy()) return poll_events;
+
+    if (extra_)
+        trigger_task_list(extra_->e_tasks_, 0, output);
+    if (!edge_triggered_)
+        del_events(POLLERR);
+
+    // 错误队列读空后仍有POLLERR, 说明socket上还有真正的错误
+    pollfd pfd = {fd_, 0, 0};
+    if (poll_f(&pfd, 1, 0) == 1 && (pfd.revents & POLLERR))
+        return poll_events;
+    return poll_events & ~POLLERR;
+}
+uint64_t FileDescriptorCtx::take_trigger_count()
+{
+    return trigger_count_.exchange(0);
+}
 std::string FileDescriptorCtx::GetDebugInfo()
 {
     std::unique_lock<std::mutex> lock(lock_);
     char buf[256];
-    sprintf(buf, "fd[%d] closed(%d) is_socket(%d) user_nonblock(%d)"
-            " i_tasks(%d) o_tasks(%d) io_tasks(%d)",
-            fd_, closed(), is_socket_, user_nonblock_, (int)i_tasks_.size(),
-            (int)o_tasks_.size(), (int)io_tasks_.size()
+    sprintf(buf, "fd[%d] closed(%d) is_socket(%d) is_pollable(%d) user_nonblock(%d) reactor(%d)"
+            " i_tasks(%d) o_tasks(%d) io_tasks(%d) e_tasks(%d) uring_tasks(%d)",
+            fd_, closed(), is_socket_, is_pollable_, user_nonblock_, reactor_, (int)i_tasks_.size(),
+            (int)o_tasks_.size(), extra_ ? (int)extra_->io_tasks_.size() : 0,
+            extra_ ? (int)extra_->e_tasks_.size() : 0, extra_ ? (int)extra_->uring_tasks_.size() : 0
             );
     return buf;
 }
 
+FdManager::EpochGuard::EpochGuard()
+{
+    FdManager & mgr = FdManager::getInstance();
+    Reader* & reader = local_reader();
+    if (!reader)
+        reader = mgr.acquire_reader();
+    if (reader->depth++ == 0)
+        reader->epoch = mgr.epoch_.load();
+}
+FdManager::EpochGuard::~EpochGuard()
+{
+    Reader* reader = local_reader();
+    if (--reader->depth == 0)
+        reader->epoch = 0;
+}
+FdManager::Reader* & FdManager::local_reader()
+{
+    // 线程退出时归还, 供以后的线程复用
+    struct LocalReader
+    {
+        Reader* reader = nullptr;
+        ~LocalReader() {
+            if (reader)
+                FdManager::getInstance().release_reader(reader);
+        }
+    };
+    static thread_local LocalReader local;
+    return local.reader;
+}
+FdManager::Reader* FdManager::acquire_reader()
+{
+    for (Reader* r = readers_; r; r = r->next) {
+        bool expected = false;
+        if (!r->in_use && r->in_use.compare_exchange_strong(expected, true))
+            return r;
+    }
+
+    Reader* r = new Reader;
+    r->in_use = true;
+    r->next = readers_;
+    while (!readers_.compare_exchange_weak(r->next, r))
+        ;
+    return r;
+}
+void FdManager::release_reader(Reader* reader)
+{
+    reader->epoch = 0;
+    reader->depth = 0;
+    reader->in_use = false;
+}
+void FdManager::retire(FdCtxPtr* pptr)
+{
+    // 槽位已经清空, 在此之后进入区间的读者看不到pptr;
+    // 只需要等待epoch不大于tag的读者离开.
+    uint64_t tag = ++epoch_;
+    std::vector<FdCtxPtr*> garbage;
+    {
+        std::unique_lock<LFLock> lock(retire_lock_);
+        retired_.push_back(std::make_pair(tag, pptr));
+
+        uint64_t min_epoch = (uint64_t)-1;
+        for (Reader* r = readers_; r; r = r->next) {
+            uint64_t e = r->epoch;
+            if (e && e < min_epoch)
+                min_epoch = e;
+        }
+
+        auto it = retired_.begin();
+        while (it != retired_.end()) {
+            if (it->first <= min_epoch) {
+                garbage.push_back(it->second);
+                it = retired_.erase(it);
+            } else
+                ++it;
+        }
+    }
+
+    // 可能析构FileDescriptorCtx, 不在锁内执行
+    for (auto p : garbage)
+        delete p;
+}
+
 FdManager & FdManager::getInstance()
 {
     static FdManager obj;
     return obj;
 }
+FdManager::FdSlot* FdManager::get_slot(int fd, bool create)
+{
+    if (fd < 0 || fd >= kMaxChunks * kSlotsPerChunk) return nullptr;
+
+    std::atomic<FdSlot*> & chunk = chunks_[fd >> kChunkBits];
+    FdSlot* slots = chunk.load(std::memory_order_acquire);
+    if (!slots) {
+        if (!create) return nullptr;
+
+        FdSlot* new_slots = new FdSlot[kSlotsPerChunk]();
+        if (chunk.compare_exchange_strong(slots, new_slots))
+            slots = new_slots;
+        else
+            delete[] new_slots;     // 其他线程已经分配
+    }
+
+    return &slots[fd & (kSlotsPerChunk - 1)];
+}
+LFLock & FdManager::slot_lock(int fd)
+{
+    return slot_locks_[fd & 63];
+}
+FileDescriptorCtx* FdManager::lookup(int fd)
+{
+    FdSlot* slot = get_slot(fd, false);
+    if (!slot) return nullptr;
+
+    FdCtxPtr* pptr = slot->load();
+    if (!pptr || !(*pptr)->is_initialize())
+        return nullptr;
+    return pptr->get();
+}
 FdCtxPtr FdManager::get_fd_ctx(int fd)
 {
-    if (fd < 0) return FdCtxPtr();
+    {
+        EpochGuard guard;
+        FdSlot* slot = get_slot(fd, false);
+        if (!slot) {
+            if (fd < 0 || fd >= kMaxChunks * kSlotsPerChunk)
+                return FdCtxPtr();
+        } else {
+            FdCtxPtr* pptr = slot->load();
+            if (pptr && (*pptr)->is_initialize())
+                return *pptr;
+        }
+    }
 
-    FdPair & fpair = get_pair(fd);
-    FdCtxPtr ptr = get(fpair, fd);
+    // 首次使用, 或者创建时fd还没有打开
+    std::unique_lock<LFLock> lock(slot_lock(fd));
+    FdSlot* slot = get_slot(fd, true);
+    FdCtxPtr* pptr = slot->load();
+    if (!pptr) {
+        pptr = new FdCtxPtr(std::make_shared<FileDescriptorCtx>(fd));
+        slot->store(pptr);
+    }
+    (*pptr)->re_initialize();
+    FdCtxPtr ptr = *pptr;
     if (!ptr->is_initialize())
         return FdCtxPtr();
     return ptr;
 }
 int FdManager::close(int fd, bool call_syscall)
 {
-    if (fd < 0) return 0;
+    FdSlot* slot = get_slot(fd, false);
+    if (!slot) {
+        if (call_syscall)
+            return close_f(fd);
+        return 0;
+    }
 
-    FdPair & fpair = get_pair(fd);
-    std::unique_lock<LFLock> lock(fpair.second);
-    FdCtxPtr* & pptr = fpair.first;
+    std::unique_lock<LFLock> lock(slot_lock(fd));
+    FdCtxPtr* pptr = slot->load();
     if (!pptr) {
         if (call_syscall)
             return close_f(fd);
         return 0;
     }
 
+    // 先从表中移除再关闭: 关闭后fd号可能立即被复用, 不能再查到旧的上下文
+    slot->store(nullptr);
     int ret = (*pptr)->close(call_syscall);
-    delete pptr;
-    pptr = nullptr;
+    lock.unlock();
+    retire(pptr);
     return ret;
 }
 bool FdManager::dup(int src, int dst)
 {
-    FdPair & src_fpair = get_pair(src);
-    FdCtxPtr src_ptr = get(src_fpair, src);
-    if (!src_ptr->is_initialize())
+    FdCtxPtr src_ptr = get_fd_ctx(src);
+    if (!src_ptr)
         return false;
 
-    FdPair & dst_fpair = get_pair(dst);
-    std::unique_lock<LFLock> lock(dst_fpair.second);
-    if (dst_fpair.first) return false;
-    dst_fpair.first = new FdCtxPtr(src_ptr);
+    FdSlot* slot = get_slot(dst, true);
+    if (!slot) return false;
+
+    std::unique_lock<LFLock> lock(slot_lock(dst));
+    if (slot->load()) return false;
+    slot->store(new FdCtxPtr(src_ptr));
     return true;
 }
 
-FdManager::FdPair & FdManager::get_pair(int fd)
+std::vector<FdCtxPtr> FdManager::GetAll()
 {
-    if (fd >= 8000000 || fd < 0) {
-        std::unique_lock<LFLock> lock(map_lock_);
-        return big_fds_[fd];
-    }
-
-    if ((int)fd_deque_.size() <= fd) {
-        std::unique_lock<LFLock> lock(deque_lock_);
-        fd_deque_.resize(fd + 1);
+    std::vector<FdCtxPtr> result;
+    EpochGuard guard;
+    for (int i = 0; i < kMaxChunks; ++i)
+    {
+        FdSlot* slots = chunks_[i].load(std::memory_order_acquire);
+        if (!slots) continue;
+        for (int j = 0; j < kSlotsPerChunk; ++j)
+        {
+            FdCtxPtr* pptr = slots[j].load();
+            if (pptr)
+                result.push_back(*pptr);
+        }
     }
-
-    return fd_deque_[fd];
-}
-
-FdCtxPtr FdManager::get(FdPair & fpair, int fd)
-{
-    std::unique_lock<LFLock> lock(fpair.second);
-    FdCtxPtr* & pptr = fpair.first;
-    if (!pptr) pptr = new FdCtxPtr(new FileDescriptorCtx(fd));
-    (*pptr)->re_initialize();
-    FdCtxPtr ptr = *pptr;
-    return ptr;
+    return result;
 }
 
 std::string FdManager::GetDebugInfo()
 {
     std::string s;
     s += "---------------------------------";
-    s += "\nFile Descriptor Info(Small):";
-
-    {
-        std::unique_lock<LFLock> lock(deque_lock_);
-        for (int i = 0; i < (int)fd_deque_.size(); ++i)
-        {
-            FdPair & fd_pair = fd_deque_[i];
-            if (!fd_pair.first) continue;
-            FdCtxPtr & p = *fd_pair.first;
-            s += "\n  [" + std::to_string(i) + "] -> " + p->GetDebugInfo();
-        }
-    }
-    s += "\n---------------------------------";
-
-    s += "\n---------------------------------";
-    s += "\nFile Descriptor Info(Big):";
+    s += "\nFile Descriptor Info:";
 
     {
-        std::unique_lock<LFLock> lock(map_lock_);
-        for (auto &kv : big_fds_)
+        EpochGuard guard;
+        for (int i = 0; i < kMaxChunks; ++i)
         {
-            FdPair & fd_pair = kv.second;
-            if (!fd_pair.first) continue;
-            FdCtxPtr & p = *fd_pair.first;
-            s += "\n  [" + std::to_string(kv.first) + "] -> " + p->GetDebugInfo();
+            FdSlot* slots = chunks_[i].load(std::memory_order_acquire);
+            if (!slots) continue;
+            for (int j = 0; j < kSlotsPerChunk; ++j)
+            {
+                FdCtxPtr* pptr = slots[j].load();
+                if (!pptr) continue;
+                s += "\n  [" + std::to_string((i << kChunkBits) + j) + "] -> " + (*pptr)->GetDebugInfo();
+            }
         }
     }
 
@@ -24,6 +24,8 @@ typedef std::weak_ptr<Task> TaskWeakPtr;
 typedef std::shared_ptr<Task> TaskPtr;
 
 class FileDescriptorCtx;
+struct UringAccept;
+class IoUring;
 typedef std::shared_ptr<FileDescriptorCtx> FdCtxPtr;
 typedef std::weak_ptr<FileDescriptorCtx> FdCtxWeakPtr;
 
@@ -41,6 +43,14 @@ struct IoSentry
     CoTimerPtr timer_;
     TaskPtr task_ptr_;
 
+    // io_uring后端: 操作提交到的ring和完成结果(io_uring_cqe::res)
+    IoUring* uring_ = nullptr;
+    int uring_res_ = 0;
+    struct {
+        int64_t tv_sec;
+        long long tv_nsec;
+    } uring_timeout_;   // struct __kernel_timespec, 提交后被IORING_OP_LINK_TIMEOUT引用
+
     explicit IoSentry(Task* tk, pollfd *fds, nfds_t nfds);
     ~IoSentry();
 
@@ -49,13 +59,88 @@ struct IoSentry
 };
 typedef std::weak_ptr<IoSentry> IoSentryWeakPtr;
 typedef std::shared_ptr<IoSentry> IoSentryPtr;
-typedef std::set<IoSentryPtr> TriggerSet;
+
+// reactor一次处理中触发的等待者, 处理完所有fd后(不持有fd的锁)再统一唤醒.
+// 线程内复用, 不必每次分配. 同一个IoSentry可能出现多次, 重复的唤醒由switch_state_to_triggered过滤.
+struct TriggerSet
+{
+    // 单fd等待的快速路径: 持有Task的引用, 唤醒后释放
+    struct TaskTrigger
+    {
+        Task* tk_;
+        uint32_t io_sequence_;
+        short revents_;
+    };
+
+    std::vector<IoSentryPtr> sentries_;
+    std::vector<TaskTrigger> tasks_;
+};
+
+// fd上的一个等待者: 通过IoSentry等待(poll、select等), 或者是单fd等待的快速路径,
+// 此时不创建IoSentry, 等待状态在Task::io_state_中(见IoWait::PrepareTaskWait).
+struct TaskWaiter
+{
+    Task* tk_ = nullptr;
+    IoSentryWeakPtr sentry_;
+    uint32_t io_sequence_ = 0;      // 快速路径的等待序号, 0表示通过sentry_等待
+    short events_ = 0;              // 快速路径等待的事件
+
+    TaskWaiter() = default;
+    explicit TaskWaiter(IoSentryPtr const& sentry);
+    TaskWaiter(Task* tk, uint32_t io_sequence, short events)
+        : tk_(tk), io_sequence_(io_sequence), events_(events) {}
+
+    // IoSentry已经析构. 快速路径的等待者由协程自己移除, 不会过期.
+    bool expired() const { return !io_sequence_ && sentry_.expired(); }
+};
+
+// 等待同一个fd的协程集合. 通常只有一个等待者, 直接存放在对象内;
+// 多个协程同时等待时, 其余的放到按需分配的数组中.
+class TaskWaiterSet
+{
+public:
+    typedef TaskWaiter value_type;
+
+    TaskWaiterSet() = default;
+    ~TaskWaiterSet() { delete more_; }
+
+    TaskWaiterSet(TaskWaiterSet const&) = delete;
+    TaskWaiterSet& operator=(TaskWaiterSet const&) = delete;
+
+    // 已有同一个协程的等待者时覆盖
+    void insert(value_type const& w);
+
+    // @return: 没有tk时返回nullptr
+    value_type* find(Task* tk);
+
+    bool erase(Task* tk);
+
+    bool empty() const { return !first_.tk_; }
+
+    std::size_t size() const;
+
+    void clear();
+
+    template <typename F>
+    void for_each(F const& fn)
+    {
+        if (!first_.tk_) return;
+        fn(first_);
+        if (more_)
+            for (auto & kv : *more_)
+                fn(kv);
+    }
+
+private:
+    value_type first_;
+    std::vector<value_type>* more_ = nullptr;
+};
 
 class FileDescriptorCtx
     : public std::enable_shared_from_this<FileDescriptorCtx>
 {
 public:
-    typedef std::map<Task*, IoSentryWeakPtr> TaskWSet;
+    typedef TaskWaiterSet TaskWSet;
 
     explicit FileDescriptorCtx(int fd);
     ~FileDescriptorCtx();
@@ -64,6 +149,10 @@ public:
 
     bool is_initialize();
     bool is_socket();
+    // 普通文件或块设备: 读写不会返回EAGAIN, 无法通过epoll等待
+    bool is_regular_file();
+    // 可以通过epoll等待就绪的fd: socket以及管道、FIFO、终端、eventfd、timerfd、signalfd、inotify等
+    bool is_pollable();
     bool closed();
     int close(bool call_syscall);
 
@@ -75,26 +164,94 @@ public:
 
     // @type: SO_RCVTIMEO SO_SNDTIMEO
     void set_time_o(int type, timeval const& tv);
-    void get_time_o(int type, timeval *tv);
+    // @return: 毫秒, 0表示不超时
+    int get_time_o(int type);
 
     // multiple threads called in coroutines
     bool add_into_reactor(int poll_events, IoSentryPtr sentry);
-    void del_from_reactor(int poll_events, Task* tk);
+    // 单fd等待的快速路径. @io_sequence: IoWait::PrepareTaskWait的返回值
+    bool add_into_reactor(int poll_events, Task* tk, uint32_t io_sequence);
+    // @io_sequence: 为0时只删除已经析构的IoSentry, 否则删除这个序号的快速路径等待者
+    void del_from_reactor(int poll_events, Task* tk, uint32_t io_sequence = 0);
 
     // single thread called in io_wait
     void reactor_trigger(int poll_events, TriggerSet & output);
 
+    // io_uring后端: 提交的操作不经过epoll, 只在close时需要取消
+    bool add_into_uring(IoSentryPtr sentry);
+    void del_from_uring(Task* tk);
+
+    // 监听socket上的multishot accept状态, 已close时返回nullptr
+    std::shared_ptr<UringAccept> get_uring_accept();
+
+    // 所属reactor的下标, 首次注册到epoll前为-1
+    int reactor();
+
+    // 迁移到第index个reactor, 已注册的事件先加入新的epoll再从旧的epoll移除.
+    // accept到的新连接和Rebalance通过它分配所属的reactor.
+    bool set_reactor(std::size_t index);
+
+    // 返回并清零上次调用以来reactor触发的事件数量
+    uint64_t take_trigger_count();
+
+    // 边缘触发模式下的就绪状态缓存: reactor收到事件时置位, hook中读写返回EAGAIN时清除.
+    // 已知未就绪时hook可以直接挂起协程, 省掉一次必然返回EAGAIN的系统调用.
+    // 非边缘触发模式下总是认为可能就绪.
+    bool maybe_ready(int poll_events);
+    uint32_t ready_seq();
+    // @seq: 系统调用前的ready_seq(), 期间有新的事件到来时不清除
+    void clear_ready(int poll_events, uint32_t seq);
+
+    // MSG_ZEROCOPY发送: 完成通知通过socket的错误队列投递, 由reactor在EPOLLERR时读出.
+    // 设置SO_ZEROCOPY, 不是socket、内核不支持或已经回退为复制时返回false.
+    // 错误队列只能整条读出, 用户自己读取错误队列(已设置SO_ZEROCOPY、IP_RECVERR或发送时间戳)时也返回false.
+    bool enable_zerocopy();
+    // 发送前记录一次零拷贝发送, 返回这次发送完成时的完成计数; 发送失败时撤销.
+    // 先计数再发送, reactor在发送期间收到的通知也会被读出.
+    uint32_t add_zerocopy_send();
+    void cancel_zerocopy_send();
+    // 等待完成计数达到seq, 已经完成或fd已close时返回false
+    bool add_zerocopy_waiter(uint32_t seq, IoSentryPtr sentry);
+    // 错误队列交给用户读取(不经过计数的MSG_ZEROCOPY发送、之后设置了IP_RECVERR等选项):
+    // 完成计数不再可信, 唤醒等待中的协程, 之后的发送按普通发送处理.
+    void release_zerocopy();
+
 private:
+    bool add_into_reactor_locked(int poll_events, TaskWaiter const& w);
+
     void del_events(int poll_events);
 
+    // 读出错误队列中的零拷贝完成通知, 读到时返回true
+    bool reap_zerocopy();
+    void release_zerocopy_locked();
+    // 唤醒等待零拷贝完成的协程, 没有真正的错误时返回去掉POLLERR的事件
+    int reactor_trigger_zerocopy(int poll_events, TriggerSet & output);
+
     void trigger_task_list(TaskWSet & tasks, int events, TriggerSet & output);
 
+    // 立即唤醒一个等待者(close、边缘触发时已经就绪), 调用时持有lock_
+    void trigger_waiter(TaskWaiter const& w, int revents);
+
     void clear_expired_sentry();
 
     TaskWSet& ChooseSet(int events);
 
+    // 不常用的等待状态, 首次用到时分配
+    struct Extra
+    {
+        TaskWSet io_tasks_;
+        TaskWSet e_tasks_;      // 只等待错误事件, 如零拷贝发送的完成通知
+        TaskWSet uring_tasks_;
+        std::shared_ptr<UringAccept> uring_accept_;
+    };
+    Extra& extra();
+
     void set_pending_events(int events);
 
+    // 边缘触发模式下的add/del/trigger
+    bool add_into_reactor_et(int poll_events, TaskWaiter const& w);
+    void reactor_trigger_et(int poll_events, TriggerSet & output);
+
     int GetEpollFd();
 
     // debugger interface
@@ -102,55 +259,108 @@ public:
     std::string GetDebugInfo();
 
 private:
+    // 每个连接一份, 按大小排列以减少对齐填充
     std::mutex lock_;
+    int fd_ = -1;
+    int pending_events_ = 0;
+    pid_t et_owner_pid_ = -1;       // 注册到epoll时的进程id, fork后需要重新注册
+    std::atomic<int> ready_events_{0};      // 边缘触发时, 可能就绪的事件
+    std::atomic<uint32_t> ready_seq_{0};    // reactor每次通知就绪事件时递增
+    int recv_o_ = 0;                // 读超时, 毫秒
+    int send_o_ = 0;                // 写超时, 毫秒
+    uint32_t zc_sent_ = 0;          // 零拷贝发送次数, 与内核分配的通知序号一致
+    uint32_t zc_done_ = 0;          // 已收到完成通知的发送次数
     bool is_initialize_ = false;
     bool is_socket_ = false;
+    bool is_regular_file_ = false;
+    bool is_pollable_ = false;
     bool sys_nonblock_ = false;
     bool user_nonblock_ = false;
     bool closed_ = false;
-    int fd_ = -1;
-    int pending_events_ = 0;
-    timeval recv_o_ = {0, 0};
-    timeval send_o_ = {0, 0};
-    TaskWSet i_tasks_;
-    TaskWSet o_tasks_;
-    TaskWSet io_tasks_;
-
+    bool edge_triggered_ = false;   // 是否以边缘触发方式常驻在epoll中
+    bool zc_enabled_ = false;       // 已设置SO_ZEROCOPY
+    bool zc_fallback_ = false;      // 内核不支持、回退为复制或由用户读取错误队列, 之后按普通发送处理
     LFLock epoll_fd_mtx_;
     int epoll_fd_ = -1;
     pid_t owner_pid_ = -1;
+    int reactor_ = -1;
+    std::atomic<uint64_t> trigger_count_{0};
+    TaskWSet i_tasks_;              // 单个读、写等待者直接存放在对象内
+    TaskWSet o_tasks_;
+    std::unique_ptr<Extra> extra_;
 };
 
 class FdManager
 {
 public:
-    typedef std::pair<FdCtxPtr*, LFLock> FdPair;
-    typedef std::deque<FdPair> FdDeque;
-    typedef std::map<int, FdPair> BigFdMap;
+    typedef std::atomic<FdCtxPtr*> FdSlot;
+
+    // fd表为两级数组: 按fd的高位分块, 每块kSlotsPerChunk个槽位, 首次用到时分配, 之后不再释放.
+    // 查找不加锁也不增加引用计数; close移除的上下文等到所有读者离开后才释放(epoch回收).
+    static const int kChunkBits = 12;
+    static const int kSlotsPerChunk = 1 << kChunkBits;
+    static const int kMaxChunks = 1 << 18;     // fd上限为2^30, 与内核的nr_open上限一致
+
+    // 读者区间: 期间lookup返回的裸指针不会被释放. 可以嵌套, 不能跨越协程切换.
+    class EpochGuard
+    {
+    public:
+        EpochGuard();
+        ~EpochGuard();
+
+        EpochGuard(EpochGuard const&) = delete;
+        EpochGuard& operator=(EpochGuard const&) = delete;
+    };
 
     static FdManager& getInstance();
 
     FdCtxPtr get_fd_ctx(int fd);
 
+    // 不增加引用计数的查找, 返回值只在EpochGuard作用域内有效.
+    // 上下文尚未创建或未初始化时返回nullptr, 需要再用get_fd_ctx创建.
+    FileDescriptorCtx* lookup(int fd);
+
     bool dup(int src, int dst);
 
     int close(int fd, bool call_syscall = true);
 
+    // 所有已创建的fd上下文, dup出的fd共享同一个上下文
+    std::vector<FdCtxPtr> GetAll();
+
 private:
-    FdPair & get_pair(int fd);
+    struct Reader
+    {
+        std::atomic<uint64_t> epoch{0};     // 进入读者区间时的全局epoch, 0表示不在区间内
+        std::atomic<bool> in_use{false};
+        int depth = 0;
+        Reader* next = nullptr;
+    };
+
+    // @create: 所在的块不存在时分配
+    FdSlot* get_slot(int fd, bool create);
+
+    // 创建、close、dup按fd分段加锁, 查找不需要
+    LFLock & slot_lock(int fd);
+
+    Reader* acquire_reader();
+    void release_reader(Reader* reader);
+    static Reader* & local_reader();
 
-    FdCtxPtr get(FdPair & fpair, int fd);
+    // 延迟释放从槽位中移除的上下文, 并释放已经没有读者能看到的部分
+    void retire(FdCtxPtr* pptr);
 
     // debugger interface
 public:
     std::string GetDebugInfo();
 
 private:
-    LFLock deque_lock_;
-    FdDeque fd_deque_;
+    std::atomic<FdSlot*> chunks_[kMaxChunks];
+    LFLock slot_locks_[64];
 
-    LFLock map_lock_;
-    BigFdMap big_fds_;
+    std::atomic<Reader*> readers_{nullptr};
+    std::atomic<uint64_t> epoch_{1};
+    LFLock retire_lock_;
+    std::vector<std::pair<uint64_t, FdCtxPtr*>> retired_;
 };
 
-} //namespace co 
+} //namespace co
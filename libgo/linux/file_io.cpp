@@ -0,0 +1,68 @@
+#include "file_io.h"
+#include <unistd.h>
+#include <thread>
+#include "scheduler.h"
+
+namespace co
+{
+
+FileIoPool& FileIoPool::getInstance()
+{
+    // 线程池的线程不会退出, 不在进程退出时析构, 避免析构阻塞在等待中的条件变量上.
+    static FileIoPool *obj = new FileIoPool;
+    return *obj;
+}
+
+std::size_t FileIoPool::GetThreadCount()
+{
+    return owner_pid_ == getpid() ? (std::size_t)thread_count_ : 0;
+}
+
+void FileIoPool::Start()
+{
+    pid_t pid = getpid();
+    if (owner_pid_ == pid) return ;
+
+    std::unique_lock<LFLock> lock(start_lock_);
+    if (owner_pid_ == pid) return ;
+
+    std::size_t count = (std::max<std::size_t>)(g_Scheduler.GetOptions().file_io_threads, 1);
+    for (std::size_t i = 0; i < count; ++i)
+        std::thread([this]{ pool_.RunLoop(); }).detach();
+
+    DebugPrint(dbg_ioblock, "start %d file io threads", (int)count);
+    thread_count_ = count;
+    owner_pid_ = pid;
+}
+
+void FileIoPool::AddLatency(eFileOp op, uint64_t us)
+{
+    FileOpStat & stat = stats_[(int)op];
+    ++stat.calls;
+    stat.total_us += us;
+    uint64_t max_us = stat.max_us;
+    while (us > max_us && !stat.max_us.compare_exchange_weak(max_us, us))
+        ;
+}
+
+FileOpStat const& FileIoPool::GetStat(eFileOp op)
+{
+    return stats_[(int)op];
+}
+
+const char* FileIoPool::GetOpName(eFileOp op)
+{
+    switch (op) {
+        case eFileOp::open:         return "open";
+        case eFileOp::stat:         return "stat";
+        case eFileOp::fsync:        return "fsync";
+        case eFileOp::fdatasync:    return "fdatasync";
+        case eFileOp::rename:       return "rename";
+        case eFileOp::unlink:       return "unlink";
+        case eFileOp::opendir:      return "opendir";
+        case eFileOp::readdir:      return "readdir";
+        default:                    return "unknown";
+    }
+}
+
+} //namespace co
@@ -0,0 +1,89 @@
+/************************************************
+ * 协程中普通文件的读写: 文件fd总是"就绪"的, 无法通过epoll等待,
+ *     慢速磁盘上的读写会阻塞整个调度线程.
+ * 按CoroutineOptions::file_io_mode提交给io_uring,
+ *     或者交给有线程数上限的阻塞IO线程池执行, 只挂起当前协程.
+ * open/stat/fsync等文件元数据操作同样交给线程池, 并分类统计耗时.
+*************************************************/
+#pragma once
+#include <functional>
+#include <atomic>
+#include <errno.h>
+#include "thread_pool.h"
+#include "spinlock.h"
+
+namespace co
+{
+
+// 被hook的文件元数据操作
+enum class eFileOp : uint8_t
+{
+    open,
+    stat,
+    fsync,
+    fdatasync,
+    rename,
+    unlink,
+    opendir,
+    readdir,
+    count,
+};
+
+// 协程中一类文件操作的耗时统计(从发起到协程恢复执行)
+struct FileOpStat
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total_us{0};
+    std::atomic<uint64_t> max_us{0};
+};
+
+class FileIoPool
+{
+public:
+    static FileIoPool& getInstance();
+
+    // 在协程中调用: 把fn交给线程池执行并挂起当前协程, 执行完成后返回fn的返回值,
+    // errno为fn执行后的值.
+    template <typename R>
+    R CoCall(std::function<R()> const& fn)
+    {
+        Start();
+
+        typedef std::pair<R, int> Result;
+        Channel<Result> ch(1);
+        int err = errno;
+        pool_.AsyncWait<Result>(ch, [fn, err] {
+                    errno = err;
+                    R r = fn();
+                    return Result(r, errno);
+                });
+
+        Result res;
+        ch >> res;
+        errno = res.second;
+        return res.first;
+    }
+
+    // 已启动的线程数量
+    std::size_t GetThreadCount();
+
+    void AddLatency(eFileOp op, uint64_t us);
+
+    FileOpStat const& GetStat(eFileOp op);
+
+    static const char* GetOpName(eFileOp op);
+
+private:
+    FileIoPool() = default;
+
+    // 按CoroutineOptions::file_io_threads启动线程, fork后在子进程中重新启动.
+    void Start();
+
+    ThreadPool pool_;
+    LFLock start_lock_;
+    std::atomic<pid_t> owner_pid_{-1};
+    std::atomic<std::size_t> thread_count_{0};
+    FileOpStat stats_[(int)eFileOp::count];
+};
+
+} //namespace co
@@ -0,0 +1,169 @@
+/************************************************
+ * 协程中IO操作的公共实现, 由hook和co::net(见co_net.h)共同使用.
+ * 只通过FdManager、IoWait、IoUring和xxx_f原函数完成, 不依赖符号替换,
+ *     DISABLE_HOOK时xxx_f直接指向libc中的函数.
+*************************************************/
+#pragma once
+#include <poll.h>
+#include <chrono>
+#include <utility>
+#include "scheduler.h"
+#include "fd_context.h"
+#include "linux_glibc_hook.h"
+#include "uring_wait.h"
+#include "file_io.h"
+
+namespace co
+{
+
+// io_uring操作的结果转换为系统调用的返回值和errno
+ssize_t uring_result(FdCtxPtr const& fd_ctx, int res, int timeout_errno);
+
+// 把fds加入reactor并挂起当前协程, 直到有事件触发或超时.
+// @fd_ctxs: 与fds一一对应, 负数fd对应nullptr
+// @timeout: 毫秒, -1表示不超时
+// @return: 同poll
+int poll_wait(Task* tk, struct pollfd *fds, nfds_t nfds, FdCtxPtr const* fd_ctxs, int timeout);
+
+// 等待单个fd的单个方向就绪(read_write_mode): 等待状态在Task中,
+// 不分配IoSentry、pollfd数组和Task的shared_ptr, 也不进入IoWait的全局等待列表.
+// @timeout: 毫秒, -1表示不超时
+// @return: 触发的事件, 超时返回0; fd已被close或不能加入reactor时返回POLLNVAL
+short fd_wait(Task* tk, FdCtxPtr const& fd_ctx, short event, int timeout);
+
+// poll/select: 先执行一次非阻塞的poll, 检测异常或无效fd, 都没有就绪时再挂起协程等待.
+// @timeout: 毫秒, -1表示不超时
+int poll_mode(Task* tk, struct pollfd *fds, nfds_t nfds, int timeout);
+
+// 普通文件的读写按CoroutineOptions::file_io_mode执行, 异步模式下只挂起当前协程.
+// @uop: 提交给io_uring的操作, opcode为none时只使用线程池.
+template <typename OriginF, typename ... Args>
+ssize_t file_io_mode(FdCtxPtr const& fd_ctx, int fd, OriginF fn, UringOp const& uop, Args ... args)
+{
+    eFileIoMode mode = g_Scheduler.GetOptions().file_io_mode;
+    if (mode == eFileIoMode::blocking)
+        return fn(fd, args...);
+
+    if (mode == eFileIoMode::async && uop.opcode != eUringOpcode::none && IoUring::IsSupported()) {
+        int res = IoUring::CoSubmit(fd_ctx, uop, -1);
+        if (res != -EAGAIN)
+            return uring_result(fd_ctx, res, EAGAIN);
+
+        // sq已满, 使用线程池
+    }
+
+    return FileIoPool::getInstance().CoCall<ssize_t>([=]{ return fn(fd, args...); });
+}
+
+// 协程中在socket等可epoll的fd上读写: 未就绪时只挂起当前协程.
+// @timeout_so: SO_RCVTIMEO或SO_SNDTIMEO, timeout_ms为负数时使用fd上设置的超时时间
+// @timeout_ms: 毫秒, 0表示不等待, 超时返回-1且errno为EAGAIN
+// @uop: io_uring后端提交的操作, opcode为none时只使用epoll.
+template <typename OriginF, typename ... Args>
+ssize_t read_write_mode(int fd, OriginF fn, const char* hook_fn_name, uint32_t event, int timeout_so, int timeout_ms,
+        UringOp const& uop, Args && ... args)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook %s. %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", hook_fn_name, g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk)
+        return fn(fd, std::forward<Args>(args)...);
+
+    // 快速路径: 不增加fd上下文的引用计数, 直接尝试一次非阻塞的系统调用.
+    // 需要挂起协程或交给文件IO时再取得FdCtxPtr.
+    bool tried = false;
+    {
+        FdManager::EpochGuard guard;
+        FileDescriptorCtx* ctx = FdManager::getInstance().lookup(fd);
+        if (ctx && !ctx->closed() && ctx->is_pollable() && !ctx->user_nonblock()
+                && ctx->sys_nonblock() && ctx->maybe_ready(event)) {
+            uint32_t ready_seq = ctx->ready_seq();
+            g_Scheduler.GetIoWait().CountHookSyscall();
+            ssize_t n = fn(fd, std::forward<Args>(args)...);
+            if (n != -1 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                return n;
+
+            ctx->clear_ready(event, ready_seq);
+            tried = true;
+        }
+    }
+
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+    if (!fd_ctx || fd_ctx->closed()) {
+        errno = EBADF;  // 已被close或无效的fd
+        return -1;
+    }
+
+    if (!fd_ctx->is_pollable()) {
+        if (fd_ctx->is_regular_file())
+            return file_io_mode(fd_ctx, fd, fn, uop, std::forward<Args>(args)...);
+
+        // 其他不能epoll的fd(如/dev/null), 直接调用
+        return fn(fd, std::forward<Args>(args)...);
+    }
+
+    if (fd_ctx->user_nonblock())
+        return fn(fd, std::forward<Args>(args)...);
+
+    if (timeout_ms < 0) {
+        timeout_ms = fd_ctx->get_time_o(timeout_so);
+        if (!timeout_ms)
+            timeout_ms = -1;    // 没有设置超时
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    bool ready = false;
+
+retry:
+    // 边缘触发模式下已知未就绪时, 跳过这次必然返回EAGAIN的系统调用.
+    uint32_t ready_seq = fd_ctx->ready_seq();
+    if (!fd_ctx->sys_nonblock()) {
+        // 没有设置O_NONBLOCK的fd(终端、标准输入输出), 等到就绪后再调用.
+        if (ready)
+            return fn(fd, std::forward<Args>(args)...);
+    } else if (tried) {
+        tried = false;  // 快速路径中刚刚返回过EAGAIN
+    } else if (fd_ctx->maybe_ready(event)) {
+        g_Scheduler.GetIoWait().CountHookSyscall();
+        ssize_t n = fn(fd, std::forward<Args>(args)...);
+        if (n != -1 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return n;
+
+        fd_ctx->clear_ready(event, ready_seq);
+    }
+
+    int poll_timeout = -1;
+    if (timeout_ms >= 0) {
+        int expired = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        if (expired >= timeout_ms) {
+            errno = EAGAIN;
+            return -1;  // 已超时
+        }
+
+        // 剩余的等待时间
+        poll_timeout = timeout_ms - expired;
+    }
+
+    if (uop.opcode != eUringOpcode::none && IoUring::IsEnabled()) {
+        // 直接把操作提交给io_uring, fd就绪后由内核完成读写, 不用再加入epoll.
+        int res = IoUring::CoSubmit(fd_ctx, uop, poll_timeout);
+        if (res != -EAGAIN)
+            return uring_result(fd_ctx, res, EAGAIN);
+
+        // 内核对O_NONBLOCK的fd直接返回了EAGAIN, 或者sq已满, 使用epoll等待.
+    }
+
+    // 刚刚返回过EAGAIN, 不需要像poll一样先做一次非阻塞探测;
+    // 加入epoll时如果已经就绪, 会立即触发.
+    if (0 == fd_wait(tk, fd_ctx, event, poll_timeout)) {  // 等待超时
+        errno = EAGAIN;
+        return -1;
+    }
+
+    ready = true;
+    goto retry;     // 事件触发 OR epoll惊群效应
+}
+
+} //namespace co
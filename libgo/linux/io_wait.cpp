@@ -1,7 +1,14 @@
 #include "io_wait.h"
 #include <sys/epoll.h>
+#include <sys/syscall.h>
 #include "scheduler.h"
+#include "uring_wait.h"
+#include "linux_glibc_hook.h"
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <thread>
+#include <limits>
 
 namespace co
 {
@@ -9,17 +16,8 @@ namespace co
 IoWait::IoWait()
 {
     epoll_event_size_ = 1024;
-}
-
-int& IoWait::EpollFdRef()
-{
-    thread_local static int epoll_fd = -1;
-    return epoll_fd;
-}
-pid_t& IoWait::EpollOwnerPid()
-{
-    thread_local static pid_t owner_pid = -1;
-    return owner_pid;
+    for (auto & r : reactors_)
+        r = nullptr;
 }
 
 static uint32_t PollEvent2Epoll(short events)
@@ -39,6 +37,7 @@ static short EpollEvent2Poll(uint32_t events)
     if (events & EPOLLOUT) e |= POLLOUT;
     if (events & EPOLLHUP) e |= POLLHUP;
     if (events & EPOLLERR) e |= POLLERR;
+    if (events & EPOLLRDHUP) e |= POLLIN;   // 对端关闭写, read会返回0
     return e;
 }
 
@@ -49,6 +48,8 @@ static std::string EpollEvent2Str(uint32_t events)
     if (events & EPOLLOUT) e += "POLLOUT|";
     if (events & EPOLLHUP) e += "POLLHUP|";
     if (events & EPOLLERR) e += "POLLERR|";
+    if (events & EPOLLRDHUP) e += "POLLRDHUP|";
+    if (events & EPOLLET) e += "EPOLLET|";
     return e;
 }
 
@@ -76,6 +77,20 @@ void IoWait::CoSwitch()
 
 void IoWait::SchedulerSwitch(Task* tk)
 {
+    if (!tk->io_sentry_) {
+        // 单fd等待的快速路径: 切出前已被唤醒或超时时CAS失败, 由这里加回runnable队列.
+        uint64_t state = tk->io_state_;
+        if ((state & tis_mask) == tis_prepare) {
+            wait_task_count_.fetch_add(1, std::memory_order_relaxed);
+            if (tk->io_state_.compare_exchange_strong(state, (state & ~(uint64_t)tis_mask) | tis_waiting))
+                return ;
+            wait_task_count_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        g_Scheduler.AddTaskRunnable(tk);
+        return ;
+    }
+
     auto sentry = tk->io_sentry_;   // reference increment. avoid wakeup task at other thread.
     wait_io_sentries_.push(sentry.get()); // A
     if (sentry->io_state_ == IoSentry::triggered) // B
@@ -98,12 +113,122 @@ void IoWait::__IOBlockTriggered(IoSentryPtr io_sentry)
     }
 }
 
-int IoWait::reactor_ctl(int epollfd, int epoll_ctl_mod, int fd, uint32_t poll_events, bool is_socket)
+static long long SteadyNowCount()
+{
+    return std::chrono::time_point_cast<MininumTimeDurationType>(
+            std::chrono::steady_clock::now()).time_since_epoch().count();
+}
+
+uint32_t IoWait::PrepareTaskWait(Task* tk, int timeout)
+{
+    if (++tk->io_sequence_ == 0)
+        ++tk->io_sequence_;     // 0表示通过IoSentry等待
+    if (timeout > 0)
+        tk->io_deadline_ = SteadyNowCount() + std::chrono::duration_cast<MininumTimeDurationType>(
+                std::chrono::milliseconds(timeout)).count();
+    else
+        tk->io_deadline_ = (std::numeric_limits<long long>::max)();
+    tk->io_state_ = ((uint64_t)tk->io_sequence_ << 32) | tis_prepare;
+    return tk->io_sequence_;
+}
+
+short IoWait::TaskSwitch(Task* tk)
+{
+    // 加入reactor时已经就绪(边缘触发的就绪缓存)的不必切出, 也不需要定时器
+    if ((tk->io_state_ & tis_mask) == tis_prepare) {
+        long long deadline = tk->io_deadline_;
+        if (deadline != (std::numeric_limits<long long>::max)())
+            ArmTaskTimer(tk, deadline);
+
+        CoSwitch();
+    }
+
+    uint64_t state = tk->io_state_;
+    if ((state & tis_mask) == tis_triggered)
+        return (short)(state & 0xffff);
+    return 0;
+}
+
+bool IoWait::TaskTriggered(Task* tk, uint32_t io_sequence, short revents)
+{
+    uint64_t state = tk->io_state_;
+    for (;;) {
+        uint64_t s = state & tis_mask;
+        if ((uint32_t)(state >> 32) != io_sequence || (s != tis_prepare && s != tis_waiting))
+            return false;
+
+        uint64_t triggered = ((uint64_t)io_sequence << 32) | tis_triggered | (uint16_t)revents;
+        if (!tk->io_state_.compare_exchange_weak(state, triggered))
+            continue;
+
+        if (s == tis_waiting) {
+            wait_task_count_.fetch_sub(1, std::memory_order_relaxed);
+            DebugPrint(dbg_ioblock, "task(%s) exit io_block", tk->DebugInfo());
+            g_Scheduler.AddTaskRunnable(tk);
+        }
+        return true;
+    }
+}
+
+void IoWait::ArmTaskTimer(Task* tk, long long deadline)
+{
+    long long timer_at = tk->io_timer_at_;
+    while (deadline < timer_at) {
+        if (!tk->io_timer_at_.compare_exchange_weak(timer_at, deadline))
+            continue;
+
+        // 与BlockObject::ArmWaitTimer相同, 定时器只持有Task的弱引用
+        TaskTimerHandle* handle = tk->GetTimerHandle();
+        handle->IncrementRef();
+        g_Scheduler.ExpireAt(std::chrono::steady_clock::time_point(MininumTimeDurationType(deadline)),
+                [this, handle, deadline]{
+                    handle->Run([=](Task* tk){ OnTaskTimer(tk, deadline); });
+                    handle->DecrementRef();
+                });
+        return ;
+    }
+}
+
+void IoWait::OnTaskTimer(Task* tk, long long timer_at)
+{
+    long long expected = timer_at;
+    tk->io_timer_at_.compare_exchange_strong(expected, (std::numeric_limits<long long>::max)());
+
+    // 必须先清除io_timer_at_再检查状态, 保证与TaskSwitch并发时至少有一方会设置定时器.
+    for (;;)
+    {
+        uint64_t state = tk->io_state_;
+        uint64_t s = state & tis_mask;
+        if (s != tis_prepare && s != tis_waiting)
+            return ;
+
+        long long deadline = tk->io_deadline_;
+        if (deadline > SteadyNowCount()) {
+            ArmTaskTimer(tk, deadline);
+            return ;
+        }
+
+        if (tk->io_state_.compare_exchange_strong(state, (state & ~(uint64_t)tis_mask) | tis_timeout)) {
+            if (s == tis_waiting) {
+                wait_task_count_.fetch_sub(1, std::memory_order_relaxed);
+                DebugPrint(dbg_ioblock, "task(%s) io_block timeout", tk->DebugInfo());
+                g_Scheduler.AddTaskRunnable(tk);
+            }
+            return ;
+        }
+    }
+}
+
+int IoWait::reactor_ctl(int epollfd, int epoll_ctl_mod, int fd, uint32_t poll_events, bool pollable,
+        bool edge_triggered)
 {
-    if (is_socket) {
+    if (pollable) {
         epoll_event ev;
         ev.events = PollEvent2Epoll(poll_events);
+        if (edge_triggered)
+            ev.events |= EPOLLET | EPOLLRDHUP;
         ev.data.fd = fd;
+        ++epoll_ctl_count_;
         int res = epoll_ctl(epollfd, epoll_ctl_mod, fd, &ev);
         DebugPrint(dbg_ioblock, "epoll_ctl(fd:%d, MOD:%s, events:%s) returns %d",
                 fd, EpollMod2Str(epoll_ctl_mod),
@@ -111,42 +236,130 @@ int IoWait::reactor_ctl(int epollfd, int epoll_ctl_mod, int fd, uint32_t poll_ev
         return res;
     }
 
-    // TODO: poll模拟
     errno = EPERM;
     return -1;
 }
-int IoWait::WaitLoop(int wait_milliseconds)
+// epoll_pwait2(linux 5.11+)的超时参数是纳秒精度的timespec, 亚毫秒级的sleep和timer不会被放大到1ms.
+// 内核不支持时退化为epoll_wait, 超时时间向上取整到毫秒, 避免提前醒来后空转.
+static int EpollWait(int epfd, epoll_event *evs, int maxevents, MininumTimeDurationType wait_time)
 {
-    if (!IsEpollCreated())
-        return -1;
+#if defined(__NR_epoll_pwait2)
+    static std::atomic<bool> s_pwait2_unsupported{false};
+    if (!s_pwait2_unsupported) {
+        struct {
+            int64_t tv_sec;
+            long long tv_nsec;
+        } ts;   // struct __kernel_timespec
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wait_time).count();
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        int n = syscall(__NR_epoll_pwait2, epfd, evs, maxevents, &ts, NULL, 0);
+        if (n != -1 || errno != ENOSYS)
+            return n;
+
+        s_pwait2_unsupported = true;
+    }
+#endif
+
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            wait_time + std::chrono::milliseconds(1) - MininumTimeDurationType(1)).count();
+    return epoll_wait_f(epfd, evs, maxevents, (int)ms);
+}
+
+int IoWait::WaitLoop(MininumTimeDurationType wait_time)
+{
+    StartNetpollers();
+
+    std::size_t index = GetCurrentReactor();
+    Reactor *r = GetReactor(index);
+    int epoll_fd = GetEpollFd(index);
+
+    // 线程退出后不再有人epoll_wait这个reactor, 新连接不能再分配给它.
+    struct PollingGuard {
+        Reactor *r = nullptr;
+        ~PollingGuard() { if (r) r->polling = false; }
+    };
+    thread_local static PollingGuard polling_guard;
+    if (!r->polling) {
+        polling_guard.r = r;
+        r->polling = true;
+    }
 
     // TODO: epoll多线程触发, poll单线程触发.
 
     thread_local static epoll_event *evs = new epoll_event[epoll_event_size_];
 
+    // io_uring后端: 先提交本轮协程写入的sqe, 完成事件通过ring fd的可读事件通知.
+    IoUring *ring = IoUring::GetCreatedThreadRing();
+    if (ring)
+        ring->Submit();
+
+    // 先标记sleeping再检查runnable队列, 与Notify中先加入队列再检查sleeping配对,
+    // 保证其他线程加入的协程不会等到epoll_wait超时才被执行.
+    if (wait_time.count()) {
+        r->sleeping = true;
+        Processer *proc = g_Scheduler.GetLocalInfo().proc;
+        if (proc && proc->GetTaskCount())
+            wait_time = MininumTimeDurationType(0);
+    }
+
+    // 没有fd归属于此reactor(netpoller模式下fd都由专用轮询线程负责)时,
+    // 不需要阻塞就不调用epoll_wait, 有协程可执行时不做io相关的系统调用.
+    if (!wait_time.count() && !r->fd_count) {
+        r->sleeping = false;
+        if (ring)
+            ring->Reap();
+        return 0;
+    }
+
 retry:
-    int n = epoll_wait(GetEpollFd(), evs, epoll_event_size_, wait_milliseconds);
+    int n = EpollWait(epoll_fd, evs, epoll_event_size_, wait_time);
     if (n == -1) {
         if (errno == EINTR) {
             goto retry;
         }
 
-        return 0;
+        // epoll_wait没有阻塞, 返回-1由调度器sleep, 避免空转.
+        r->sleeping = false;
+        if (ring)
+            ring->Reap();
+        return -1;
     }
+    r->sleeping = false;
 
-    DebugPrint(dbg_scheduler|dbg_scheduler_sleep, "epollwait(%d ms) returns: %d",
-            wait_milliseconds, n);
+    DebugPrint(dbg_scheduler|dbg_scheduler_sleep, "epollwait(%lld us) returns: %d",
+            (long long)std::chrono::duration_cast<std::chrono::microseconds>(wait_time).count(), n);
+
+    Trigger(r, evs, n, ring);
+
+    if (ring)
+        ring->Reap();
+
+    return n;
+}
 
-    TriggerSet triggers;
+void IoWait::Trigger(Reactor *r, epoll_event *evs, int n, IoUring *ring)
+{
+    thread_local static TriggerSet triggers;
     for (int i = 0; i < n; ++i)
     {
         int fd = evs[i].data.fd;
+        if (ring && fd == ring->GetFd())
+            continue;
+
+        if (fd == r->event_fd) {
+            uint64_t v;
+            read_f(fd, &v, sizeof(v));
+            continue;
+        }
+
         FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
         DebugPrint(dbg_ioblock, "epoll trigger fd(%d) events(%s) has_ctx(%d)",
                 fd, EpollEvent2Str(evs[i].events).c_str(), !!fd_ctx);
         if (!fd_ctx) continue;
 
         // 暂存, 最后再执行Trigger, 以便于poll可以得到更多的事件触发.
+        ++r->trigger_count;
         fd_ctx->reactor_trigger(EpollEvent2Poll(evs[i].events), triggers);
     }
 
@@ -155,36 +368,244 @@ retry:
     // 触发事件, 唤醒等待中的协程.
     // 过时的唤醒由于已不在wait列表中, 
     // 会被IOBlockTriggered中的原子操作switch_state_to_triggered根据返回值过滤掉.
-    for (auto & sentry : triggers)
+    for (auto & sentry : triggers.sentries_)
         IOBlockTriggered(sentry);
+    triggers.sentries_.clear();
 
-    return n;
+    for (auto & t : triggers.tasks_) {
+        TaskTriggered(t.tk_, t.io_sequence_, t.revents_);
+        t.tk_->DecrementRef();
+    }
+    triggers.tasks_.clear();
+}
+
+void IoWait::NetpollerLoop(std::size_t index)
+{
+    Reactor *r = GetReactor(index);
+    int epoll_fd = GetEpollFd(index);
+    std::vector<epoll_event> evs(epoll_event_size_);
+    pid_t pid = getpid();
+    while (r->owner_pid == pid) {
+        int n = epoll_wait_f(epoll_fd, &evs[0], (int)evs.size(), -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        DebugPrint(dbg_scheduler, "netpoller(%d) epollwait returns: %d", (int)(index - kMaxReactors), n);
+        Trigger(r, &evs[0], n, nullptr);
+    }
+    r->polling = false;
+}
+
+bool IoWait::StartNetpollers()
+{
+    pid_t pid = getpid();
+    if (netpoller_pid_ == pid) return true;
+
+    std::size_t count = (std::min<std::size_t>)(
+            g_Scheduler.GetOptions().netpoller_threads, kMaxNetpollers);
+    if (!count) return false;
+
+    std::unique_lock<LFLock> lock(netpoller_lock_);
+    if (netpoller_pid_ == pid) return true;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t index = kMaxReactors + i;
+        Reactor *r = GetReactor(index);
+        r->netpoller = true;
+        GetEpollFd(index);
+
+        // 线程开始epoll_wait之前注册到epoll中的事件也不会丢失, 可以立即分配fd.
+        r->polling = true;
+        std::thread(&IoWait::NetpollerLoop, this, index).detach();
+    }
+
+    DebugPrint(dbg_scheduler, "start %d netpoller threads", (int)count);
+    netpoller_count_ = count;
+    netpoller_pid_ = pid;
+    return true;
+}
+
+std::size_t IoWait::GetNetpollerCount()
+{
+    return netpoller_pid_ == getpid() ? (std::size_t)netpoller_count_ : 0;
 }
 
 int IoWait::GetEpollFd()
 {
-    CreateEpoll();
-    return EpollFdRef();
+    return GetEpollFd(GetCurrentReactor());
+}
+
+int IoWait::GetEpollFd(std::size_t index)
+{
+    Reactor *r = GetReactor(index);
+    CreateEpoll(*r);
+    return r->epoll_fd;
+}
+
+std::size_t IoWait::GetCurrentReactor()
+{
+    int thread_id = g_Scheduler.GetLocalInfo().thread_id;
+    return thread_id < 0 ? 0 : (std::size_t)thread_id % kMaxReactors;
+}
+
+std::size_t IoWait::ChooseReactor()
+{
+    if (StartNetpollers())
+        return kMaxReactors + choose_robin_index_++ % netpoller_count_;
+
+    std::size_t n = reactor_count_;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t index = choose_robin_index_++ % n;
+        Reactor *r = reactors_[index];
+        if (r && r->polling && r->owner_pid == getpid())
+            return index;
+    }
+
+    return GetCurrentReactor();
+}
+
+std::size_t IoWait::GetRegisterReactor()
+{
+    return StartNetpollers() ? ChooseReactor() : GetCurrentReactor();
 }
 
-void IoWait::CreateEpoll()
+std::size_t IoWait::GetReactorCount()
+{
+    return reactor_count_;
+}
+
+IoWait::Reactor* IoWait::GetReactor(std::size_t index)
+{
+    index %= kMaxReactors + kMaxNetpollers;
+    Reactor *r = reactors_[index];
+    if (r) return r;
+
+    std::unique_lock<LFLock> lock(reactor_init_lock_);
+    r = reactors_[index];
+    if (r) return r;
+
+    r = new Reactor;
+    reactors_[index] = r;
+    if (index < kMaxReactors && reactor_count_ <= index)
+        reactor_count_ = index + 1;
+    return r;
+}
+
+void IoWait::Notify(std::size_t index)
+{
+    Reactor *r = reactors_[index % kMaxReactors];
+    if (!r || !r->sleeping.exchange(false)) return;
+
+    uint64_t v = 1;
+    write_f(r->event_fd, &v, sizeof(v));
+}
+
+void IoWait::OnReactorChanged(int from, int to)
+{
+    if (from >= 0)
+        --GetReactor(from)->fd_count;
+    if (to >= 0)
+        ++GetReactor(to)->fd_count;
+}
+
+std::size_t IoWait::Rebalance(std::size_t max_move)
+{
+    std::unique_lock<LFLock> lock(rebalance_lock_, std::defer_lock);
+    if (!lock.try_lock()) return 0;
+
+    // 参与均衡的reactor: netpoller模式下只有专用轮询线程的reactor
+    bool netpoller = StartNetpollers();
+    std::vector<std::size_t> indices;
+    if (netpoller) {
+        for (std::size_t i = 0; i < netpoller_count_; ++i)
+            indices.push_back(kMaxReactors + i);
+    } else {
+        for (std::size_t i = 0; i < reactor_count_; ++i)
+            indices.push_back(i);
+    }
+
+    // 上次Rebalance以来各reactor触发的事件数量
+    std::vector<uint64_t> loads(kMaxReactors + kMaxNetpollers, 0);
+    for (std::size_t i : indices) {
+        Reactor *r = reactors_[i];
+        if (!r) continue;
+        uint64_t c = r->trigger_count;
+        loads[i] = c - r->last_trigger_count;
+        r->last_trigger_count = c;
+    }
+
+    std::vector<FdCtxPtr> fds = FdManager::getInstance().GetAll();
+    std::vector<std::pair<uint64_t, FdCtxPtr>> hot_fds;
+    std::size_t hot = 0, cold = 0;
+    bool has_polling = false;
+    for (std::size_t i : indices) {
+        Reactor *r = reactors_[i];
+        if (!r || !r->polling) continue;
+        if (!has_polling || loads[i] > loads[hot]) hot = i;
+        if (!has_polling || loads[i] < loads[cold]) cold = i;
+        has_polling = true;
+    }
+
+    if (!has_polling) return 0;
+
+    std::size_t moved = 0;
+    for (auto & fd_ctx : fds) {
+        uint64_t c = fd_ctx->take_trigger_count();
+        int index = fd_ctx->reactor();
+        if (index < 0) continue;
+
+        // 所属线程已经退出的fd没有人epoll_wait, 全部迁移走.
+        // 进入netpoller模式前注册在调度线程reactor上的fd, 也迁移到专用轮询线程.
+        Reactor *r = reactors_[index];
+        if (r && (!r->polling || (netpoller && !r->netpoller)) && moved < max_move) {
+            if (fd_ctx->set_reactor(ChooseReactor()))
+                ++moved;
+            continue;
+        }
+
+        if (hot != cold && index == (int)hot && c)
+            hot_fds.emplace_back(c, fd_ctx);
+    }
+
+    // 从最热的fd开始迁移, 每迁移一个负载为c的fd, 两者的差距减少2c.
+    std::sort(hot_fds.begin(), hot_fds.end(),
+            [](std::pair<uint64_t, FdCtxPtr> const& a, std::pair<uint64_t, FdCtxPtr> const& b) {
+                return a.first > b.first;
+            });
+    int64_t diff = (int64_t)(loads[hot] - loads[cold]);
+    for (auto & kv : hot_fds) {
+        if (moved >= max_move || diff <= 0) break;
+        if ((int64_t)kv.first >= diff) continue;   // 迁移后差距不会缩小
+        if (!kv.second->set_reactor(cold)) continue;
+        diff -= 2 * (int64_t)kv.first;
+        ++moved;
+    }
+
+    DebugPrint(dbg_ioblock, "rebalance reactor(%d load:%llu) -> reactor(%d load:%llu) moved %d fds",
+            (int)hot, (long long unsigned)loads[hot], (int)cold, (long long unsigned)loads[cold], (int)moved);
+    return moved;
+}
+
+void IoWait::CreateEpoll(Reactor & r)
 {
     pid_t pid = getpid();
-    pid_t& epoll_owner_pid = EpollOwnerPid();
-    if (epoll_owner_pid == pid) return ;
-    std::unique_lock<LFLock> lock(epoll_create_lock_);
-    if (epoll_owner_pid == pid) return ;
+    if (r.owner_pid == pid) return ;
+    std::unique_lock<LFLock> lock(r.create_lock);
+    if (r.owner_pid == pid) return ;
 
-    epoll_owner_pid = pid;
     epoll_event_size_ = g_Scheduler.GetOptions().epoll_event_size;
 
-    int & epoll_fd_ = EpollFdRef();
-    if (epoll_fd_ >= 0)
-        close(epoll_fd_);
+    // fork后继承的fd属于父进程, 关闭后重新创建
+    if (r.epoll_fd >= 0)
+        close_f(r.epoll_fd);
+    if (r.event_fd >= 0)
+        close_f(r.event_fd);
 
-    epoll_fd_ = epoll_create(epoll_event_size_);
-    if (epoll_fd_ != -1) {
-        DebugPrint(dbg_ioblock, "create epoll success. epollfd=%d", epoll_fd_);
+    r.epoll_fd = epoll_create(epoll_event_size_);
+    if (r.epoll_fd != -1) {
+        DebugPrint(dbg_ioblock, "create epoll success. epollfd=%d", r.epoll_fd);
         // 使用epoll需要忽略SIGPIPE信号
         IgnoreSigPipe();
     }
@@ -194,6 +615,19 @@ void IoWait::CreateEpoll()
                 strerror(errno));
         exit(1);
     }
+
+    r.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r.event_fd != -1) {
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = r.event_fd;
+        epoll_ctl(r.epoll_fd, EPOLL_CTL_ADD, r.event_fd, &ev);
+    }
+
+    r.sleeping = false;
+    r.polling = false;
+    r.fd_count = 0;
+    r.owner_pid = pid;
 }
 
 void IoWait::IgnoreSigPipe()
@@ -204,7 +638,8 @@ void IoWait::IgnoreSigPipe()
 
 bool IoWait::IsEpollCreated()
 {
-    return EpollFdRef() != -1 && EpollOwnerPid() == getpid();
+    Reactor *r = reactors_[GetCurrentReactor()];
+    return r && r->epoll_fd != -1 && r->owner_pid == getpid();
 }
 
 } //namespace co
@@ -6,6 +6,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <sys/epoll.h>
 #include "task.h"
 #include "fd_context.h"
 #include "debugger.h"
@@ -13,13 +14,70 @@
 namespace co
 {
 
+class IoUring;
+
 class IoWait
 {
 public:
+    // 每个调度线程一个reactor(epoll), 下标与ThreadLocalInfo::thread_id和Processer一一对应.
+    // 每个fd归属于其中一个reactor, 只由所属线程epoll_wait, 唤醒的协程交给它所在的Processer.
+    // netpoller模式下另有专用轮询线程的reactor, 下标为kMaxReactors+i, fd都归属于它们,
+    // 调度线程的reactor中只剩下event_fd, 仅在空闲时用于阻塞休眠.
+    struct Reactor
+    {
+        int epoll_fd = -1;
+        int event_fd = -1;      // 其他线程唤醒阻塞在epoll_wait中的所属线程
+        pid_t owner_pid = -1;
+        LFLock create_lock;
+        std::atomic<bool> polling{false};       // 所属线程已经开始执行WaitLoop
+        std::atomic<bool> sleeping{false};      // 所属线程正阻塞在epoll_wait中
+        std::atomic<uint32_t> fd_count{0};      // 归属于此reactor的fd数量
+        std::atomic<uint64_t> trigger_count{0}; // 触发的fd事件数量, 用于Rebalance
+        uint64_t last_trigger_count = 0;
+        bool netpoller = false;                 // 属于专用轮询线程
+    };
+    static const std::size_t kMaxReactors = 1024;
+    static const std::size_t kMaxNetpollers = 4;
+
     IoWait();
 
+    // 当前调度线程的reactor的epoll fd
     int GetEpollFd();
 
+    // 第index个reactor的epoll fd, 首次调用或fork后创建
+    int GetEpollFd(std::size_t index);
+
+    // 当前调度线程的reactor下标, 不在调度线程中时返回0
+    std::size_t GetCurrentReactor();
+
+    // 为新连接选择reactor: 在已开始epoll_wait的reactor中轮流选择
+    // netpoller模式下在专用轮询线程的reactor中轮流选择.
+    std::size_t ChooseReactor();
+
+    // 首次注册的fd归属的reactor: netpoller模式下同ChooseReactor, 否则为当前线程的reactor.
+    std::size_t GetRegisterReactor();
+
+    // 按CoroutineOptions::netpoller_threads启动专用轮询线程, 已启动时直接返回.
+    // fork后子进程中没有轮询线程, 首次调用时重新启动.
+    // @return: 是否处于netpoller模式
+    bool StartNetpollers();
+
+    // 已启动的专用轮询线程数量
+    std::size_t GetNetpollerCount();
+
+    std::size_t GetReactorCount();
+
+    Reactor* GetReactor(std::size_t index);
+
+    // 把最繁忙的reactor上触发最频繁的fd迁移到最空闲的reactor上.
+    // 繁忙程度按上次Rebalance以来的事件触发数量计算.
+    // @max_move: 最多迁移的fd数量
+    // @return: 迁移的fd数量
+    std::size_t Rebalance(std::size_t max_move = 64);
+
+    // 唤醒第index个reactor的所属线程, 让它尽快执行新加入的协程
+    void Notify(std::size_t index);
+
     // 在协程中调用的switch, 暂存状态并yield
     void CoSwitch();
 
@@ -35,31 +93,92 @@ public:
     void __IOBlockTriggered(IoSentryPtr io_sentry);
     // --------------------------------------
 
+    // --------------------------------------
+    /*
+    * 单fd单方向等待的快速路径: 等待状态在Task中, 不分配IoSentry, 不进入wait_io_sentries_.
+    * 协程中 PrepareTaskWait -> FileDescriptorCtx::add_into_reactor -> TaskSwitch,
+    * reactor、close和超时定时器通过TaskTriggered唤醒. 与SchedulerSwitch同样是ABBA式的并行:
+    * 协程切出前被唤醒时只修改状态, 由SchedulerSwitch把它重新加回runnable队列.
+    */
+    // 开始一次新的等待
+    // @timeout: 毫秒, -1表示不超时
+    // @return: 本次等待的序号
+    uint32_t PrepareTaskWait(Task* tk, int timeout);
+
+    // 在协程中调用, 切出直到被唤醒或超时. 切出前已被唤醒时不切出.
+    // @return: 触发的事件, 超时返回0
+    short TaskSwitch(Task* tk);
+
+    // 唤醒序号为io_sequence的等待, 过时的唤醒返回false
+    bool TaskTriggered(Task* tk, uint32_t io_sequence, short revents);
+    // --------------------------------------
+
     // --------------------------------------
     /*
     * reactor相关操作, 使用类似epoll的接口屏蔽epoll/poll的区别
-    * TODO: 同时支持socket-io和文件io.
+    * 普通文件等不能epoll的fd返回EPERM, 由hook直接读写或交给线程池.
     */
-    int reactor_ctl(int epollfd, int epoll_ctl_mod, int fd, uint32_t poll_events, bool is_socket);
+    // @pollable: FileDescriptorCtx::is_pollable()
+    // @edge_triggered: 以EPOLLET|EPOLLRDHUP注册, 用于fd上的常驻注册
+    int reactor_ctl(int epollfd, int epoll_ctl_mod, int fd, uint32_t poll_events, bool pollable,
+            bool edge_triggered = false);
     // --------------------------------------
 
-    int WaitLoop(int wait_milliseconds);
+    // @wait_time: epoll等待的超时时间, 内核支持epoll_pwait2时精确到纳秒.
+    // @return: 触发的事件数量; epoll_wait出错时返回-1.
+    int WaitLoop(MininumTimeDurationType wait_time);
 
     bool IsEpollCreated();
 
-private:
-    void CreateEpoll();
+    // fd的所属reactor发生变化
+    void OnReactorChanged(int from, int to);
 
-    void IgnoreSigPipe();
+    // hook中实际发起的io系统调用(读写和poll探测)计数
+    void CountHookSyscall() { hook_syscall_count_.fetch_add(1, std::memory_order_relaxed); }
 
-    int& EpollFdRef();
-    pid_t& EpollOwnerPid();
+private:
+    void IgnoreSigPipe();
 
-    LFLock epoll_create_lock_;
+    void CreateEpoll(Reactor & r);
+
+    // 处理epoll_wait返回的事件, 唤醒等待的协程
+    void Trigger(Reactor *r, epoll_event *evs, int n, IoUring *ring);
+
+    // 专用轮询线程: 阻塞在epoll_wait中, 把唤醒的协程直接放入其Processer的队列
+    void NetpollerLoop(std::size_t index);
+
+    // 等待状态(Task::io_state_的低32位), 低16位为触发的事件
+    enum eTaskIoState : uint64_t
+    {
+        tis_prepare = 1 << 16,      // 已加入reactor, 协程还没有切出
+        tis_waiting = 2 << 16,
+        tis_triggered = 3 << 16,
+        tis_timeout = 4 << 16,
+        tis_mask = 0xffffu << 16,
+    };
+
+    // 快速路径的超时定时器, 同BlockObject::ArmWaitTimer:
+    // 被唤醒时不取消, 到期时如果协程正在进行的等待还没到截止时间, 就按新的截止时间重新设置.
+    void ArmTaskTimer(Task* tk, long long deadline);
+    void OnTaskTimer(Task* tk, long long timer_at);
+
+    LFLock reactor_init_lock_;
+    std::atomic<Reactor*> reactors_[kMaxReactors + kMaxNetpollers];
+    std::atomic<std::size_t> reactor_count_{0};
+    std::atomic<uint32_t> choose_robin_index_{0};
+    LFLock rebalance_lock_;
+    LFLock netpoller_lock_;
+    std::atomic<pid_t> netpoller_pid_{-1};
+    std::atomic<std::size_t> netpoller_count_{0};
     int epoll_event_size_;
 
     typedef TSQueue<IoSentry> IoSentryList;
     IoSentryList wait_io_sentries_;
+    std::atomic<uint32_t> wait_task_count_{0};      // 快速路径中已切出的协程数量
+
+    // reactor_ctl调用epoll_ctl的次数
+    std::atomic<uint64_t> epoll_ctl_count_{0};
+    std::atomic<uint64_t> hook_syscall_count_{0};
 
     friend class CoDebugger;
 
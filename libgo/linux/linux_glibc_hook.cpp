@@ -6,80 +6,278 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <unordered_map>
+#include <netdb.h>
+#include <ifaddrs.h>
+#include <linux/net_tstamp.h>
+#include <arpa/inet.h>
 #include <assert.h>
 #include <chrono>
-#include <map>
+#include <limits>
 #include <stdarg.h>
 #include "scheduler.h"
 #include "fd_context.h"
 #include "linux_glibc_hook.h"
+#include "uring_wait.h"
+#include "file_io.h"
+#include "dns_resolver.h"
+#include "addr_wait.h"
+#include "io_mode.h"
+#include "co_net.h"
 using namespace co;
 
 namespace co {
     void coroutine_hook_init();
 }
 
+
+// epoll_wait/epoll_pwait: 用户的epoll fd作为一个普通的可读fd嵌套加入reactor, 等待时只挂起当前协程.
+// epoll fd可读只说明有事件就绪, 可能已被其他线程取走, 因此唤醒后再非阻塞地取一次, 取不到就继续等待.
+// @sigmask: 只在非阻塞地取事件时生效, 等待期间线程的信号掩码不变(同一线程上还有其他协程在运行).
+// @timeout: 毫秒, -1表示不超时
+static int epoll_wait_mode(Task* tk, int epfd, struct epoll_event *events, int maxevents,
+        int timeout, const sigset_t *sigmask)
+{
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(epfd);
+    if (!fd_ctx || !fd_ctx->is_pollable())
+        return epoll_pwait_f(epfd, events, maxevents, timeout, sigmask);
+
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        g_Scheduler.GetIoWait().CountHookSyscall();
+        int n = epoll_pwait_f(epfd, events, maxevents, 0, sigmask);
+        if (n != 0)
+            return n;
+
+        int poll_timeout = -1;
+        if (timeout > 0) {
+            int expired = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            if (expired >= timeout)
+                return 0;   // 已超时
+
+            poll_timeout = timeout - expired;
+        }
+
+        short revents = fd_wait(tk, fd_ctx, POLLIN, poll_timeout);
+        if (revents & POLLNVAL) {
+            if (fd_ctx->closed()) {
+                errno = EBADF;
+                return -1;
+            }
+
+            // 不能加入reactor, 直接调用
+            return epoll_pwait_f(epfd, events, maxevents, poll_timeout, sigmask);
+        }
+        // 超时后还要再取一次: 超时的同时可能有事件到来
+    }
+}
+
+// waitpid: 等待指定的子进程时, 用pidfd(linux 5.3+)在reactor中等待它退出, 只挂起当前协程.
+// 等待任意子进程、进程组, 需要报告停止/继续状态, 或者内核不支持pidfd时没有可以等待的fd,
+// 以WNOHANG检查, 未退出时sleep, 间隔从1ms逐渐加长到50ms.
+static pid_t wait_child_mode(Task* tk, pid_t pid, int *wstatus, int options)
+{
+    int pidfd = -1;
+#if defined(SYS_pidfd_open)
+    if (pid > 0 && !(options & (WUNTRACED | WCONTINUED)))
+        pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+    FdCtxPtr fd_ctx;
+    if (pidfd >= 0) {
+        fd_ctx = FdManager::getInstance().get_fd_ctx(pidfd);
+        if (fd_ctx && !fd_ctx->is_pollable())
+            fd_ctx.reset();
+    }
+
+    int sleep_ms = 1;
+    pid_t res;
+    for (;;) {
+        res = waitpid_f(pid, wstatus, options | WNOHANG);
+        if (res != 0)
+            break;
+
+        if (fd_ctx) {
+            // 子进程退出后pidfd可读
+            if (fd_wait(tk, fd_ctx, POLLIN, -1) & POLLNVAL)
+                fd_ctx.reset();
+        } else {
+            g_Scheduler.SleepSwitch(sleep_ms);
+            sleep_ms = (std::min)(sleep_ms * 2, 50);
+        }
+    }
+
+    if (pidfd >= 0) {
+        int err = errno;
+        fd_ctx.reset();
+        FdManager::getInstance().close(pidfd);
+        errno = err;
+    }
+    return res;
+}
+
+
+// 文件元数据操作: 协程中按file_io_mode交给线程池执行, 并统计从发起到协程恢复执行的耗时.
+// 不在协程中时直接调用原函数.
+template <typename R, typename OriginF, typename ... Args>
+static R file_meta_mode(eFileOp op, OriginF fn, Args ... args)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    if (!tk)
+        return fn(args...);
+
+    DebugPrint(dbg_hook, "task(%s) hook %s.", tk->DebugInfo(), FileIoPool::GetOpName(op));
+    auto start = std::chrono::steady_clock::now();
+    R r;
+    if (g_Scheduler.GetOptions().file_io_mode == eFileIoMode::blocking)
+        r = fn(args...);
+    else
+        r = FileIoPool::getInstance().CoCall<R>([=]{ return fn(args...); });
+
+    int err = errno;
+    FileIoPool::getInstance().AddLatency(op, std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    errno = err;
+    return r;
+}
+
+// 只对普通文件有意义的操作(pread/pwrite), 其他fd直接调用原函数
 template <typename OriginF, typename ... Args>
-static ssize_t read_write_mode(int fd, OriginF fn, const char* hook_fn_name, uint32_t event, int timeout_so, Args && ... args)
+static ssize_t file_only_mode(int fd, OriginF fn, const char* hook_fn_name, UringOp const& uop, Args ... args)
 {
     Task* tk = g_Scheduler.GetCurrentTask();
     DebugPrint(dbg_hook, "task(%s) hook %s. %s coroutine.",
             tk ? tk->DebugInfo() : "nil", hook_fn_name, g_Scheduler.IsCoroutine() ? "In" : "Not in");
 
     if (!tk)
-        return fn(fd, std::forward<Args>(args)...);
+        return fn(fd, args...);
 
     FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
-    if (!fd_ctx || fd_ctx->closed()) {
-        errno = EBADF;  // 已被close或无效的fd
-        return -1;
-    }
+    if (!fd_ctx || fd_ctx->closed() || !fd_ctx->is_regular_file())
+        return fn(fd, args...);
 
-    if (!fd_ctx->is_socket())   // 非socket, 暂不HOOK. 以保障文件fd读写正常
-        return fn(fd, std::forward<Args>(args)...);
+    return file_io_mode(fd_ctx, fd, fn, uop, args...);
+}
 
-    if (fd_ctx->user_nonblock())
-        return fn(fd, std::forward<Args>(args)...);
 
-    timeval tv;
-    fd_ctx->get_time_o(timeout_so, &tv);
-    int timeout_ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
-    auto start = std::chrono::steady_clock::now();
+// splice/tee: 数据在两个fd之间传输, 任意一端未就绪都会返回EAGAIN.
+// 以SPLICE_F_NONBLOCK调用, 返回EAGAIN时只等待未就绪的一端; 普通文件一端总是就绪.
+// @call: 以传入的flags执行原函数
+template <typename F>
+static ssize_t splice_mode(const char* hook_fn_name, int fd_in, int fd_out, unsigned int flags, F call)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook %s(fd_in=%d, fd_out=%d). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", hook_fn_name, fd_in, fd_out,
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
 
-retry:
-    ssize_t n = fn(fd, std::forward<Args>(args)...);
-    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-        int poll_timeout = 0;
-        if (!timeout_ms)
-            poll_timeout = -1;
-        else {
-            int expired = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::steady_clock::now() - start).count();
-            if (expired > timeout_ms) {
-                errno = EAGAIN;
-                return -1;  // 已超时
-            }
+    if (!tk || (flags & SPLICE_F_NONBLOCK))
+        return call(flags);
 
-            // 剩余的等待时间
-            poll_timeout = timeout_ms - expired;
+    FdCtxPtr fd_ctxs[2] = {FdManager::getInstance().get_fd_ctx(fd_in),
+        FdManager::getInstance().get_fd_ctx(fd_out)};
+    for (auto & fd_ctx : fd_ctxs) {
+        if (!fd_ctx || fd_ctx->closed()) {
+            errno = EBADF;
+            return -1;
         }
 
-        pollfd pfd;
-        pfd.fd = fd;
-        pfd.events = event;
-eintr:
-        int triggers = poll(&pfd, 1, poll_timeout);
-        if (-1 == triggers) {
-            if (errno == EINTR) goto eintr;
-            return -1;
-        } else if (0 == triggers) {  // poll等待超时
-            errno = EAGAIN;
-            return -1;
+        if (fd_ctx->is_pollable() && fd_ctx->user_nonblock())
+            return call(flags);
+    }
+
+    if (!fd_ctxs[0]->is_pollable() && !fd_ctxs[1]->is_pollable())
+        return call(flags);
+
+    for (;;) {
+        g_Scheduler.GetIoWait().CountHookSyscall();
+        ssize_t n = call(flags | SPLICE_F_NONBLOCK);
+        if (n != -1 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return n;
+
+        pollfd pfds[2] = {{fd_in, POLLIN, 0}, {fd_out, POLLOUT, 0}};
+        for (int i = 0; i < 2; ++i)
+            if (!fd_ctxs[i]->is_pollable())
+                pfds[i].fd = -1;
+
+        // 两端都已就绪时(例如管道剩余空间不足一页)让出一次再重试
+        if (poll_f(pfds, 2, 0) > 0) {
+            for (auto & pfd : pfds)
+                if (pfd.revents)
+                    pfd.fd = -1;
+            if (pfds[0].fd == -1 && pfds[1].fd == -1) {
+                g_Scheduler.CoYield();
+                continue;
+            }
         }
 
-        goto retry;     // 事件触发 OR epoll惊群效应
+        poll_wait(tk, pfds, 2, fd_ctxs, -1);
     }
+}
 
+// 挂起协程直到fd上的零拷贝完成计数达到seq. fd被close、出错或错误队列交给用户时不再等待,
+// 此时内核仍然锁定着缓冲区所在的页, 用户复用缓冲区只会影响未发出的数据.
+static void zerocopy_wait(Task* tk, FdCtxPtr const& fd_ctx, int fd, uint32_t seq)
+{
+    pollfd pfd = {fd, 0, 0};
+    for (;;) {
+        IoSentryPtr io_sentry = MakeShared<IoSentry>(tk, &pfd, 1);
+        if (!fd_ctx->add_zerocopy_waiter(seq, io_sentry))
+            return;
+
+        tk->io_sentry_ = io_sentry;
+        g_Scheduler.GetIoWait().CoSwitch();
+        tk->io_sentry_.reset();
+
+        // 完成通知唤醒时revents为0
+        if (io_sentry->watch_fds_[0].revents)
+            return;
+    }
+}
+
+// 以MSG_ZEROCOPY发送: 发送成功后挂起协程, 直到内核通过错误队列通知不再引用用户缓冲区,
+// 返回时缓冲区可以立即复用, 与普通发送的语义一致.
+// 数据小于zerocopy_threshold、或者内核已经回退为复制时, 去掉MSG_ZEROCOPY按普通发送处理.
+// 不在协程中或用户设置了非阻塞时保持原样, 由用户自己读取错误队列;
+// 这些发送同样占用内核的通知序号, 之后这个fd上不再计数和等待.
+// @call: 以传入的flags执行hook后的发送
+template <typename F>
+static ssize_t zerocopy_mode(int fd, size_t len, int flags, F call)
+{
+    if (!(flags & MSG_ZEROCOPY))
+        return call(flags);
+
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+    if (!fd_ctx || fd_ctx->closed() || !fd_ctx->is_socket())
+        return call(flags);
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    if (!tk || fd_ctx->user_nonblock()) {
+        fd_ctx->release_zerocopy();
+        return call(flags);
+    }
+
+    if (len < g_Scheduler.GetOptions().zerocopy_threshold || !fd_ctx->enable_zerocopy())
+        return call(flags & ~MSG_ZEROCOPY);
+
+    uint32_t seq = fd_ctx->add_zerocopy_send();
+    ssize_t n = call(flags);
+    if (n <= 0) {
+        // 没有数据进入发送队列时内核不分配通知序号
+        int err = errno;
+        fd_ctx->cancel_zerocopy_send();
+        errno = err;
+        return n;
+    }
+
+    zerocopy_wait(tk, fd_ctx, fd, seq);
+    errno = 0;
     return n;
 }
 
@@ -102,17 +300,44 @@ extern "C" {
 connect_t connect_f = NULL;
 read_t read_f = NULL;
 readv_t readv_f = NULL;
+pread_t pread_f = NULL;
 recv_t recv_f = NULL;
 recvfrom_t recvfrom_f = NULL;
 recvmsg_t recvmsg_f = NULL;
+recvmmsg_t recvmmsg_f = NULL;
 write_t write_f = NULL;
 writev_t writev_f = NULL;
+pwrite_t pwrite_f = NULL;
 send_t send_f = NULL;
 sendto_t sendto_f = NULL;
 sendmsg_t sendmsg_f = NULL;
+sendmmsg_t sendmmsg_f = NULL;
+sendfile_t sendfile_f = NULL;
+sendfile64_t sendfile64_f = NULL;
+splice_t splice_f = NULL;
+tee_t tee_f = NULL;
+vmsplice_t vmsplice_f = NULL;
 poll_t poll_f = NULL;
 select_t select_f = NULL;
+epoll_wait_t epoll_wait_f = NULL;
+epoll_pwait_t epoll_pwait_f = NULL;
 accept_t accept_f = NULL;
+accept4_t accept4_f = NULL;
+getaddrinfo_t getaddrinfo_f = NULL;
+gethostbyname_t gethostbyname_f = NULL;
+waitpid_t waitpid_f = NULL;
+system_t system_f = NULL;
+popen_t popen_f = NULL;
+pclose_t pclose_f = NULL;
+pthread_mutex_lock_t pthread_mutex_lock_f = NULL;
+pthread_mutex_unlock_t pthread_mutex_unlock_f = NULL;
+pthread_cond_wait_t pthread_cond_wait_f = NULL;
+pthread_cond_timedwait_t pthread_cond_timedwait_f = NULL;
+#if __GLIBC_PREREQ(2, 30)
+pthread_cond_clockwait_t pthread_cond_clockwait_f = NULL;
+#endif
+pthread_cond_signal_t pthread_cond_signal_f = NULL;
+pthread_cond_broadcast_t pthread_cond_broadcast_f = NULL;
 sleep_t sleep_f = NULL;
 usleep_t usleep_f = NULL;
 nanosleep_t nanosleep_f = NULL;
@@ -124,223 +349,218 @@ setsockopt_t setsockopt_f = NULL;
 dup_t dup_f = NULL;
 dup2_t dup2_f = NULL;
 dup3_t dup3_f = NULL;
+open_t open_f = NULL;
+stat_t stat_f = NULL;
+fsync_t fsync_f = NULL;
+fdatasync_t fdatasync_f = NULL;
+rename_t rename_f = NULL;
+unlink_t unlink_f = NULL;
+opendir_t opendir_f = NULL;
+readdir_t readdir_f = NULL;
 
 int connect(int fd, const struct sockaddr *addr, socklen_t addrlen)
 {
-    Task* tk = g_Scheduler.GetCurrentTask();
     DebugPrint(dbg_hook, "task(%s) hook connect. %s coroutine.",
-            tk ? tk->DebugInfo() : "nil", g_Scheduler.IsCoroutine() ? "In" : "Not in");
-
-    if (!tk)
-        return connect_f(fd, addr, addrlen);
-
-    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
-    if (!fd_ctx || fd_ctx->closed()) {
-        errno = EBADF;
-        return -1;
-    }
-
-    if (fd_ctx->user_nonblock())
-        return connect_f(fd, addr, addrlen);
-
-    int n = connect_f(fd, addr, addrlen);
-    if (n == 0) {
-        DebugPrint(dbg_hook, "continue task(%s) connect completed immediately. fd=%d",
-                g_Scheduler.GetCurrentTaskDebugInfo(), fd);
-        return 0;
-    } else if (n != -1 || errno != EINPROGRESS) {
-        return n;
-    }
-
-    // EINPROGRESS. use poll for wait connect complete.
-    pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLOUT;
-    int poll_res = poll(&pfd, 1, s_connect_timeout);
-    if (poll_res <= 0 || pfd.revents != POLLOUT) {
-        errno = ETIMEDOUT;
-        return -1;
-    }
-
-    int error = 0;
-    socklen_t len = sizeof(int);
-    if (-1 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len))
-        return -1;
-
-    if (!error)
-        return 0;
-    else {
-        errno = error;
-        return -1;
-    }
+            g_Scheduler.GetCurrentTaskDebugInfo(), g_Scheduler.IsCoroutine() ? "In" : "Not in");
+    return co::net::connect(fd, addr, addrlen, s_connect_timeout);
 }
 
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
 {
     if (!accept_f) coroutine_hook_init();
-    return read_write_mode(sockfd, accept_f, "accept", POLLIN, SO_RCVTIMEO, addr, addrlen);
+    return co::net::accept(sockfd, addr, addrlen);
+}
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    if (!accept4_f) coroutine_hook_init();
+    return co::net::accept4(sockfd, addr, addrlen, flags);
 }
 
 ssize_t read(int fd, void *buf, size_t count)
 {
     if (!read_f) coroutine_hook_init();
-    return read_write_mode(fd, read_f, "read", POLLIN, SO_RCVTIMEO, buf, count);
+    return co::net::read(fd, buf, count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 {
     if (!readv_f) coroutine_hook_init();
-    return read_write_mode(fd, readv_f, "readv", POLLIN, SO_RCVTIMEO, iov, iovcnt);
+    return co::net::readv(fd, iov, iovcnt);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+    if (!pread_f) coroutine_hook_init();
+    return file_only_mode(fd, pread_f, "pread",
+            UringOp{eUringOpcode::read, fd, buf, (uint32_t)count, (uint64_t)offset, nullptr, 0},
+            buf, count, offset);
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags)
 {
     if (!recv_f) coroutine_hook_init();
-    return read_write_mode(sockfd, recv_f, "recv", POLLIN, SO_RCVTIMEO, buf, len, flags);
+    return co::net::recv(sockfd, buf, len, flags);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
         struct sockaddr *src_addr, socklen_t *addrlen)
 {
     if (!recvfrom_f) coroutine_hook_init();
-    return read_write_mode(sockfd, recvfrom_f, "recvfrom", POLLIN, SO_RCVTIMEO, buf, len, flags,
-            src_addr, addrlen);
+    return read_write_mode(sockfd, recvfrom_f, "recvfrom", POLLIN, SO_RCVTIMEO, -1,
+            UringOp{src_addr ? eUringOpcode::none : eUringOpcode::recv,
+                sockfd, buf, (uint32_t)len, 0, nullptr, flags},
+            buf, len, flags, src_addr, addrlen);
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
     if (!recvmsg_f) coroutine_hook_init();
-    return read_write_mode(sockfd, recvmsg_f, "recvmsg", POLLIN, SO_RCVTIMEO, msg, flags);
+    return read_write_mode(sockfd, recvmsg_f, "recvmsg", POLLIN, SO_RCVTIMEO, -1,
+            UringOp{eUringOpcode::recvmsg, sockfd, msg, 1, 0, nullptr, flags}, msg, flags);
+}
+
+// 非阻塞socket上的recvmmsg只收取已经到达的报文, 至少有一个时就返回,
+// 相当于总是带有MSG_WAITFORONE.
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+        int flags, struct timespec *timeout)
+{
+    if (!recvmmsg_f) coroutine_hook_init();
+    return read_write_mode(sockfd, recvmmsg_f, "recvmmsg", POLLIN, SO_RCVTIMEO, -1,
+            UringOp{eUringOpcode::none, sockfd, nullptr, 0, 0, nullptr, flags},
+            msgvec, vlen, flags, timeout);
 }
 
 ssize_t write(int fd, const void *buf, size_t count)
 {
     if (!write_f) coroutine_hook_init();
-    return read_write_mode(fd, write_f, "write", POLLOUT, SO_SNDTIMEO, buf, count);
+    return co::net::write(fd, buf, count);
 }
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 {
     if (!writev_f) coroutine_hook_init();
-    return read_write_mode(fd, writev_f, "writev", POLLOUT, SO_SNDTIMEO, iov, iovcnt);
+    return co::net::writev(fd, iov, iovcnt);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    if (!pwrite_f) coroutine_hook_init();
+    return file_only_mode(fd, pwrite_f, "pwrite",
+            UringOp{eUringOpcode::write, fd, buf, (uint32_t)count, (uint64_t)offset, nullptr, 0},
+            buf, count, offset);
 }
 
 ssize_t send(int sockfd, const void *buf, size_t len, int flags)
 {
     if (!send_f) coroutine_hook_init();
-    return read_write_mode(sockfd, send_f, "send", POLLOUT, SO_SNDTIMEO, buf, len, flags);
+    if (flags & MSG_ZEROCOPY)
+        return zerocopy_mode(sockfd, len, flags, [=](int f) {
+                return read_write_mode(sockfd, send_f, "send", POLLOUT, SO_SNDTIMEO, -1,
+                    UringOp{eUringOpcode::none, sockfd, nullptr, 0, 0, nullptr, f}, buf, len, f);
+            });
+
+    return co::net::send(sockfd, buf, len, flags);
 }
 
 ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
         const struct sockaddr *dest_addr, socklen_t addrlen)
 {
     if (!sendto_f) coroutine_hook_init();
-    return read_write_mode(sockfd, sendto_f, "sendto", POLLOUT, SO_SNDTIMEO, buf, len, flags,
-            dest_addr, addrlen);
+    if (flags & MSG_ZEROCOPY)
+        return zerocopy_mode(sockfd, len, flags, [=](int f) {
+                return read_write_mode(sockfd, sendto_f, "sendto", POLLOUT, SO_SNDTIMEO, -1,
+                    UringOp{eUringOpcode::none, sockfd, nullptr, 0, 0, nullptr, f},
+                    buf, len, f, dest_addr, addrlen);
+            });
+
+    return read_write_mode(sockfd, sendto_f, "sendto", POLLOUT, SO_SNDTIMEO, -1,
+            UringOp{dest_addr ? eUringOpcode::none : eUringOpcode::send,
+                sockfd, buf, (uint32_t)len, 0, nullptr, flags},
+            buf, len, flags, dest_addr, addrlen);
 }
 
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
 {
     if (!sendmsg_f) coroutine_hook_init();
-    return read_write_mode(sockfd, sendmsg_f, "sendmsg", POLLOUT, SO_SNDTIMEO, msg, flags);
-}
-
-int poll(struct pollfd *fds, nfds_t nfds, int timeout)
-{
-    if (!poll_f) coroutine_hook_init();
-
-    Task* tk = g_Scheduler.GetCurrentTask();
-    DebugPrint(dbg_hook, "task(%s) hook poll(nfds=%d, timeout=%d). %s coroutine.",
-            tk ? tk->DebugInfo() : "nil",
-            (int)nfds, timeout,
-            g_Scheduler.IsCoroutine() ? "In" : "Not in");
-
-    if (!tk)
-        return poll_f(fds, nfds, timeout);
-
-    if (timeout == 0)
-        return poll_f(fds, nfds, timeout);
-
-    // --------------------------------
-    // 全部是负数fd时, 等价于sleep
-    nfds_t negative_fd_n = 0;
-    for (nfds_t i = 0; i < nfds; ++i)
-        if (fds[i].fd < 0)
-            ++ negative_fd_n;
-
-    if (nfds == negative_fd_n) {
-        // co sleep
-        g_Scheduler.SleepSwitch(timeout);
-        return 0;
+    if (flags & MSG_ZEROCOPY) {
+        size_t len = 0;
+        for (size_t i = 0; i < msg->msg_iovlen; ++i)
+            len += msg->msg_iov[i].iov_len;
+        return zerocopy_mode(sockfd, len, flags, [=](int f) {
+                return read_write_mode(sockfd, sendmsg_f, "sendmsg", POLLOUT, SO_SNDTIMEO, -1,
+                    UringOp{eUringOpcode::none, sockfd, nullptr, 0, 0, nullptr, f}, msg, f);
+            });
     }
-    // --------------------------------
 
-    // 执行一次非阻塞的poll, 检测异常或无效fd.
-    int res = poll_f(fds, nfds, 0);
-    if (res != 0)
-        return res;
-
-    // create io-sentry
-    IoSentryPtr io_sentry = MakeShared<IoSentry>(tk, fds, nfds);
-
-    // add file descriptor into epoll or poll.
-    bool added = false;
-    for (nfds_t i = 0; i < nfds; ++i) {
-        fds[i].revents = 0;     // clear revents
-        pollfd & pfd = io_sentry->watch_fds_[i];
-        if (pfd.fd < 0)
-            continue;
-
-        FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(pfd.fd);
-        if (!fd_ctx || fd_ctx->closed()) {
-            // bad file descriptor
-            pfd.revents = POLLNVAL;
-            continue;
-        }
-
-        if (!fd_ctx->add_into_reactor(pfd.events, io_sentry)) {
-            // TODO: 兼容文件fd
-            pfd.revents = POLLNVAL;
-            continue;
-        }
-
-        added = true;
-    }
+    return read_write_mode(sockfd, sendmsg_f, "sendmsg", POLLOUT, SO_SNDTIMEO, -1,
+            UringOp{eUringOpcode::sendmsg, sockfd, msg, 1, 0, nullptr, flags}, msg, flags);
+}
 
-    if (!added) {
-        errno = 0;
-        return nfds;
-    }
+// 发送缓冲区不足时返回已经发送的报文数, 与send的部分写入一致
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    if (!sendmmsg_f) coroutine_hook_init();
+    return read_write_mode(sockfd, sendmmsg_f, "sendmmsg", POLLOUT, SO_SNDTIMEO, -1,
+            UringOp{eUringOpcode::none, sockfd, nullptr, 0, 0, nullptr, flags},
+            msgvec, vlen, flags);
+}
 
-    // set timer
-    if (timeout > 0)
-        io_sentry->timer_ = g_Scheduler.ExpireAt(
-                std::chrono::milliseconds(timeout),
-                [io_sentry]{
-                    g_Scheduler.GetIoWait().IOBlockTriggered(io_sentry);
-                });
+// 发送进度受out_fd限制, in_fd是普通文件
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    if (!sendfile_f) coroutine_hook_init();
+    return read_write_mode(out_fd, sendfile_f, "sendfile", POLLOUT, SO_SNDTIMEO, -1,
+            UringOp{eUringOpcode::none, out_fd, nullptr, 0, 0, nullptr, 0},
+            in_fd, offset, count);
+}
 
-    // save io-sentry
-    tk->io_sentry_ = io_sentry;
+ssize_t sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count)
+{
+    if (!sendfile64_f) coroutine_hook_init();
+    return read_write_mode(out_fd, sendfile64_f, "sendfile64", POLLOUT, SO_SNDTIMEO, -1,
+            UringOp{eUringOpcode::none, out_fd, nullptr, 0, 0, nullptr, 0},
+            in_fd, offset, count);
+}
 
-    // yield
-    g_Scheduler.GetIoWait().CoSwitch();
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+        size_t len, unsigned int flags)
+{
+    if (!splice_f) coroutine_hook_init();
+    return splice_mode("splice", fd_in, fd_out, flags, [=](unsigned int f) {
+                return splice_f(fd_in, off_in, fd_out, off_out, len, f);
+            });
+}
 
-    // clear task->io_sentry_ reference count
-    tk->io_sentry_.reset();
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    if (!tee_f) coroutine_hook_init();
+    return splice_mode("tee", fd_in, fd_out, flags, [=](unsigned int f) {
+                return tee_f(fd_in, fd_out, len, f);
+            });
+}
 
-    if (io_sentry->timer_) {
-        g_Scheduler.CancelTimer(io_sentry->timer_);
-        io_sentry->timer_.reset();
-    }
+// 写端把用户内存放入管道, 读端把管道中的数据取到用户内存
+ssize_t vmsplice(int fd, const struct iovec *iov, size_t nr_segs, unsigned int flags)
+{
+    if (!vmsplice_f) coroutine_hook_init();
+    if (!g_Scheduler.IsCoroutine() || (flags & SPLICE_F_NONBLOCK))
+        return vmsplice_f(fd, iov, nr_segs, flags);
+
+    bool reader = (fcntl_f(fd, F_GETFL) & O_ACCMODE) == O_RDONLY;
+    return read_write_mode(fd, vmsplice_f, "vmsplice", reader ? POLLIN : POLLOUT,
+            reader ? SO_RCVTIMEO : SO_SNDTIMEO, -1,
+            UringOp{eUringOpcode::none, fd, nullptr, 0, 0, nullptr, 0},
+            iov, nr_segs, flags | SPLICE_F_NONBLOCK);
+}
 
-    int n = 0;
-    for (nfds_t i = 0; i < nfds; ++i) {
-        fds[i].revents = io_sentry->watch_fds_[i].revents;
-        if (fds[i].revents) ++n;
-    }
-    errno = 0;
-    return n;
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    if (!poll_f) coroutine_hook_init();
+    DebugPrint(dbg_hook, "task(%s) hook poll(nfds=%d, timeout=%d). %s coroutine.",
+            g_Scheduler.GetCurrentTaskDebugInfo(), (int)nfds, timeout,
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+    return co::net::poll(fds, nfds, timeout);
 }
 
 int select(int nfds, fd_set *readfds, fd_set *writefds,
@@ -348,9 +568,10 @@ int select(int nfds, fd_set *readfds, fd_set *writefds,
 {
     if (!select_f) coroutine_hook_init();
 
+    // 不足1毫秒的非零超时按1毫秒计
     int timeout_ms = -1;
     if (timeout)
-        timeout_ms = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+        timeout_ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
 
     Task* tk = g_Scheduler.GetCurrentTask();
     DebugPrint(dbg_hook, "task(%s) hook select(nfds=%d, rd_set=%p, wr_set=%p, er_set=%p, timeout=%d ms).",
@@ -370,87 +591,62 @@ int select(int nfds, fd_set *readfds, fd_set *writefds,
 
     nfds = std::min<int>(nfds, FD_SETSIZE);
 
-    // 执行一次非阻塞的select, 检测异常或无效fd.
-    fd_set rfs, wfs, efs;
-    FD_ZERO(&rfs);
-    FD_ZERO(&wfs);
-    FD_ZERO(&efs);
-    if (readfds) rfs = *readfds;
-    if (writefds) wfs = *writefds;
-    if (exceptfds) efs = *exceptfds;
-    timeval zero_tv = {0, 0};
-    int n = select_f(nfds, (readfds ? &rfs : nullptr),
-            (writefds ? &wfs : nullptr),
-            (exceptfds ? &efs : nullptr), &zero_tv);
-    if (n != 0) {
-        if (readfds) *readfds = rfs;
-        if (writefds) *writefds = wfs;
-        if (exceptfds) *exceptfds = efs;
-        return n;
-    }
-
     // -------------------------------------
-    // convert fd_set to pollfd, and clear 3 fd_set.
-    std::pair<fd_set*, uint32_t> sets[3] = {
-        {readfds, POLLIN},
-        {writefds, POLLOUT},
-        {exceptfds, 0}
-    };
-    //static const char* set_names[] = {"readfds", "writefds", "exceptfds"};
-
-    std::map<int, int> pfd_map;
-    for (int i = 0; i < 3; ++i) {
-        fd_set* fds = sets[i].first;
-        if (!fds) continue;
-        int event = sets[i].second;
-        for (int fd = 0; fd < nfds; ++fd) {
-            if (FD_ISSET(fd, fds)) {
-                pfd_map[fd] &= event;
-            }
-        }
-        FD_ZERO(fds);
+    // convert fd_set to pollfd.
+    // 按fd从小到大逐个检查, 同一个fd的读写异常事件合并为一个pollfd.
+    std::vector<pollfd> pfds;
+    for (int fd = 0; fd < nfds; ++fd) {
+        short events = 0;
+        if (readfds && FD_ISSET(fd, readfds)) events |= POLLIN;
+        if (writefds && FD_ISSET(fd, writefds)) events |= POLLOUT;
+        if (exceptfds && FD_ISSET(fd, exceptfds)) events |= POLLPRI;
+        if (events)
+            pfds.push_back(pollfd{fd, events, 0});
     }
 
-    std::vector<pollfd> pfds(pfd_map.size());
-    int i = 0;
-    for (auto &kv : pfd_map) {
-        pollfd &pfd = pfds[i++];
-        pfd.fd = kv.first;
-        pfd.events = kv.second;
+    if (pfds.empty()) {
+        g_Scheduler.SleepSwitch(timeout_ms);
+        return 0;
     }
     // -------------------------------------
 
     // -------------------------------------
     // poll
-    n = poll(pfds.data(), pfds.size(), timeout_ms);
-    if (n <= 0)
+    // 与内核的select一致: 出错时(包括EBADF)不修改调用者的fd_set.
+    int n = poll_mode(tk, pfds.data(), pfds.size(), timeout_ms);
+    if (n < 0)
         return n;
+
+    for (size_t i = 0; i < pfds.size(); ++i)
+        if (pfds[i].revents & POLLNVAL) {
+            errno = EBADF;
+            return -1;
+        }
     // -------------------------------------
 
     // -------------------------------------
-    // convert pollfd to fd_set.
+    // clear 3 fd_set, and convert pollfd to fd_set.
+    // 与内核的select一致: 挂断和错误同时算作可读, 错误算作可写, 带外数据算作异常.
+    if (readfds) FD_ZERO(readfds);
+    if (writefds) FD_ZERO(writefds);
+    if (exceptfds) FD_ZERO(exceptfds);
+
     int ret = 0;
     for (size_t i = 0; i < pfds.size(); ++i) {
         pollfd &pfd = pfds[i];
-        if (pfd.events & POLLIN) {
-            if (readfds) {
-                FD_SET(pfd.fd, readfds);
-                ++ret;
-            }
+        if ((pfd.events & POLLIN) && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            FD_SET(pfd.fd, readfds);
+            ++ret;
         }
 
-        if (pfd.events & POLLOUT) {
-            if (writefds) {
-                FD_SET(pfd.fd, writefds);
-                ++ret;
-            }
+        if ((pfd.events & POLLOUT) && (pfd.revents & (POLLOUT | POLLERR))) {
+            FD_SET(pfd.fd, writefds);
+            ++ret;
         }
 
-        if (pfd.events & ~(POLLIN | POLLOUT)) {
-            if (exceptfds) {
-                FD_SET(pfd.fd, exceptfds);
-                ++ret;
-            }
+        if ((pfd.events & POLLPRI) && (pfd.revents & POLLPRI)) {
+            FD_SET(pfd.fd, exceptfds);
+            ++ret;
         }
     }
     // -------------------------------------
@@ -458,6 +654,566 @@ int select(int nfds, fd_set *readfds, fd_set *writefds,
     return ret;
 }
 
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    if (!epoll_wait_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook epoll_wait(epfd=%d, maxevents=%d, timeout=%d). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", epfd, maxevents, timeout,
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || timeout == 0)
+        return epoll_wait_f(epfd, events, maxevents, timeout);
+
+    return epoll_wait_mode(tk, epfd, events, maxevents, timeout, nullptr);
+}
+
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout,
+        const sigset_t *sigmask)
+{
+    if (!epoll_pwait_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook epoll_pwait(epfd=%d, maxevents=%d, timeout=%d). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", epfd, maxevents, timeout,
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || timeout == 0)
+        return epoll_pwait_f(epfd, events, maxevents, timeout, sigmask);
+
+    return epoll_wait_mode(tk, epfd, events, maxevents, timeout, sigmask);
+}
+
+#if defined(CO_DYNAMIC_LINK)
+// 数字地址不需要查询DNS, 不会阻塞
+static bool is_numeric_host(const char *node)
+{
+    in_addr addr4;
+    in6_addr addr6;
+    return inet_aton(node, &addr4) || inet_pton(AF_INET6, node, &addr6) == 1
+        || strchr(node, '%');   // 带scope的IPv6地址
+}
+
+// 内置的DNS客户端只实现了files和dns, 需要开启选项并且nsswitch.conf与之一致才使用
+static bool use_dns_resolver()
+{
+    return g_Scheduler.GetOptions().enable_dns_resolver
+        && DnsResolver::getInstance().IsNssCompatible();
+}
+
+// 与glibc对AI_ADDRCONFIG的处理一致: 本机配置了127.0.0.1和::1以外的地址, 才认为支持该协议族
+static void configured_families(bool & has_v4, bool & has_v6)
+{
+    struct ifaddrs *ifa = nullptr;
+    if (getifaddrs(&ifa) != 0) {
+        has_v4 = has_v6 = true;
+        return ;
+    }
+
+    has_v4 = has_v6 = false;
+    for (struct ifaddrs *p = ifa; p; p = p->ifa_next) {
+        if (!p->ifa_addr) continue;
+        if (p->ifa_addr->sa_family == AF_INET) {
+            if (((sockaddr_in*)p->ifa_addr)->sin_addr.s_addr != htonl(INADDR_LOOPBACK))
+                has_v4 = true;
+        } else if (p->ifa_addr->sa_family == AF_INET6) {
+            if (!IN6_IS_ADDR_LOOPBACK(&((sockaddr_in6*)p->ifa_addr)->sin6_addr))
+                has_v6 = true;
+        }
+    }
+    freeifaddrs(ifa);
+}
+
+int getaddrinfo(const char *node, const char *service,
+        const struct addrinfo *hints, struct addrinfo **res)
+{
+    if (!getaddrinfo_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook getaddrinfo(node=%s, service=%s). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", node ? node : "nil", service ? service : "nil",
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    int flags = hints ? hints->ai_flags : 0;
+    int family = hints ? hints->ai_family : AF_UNSPEC;
+    if (!tk || !node || (flags & AI_NUMERICHOST) || is_numeric_host(node)
+            || (family != AF_UNSPEC && family != AF_INET && family != AF_INET6))
+        return getaddrinfo_f(node, service, hints, res);
+
+    // 未启用内置的DNS客户端, 以及规范名和v4映射地址需要原函数的完整实现, 交给线程池执行
+    if ((flags & (AI_CANONNAME | AI_V4MAPPED | AI_ALL)) || !use_dns_resolver())
+        return FileIoPool::getInstance().CoCall<int>([=]{
+                    return getaddrinfo_f(node, service, hints, res);
+                });
+
+    if (flags & AI_ADDRCONFIG) {
+        bool has_v4, has_v6;
+        configured_families(has_v4, has_v6);
+        if (family == AF_UNSPEC && has_v4 != has_v6)
+            family = has_v4 ? AF_INET : AF_INET6;
+        else if ((family == AF_INET && !has_v4) || (family == AF_INET6 && !has_v6))
+            return EAI_NONAME;
+    }
+
+    // 端口和socktype、protocol的组合由原函数解析通配地址得到, 与原函数对service的处理一致
+    struct addrinfo tmpl_hints;
+    memset(&tmpl_hints, 0, sizeof(tmpl_hints));
+    if (hints) {
+        tmpl_hints.ai_socktype = hints->ai_socktype;
+        tmpl_hints.ai_protocol = hints->ai_protocol;
+    }
+    tmpl_hints.ai_family = AF_INET;
+    tmpl_hints.ai_flags = (flags & AI_NUMERICSERV) | AI_PASSIVE | AI_NUMERICHOST;
+    struct addrinfo *tmpl = nullptr;
+    int err = getaddrinfo_f(nullptr, service ? service : "0", &tmpl_hints, &tmpl);
+    if (err)
+        return err;
+
+    std::vector<DnsAddress> addrs;
+    err = DnsResolver::getInstance().Resolve(node, family, addrs);
+    if (err) {
+        freeaddrinfo(tmpl);
+        return err;
+    }
+
+    // 与glibc的内存布局一致: 地址紧跟在addrinfo之后, 由原来的freeaddrinfo释放
+    struct addrinfo *head = nullptr, **tail = &head;
+    for (auto & addr : addrs) {
+        for (struct addrinfo *t = tmpl; t; t = t->ai_next) {
+            struct addrinfo *ai = (struct addrinfo*)calloc(1, sizeof(struct addrinfo) + sizeof(sockaddr_in6));
+            if (!ai) {
+                freeaddrinfo(head);
+                freeaddrinfo(tmpl);
+                return EAI_MEMORY;
+            }
+
+            in_port_t port = ((sockaddr_in*)t->ai_addr)->sin_port;
+            ai->ai_family = addr.family;
+            ai->ai_socktype = t->ai_socktype;
+            ai->ai_protocol = t->ai_protocol;
+            ai->ai_addr = (struct sockaddr*)(ai + 1);
+            if (addr.family == AF_INET) {
+                sockaddr_in* sin = (sockaddr_in*)ai->ai_addr;
+                sin->sin_family = AF_INET;
+                sin->sin_port = port;
+                sin->sin_addr = addr.v4;
+                ai->ai_addrlen = sizeof(sockaddr_in);
+            } else {
+                sockaddr_in6* sin6 = (sockaddr_in6*)ai->ai_addr;
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_port = port;
+                sin6->sin6_addr = addr.v6;
+                ai->ai_addrlen = sizeof(sockaddr_in6);
+            }
+            *tail = ai;
+            tail = &ai->ai_next;
+        }
+    }
+    freeaddrinfo(tmpl);
+    *res = head;
+    return 0;
+}
+
+struct hostent *gethostbyname(const char *name)
+{
+    if (!gethostbyname_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook gethostbyname(name=%s). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", name ? name : "nil",
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || !name || is_numeric_host(name))
+        return gethostbyname_f(name);
+
+    // 与原函数一样返回glibc内部的静态结果, h_errno是线程局部的, 需要带回当前线程
+    if (!use_dns_resolver()) {
+        int herr = 0;
+        struct hostent *ent = FileIoPool::getInstance().CoCall<struct hostent*>([=, &herr]{
+                    struct hostent *e = gethostbyname_f(name);
+                    herr = h_errno;
+                    return e;
+                });
+        if (!ent)
+            h_errno = herr;
+        return ent;
+    }
+
+    std::vector<DnsAddress> addrs;
+    int err = DnsResolver::getInstance().Resolve(name, AF_INET, addrs);
+    if (err) {
+        h_errno = (err == EAI_AGAIN) ? TRY_AGAIN : HOST_NOT_FOUND;
+        return nullptr;
+    }
+
+    // 与原函数一样返回静态的结果, 在下一次调用前有效
+    static thread_local struct {
+        struct hostent ent;
+        std::string name;
+        std::vector<in_addr> addrs;
+        std::vector<char*> addr_list;
+        char* aliases[1];
+    } result;
+    result.name = name;
+    result.addrs.clear();
+    for (auto & addr : addrs)
+        result.addrs.push_back(addr.v4);
+    result.addr_list.clear();
+    for (auto & addr : result.addrs)
+        result.addr_list.push_back((char*)&addr);
+    result.addr_list.push_back(nullptr);
+    result.aliases[0] = nullptr;
+    result.ent.h_name = &result.name[0];
+    result.ent.h_aliases = result.aliases;
+    result.ent.h_addrtype = AF_INET;
+    result.ent.h_length = sizeof(in_addr);
+    result.ent.h_addr_list = &result.addr_list[0];
+    return &result.ent;
+}
+#endif
+
+pid_t waitpid(pid_t pid, int *wstatus, int options)
+{
+    if (!waitpid_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook waitpid(pid=%d, options=%d). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", (int)pid, options,
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || (options & WNOHANG))
+        return waitpid_f(pid, wstatus, options);
+
+    return wait_child_mode(tk, pid, wstatus, options);
+}
+
+pid_t wait(int *wstatus)
+{
+    return waitpid(-1, wstatus, 0);
+}
+
+#if defined(CO_DYNAMIC_LINK)
+// 启动/bin/sh -c command, 标准输入或输出可以重定向到child_fd.
+// 使用posix_spawn(vfork), 复制大进程的页表时不会长时间阻塞.
+static pid_t spawn_shell(const char *command, int child_fd, int target_fd)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (child_fd >= 0 && child_fd != target_fd)
+        posix_spawn_file_actions_adddup2(&actions, child_fd, target_fd);
+
+    // 与glibc的system一致, 子进程中恢复SIGINT和SIGQUIT的默认处理
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid = -1;
+    const char* argv[] = {"sh", "-c", command, nullptr};
+    int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, (char* const*)argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+// system: 父进程中不忽略SIGINT/SIGQUIT、不阻塞SIGCHLD, 它们是整个进程(所有协程)的设置.
+int system(const char *command)
+{
+    if (!system_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook system(%s). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", command ? command : "nil",
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || !command)
+        return system_f(command);
+
+    pid_t pid = spawn_shell(command, -1, -1);
+    if (pid == -1) {
+        // 与glibc一致: 无法执行shell时返回值如同shell以127退出
+        if (errno == ENOENT || errno == EACCES)
+            return W_EXITCODE(127, 0);
+        return -1;
+    }
+
+    int status;
+    if (wait_child_mode(tk, pid, &status, 0) == -1)
+        return -1;
+    return status;
+}
+
+// 协程中popen创建的子进程, pclose时等待
+static LFLock s_popen_lock;
+static std::unordered_map<FILE*, pid_t> s_popen_children;
+
+// popen: 流的读写仍然使用libc内部的read/write, 需要时可以对fileno(stream)调用被hook的read/write.
+// 父进程一端总是带有O_CLOEXEC, 之后创建的子进程不会继承.
+FILE *popen(const char *command, const char *type)
+{
+    if (!popen_f) coroutine_hook_init();
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    DebugPrint(dbg_hook, "task(%s) hook popen(%s, %s). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", command ? command : "nil", type ? type : "nil",
+            g_Scheduler.IsCoroutine() ? "In" : "Not in");
+
+    if (!tk || !command || !type || (type[0] != 'r' && type[0] != 'w'))
+        return popen_f(command, type);
+
+    bool reading = type[0] == 'r';
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        return nullptr;
+
+    int parent_fd = reading ? fds[0] : fds[1];
+    int child_fd = reading ? fds[1] : fds[0];
+    pid_t pid = spawn_shell(command, child_fd, reading ? STDOUT_FILENO : STDIN_FILENO);
+    close(child_fd);
+    if (pid == -1) {
+        int err = errno;
+        close(parent_fd);
+        errno = err;
+        return nullptr;
+    }
+
+    FILE* stream = fdopen(parent_fd, reading ? "r" : "w");
+    if (!stream) {
+        int err = errno;
+        close(parent_fd);
+        wait_child_mode(tk, pid, nullptr, 0);
+        errno = err;
+        return nullptr;
+    }
+
+    std::unique_lock<LFLock> lock(s_popen_lock);
+    s_popen_children[stream] = pid;
+    return stream;
+}
+
+int pclose(FILE *stream)
+{
+    if (!pclose_f) coroutine_hook_init();
+
+    pid_t pid = -1;
+    {
+        std::unique_lock<LFLock> lock(s_popen_lock);
+        auto it = s_popen_children.find(stream);
+        if (it != s_popen_children.end()) {
+            pid = it->second;
+            s_popen_children.erase(it);
+        }
+    }
+
+    if (pid == -1)
+        return pclose_f(stream);
+
+    fclose(stream);
+    int status;
+    if (waitpid(pid, &status, 0) == -1)
+        return -1;
+    return status;
+}
+
+// 协程中的pthread_mutex_t/pthread_cond_t: 锁被占用或等待条件时挂起协程而不是线程,
+// 协程挂起在AddrWait中以对象地址为key的等待队列上, 解锁和通知时按地址唤醒.
+// mutex的状态仍然由glibc维护, 协程和普通线程可以混用同一个对象.
+static const int kMutexSpinCount = 100;
+
+// 协程等待mutex时, 至多隔这么久重新trylock一次.
+// glibc内部的解锁(例如线程中的pthread_cond_wait释放mutex)不经过hook, 不会唤醒等待的协程.
+static const int kMutexRecheckMs = 10;
+
+// 只处理普通的mutex: 递归、检错mutex的所有者是线程, 同一线程上的协程无法区分;
+// robust、优先级继承/保护、进程间共享的mutex也直接交给glibc.
+static bool is_plain_mutex(pthread_mutex_t *mutex)
+{
+    int kind = mutex->__data.__kind & 0xff;
+    return kind == PTHREAD_MUTEX_NORMAL || kind == PTHREAD_MUTEX_ADAPTIVE_NP;
+}
+
+// 不是进程间共享的条件变量才能在进程内的队列上等待.
+// @clockid: 返回pthread_condattr_setclock设置的时钟
+static bool is_private_cond(pthread_cond_t *cond, clockid_t *clockid)
+{
+#if __GLIBC_PREREQ(2, 25)
+    // __wrefs的bit0: 进程间共享, bit1: 使用CLOCK_MONOTONIC
+    unsigned int flags = __atomic_load_n(&cond->__data.__wrefs, __ATOMIC_RELAXED);
+    if (clockid)
+        *clockid = (flags & 2) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+    return !(flags & 1);
+#else
+    (void)cond; (void)clockid;
+    return false;
+#endif
+}
+
+// 需要按协程方式处理时返回当前协程
+static Task* pthread_hook_task(pthread_mutex_t *mutex)
+{
+    if (!HookOptions::get_enable_pthread_hook())
+        return nullptr;
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    if (!tk || !is_plain_mutex(mutex))
+        return nullptr;
+    return tk;
+}
+
+static int co_mutex_lock(Task* tk, pthread_mutex_t *mutex)
+{
+    int ret;
+    for (int i = 0; i < kMutexSpinCount; ++i) {
+        ret = pthread_mutex_trylock(mutex);
+        if (ret != EBUSY)
+            return ret;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    DebugPrint(dbg_hook, "task(%s) pthread_mutex_lock(%p) parked.", tk->DebugInfo(), (void*)mutex);
+    AddrWait & addr_wait = AddrWait::getInstance();
+    for (;;) {
+        AddrWait::Waiter w;
+        addr_wait.Enqueue(&w, mutex);
+        ret = pthread_mutex_trylock(mutex);
+        if (ret != EBUSY) {
+            addr_wait.Cancel(&w);
+            return ret;
+        }
+        addr_wait.Wait(&w, std::chrono::milliseconds(kMutexRecheckMs));
+    }
+}
+
+// @abstime: clockid时钟的绝对时间, nullptr表示不超时
+static int co_cond_wait(Task* tk, pthread_cond_t *cond, pthread_mutex_t *mutex,
+        clockid_t clockid, const struct timespec *abstime)
+{
+    MininumTimeDurationType timeout(-1);
+    if (abstime) {
+        if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000)
+            return EINVAL;
+
+        struct timespec now;
+        clock_gettime(clockid, &now);
+        long long ns = (long long)(abstime->tv_sec - now.tv_sec) * 1000000000LL
+            + (abstime->tv_nsec - now.tv_nsec);
+        timeout = std::chrono::duration_cast<MininumTimeDurationType>(
+                std::chrono::nanoseconds((std::max)(ns, 0LL)));
+    }
+
+    DebugPrint(dbg_hook, "task(%s) pthread_cond_wait(%p, %p) timeout=%lld.",
+            tk->DebugInfo(), (void*)cond, (void*)mutex, (long long)timeout.count());
+
+    // 先加入等待队列再解锁, 持有mutex修改条件后发出的通知不会丢失
+    AddrWait & addr_wait = AddrWait::getInstance();
+    AddrWait::Waiter w;
+    addr_wait.Enqueue(&w, cond);
+    int ret = pthread_mutex_unlock(mutex);
+    if (ret) {
+        addr_wait.Cancel(&w);
+        return ret;
+    }
+
+    bool woken = addr_wait.Wait(&w, timeout);
+    ret = co_mutex_lock(tk, mutex);
+    if (ret)
+        return ret;
+    return woken ? 0 : ETIMEDOUT;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    if (!pthread_mutex_lock_f) coroutine_hook_init();
+
+    Task* tk = pthread_hook_task(mutex);
+    if (!tk)
+        return pthread_mutex_lock_f(mutex);
+
+    return co_mutex_lock(tk, mutex);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+    if (!pthread_mutex_unlock_f) coroutine_hook_init();
+
+    int ret = pthread_mutex_unlock_f(mutex);
+    if (ret == 0 && HookOptions::get_enable_pthread_hook())
+        AddrWait::getInstance().Wake(mutex, 1);
+    return ret;
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    if (!pthread_cond_wait_f) coroutine_hook_init();
+
+    clockid_t clockid;
+    Task* tk = pthread_hook_task(mutex);
+    if (!tk || !is_private_cond(cond, &clockid))
+        return pthread_cond_wait_f(cond, mutex);
+
+    return co_cond_wait(tk, cond, mutex, clockid, nullptr);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+        const struct timespec *abstime)
+{
+    if (!pthread_cond_timedwait_f) coroutine_hook_init();
+
+    clockid_t clockid;
+    Task* tk = pthread_hook_task(mutex);
+    if (!tk || !is_private_cond(cond, &clockid))
+        return pthread_cond_timedwait_f(cond, mutex, abstime);
+
+    return co_cond_wait(tk, cond, mutex, clockid, abstime);
+}
+
+#if __GLIBC_PREREQ(2, 30)
+// std::condition_variable::wait_for/wait_until(steady_clock)使用pthread_cond_clockwait
+int pthread_cond_clockwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+        clockid_t clockid, const struct timespec *abstime)
+{
+    if (!pthread_cond_clockwait_f) coroutine_hook_init();
+
+    Task* tk = pthread_hook_task(mutex);
+    if (!tk || !is_private_cond(cond, nullptr)
+            || (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC))
+        return pthread_cond_clockwait_f(cond, mutex, clockid, abstime);
+
+    return co_cond_wait(tk, cond, mutex, clockid, abstime);
+}
+#endif
+
+// 条件变量允许虚假唤醒: 唤醒了协程时不再通知在glibc中等待的线程
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+    if (!pthread_cond_signal_f) coroutine_hook_init();
+
+    if (HookOptions::get_enable_pthread_hook() && AddrWait::getInstance().Wake(cond, 1))
+        return 0;
+    return pthread_cond_signal_f(cond);
+}
+
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+    if (!pthread_cond_broadcast_f) coroutine_hook_init();
+
+    if (HookOptions::get_enable_pthread_hook())
+        AddrWait::getInstance().Wake(cond, (std::numeric_limits<int>::max)());
+    return pthread_cond_broadcast_f(cond);
+}
+#endif
+
 unsigned int sleep(unsigned int seconds)
 {
     if (!sleep_f) coroutine_hook_init();
@@ -487,8 +1243,7 @@ int usleep(useconds_t usec)
     if (!tk)
         return usleep_f(usec);
 
-    int timeout_ms = usec / 1000;
-    g_Scheduler.SleepSwitch(timeout_ms);
+    g_Scheduler.SleepSwitch(std::chrono::microseconds(usec));
     return 0;
 
 }
@@ -498,22 +1253,22 @@ int nanosleep(const struct timespec *req, struct timespec *rem)
     if (!nanosleep_f) coroutine_hook_init();
 
     Task* tk = g_Scheduler.GetCurrentTask();
-    int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000000;
-    DebugPrint(dbg_hook, "task(%s) hook nanosleep(milliseconds=%d). %s coroutine.",
-            tk ? tk->DebugInfo() : "nil", timeout_ms,
+    DebugPrint(dbg_hook, "task(%s) hook nanosleep(seconds=%ld, nanoseconds=%ld). %s coroutine.",
+            tk ? tk->DebugInfo() : "nil", (long)req->tv_sec, (long)req->tv_nsec,
             g_Scheduler.IsCoroutine() ? "In" : "Not in");
 
     if (!tk)
         return nanosleep_f(req, rem);
 
-    g_Scheduler.SleepSwitch(timeout_ms);
+    g_Scheduler.SleepSwitch(std::chrono::duration_cast<MininumTimeDurationType>(
+                std::chrono::seconds(req->tv_sec) + std::chrono::nanoseconds(req->tv_nsec)));
     return 0;
 }
 
 int close(int fd)
 {
     if (!close_f) coroutine_hook_init();
-    return FdManager::getInstance().close(fd);
+    return co::net::close(fd);
 }
 
 int fcntl(int __fd, int __cmd, ...)
@@ -564,12 +1319,10 @@ int fcntl(int __fd, int __cmd, ...)
                 va_end(va);
                 FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(__fd);
                 if (!fd_ctx || fd_ctx->closed()) return fcntl_f(__fd, __cmd, flags);
-                if (!fd_ctx->is_socket()) return fcntl_f(__fd, __cmd, flags);
+                if (!fd_ctx->is_pollable()) return fcntl_f(__fd, __cmd, flags);
                 fd_ctx->set_user_nonblock(flags & O_NONBLOCK);
                 if (fd_ctx->sys_nonblock())
                     flags |= O_NONBLOCK;
-                else
-                    flags &= ~O_NONBLOCK;
                 return fcntl_f(__fd, __cmd, flags);
             }
 
@@ -599,7 +1352,7 @@ int fcntl(int __fd, int __cmd, ...)
                 int flags = fcntl_f(__fd, __cmd);
                 FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(__fd);
                 if (!fd_ctx || fd_ctx->closed()) return flags;
-                if (!fd_ctx->is_socket()) return flags;
+                if (!fd_ctx->is_pollable()) return flags;
                 if (fd_ctx->user_nonblock())
                     return flags | O_NONBLOCK;
                 else
@@ -635,9 +1388,11 @@ int ioctl(int fd, unsigned long int request, ...)
         bool user_nonblock = !!*(int*)arg;
         FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
         if (!fd_ctx || fd_ctx->closed()) return ioctl_f(fd, request, arg);
-        if (!fd_ctx->is_socket()) return ioctl_f(fd, request, arg);
+        if (!fd_ctx->is_pollable()) return ioctl_f(fd, request, arg);
 
         fd_ctx->set_user_nonblock(user_nonblock);
+        if (!fd_ctx->sys_nonblock())
+            return ioctl_f(fd, request, arg);   // 终端等fd的O_NONBLOCK由用户决定
         return 0;
     }
 
@@ -662,7 +1417,21 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
         }
     }
 
-    return setsockopt_f(sockfd, level, optname, optval, optlen);
+    int res = setsockopt_f(sockfd, level, optname, optval, optlen);
+
+    // 之后错误队列中会有其他条目, 零拷贝通知交给用户读取
+    int on = (res == 0 && optval && optlen >= (socklen_t)sizeof(int)) ? *(const int*)optval : 0;
+    if ((level == SOL_IP && optname == IP_RECVERR && on) ||
+            (level == SOL_IPV6 && optname == IPV6_RECVERR && on) ||
+            (level == SOL_SOCKET && optname == SO_TIMESTAMPING &&
+             (on & (SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                    SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_ACK)))) {
+        FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(sockfd);
+        if (fd_ctx)
+            fd_ctx->release_zerocopy();
+    }
+
+    return res;
 }
 
 int dup(int oldfd)
@@ -718,20 +1487,84 @@ int dup3(int oldfd, int newfd, int flags)
     return ret;
 }
 
+int open(const char *pathname, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_list va;
+        va_start(va, flags);
+        mode = va_arg(va, mode_t);
+        va_end(va);
+    }
+
+    if (!open_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::open, open_f, pathname, flags, mode);
+}
+
+#if __GLIBC_PREREQ(2, 33)
+// 2.33之前的glibc中stat是调用__xstat的内联函数, 不能hook.
+int stat(const char *pathname, struct stat *statbuf)
+{
+    if (!stat_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::stat, stat_f, pathname, statbuf);
+}
+#endif
+
+int fsync(int fd)
+{
+    if (!fsync_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::fsync, fsync_f, fd);
+}
+
+int fdatasync(int fd)
+{
+    if (!fdatasync_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::fdatasync, fdatasync_f, fd);
+}
+
+int rename(const char *oldpath, const char *newpath)
+{
+    if (!rename_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::rename, rename_f, oldpath, newpath);
+}
+
+int unlink(const char *pathname)
+{
+    if (!unlink_f) coroutine_hook_init();
+    return file_meta_mode<int>(eFileOp::unlink, unlink_f, pathname);
+}
+
+DIR *opendir(const char *name)
+{
+    if (!opendir_f) coroutine_hook_init();
+    return file_meta_mode<DIR*>(eFileOp::opendir, opendir_f, name);
+}
+
+struct dirent *readdir(DIR *dirp)
+{
+    if (!readdir_f) coroutine_hook_init();
+    return file_meta_mode<struct dirent*>(eFileOp::readdir, readdir_f, dirp);
+}
+
 #if !defined(CO_DYNAMIC_LINK)
 extern int __connect(int fd, const struct sockaddr *addr, socklen_t addrlen);
 extern ssize_t __read(int fd, void *buf, size_t count);
 extern ssize_t __readv(int fd, const struct iovec *iov, int iovcnt);
+extern ssize_t __libc_pread(int fd, void *buf, size_t count, off_t offset);
 extern ssize_t __recv(int sockfd, void *buf, size_t len, int flags);
 extern ssize_t __recvfrom(int sockfd, void *buf, size_t len, int flags,
         struct sockaddr *src_addr, socklen_t *addrlen);
 extern ssize_t __recvmsg(int sockfd, struct msghdr *msg, int flags);
+extern int __recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+        int flags, struct timespec *timeout);
 extern ssize_t __write(int fd, const void *buf, size_t count);
 extern ssize_t __writev(int fd, const struct iovec *iov, int iovcnt);
+extern ssize_t __libc_pwrite(int fd, const void *buf, size_t count, off_t offset);
 extern ssize_t __send(int sockfd, const void *buf, size_t len, int flags);
 extern ssize_t __sendto(int sockfd, const void *buf, size_t len, int flags,
         const struct sockaddr *dest_addr, socklen_t addrlen);
 extern ssize_t __sendmsg(int sockfd, const struct msghdr *msg, int flags);
+extern int __sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
 extern int __libc_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 extern int __poll(struct pollfd *fds, nfds_t nfds, int timeout);
 extern int __select(int nfds, fd_set *readfds, fd_set *writefds,
@@ -749,6 +1582,70 @@ extern int __dup(int);
 extern int __dup2(int, int);
 extern int __dup3(int, int, int);
 extern int __usleep(useconds_t usec);
+extern int __open(const char *pathname, int flags, ...);
+#if __GLIBC_PREREQ(2, 33)
+extern int __stat(const char *pathname, struct stat *statbuf);
+#endif
+extern int __renameat(int olddirfd, const char *oldpath, int newdirfd, const char *newpath);
+extern int __unlink(const char *pathname);
+extern DIR *__opendir(const char *name);
+extern struct dirent *__readdir(DIR *dirp);
+
+// libc.a中fsync/fdatasync/rename/accept4/sendfile/splice/epoll_wait等没有内部别名, 直接使用系统调用.
+static ssize_t __co_sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    return syscall(SYS_sendfile, out_fd, in_fd, offset, count);
+}
+static ssize_t __co_sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count)
+{
+#if defined(SYS_sendfile64)
+    return syscall(SYS_sendfile64, out_fd, in_fd, offset, count);
+#else
+    return syscall(SYS_sendfile, out_fd, in_fd, offset, count);
+#endif
+}
+static ssize_t __co_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+        size_t len, unsigned int flags)
+{
+    return syscall(SYS_splice, fd_in, off_in, fd_out, off_out, len, flags);
+}
+static ssize_t __co_tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    return syscall(SYS_tee, fd_in, fd_out, len, flags);
+}
+static ssize_t __co_vmsplice(int fd, const struct iovec *iov, size_t nr_segs, unsigned int flags)
+{
+    return syscall(SYS_vmsplice, fd, iov, nr_segs, flags);
+}
+static int __co_epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout,
+        const sigset_t *sigmask)
+{
+    return syscall(SYS_epoll_pwait, epfd, events, maxevents, timeout, sigmask, _NSIG / 8);
+}
+static int __co_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    return __co_epoll_pwait(epfd, events, maxevents, timeout, nullptr);
+}
+static pid_t __co_waitpid(pid_t pid, int *wstatus, int options)
+{
+    return syscall(SYS_wait4, pid, wstatus, options, nullptr);
+}
+static int __co_accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    return syscall(SYS_accept4, sockfd, addr, addrlen, flags);
+}
+static int __co_fsync(int fd)
+{
+    return syscall(SYS_fsync, fd);
+}
+static int __co_fdatasync(int fd)
+{
+    return syscall(SYS_fdatasync, fd);
+}
+static int __co_rename(const char *oldpath, const char *newpath)
+{
+    return __renameat(AT_FDCWD, oldpath, AT_FDCWD, newpath);
+}
 
 // 某些版本libc.a中没有__usleep.
 __attribute__((weak))
@@ -760,6 +1657,16 @@ int __usleep(useconds_t usec)
 #endif
 }
 
+#if defined(CO_DYNAMIC_LINK)
+// pthread_cond_*在x86/x86_64等平台上还保留着旧版本(GLIBC_2.2.5等)的实现,
+// dlsym可能返回旧版本, 与新版本初始化的pthread_cond_t不兼容, 需要指定版本查找.
+static void* dlsym_pthread_cond(const char* name)
+{
+    void* fn = dlvsym(RTLD_NEXT, name, "GLIBC_2.3.2");
+    return fn ? fn : dlsym(RTLD_NEXT, name);
+}
+#endif
+
 namespace co
 {
 
@@ -772,17 +1679,44 @@ void coroutine_hook_init()
     connect_f = (connect_t)dlsym(RTLD_NEXT, "connect");
     read_f = (read_t)dlsym(RTLD_NEXT, "read");
     readv_f = (readv_t)dlsym(RTLD_NEXT, "readv");
+    pread_f = (pread_t)dlsym(RTLD_NEXT, "pread");
     recv_f = (recv_t)dlsym(RTLD_NEXT, "recv");
     recvfrom_f = (recvfrom_t)dlsym(RTLD_NEXT, "recvfrom");
     recvmsg_f = (recvmsg_t)dlsym(RTLD_NEXT, "recvmsg");
+    recvmmsg_f = (recvmmsg_t)dlsym(RTLD_NEXT, "recvmmsg");
     write_f = (write_t)dlsym(RTLD_NEXT, "write");
     writev_f = (writev_t)dlsym(RTLD_NEXT, "writev");
+    pwrite_f = (pwrite_t)dlsym(RTLD_NEXT, "pwrite");
     send_f = (send_t)dlsym(RTLD_NEXT, "send");
     sendto_f = (sendto_t)dlsym(RTLD_NEXT, "sendto");
     sendmsg_f = (sendmsg_t)dlsym(RTLD_NEXT, "sendmsg");
+    sendmmsg_f = (sendmmsg_t)dlsym(RTLD_NEXT, "sendmmsg");
+    sendfile_f = (sendfile_t)dlsym(RTLD_NEXT, "sendfile");
+    sendfile64_f = (sendfile64_t)dlsym(RTLD_NEXT, "sendfile64");
+    splice_f = (splice_t)dlsym(RTLD_NEXT, "splice");
+    tee_f = (tee_t)dlsym(RTLD_NEXT, "tee");
+    vmsplice_f = (vmsplice_t)dlsym(RTLD_NEXT, "vmsplice");
     accept_f = (accept_t)dlsym(RTLD_NEXT, "accept");
+    accept4_f = (accept4_t)dlsym(RTLD_NEXT, "accept4");
+    getaddrinfo_f = (getaddrinfo_t)dlsym(RTLD_NEXT, "getaddrinfo");
+    gethostbyname_f = (gethostbyname_t)dlsym(RTLD_NEXT, "gethostbyname");
+    waitpid_f = (waitpid_t)dlsym(RTLD_NEXT, "waitpid");
+    system_f = (system_t)dlsym(RTLD_NEXT, "system");
+    popen_f = (popen_t)dlsym(RTLD_NEXT, "popen");
+    pclose_f = (pclose_t)dlsym(RTLD_NEXT, "pclose");
+    pthread_mutex_lock_f = (pthread_mutex_lock_t)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    pthread_mutex_unlock_f = (pthread_mutex_unlock_t)dlsym(RTLD_NEXT, "pthread_mutex_unlock");
+    pthread_cond_wait_f = (pthread_cond_wait_t)dlsym_pthread_cond("pthread_cond_wait");
+    pthread_cond_timedwait_f = (pthread_cond_timedwait_t)dlsym_pthread_cond("pthread_cond_timedwait");
+#if __GLIBC_PREREQ(2, 30)
+    pthread_cond_clockwait_f = (pthread_cond_clockwait_t)dlsym(RTLD_NEXT, "pthread_cond_clockwait");
+#endif
+    pthread_cond_signal_f = (pthread_cond_signal_t)dlsym_pthread_cond("pthread_cond_signal");
+    pthread_cond_broadcast_f = (pthread_cond_broadcast_t)dlsym_pthread_cond("pthread_cond_broadcast");
     poll_f = (poll_t)dlsym(RTLD_NEXT, "poll");
     select_f = (select_t)dlsym(RTLD_NEXT, "select");
+    epoll_wait_f = (epoll_wait_t)dlsym(RTLD_NEXT, "epoll_wait");
+    epoll_pwait_f = (epoll_pwait_t)dlsym(RTLD_NEXT, "epoll_pwait");
     sleep_f = (sleep_t)dlsym(RTLD_NEXT, "sleep");
     usleep_f = (usleep_t)dlsym(RTLD_NEXT, "usleep");
     nanosleep_f = (nanosleep_t)dlsym(RTLD_NEXT, "nanosleep");
@@ -794,21 +1728,58 @@ void coroutine_hook_init()
     dup_f = (dup_t)dlsym(RTLD_NEXT, "dup");
     dup2_f = (dup2_t)dlsym(RTLD_NEXT, "dup2");
     dup3_f = (dup3_t)dlsym(RTLD_NEXT, "dup3");
+    open_f = (open_t)dlsym(RTLD_NEXT, "open");
+#if __GLIBC_PREREQ(2, 33)
+    stat_f = (stat_t)dlsym(RTLD_NEXT, "stat");
+#endif
+    fsync_f = (fsync_t)dlsym(RTLD_NEXT, "fsync");
+    fdatasync_f = (fdatasync_t)dlsym(RTLD_NEXT, "fdatasync");
+    rename_f = (rename_t)dlsym(RTLD_NEXT, "rename");
+    unlink_f = (unlink_t)dlsym(RTLD_NEXT, "unlink");
+    opendir_f = (opendir_t)dlsym(RTLD_NEXT, "opendir");
+    readdir_f = (readdir_t)dlsym(RTLD_NEXT, "readdir");
 #else
     connect_f = &__connect;
     read_f = &__read;
     readv_f = &__readv;
+    pread_f = &__libc_pread;
     recv_f = &__recv;
     recvfrom_f = &__recvfrom;
     recvmsg_f = &__recvmsg;
+    recvmmsg_f = &__recvmmsg;
     write_f = &__write;
     writev_f = &__writev;
+    pwrite_f = &__libc_pwrite;
     send_f = &__send;
     sendto_f = &__sendto;
     sendmsg_f = &__sendmsg;
+    sendmmsg_f = &__sendmmsg;
+    sendfile_f = &__co_sendfile;
+    sendfile64_f = &__co_sendfile64;
+    splice_f = &__co_splice;
+    tee_f = &__co_tee;
+    vmsplice_f = &__co_vmsplice;
     accept_f = &__libc_accept;
+    accept4_f = &__co_accept4;
+    getaddrinfo_f = &getaddrinfo;       // 静态链接时没有hook
+    gethostbyname_f = &gethostbyname;
+    waitpid_f = &__co_waitpid;
+    system_f = &system;
+    popen_f = &popen;
+    pclose_f = &pclose;
+    pthread_mutex_lock_f = &pthread_mutex_lock;
+    pthread_mutex_unlock_f = &pthread_mutex_unlock;
+    pthread_cond_wait_f = &pthread_cond_wait;
+    pthread_cond_timedwait_f = &pthread_cond_timedwait;
+#if __GLIBC_PREREQ(2, 30)
+    pthread_cond_clockwait_f = &pthread_cond_clockwait;
+#endif
+    pthread_cond_signal_f = &pthread_cond_signal;
+    pthread_cond_broadcast_f = &pthread_cond_broadcast;
     poll_f = &__poll;
     select_f = &__select;
+    epoll_wait_f = &__co_epoll_wait;
+    epoll_pwait_f = &__co_epoll_pwait;
     sleep_f = &__sleep;
     usleep_f = &__usleep;
     nanosleep_f = &__nanosleep;
@@ -820,12 +1791,30 @@ void coroutine_hook_init()
     dup_f = &__dup;
     dup2_f = &__dup2;
     dup3_f = &__dup3;
+    open_f = &__open;
+#if __GLIBC_PREREQ(2, 33)
+    stat_f = &__stat;
+#endif
+    fsync_f = &__co_fsync;
+    fdatasync_f = &__co_fdatasync;
+    rename_f = &__co_rename;
+    unlink_f = &__unlink;
+    opendir_f = &__opendir;
+    readdir_f = &__readdir;
 #endif
 
-    if (!connect_f || !read_f || !write_f || !readv_f || !writev_f || !send_f
+    if (!connect_f || !read_f || !write_f || !readv_f || !writev_f || !pread_f || !pwrite_f || !send_f
             || !sendto_f || !sendmsg_f || !accept_f || !poll_f || !select_f
+            || !epoll_wait_f || !epoll_pwait_f
+            || !recvmmsg_f || !sendmmsg_f || !accept4_f || !getaddrinfo_f || !gethostbyname_f
+            || !waitpid_f || !system_f || !popen_f || !pclose_f
+            || !pthread_mutex_lock_f || !pthread_mutex_unlock_f || !pthread_cond_wait_f
+            || !pthread_cond_timedwait_f || !pthread_cond_signal_f || !pthread_cond_broadcast_f
+            || !sendfile_f || !sendfile64_f || !splice_f || !tee_f || !vmsplice_f
             || !sleep_f|| !usleep_f || !nanosleep_f || !close_f || !fcntl_f || !setsockopt_f
-            || !getsockopt_f || !dup_f || !dup2_f || !dup3_f)
+            || !getsockopt_f || !dup_f || !dup2_f || !dup3_f
+            || !open_f || !fsync_f || !fdatasync_f || !rename_f || !unlink_f
+            || !opendir_f || !readdir_f)
     {
         fprintf(stderr, "Hook syscall failed. Please don't remove libc.a when static-link.\n");
         exit(1);
@@ -1,5 +1,10 @@
 #pragma once
 #include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
 
 extern "C" {
 
@@ -12,6 +17,9 @@ extern read_t read_f;
 typedef ssize_t(*readv_t)(int, const struct iovec *, int);
 extern readv_t readv_f;
 
+typedef ssize_t(*pread_t)(int, void *, size_t, off_t);
+extern pread_t pread_f;
+
 typedef ssize_t(*recv_t)(int sockfd, void *buf, size_t len, int flags);
 extern recv_t recv_f;
 
@@ -22,12 +30,19 @@ extern recvfrom_t recvfrom_f;
 typedef ssize_t(*recvmsg_t)(int sockfd, struct msghdr *msg, int flags);
 extern recvmsg_t recvmsg_f;
 
+typedef int(*recvmmsg_t)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+        int flags, struct timespec *timeout);
+extern recvmmsg_t recvmmsg_f;
+
 typedef ssize_t(*write_t)(int, const void *, size_t);
 extern write_t write_f;
 
 typedef ssize_t(*writev_t)(int, const struct iovec *, int);
 extern writev_t writev_f;
 
+typedef ssize_t(*pwrite_t)(int, const void *, size_t, off_t);
+extern pwrite_t pwrite_f;
+
 typedef ssize_t(*send_t)(int sockfd, const void *buf, size_t len, int flags);
 extern send_t send_f;
 
@@ -38,6 +53,26 @@ extern sendto_t sendto_f;
 typedef ssize_t(*sendmsg_t)(int sockfd, const struct msghdr *msg, int flags);
 extern sendmsg_t sendmsg_f;
 
+typedef int(*sendmmsg_t)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+extern sendmmsg_t sendmmsg_f;
+
+// 零拷贝传输
+typedef ssize_t(*sendfile_t)(int out_fd, int in_fd, off_t *offset, size_t count);
+extern sendfile_t sendfile_f;
+
+typedef ssize_t(*sendfile64_t)(int out_fd, int in_fd, off64_t *offset, size_t count);
+extern sendfile64_t sendfile64_f;
+
+typedef ssize_t(*splice_t)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+        size_t len, unsigned int flags);
+extern splice_t splice_f;
+
+typedef ssize_t(*tee_t)(int fd_in, int fd_out, size_t len, unsigned int flags);
+extern tee_t tee_f;
+
+typedef ssize_t(*vmsplice_t)(int fd, const struct iovec *iov, size_t nr_segs, unsigned int flags);
+extern vmsplice_t vmsplice_f;
+
 typedef int(*poll_t)(struct pollfd *fds, nfds_t nfds, int timeout);
 extern poll_t poll_f;
 
@@ -45,9 +80,67 @@ typedef int(*select_t)(int nfds, fd_set *readfds, fd_set *writefds,
         fd_set *exceptfds, struct timeval *timeout);
 extern select_t select_f;
 
+// 用户自己的epoll fd
+typedef int(*epoll_wait_t)(int epfd, struct epoll_event *events, int maxevents, int timeout);
+extern epoll_wait_t epoll_wait_f;
+
+typedef int(*epoll_pwait_t)(int epfd, struct epoll_event *events, int maxevents, int timeout,
+        const sigset_t *sigmask);
+extern epoll_pwait_t epoll_pwait_f;
+
 typedef int(*accept_t)(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 extern accept_t accept_f;
 
+typedef int(*accept4_t)(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags);
+extern accept4_t accept4_f;
+
+// 域名解析(见dns_resolver.h). 静态链接时不hook, 只能显式调用DnsResolver.
+typedef int(*getaddrinfo_t)(const char *node, const char *service,
+        const struct addrinfo *hints, struct addrinfo **res);
+extern getaddrinfo_t getaddrinfo_f;
+
+typedef struct hostent*(*gethostbyname_t)(const char *name);
+extern gethostbyname_t gethostbyname_f;
+
+// 子进程. system/popen/pclose在静态链接时不hook
+typedef pid_t(*waitpid_t)(pid_t pid, int *wstatus, int options);
+extern waitpid_t waitpid_f;
+
+typedef int(*system_t)(const char *command);
+extern system_t system_f;
+
+typedef FILE*(*popen_t)(const char *command, const char *type);
+extern popen_t popen_f;
+
+typedef int(*pclose_t)(FILE *stream);
+extern pclose_t pclose_f;
+
+// pthread互斥锁和条件变量, CoroutineOptions::enable_pthread_hook开启时在协程中生效. 静态链接时不hook
+typedef int(*pthread_mutex_lock_t)(pthread_mutex_t *mutex);
+extern pthread_mutex_lock_t pthread_mutex_lock_f;
+
+typedef int(*pthread_mutex_unlock_t)(pthread_mutex_t *mutex);
+extern pthread_mutex_unlock_t pthread_mutex_unlock_f;
+
+typedef int(*pthread_cond_wait_t)(pthread_cond_t *cond, pthread_mutex_t *mutex);
+extern pthread_cond_wait_t pthread_cond_wait_f;
+
+typedef int(*pthread_cond_timedwait_t)(pthread_cond_t *cond, pthread_mutex_t *mutex,
+        const struct timespec *abstime);
+extern pthread_cond_timedwait_t pthread_cond_timedwait_f;
+
+#if __GLIBC_PREREQ(2, 30)
+typedef int(*pthread_cond_clockwait_t)(pthread_cond_t *cond, pthread_mutex_t *mutex,
+        clockid_t clockid, const struct timespec *abstime);
+extern pthread_cond_clockwait_t pthread_cond_clockwait_f;
+#endif
+
+typedef int(*pthread_cond_signal_t)(pthread_cond_t *cond);
+extern pthread_cond_signal_t pthread_cond_signal_f;
+
+typedef int(*pthread_cond_broadcast_t)(pthread_cond_t *cond);
+extern pthread_cond_broadcast_t pthread_cond_broadcast_f;
+
 typedef unsigned int(*sleep_t)(unsigned int seconds);
 extern sleep_t sleep_f;
 
@@ -84,9 +177,39 @@ extern dup2_t dup2_f;
 typedef int(*dup3_t)(int, int, int);
 extern dup3_t dup3_f;
 
+// 文件元数据操作
+typedef int(*open_t)(const char *pathname, int flags, ...);
+extern open_t open_f;
+
+typedef int(*stat_t)(const char *pathname, struct stat *statbuf);
+extern stat_t stat_f;
+
+typedef int(*fsync_t)(int fd);
+extern fsync_t fsync_f;
+
+typedef int(*fdatasync_t)(int fd);
+extern fdatasync_t fdatasync_f;
+
+typedef int(*rename_t)(const char *oldpath, const char *newpath);
+extern rename_t rename_f;
+
+typedef int(*unlink_t)(const char *pathname);
+extern unlink_t unlink_f;
+
+typedef DIR*(*opendir_t)(const char *name);
+extern opendir_t opendir_f;
+
+typedef struct dirent*(*readdir_t)(DIR *dirp);
+extern readdir_t readdir_f;
+
 } //extern "C"
 
 namespace co {
     extern void set_connect_timeout(int milliseconds);
     extern void initialize_socket_async_methods(int socketfd);
+
+    // 经过一个管道用splice把from_fd的数据转发到to_fd, 数据不经过用户空间.
+    // 在协程中调用时两端未就绪会挂起协程. 直到from_fd读到EOF才返回.
+    // @return: 转发的字节数, 出错时返回-1并设置errno
+    extern ssize_t splice_proxy(int from_fd, int to_fd);
 } //namespace co
@@ -0,0 +1,81 @@
+#include "signal_channel.h"
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <mutex>
+#include "scheduler.h"
+#include "co_net.h"
+
+namespace co
+{
+
+SignalChannel::SignalChannel(std::initializer_list<int> signals, std::size_t capacity)
+    : Channel<int>(capacity)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int signo : signals)
+        sigaddset(&mask, signo);
+
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sfd == -1)
+        throw std::system_error(errno, std::system_category(), "signalfd");
+
+    int stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd == -1) {
+        int err = errno;
+        close(sfd);
+        throw std::system_error(err, std::system_category(), "eventfd");
+    }
+    stop_ = std::make_shared<StopFd>();
+    stop_->fd = stop_fd;
+
+    // 两个fd都由后台协程关闭: 协程等待期间fd号不会被关闭并复用.
+    // 协程也可能因为poll出错而提前退出, 所以Close要通过共享的StopFd确认fd仍属于协程.
+    // 使用co::net的接口, DISABLE_HOOK时同样只挂起后台协程.
+    std::shared_ptr<StopFd> stop = stop_;
+    Channel<int> ch = *this;
+    g_Scheduler.CreateTask([sfd, stop_fd, stop, ch]{
+                for (;;) {
+                    pollfd pfds[2] = {{sfd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+                    if (net::poll(pfds, 2, -1) == -1 && errno != EINTR)
+                        break;
+                    if (pfds[1].revents)
+                        break;
+
+                    signalfd_siginfo info;
+                    if ((pfds[0].revents & POLLIN) && read(sfd, &info, sizeof(info)) == sizeof(info))
+                        ch.TryPush((int)info.ssi_signo);
+                }
+                {
+                    std::unique_lock<LFLock> lock(stop->lock);
+                    stop->fd = -1;
+                }
+                net::close(sfd);
+                net::close(stop_fd);
+            }, 0, __FILE__, __LINE__, egod_default);
+}
+
+SignalChannel::~SignalChannel()
+{
+    Close();
+}
+
+void SignalChannel::Close()
+{
+    if (!stop_) return ;
+    {
+        std::unique_lock<LFLock> lock(stop_->lock);
+        if (stop_->fd != -1) {
+            uint64_t v = 1;
+            write(stop_->fd, &v, sizeof(v));
+        }
+    }
+    stop_.reset();
+}
+
+} //namespace co
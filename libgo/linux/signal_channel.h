@@ -0,0 +1,44 @@
+/************************************************
+ * 在协程中接收信号: sigwait会阻塞整个调度线程.
+ * 信号被阻塞后由signalfd接收, signalfd加入reactor, 由一个后台协程读出信号编号放入channel.
+ *
+ * 进程收到的信号会投递给任意一个没有阻塞它的线程, 因此需要在创建调度线程之前
+ *     创建SignalChannel(新线程继承信号掩码), 或者在所有线程中都阻塞这些信号.
+ * 后台协程一直存在, 直到SignalChannel被析构或Close.
+*************************************************/
+#pragma once
+#include <initializer_list>
+#include <memory>
+#include "channel.h"
+#include "spinlock.h"
+
+namespace co
+{
+
+class SignalChannel : public Channel<int>
+{
+public:
+    // 在当前线程阻塞signals并开始接收. channel满时丢弃新到的信号
+    // (与未处理的同一个信号只保留一个的语义一致).
+    // @throws: signalfd创建失败时抛出std::system_error
+    explicit SignalChannel(std::initializer_list<int> signals, std::size_t capacity = 64);
+    ~SignalChannel();
+
+    SignalChannel(SignalChannel const&) = delete;
+    SignalChannel& operator=(SignalChannel const&) = delete;
+
+    // 停止接收, 已经在channel中的信号仍然可以取出. 不恢复信号掩码.
+    void Close();
+
+private:
+    // 通知后台协程退出的eventfd, 与后台协程共享.
+    // 后台协程退出时在锁内把fd置为-1后再关闭, Close只在fd仍有效时写入.
+    struct StopFd
+    {
+        LFLock lock;
+        int fd = -1;
+    };
+    std::shared_ptr<StopFd> stop_;
+};
+
+} //namespace co
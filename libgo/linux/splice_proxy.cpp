@@ -0,0 +1,60 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "linux_glibc_hook.h"
+
+namespace co
+{
+
+ssize_t splice_proxy(int from_fd, int to_fd)
+{
+    // 每次最多搬运管道默认容量的数据
+    static const size_t chunk = 64 * 1024;
+
+    int pipefd[2];
+    if (-1 == pipe2(pipefd, O_CLOEXEC))
+        return -1;
+
+    ssize_t total = 0;
+    int error = 0;
+    while (!error) {
+        ssize_t n = splice(from_fd, nullptr, pipefd[1], nullptr, chunk,
+                SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0)
+            break;  // EOF
+
+        if (n == -1) {
+            if (errno != EINTR)
+                error = errno;
+            continue;
+        }
+
+        // 把管道中的数据全部写出, 对端接收慢时会分多次完成
+        while (n > 0) {
+            ssize_t m = splice(pipefd[0], nullptr, to_fd, nullptr, n,
+                    SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (m == -1) {
+                if (errno == EINTR) continue;
+                error = errno;
+                break;
+            }
+
+            n -= m;
+            total += m;
+        }
+    }
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return total;
+}
+
+} //namespace co
@@ -0,0 +1,594 @@
+#include "uring_wait.h"
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <chrono>
+#include "scheduler.h"
+#include "linux_glibc_hook.h"
+#if ENABLE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+namespace co
+{
+
+std::atomic<uint64_t> IoUring::s_submit_count{0};
+std::atomic<uint64_t> IoUring::s_complete_count{0};
+
+uint64_t IoUring::GetSubmitCount()
+{
+    return s_submit_count;
+}
+
+uint64_t IoUring::GetCompleteCount()
+{
+    return s_complete_count;
+}
+
+#if ENABLE_IO_URING && defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+#define LIBGO_IO_URING 1
+#else
+#define LIBGO_IO_URING 0
+#endif
+
+#if LIBGO_IO_URING
+
+// user_data的最低位区分cqe的来源, 为0的cqe(link timeout, cancel)直接忽略.
+static const uint64_t uring_tag_sentry = 0;
+static const uint64_t uring_tag_accept = 1;
+static const uint64_t uring_tag_mask = 1;
+
+static int io_uring_setup(unsigned entries, io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint8_t UringOpcode(eUringOpcode opcode)
+{
+    switch (opcode) {
+        case eUringOpcode::read:    return IORING_OP_READ;
+        case eUringOpcode::readv:   return IORING_OP_READV;
+        case eUringOpcode::recv:    return IORING_OP_RECV;
+        case eUringOpcode::recvmsg: return IORING_OP_RECVMSG;
+        case eUringOpcode::write:   return IORING_OP_WRITE;
+        case eUringOpcode::writev:  return IORING_OP_WRITEV;
+        case eUringOpcode::send:    return IORING_OP_SEND;
+        case eUringOpcode::sendmsg: return IORING_OP_SENDMSG;
+        case eUringOpcode::connect: return IORING_OP_CONNECT;
+        case eUringOpcode::accept:  return IORING_OP_ACCEPT;
+        default:                    return IORING_OP_NOP;
+    }
+}
+
+#ifdef IORING_ACCEPT_MULTISHOT
+static std::atomic<bool> s_multishot_accept_unsupported{false};
+#else
+static std::atomic<bool> s_multishot_accept_unsupported{true};
+#endif
+
+// 内核需要支持FAST_POLL(5.7+): 对未就绪的socket, 内核内部poll等待后再执行,
+// 否则操作会被放入io-wq线程池中阻塞执行.
+bool IoUring::IsSupported()
+{
+    static bool supported = [] {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = io_uring_setup(4, &params);
+        if (fd < 0)
+            return false;
+
+        bool ok = !!(params.features & IORING_FEAT_FAST_POLL);
+        if (ok) {
+            size_t len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+            io_uring_probe *probe = (io_uring_probe*)calloc(1, len);
+            if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                ok = false;
+            } else {
+                uint8_t ops[] = {IORING_OP_READ, IORING_OP_READV, IORING_OP_RECV,
+                    IORING_OP_RECVMSG, IORING_OP_WRITE, IORING_OP_WRITEV, IORING_OP_SEND,
+                    IORING_OP_SENDMSG, IORING_OP_CONNECT, IORING_OP_ACCEPT,
+                    IORING_OP_LINK_TIMEOUT, IORING_OP_ASYNC_CANCEL};
+                for (auto op : ops)
+                    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                        ok = false;
+            }
+            free(probe);
+        }
+        // 可能在调度器初始化hook之前调用, 此时close_f还是NULL
+        syscall(SYS_close, fd);
+        DebugPrint(dbg_ioblock, "io_uring supported: %d", (int)ok);
+        return ok;
+    }();
+    return supported;
+}
+
+bool IoUring::IsEnabled()
+{
+    return g_Scheduler.GetOptions().io_backend == eIoBackend::io_uring && IsSupported();
+}
+
+IoUring::IoUring()
+{
+}
+
+IoUring::~IoUring()
+{
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+    if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+    if (ring_fd_ >= 0) close_f(ring_fd_);
+}
+
+bool IoUring::Init(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 大量协程同时阻塞在io上时, 完成事件可能远多于一轮提交的sqe数量
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = entries * 8;
+#ifdef IORING_SETUP_COOP_TASKRUN
+    // 完成事件在线程下次进入内核时处理即可, 不需要打断正在运行的协程(linux 5.19+)
+    params.flags |= IORING_SETUP_COOP_TASKRUN;
+    ring_fd_ = io_uring_setup(entries, &params);
+    if (ring_fd_ < 0 && errno == EINVAL) {
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        ring_fd_ = io_uring_setup(entries, &params);
+    }
+#else
+    ring_fd_ = io_uring_setup(entries, &params);
+#endif
+    if (ring_fd_ < 0)
+        return false;
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sq_size_ = cq_size_ = (std::max)(sq_size_, cq_size_);
+
+    sq_ptr_ = mmap(0, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+        sq_ptr_ = nullptr;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cq_ptr_ = sq_ptr_;
+    else {
+        cq_ptr_ = mmap(0, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) {
+            cq_ptr_ = nullptr;
+            return false;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(0, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        return false;
+    }
+
+    char *sq = (char*)sq_ptr_;
+    sq_head_ = (unsigned*)(sq + params.sq_off.head);
+    sq_tail_ = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask_ = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_entries_ = (unsigned*)(sq + params.sq_off.ring_entries);
+    sq_flags_ = (unsigned*)(sq + params.sq_off.flags);
+    sq_array_ = (unsigned*)(sq + params.sq_off.array);
+
+    char *cq = (char*)cq_ptr_;
+    cq_head_ = (unsigned*)(cq + params.cq_off.head);
+    cq_tail_ = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask_ = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+}
+
+IoUring*& IoUring::ThreadRingRef()
+{
+    thread_local static IoUring *ring = nullptr;
+    return ring;
+}
+pid_t& IoUring::ThreadRingOwnerPid()
+{
+    thread_local static pid_t owner_pid = -1;
+    return owner_pid;
+}
+
+IoUring* IoUring::GetCreatedThreadRing()
+{
+    return ThreadRingOwnerPid() == getpid() ? ThreadRingRef() : nullptr;
+}
+
+IoUring* IoUring::GetThreadRing()
+{
+    IoUring* & ring = ThreadRingRef();
+    pid_t& owner_pid = ThreadRingOwnerPid();
+    pid_t pid = getpid();
+    if (owner_pid == pid)
+        return ring;
+
+    // 首次调用或者fork后(旧的ring属于父进程), 创建失败时ring为空, 不再重试
+    owner_pid = pid;
+    delete ring;
+    ring = new IoUring;
+    if (!ring->Init(1024)) {
+        DebugPrint(dbg_ioblock, "io_uring setup failed: %s", strerror(errno));
+        delete ring;
+        ring = nullptr;
+        return ring;
+    }
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = ring->ring_fd_;
+    if (-1 == epoll_ctl(g_Scheduler.GetIoWait().GetEpollFd(), EPOLL_CTL_ADD, ring->ring_fd_, &ev)) {
+        DebugPrint(dbg_ioblock, "add io_uring fd into epoll failed: %s", strerror(errno));
+        delete ring;
+        ring = nullptr;
+        return ring;
+    }
+
+    DebugPrint(dbg_ioblock, "create io_uring success. ringfd=%d", ring->ring_fd_);
+    return ring;
+}
+
+int IoUring::GetFd()
+{
+    return ring_fd_;
+}
+
+int IoUring::GetSqe(unsigned n)
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail_ + pending_;
+    if (*sq_entries_ - (tail - head) < n) {
+        SubmitLocked();
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        tail = *sq_tail_ + pending_;
+        if (*sq_entries_ - (tail - head) < n)
+            return -1;
+    }
+
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned index = (tail + i) & *sq_mask_;
+        sq_array_[index] = index;
+        memset((io_uring_sqe*)sqes_ + index, 0, sizeof(io_uring_sqe));
+    }
+    return tail & *sq_mask_;
+}
+
+void IoUring::CommitSqe(unsigned n)
+{
+    pending_ += n;
+}
+
+int IoUring::SubmitLocked()
+{
+    if (pending_) {
+        __atomic_store_n(sq_tail_, *sq_tail_ + pending_, __ATOMIC_RELEASE);
+        pending_ = 0;
+    }
+
+    // 上次提交失败(EBUSY)时, 未被内核取走的sqe也要一起提交
+    unsigned to_submit = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (!to_submit) return 0;
+
+    int n = io_uring_enter(ring_fd_, to_submit, 0, 0);
+    DebugPrint(dbg_ioblock, "io_uring_enter(to_submit:%u) returns %d", to_submit, n);
+    return n;
+}
+
+void IoUring::Submit()
+{
+    std::unique_lock<LFLock> lock(sq_lock_);
+    SubmitLocked();
+}
+
+void IoUring::Cancel(uint64_t user_data)
+{
+    std::unique_lock<LFLock> lock(sq_lock_);
+    int index = GetSqe(1);
+    if (index < 0) return ;
+
+    io_uring_sqe *sqe = (io_uring_sqe*)sqes_ + index;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    CommitSqe(1);
+
+    // 可能由其他线程调用, 所属线程此时可能正阻塞在epoll_wait中, 立即提交.
+    SubmitLocked();
+}
+
+int IoUring::Reap()
+{
+    int count = 0;
+    for (;;) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            // cq满了以后完成事件暂存在内核中, GETEVENTS时才会被刷回cq
+            if (!(__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+                break;
+            io_uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+            if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+                break;
+            continue;
+        }
+
+        for (; head != tail; ++head, ++count) {
+            io_uring_cqe cqe = ((io_uring_cqe*)cqes_)[head & *cq_mask_];
+            if (!cqe.user_data) continue;
+
+            s_complete_count.fetch_add(1, std::memory_order_relaxed);
+
+            if ((cqe.user_data & uring_tag_mask) == uring_tag_accept) {
+                OnAccept((UringAccept*)(cqe.user_data & ~uring_tag_mask), cqe.res, cqe.flags);
+                continue;
+            }
+
+            IoSentry *sentry = (IoSentry*)cqe.user_data;
+            sentry->uring_res_ = cqe.res;
+            IoSentryPtr sptr = SharedFromThis(sentry);
+            sentry->DecrementRef();     // 提交时增加的引用计数
+            g_Scheduler.GetIoWait().IOBlockTriggered(sptr);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+int IoUring::CoSubmit(FdCtxPtr const& fd_ctx, UringOp const& op, int timeout_ms)
+{
+    if (op.opcode == eUringOpcode::accept && !s_multishot_accept_unsupported)
+        return CoAccept(fd_ctx, op, timeout_ms);
+
+    Task* tk = g_Scheduler.GetCurrentTask();
+    IoUring* ring = GetThreadRing();
+    if (!tk || !ring)
+        return -EAGAIN;
+
+    IoSentryPtr sentry = MakeShared<IoSentry>(tk, nullptr, 0);
+    sentry->uring_ = ring;
+    if (!fd_ctx->add_into_uring(sentry))
+        return -EBADF;
+
+    {
+        std::unique_lock<LFLock> lock(ring->sq_lock_);
+        // 带超时时, 操作和link timeout必须在同一次提交中, 所以一起申请
+        unsigned n = timeout_ms >= 0 ? 2 : 1;
+        int index = ring->GetSqe(n);
+        if (index < 0) {
+            lock.unlock();
+            fd_ctx->del_from_uring(tk);
+            return -EAGAIN;
+        }
+
+        io_uring_sqe *sqe = (io_uring_sqe*)ring->sqes_ + index;
+        sqe->opcode = UringOpcode(op.opcode);
+        sqe->fd = op.fd;
+        sqe->addr = (uint64_t)op.addr;
+        sqe->len = op.len;
+        if (op.addr2)   // off和addr2是union
+            sqe->addr2 = (uint64_t)op.addr2;
+        else
+            sqe->off = op.off;
+        sqe->msg_flags = op.op_flags;
+        sqe->user_data = (uint64_t)sentry.get() | uring_tag_sentry;
+        sentry->IncrementRef();     // cqe收割时释放
+
+        if (n == 2) {
+            sqe->flags |= IOSQE_IO_LINK;
+            sentry->uring_timeout_.tv_sec = timeout_ms / 1000;
+            sentry->uring_timeout_.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            io_uring_sqe *ts_sqe = (io_uring_sqe*)ring->sqes_ + ((index + 1) & *ring->sq_mask_);
+            ts_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+            ts_sqe->fd = -1;
+            ts_sqe->addr = (uint64_t)&sentry->uring_timeout_;
+            ts_sqe->len = 1;
+            ts_sqe->user_data = 0;
+        }
+        ring->CommitSqe(n);
+    }
+    s_submit_count.fetch_add(1, std::memory_order_relaxed);
+
+    DebugPrint(dbg_ioblock, "task(%s) submit io_uring op(%d) fd(%d) timeout(%d ms)",
+            tk->DebugInfo(), (int)op.opcode, op.fd, timeout_ms);
+
+    // 在WaitLoop中提交, 完成后由Reap唤醒.
+    tk->io_sentry_ = sentry;
+    g_Scheduler.GetIoWait().CoSwitch();
+    tk->io_sentry_.reset();
+
+    fd_ctx->del_from_uring(tk);
+    return sentry->uring_res_;
+}
+
+bool IoUring::ArmAccept(UringAccept* acc)
+{
+#ifdef IORING_ACCEPT_MULTISHOT
+    std::unique_lock<LFLock> lock(sq_lock_);
+    int index = GetSqe(1);
+    if (index < 0) return false;
+
+    io_uring_sqe *sqe = (io_uring_sqe*)sqes_ + index;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = acc->fd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = (uint64_t)acc | uring_tag_accept;
+    acc->IncrementRef();    // multishot结束(cqe不带IORING_CQE_F_MORE)时释放
+    acc->ring_ = this;
+    CommitSqe(1);
+    s_submit_count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void IoUring::OnAccept(UringAccept* acc, int res, uint32_t flags)
+{
+    bool more = !!(flags & IORING_CQE_F_MORE);
+    {
+        std::unique_lock<std::mutex> lock(acc->lock_);
+        if (res >= 0) {
+            if (acc->closed_)
+                close_f(res);
+            else
+                acc->ready_fds_.push_back(res);
+        } else if (!more) {
+            if (res == -EINVAL && acc->ready_fds_.empty() && !acc->error_) {
+                // 内核不支持multishot accept(5.19-), 以后都使用单次accept
+                s_multishot_accept_unsupported = true;
+            } else if (res != -ECANCELED) {
+                acc->error_ = res;
+            }
+        }
+
+        if (!more) {
+            acc->ring_ = nullptr;
+            acc->cancelling_ = false;
+        } else if (!acc->cancelling_ && acc->waiters_.empty()
+                && acc->ready_fds_.size() >= UringAccept::kMaxReadyFds) {
+            // 没有协程在accept时不再从backlog中取走连接: 保留listen backlog的背压,
+            // 连接数限制、暂停accept、SO_REUSEPORT的其他监听socket仍然有效.
+            acc->cancelling_ = true;
+            Cancel((uint64_t)acc | uring_tag_accept);
+        }
+
+        acc->waiters_.for_each([](FileDescriptorCtx::TaskWSet::value_type & kv) {
+                    IoSentryPtr sptr = kv.sentry_.lock();
+                    if (sptr)
+                        g_Scheduler.GetIoWait().IOBlockTriggered(sptr);
+                });
+        acc->waiters_.clear();
+    }
+
+    if (!more)
+        acc->DecrementRef();
+}
+
+int IoUring::CoAccept(FdCtxPtr const& fd_ctx, UringOp const& op, int timeout_ms)
+{
+    Task* tk = g_Scheduler.GetCurrentTask();
+    IoUring* ring = GetThreadRing();
+    if (!tk || !ring)
+        return -EAGAIN;
+
+    std::shared_ptr<UringAccept> acc = fd_ctx->get_uring_accept();
+    if (!acc)
+        return -EBADF;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+        IoSentryPtr sentry;
+        {
+            std::unique_lock<std::mutex> lock(acc->lock_);
+            if (!acc->ready_fds_.empty()) {
+                int fd = acc->ready_fds_.front();
+                acc->ready_fds_.pop_front();
+                lock.unlock();
+
+                sockaddr *addr = (sockaddr*)op.addr;
+                socklen_t *addrlen = (socklen_t*)op.addr2;
+                if (addr && addrlen && -1 == getpeername(fd, addr, addrlen))
+                    *addrlen = 0;
+                return fd;
+            }
+
+            if (acc->error_) {
+                int res = acc->error_;
+                acc->error_ = 0;
+                return res;
+            }
+
+            if (acc->closed_)
+                return -EBADF;
+
+            if (!acc->ring_) {
+                if (s_multishot_accept_unsupported) {
+                    lock.unlock();
+                    return CoSubmit(fd_ctx, op, timeout_ms);
+                }
+
+                if (!ring->ArmAccept(acc.get()))
+                    return -EAGAIN;
+            }
+
+            if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+                return -ECANCELED;
+
+            sentry = MakeShared<IoSentry>(tk, nullptr, 0);
+            acc->waiters_.insert(TaskWaiter(sentry));
+        }
+
+        if (timeout_ms >= 0)
+            sentry->timer_ = g_Scheduler.ExpireAt(deadline,
+                    [sentry]{
+                        g_Scheduler.GetIoWait().IOBlockTriggered(sentry);
+                    });
+
+        tk->io_sentry_ = sentry;
+        g_Scheduler.GetIoWait().CoSwitch();
+        tk->io_sentry_.reset();
+
+        if (sentry->timer_)
+            g_Scheduler.CancelTimer(sentry->timer_);
+
+        std::unique_lock<std::mutex> lock(acc->lock_);
+        acc->waiters_.erase(tk);
+    }
+}
+
+void UringAccept::Close()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    closed_ = true;
+    for (int fd : ready_fds_)
+        close_f(fd);
+    ready_fds_.clear();
+
+    waiters_.for_each([](FileDescriptorCtx::TaskWSet::value_type & kv) {
+                IoSentryPtr sptr = kv.sentry_.lock();
+                if (sptr)
+                    g_Scheduler.GetIoWait().IOBlockTriggered(sptr);
+            });
+    waiters_.clear();
+
+    if (ring_)
+        ring_->Cancel((uint64_t)this | uring_tag_accept);
+}
+
+#else   // LIBGO_IO_URING
+
+bool IoUring::IsSupported() { return false; }
+bool IoUring::IsEnabled() { return false; }
+IoUring::IoUring() {}
+IoUring::~IoUring() {}
+IoUring* IoUring::GetThreadRing() { return nullptr; }
+IoUring* IoUring::GetCreatedThreadRing() { return nullptr; }
+int IoUring::GetFd() { return ring_fd_; }
+void IoUring::Submit() {}
+int IoUring::Reap() { return 0; }
+void IoUring::Cancel(uint64_t) {}
+int IoUring::CoSubmit(FdCtxPtr const&, UringOp const&, int) { return -EAGAIN; }
+void UringAccept::Close() {}
+
+#endif  // LIBGO_IO_URING
+
+} //namespace co
@@ -0,0 +1,155 @@
+/************************************************
+ * io_uring后端: hook的read/recv/write/send/accept/connect等操作
+ *     直接提交给内核, 操作完成后唤醒协程, 不再经过epoll_ctl+epoll_wait+重试.
+ * 每个调度线程一个ring, ring fd加入该线程的epoll中,
+ *     由IoWait::WaitLoop统一提交sqe和收割cqe.
+*************************************************/
+#pragma once
+#include <sys/socket.h>
+#include <mutex>
+#include <deque>
+#include "fd_context.h"
+
+namespace co
+{
+
+class IoUring;
+
+// 提交给io_uring的操作类型
+enum class eUringOpcode : uint8_t
+{
+    none,       // 不支持io_uring, 使用epoll
+    read,
+    readv,
+    recv,
+    recvmsg,
+    write,
+    writev,
+    send,
+    sendmsg,
+    connect,
+    accept,
+};
+
+// 提交给io_uring的操作, 各字段含义与io_uring_sqe一致
+struct UringOp
+{
+    eUringOpcode opcode;
+    int fd;
+    const void* addr;       // buf, iovec, msghdr, sockaddr
+    uint32_t len;           // buf长度, iovec数量
+    uint64_t off;           // 文件偏移(-1表示当前位置), connect的addrlen
+    void* addr2;            // accept的addrlen
+    int op_flags;           // recv/send的flags
+};
+
+// 监听socket上的multishot accept: 一次提交, 内核每accept一个连接产生一个cqe.
+// 连接先缓存在ready_fds_中, 由调用accept的协程取走.
+// 没有协程在accept时最多缓存kMaxReadyFds个连接, 超过后取消multishot请求,
+// 之后的连接留在listen backlog中, 下一次accept时再重新提交.
+struct UringAccept
+    : public RefObject
+{
+    std::mutex lock_;
+    int fd_;
+    IoUring* ring_ = nullptr;           // multishot请求所在的ring, 为空表示未提交
+    bool cancelling_ = false;           // 已经取消multishot请求, 等待它的最后一个cqe
+    bool closed_ = false;
+    int error_ = 0;                     // multishot异常结束时的错误码, 交给下一次accept返回
+    std::deque<int> ready_fds_;         // 已经accept但还没被取走的连接
+    FileDescriptorCtx::TaskWSet waiters_;
+
+    static const std::size_t kMaxReadyFds = 16;
+
+    explicit UringAccept(int fd) : fd_(fd) {}
+
+    // listen fd被close时调用: 关闭未取走的连接, 唤醒等待者, 取消multishot请求
+    void Close();
+};
+
+class IoUring
+{
+public:
+    // 是否使用io_uring后端: 设置了CoroutineOptions::io_backend, 且内核支持.
+    static bool IsEnabled();
+
+    // 内核是否支持io_uring及用到的各个操作
+    static bool IsSupported();
+
+    // 当前线程的ring, 首次调用时创建, 并加入当前线程的epoll中.
+    static IoUring* GetThreadRing();
+
+    // 当前线程已创建的ring, 没有创建时返回nullptr
+    static IoUring* GetCreatedThreadRing();
+
+    // 在协程中调用: 提交一个操作并挂起, 操作完成后返回
+    // @timeout_ms: 超时时间, 小于0表示不限时. 超时后操作被取消, 返回-ECANCELED.
+    // @returns: 与io_uring_cqe::res相同, 失败时为-errno.
+    static int CoSubmit(FdCtxPtr const& fd_ctx, UringOp const& op, int timeout_ms);
+
+    int GetFd();
+
+    // 提交还未提交的sqe
+    void Submit();
+
+    // 收割完成的cqe, 唤醒对应的协程. 只在所属线程调用.
+    // @returns: 收割的cqe数量
+    int Reap();
+
+    // 异步取消一个已提交的操作, 可以在任意线程调用.
+    void Cancel(uint64_t user_data);
+
+    // 所有ring累计提交的操作数和收割的完成事件数(不含link timeout和cancel)
+    static uint64_t GetSubmitCount();
+    static uint64_t GetCompleteCount();
+
+private:
+    IoUring();
+    ~IoUring();
+
+    bool Init(unsigned entries);
+
+    // 获取n个连续的空闲sqe, 空间不足时先提交
+    // @returns: 第一个sqe在sqes_中的下标, 失败返回-1
+    int GetSqe(unsigned n);
+    void CommitSqe(unsigned n);
+    int SubmitLocked();
+
+    static int CoAccept(FdCtxPtr const& fd_ctx, UringOp const& op, int timeout_ms);
+    bool ArmAccept(UringAccept* acc);
+    void OnAccept(UringAccept* acc, int res, uint32_t flags);
+
+    static IoUring*& ThreadRingRef();
+    static pid_t& ThreadRingOwnerPid();
+
+    static std::atomic<uint64_t> s_submit_count;
+    static std::atomic<uint64_t> s_complete_count;
+
+private:
+    int ring_fd_ = -1;
+    LFLock sq_lock_;
+    unsigned pending_ = 0;      // 已写入sq但还没有提交的sqe数量
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_mask_ = nullptr;
+    unsigned *sq_entries_ = nullptr;
+    unsigned *sq_flags_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    void *sqes_ = nullptr;
+
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned *cq_mask_ = nullptr;
+    void *cqes_ = nullptr;
+
+    void *sq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    void *cq_ptr_ = nullptr;
+    size_t cq_size_ = 0;
+    size_t sqes_size_ = 0;
+
+    friend struct UringAccept;
+};
+
+} //namespace co
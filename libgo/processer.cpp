@@ -65,8 +65,11 @@ uint32_t Processer::Run(uint32_t &done_count)
 
             case TaskState::sys_block:
                 assert(tk->block_);
-                if (!tk->block_->AddWaitTask(tk))
+                if (!tk->block_->AddWaitTask(tk)) {
+                    // Ѿź, . ָΪrunnable, ֮co_yieldгʱᱻsys_block
+                    tk->state_ = TaskState::runnable;
                     runnable_list_.push(tk);
+                }
                 break;
 
             case TaskState::done:
@@ -105,6 +108,16 @@ Task* Processer::GetCurrentTask()
     return current_task_;
 }
 
+uint32_t Processer::GetTaskCount()
+{
+    return runnable_list_.size();
+}
+
+std::size_t Processer::GetIndex()
+{
+    return id_ - 1;
+}
+
 std::size_t Processer::StealHalf(Processer & other)
 {
     std::size_t runnable_task_count = runnable_list_.size();
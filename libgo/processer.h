@@ -30,6 +30,9 @@ public:
 
     uint32_t GetTaskCount();
 
+    // index in Scheduler's processer list, equal to the Run thread's thread_id.
+    std::size_t GetIndex();
+
     Task* GetCurrentTask();
 
     std::size_t StealHalf(Processer & other);
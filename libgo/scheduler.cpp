@@ -99,42 +99,46 @@ uint32_t Scheduler::Run(int flags)
         run_task_count = DoRunnable(GetOptions().enable_work_steal);
 
     // timer
-    long long timer_next_ms = GetOptions().max_sleep_ms;
+    MininumTimeDurationType max_sleep = std::chrono::milliseconds(GetOptions().max_sleep_ms);
+    MininumTimeDurationType timer_next = max_sleep;
     uint32_t tm_count = 0;
     if (flags & erf_do_timer)
-        tm_count = DoTimer(timer_next_ms);
+        tm_count = DoTimer(timer_next);
 
     // sleep wait.
-    long long sleep_next_ms = GetOptions().max_sleep_ms;
+    MininumTimeDurationType sleep_next = max_sleep;
     uint32_t sl_count = 0;
     if (flags & erf_do_sleeper)
-        sl_count = DoSleep(sleep_next_ms);
+        sl_count = DoSleep(sleep_next);
 
-    // 下一次timer或sleeper触发的时间毫秒数, 休眠或阻塞等待IO事件触发的时间不能超过这个值
-    long long next_ms = (std::min)(timer_next_ms, sleep_next_ms);
+    // 下一次timer或sleeper触发的时间, 休眠或阻塞等待IO事件触发的时间不能超过这个值
+    MininumTimeDurationType next = (std::min)(timer_next, sleep_next);
 
     // epoll
     int ep_count = -1;
     if (flags & erf_do_eventloop) {
-        int wait_milliseconds = 0;
+        MininumTimeDurationType wait_time(0);
         if (run_task_count || tm_count || sl_count)
-            wait_milliseconds = 0;
+            wait_time = MininumTimeDurationType(0);
         else {
-            wait_milliseconds = (std::min<long long>)(next_ms, GetOptions().max_sleep_ms);
-            DebugPrint(dbg_scheduler_sleep, "wait_milliseconds %d ms, next_ms=%lld", wait_milliseconds, next_ms);
+            wait_time = (std::min)(next, max_sleep);
+            DebugPrint(dbg_scheduler_sleep, "wait_time %lld us, next=%lld us",
+                    (long long)std::chrono::duration_cast<std::chrono::microseconds>(wait_time).count(),
+                    (long long)std::chrono::duration_cast<std::chrono::microseconds>(next).count());
         }
-        ep_count = DoEpoll(wait_milliseconds);
+        ep_count = DoEpoll(wait_time);
     }
 
     if (flags & erf_idle_cpu) {
         if (!run_task_count && ep_count <= 0 && !tm_count && !sl_count) {
             if (ep_count == -1) {
-                // 此线程没有执行epoll_wait, 使用sleep降低空转时的cpu使用率
+                // 此线程没有执行epoll_wait或epoll_wait出错, 使用sleep降低空转时的cpu使用率
                 ++info.sleep_ms;
                 info.sleep_ms = (std::min)(info.sleep_ms, GetOptions().max_sleep_ms);
-                info.sleep_ms = (std::min<long long>)(info.sleep_ms, next_ms);
-                DebugPrint(dbg_scheduler_sleep, "sleep %d ms, next_ms=%lld", (int)info.sleep_ms, next_ms);
-                usleep(info.sleep_ms * 1000);
+                long long sleep_us = (std::min<long long>)(info.sleep_ms * 1000,
+                        std::chrono::duration_cast<std::chrono::microseconds>(next).count());
+                DebugPrint(dbg_scheduler_sleep, "sleep %lld us", sleep_us);
+                usleep(sleep_us);
             }
         } else {
             info.sleep_ms = 1;
@@ -190,24 +194,24 @@ uint32_t Scheduler::DoRunnable(bool allow_steal)
 }
 
 // Run函数的一部分, 处理epoll相关
-int Scheduler::DoEpoll(int wait_milliseconds)
+int Scheduler::DoEpoll(MininumTimeDurationType wait_time)
 {
-    return io_wait_.WaitLoop(wait_milliseconds);
+    return io_wait_.WaitLoop(wait_time);
 }
 
-uint32_t Scheduler::DoSleep(long long &next_ms)
+uint32_t Scheduler::DoSleep(MininumTimeDurationType &next)
 {
-    return sleep_wait_.WaitLoop(next_ms);
+    return sleep_wait_.WaitLoop(next);
 }
 
 // Run函数的一部分, 处理定时器
-uint32_t Scheduler::DoTimer(long long &next_ms)
+uint32_t Scheduler::DoTimer(MininumTimeDurationType &next)
 {
     uint32_t c = 0;
     while (!GetOptions().timer_handle_every_cycle || c < GetOptions().timer_handle_every_cycle)
     {
         std::list<CoTimerPtr> timers;
-        next_ms = timer_mgr_.GetExpired(timers, 128);
+        next = timer_mgr_.GetExpired(timers, 128);
         if (timers.empty()) break;
         c += timers.size();
         for (auto &sp_timer : timers)
@@ -216,6 +220,10 @@ uint32_t Scheduler::DoTimer(long long &next_ms)
             (*sp_timer)();
             DebugPrint(dbg_timer, "leave timer callback %llu", (long long unsigned)sp_timer->GetId());
         }
+
+        // 不足一批说明已处理完本轮到期的定时器.
+        // 回调耗时较长时周期定时器可能再次到期, 留到下一次Run处理, 避免在这里无限循环.
+        if (timers.size() < 128) break;
     }
 
     return c;
@@ -229,9 +237,16 @@ void Scheduler::RunLoop()
 void Scheduler::AddTaskRunnable(Task* tk, int dispatch)
 {
     DebugPrint(dbg_scheduler, "Add task(%s) to runnable list.", tk->DebugInfo());
-    if (tk->proc_)
-        tk->proc_->AddTaskRunnable(tk);
-    else {
+    if (tk->proc_) {
+        Processer *proc = tk->proc_;
+        proc->AddTaskRunnable(tk);
+#if __linux__
+        // 在其他线程(reactor、定时器、线程池)中唤醒时, 通知协程所在的调度线程,
+        // 不用等到它的epoll_wait超时.
+        if (proc != GetLocalInfo().proc)
+            io_wait_.Notify(proc->GetIndex());
+#endif
+    } else {
         if (dispatch <= egod_default)
             dispatch = GetOptions().enable_work_steal ? egod_local_thread : egod_robin;
 
@@ -318,10 +333,15 @@ Task* Scheduler::GetCurrentTask()
 
 void Scheduler::SleepSwitch(int timeout_ms)
 {
-    if (timeout_ms <= 0)
+    SleepSwitch(std::chrono::milliseconds(timeout_ms));
+}
+
+void Scheduler::SleepSwitch(MininumTimeDurationType timeout)
+{
+    if (timeout <= MininumTimeDurationType::zero())
         CoYield();
     else
-        sleep_wait_.CoSwitch(timeout_ms);
+        sleep_wait_.CoSwitch(timeout);
 }
 
 bool Scheduler::CancelTimer(TimerId timer_id)
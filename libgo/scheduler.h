@@ -19,6 +19,21 @@
 
 namespace co {
 
+    // IOȴʹõĺ(linuxЧ)
+    enum class eIoBackend : uint8_t
+    {
+        epoll,      // ֪ͨ: epollȴfdɶдִϵͳ
+        io_uring,   // ֪ͨ: ֱύں, ɺЭ(Ҫlinux 5.7+)
+    };
+
+    // ЭͨļдĴʽ(linuxЧ)
+    enum class eFileIoMode : uint8_t
+    {
+        blocking,       // ֱִϵͳ, ڵĵ߳
+        async,          // ں֧io_uringʱύio_uring, 򽻸IO̳߳
+        thread_pool,    // ǽIOִ̳߳
+    };
+
     // Э׳δ쳣ʱĴʽ
     enum class eCoExHandle : uint8_t
     {
@@ -27,6 +42,16 @@ namespace co {
         debugger_only,      // ӡϢ
     };
 
+    // ڹScheduler֮ǰҲԶȡѡ(pthreadhookȫֶʼʱͱ)
+    struct HookOptions
+    {
+        inline static bool& get_enable_pthread_hook()
+        {
+            static bool enable_pthread_hook = false;
+            return enable_pthread_hook;
+        }
+    };
+
     ///---- ѡ
     struct CoroutineOptions
     {
@@ -53,9 +78,59 @@ namespace co {
         // ÿʱÿ֡(Ϊ0ʾ, ÿ֡ǰпԴ)
         uint32_t timer_handle_every_cycle = 0;
 
+        // ʱĬϵɳʱ(΢), ĬΪ0, :ϲ.
+        // ʱƳٵdeadline+slack֮ʱ̴, ɳڴصĶʱϲΪһλ,
+        // RunȴʱҲӦӳĩβ. ڴӶ˽ϳʱʱĳ.
+        // ֻӰڴֵ֮ӵĶʱ(co_timer_addIOʱBlockObjectʱ), Ӱsleep.
+        uint32_t timer_slack_us = 0;
+
         // epollÿδevent(WindowsЧ)
         uint32_t epoll_event_size = 10240;
 
+        // IOȴʹõĺ, ĬΪepoll. Ϊio_uringʱ, ں˻뻷֧ʹepoll.
+        // socketread/recv/write/send/accept/connectȲֱύio_uring,
+        // poll/selectԼsocketfdȻʹepoll.
+        eIoBackend io_backend = eIoBackend::epoll;
+
+        // socketǷԱԵʽעᵽepoll(Ĭϲ).
+        // socket״εȴʱעһEPOLLIN|EPOLLOUT|EPOLLRDHUP, ֱcloseƳ,
+        // ״̬ݴfd, Э̵ȴͻʱٵepoll_ctl.
+        // ֻӰڴֵ֮״ʹõsocket.
+        bool epoll_edge_triggered = false;
+
+        // רѯ̵߳(linuxЧ, 4), ĬΪ0, : ɸ߳Runepoll_wait.
+        // 0ʱô߳רepoll_wait, ѵЭֱӷPĶ,
+        // еĵ߳. fdЩ߳, ߳Эִ̿ʱioصϵͳ.
+        // Ҫ״Run״ʹsocket֮ǰ, ޸.
+        uint8_t netpoller_threads = 0;
+
+        // Эͨļ(豸)read/pread/readv/write/pwrite/writevĴʽ, ĬΪblocking.
+        // asyncthread_poolģʽֻǰЭ, ٴϵĶд߳.
+        // ܵն˵socketfdӰ.
+        eFileIoMode file_io_mode = eFileIoMode::blocking;
+
+        // IO̳߳ص߳, ״ʹʱ, ֮޸Ч.
+        uint8_t file_io_threads = 4;
+
+        // ЭMSG_ZEROCOPYsend/sendto/sendmsgʱ, Сֽʹ㿽(linuxЧ).
+        // 㿽ͳɹЭ̹ں֪ͨ, غ󻺳;
+        // СֵںѾΪ(ػַ)ʱȥMSG_ZEROCOPY, ͨʹ.
+        uint32_t zerocopy_threshold = 16 * 1024;
+
+        // Эеgetaddrinfo/gethostbynameǷʹõDNSͻ(linux̬ʱЧ, Ĭϲ).
+        // ʱIO̳߳еglibcԭ, NSS, 벻ʹlibgoʱһ.
+        // , nsswitch.confhostsǡΪ"files dns"ʱõĿͻ˲ѯhostsļnameserver,
+        // ȴӦʱֻǰЭ, TTL; gai.conf, ͬʱѯʱIPv4ַǰ.
+        bool enable_dns_resolver = false;
+
+        // Эеpthread_mutex_lock/pthread_cond_wait/pthread_cond_timedwaitǷֻǰЭ
+        // (linux̬ʱЧ, Ĭϲ).
+        // std::mutexʧʱȶ, ٰЭ̹𵽰mutexַĵȴ;
+        // std::condition_variableĵȴҲЭ, ͬһ߳ϵЭ̿ԼС֪ͨ.
+        // ֻͨ(ǵݹ顢Ǽǽ̼乲)mutexͷǽ̼乲Ч, Ȼ߳.
+        // ҪЭʹЩ֮ǰ.
+        bool & enable_pthread_hook = HookOptions::get_enable_pthread_hook();
+
         // Ƿworksteal㷨
         bool enable_work_steal = true;
 
@@ -158,16 +233,66 @@ namespace co {
         //  \timeout_ms min value is 0.
         void SleepSwitch(int timeout_ms);
 
+        //  \timeout ΪMininumTimeDurationType, Ǻ뼶˯.
+        void SleepSwitch(MininumTimeDurationType timeout);
+
         /// ------------------------------------------------------------------------
         // @{ ʱ
         template <typename DurationOrTimepoint>
         TimerId ExpireAt(DurationOrTimepoint const& dur_or_tp, CoTimer::fn_t const& fn)
         {
-            TimerId id = timer_mgr_.ExpireAt(dur_or_tp, fn);
-            DebugPrint(dbg_timer, "add timer id=%llu", (long long unsigned)id->GetId());
+            return ExpireAt(dur_or_tp, fn, std::chrono::duration_cast<MininumTimeDurationType>(
+                        std::chrono::microseconds(GetOptions().timer_slack_us)));
+        }
+
+        // @slack: ʱɳʱ, CoroutineOptions::timer_slack_us.
+        template <typename DurationOrTimepoint>
+        TimerId ExpireAt(DurationOrTimepoint const& dur_or_tp, CoTimer::fn_t const& fn,
+                MininumTimeDurationType slack)
+        {
+            TimerId id = timer_mgr_.ExpireAt(dur_or_tp, fn, slack);
+            DebugPrint(dbg_timer, "add timer id=%llu slack=%lld us", (long long unsigned)id->GetId(),
+                    (long long)std::chrono::duration_cast<std::chrono::microseconds>(slack).count());
             return id;
         }
 
+        // ڶʱ: ÿperiodһ, ֱCancelTimer.
+        // ÿδͬһʱ, ´δʱ䰴mode(ePeriodicMode).
+        template <typename Duration>
+        TimerId ExpireEvery(Duration const& period, CoTimer::fn_t const& fn,
+                ePeriodicMode mode = ePeriodicMode::fixed_rate)
+        {
+            MininumTimeDurationType p = std::chrono::duration_cast<MininumTimeDurationType>(period);
+            TimerId id = timer_mgr_.ExpireEvery(SteadyTimePoint::clock::now() + p, p, fn, mode,
+                    std::chrono::duration_cast<MininumTimeDurationType>(
+                        std::chrono::microseconds(GetOptions().timer_slack_us)));
+            DebugPrint(dbg_timer, "add periodic timer id=%llu period=%lld us mode=%s",
+                    (long long unsigned)id->GetId(),
+                    (long long)std::chrono::duration_cast<std::chrono::microseconds>(p).count(),
+                    mode == ePeriodicMode::fixed_rate ? "fixed_rate" : "fixed_delay");
+            return id;
+        }
+
+        // Э̶ʱ: ʱֻһЭ, صЭִ,
+        // ʹhookIO, ʱ͵ǰ̵߳Э.
+        // @dispatch: صЭ̵ķɲ, ĬΪegod_local_thread, :ɵӶʱ߳,
+        //            ǵ߳ӵĶʱegod_robin.
+        // @file, lineno: صЭ̵Ĵλ, co_timer_add_goдôλ.
+        // @remarks: صЭ̴ʱΪѴ, CancelTimer/BlockCancelTimerȴЭִ.
+        template <typename DurationOrTimepoint>
+        TimerId ExpireAtGo(DurationOrTimepoint const& dur_or_tp, CoTimer::fn_t const& fn,
+                int dispatch = egod_local_thread, const char* file = nullptr, int lineno = 0)
+        {
+            if (dispatch == egod_local_thread) {
+                int thread_id = GetLocalInfo().thread_id;
+                dispatch = thread_id >= 0 ? thread_id : egod_robin;
+            }
+
+            return ExpireAt(dur_or_tp, [=]{
+                        CreateTask(fn, 0, file, lineno, dispatch);
+                    });
+        }
+
         bool CancelTimer(TimerId timer_id);
         bool BlockCancelTimer(TimerId timer_id);
         // }@
@@ -201,15 +326,15 @@ namespace co {
         uint32_t DoRunnable(bool allow_steal = true);
 
         // Runһ, epoll
-        int DoEpoll(int wait_milliseconds);
+        int DoEpoll(MininumTimeDurationType wait_time);
 
         // Runһ, sleep
-        // @next_ms: һtimerĺ
-        uint32_t DoSleep(long long &next_ms);
+        // @next: һtimerʱ
+        uint32_t DoSleep(MininumTimeDurationType &next);
 
         // Runһ, ʱ
-        // @next_ms: һtimerĺ
-        uint32_t DoTimer(long long &next_ms);
+        // @next: һtimerʱ
+        uint32_t DoTimer(MininumTimeDurationType &next);
 
         // ȡֲ߳̾Ϣ
         ThreadLocalInfo& GetLocalInfo();
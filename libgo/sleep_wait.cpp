@@ -6,35 +6,37 @@
 namespace co
 {
 
-void SleepWait::CoSwitch(int timeout_ms)
+void SleepWait::CoSwitch(MininumTimeDurationType timeout)
 {
     Task *tk = g_Scheduler.GetCurrentTask();
     if (!tk) return ;
 
-    tk->sleep_ms_ = timeout_ms;
+    tk->sleep_timeout_ = timeout;
     tk->state_ = TaskState::sleep;
 
-    DebugPrint(dbg_sleepblock, "task(%s) will sleep %d ms", tk->DebugInfo(), tk->sleep_ms_);
+    DebugPrint(dbg_sleepblock, "task(%s) will sleep %lld ns", tk->DebugInfo(),
+            (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count());
     g_Scheduler.CoYield();
 }
 
 void SleepWait::SchedulerSwitch(Task* tk)
 {
-    DebugPrint(dbg_sleepblock, "task(%s) begin sleep %d ms", tk->DebugInfo(), tk->sleep_ms_);
+    DebugPrint(dbg_sleepblock, "task(%s) begin sleep %lld ns", tk->DebugInfo(),
+            (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(tk->sleep_timeout_).count());
     wait_tasks_.push(tk);
-    timer_mgr_.ExpireAt(std::chrono::milliseconds(tk->sleep_ms_),
+    timer_mgr_.ExpireAt(tk->sleep_timeout_,
             [=] {
                 this->Wakeup(tk);
             });
 }
 
-uint32_t SleepWait::WaitLoop(long long &next_ms)
+uint32_t SleepWait::WaitLoop(MininumTimeDurationType &next)
 {
     uint32_t c = 0;
     for (;;)
     {
         std::list<CoTimerPtr> timers;
-        next_ms = timer_mgr_.GetExpired(timers, 128);
+        next = timer_mgr_.GetExpired(timers, 128);
         if (timers.empty()) break;
         c += timers.size();
         for (auto &sp_timer : timers)
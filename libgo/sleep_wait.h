@@ -14,13 +14,13 @@ class SleepWait
 {
 public:
     // 在协程中调用的switch, 暂存状态并yield
-    void CoSwitch(int timeout_ms);
+    void CoSwitch(MininumTimeDurationType timeout);
 
     // 在调度器中调用的switch
     void SchedulerSwitch(Task* tk);
 
-    // @next_ms: 距离下一个timer触发的毫秒数
-    uint32_t WaitLoop(long long &next_ms);
+    // @next: 距离下一个timer触发的时间
+    uint32_t WaitLoop(MininumTimeDurationType &next);
 
 private:
     void Wakeup(Task *tk);
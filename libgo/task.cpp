@@ -101,11 +101,37 @@ Task::~Task()
         s_stat_set.erase(this);
     }
 
+    // 等待已设置的超时定时器回调执行完, 之后触发的定时器不再访问这个Task
+    TaskTimerHandle* handle = timer_handle_;
+    if (handle) {
+        {
+            std::unique_lock<LFLock> lock(handle->lock_);
+            handle->tk_ = nullptr;
+        }
+        handle->DecrementRef();
+    }
+
     --s_task_count;
 
     DebugPrint(dbg_task, "task(%s) destruct. this=%p", DebugInfo(), this);
 }
 
+TaskTimerHandle* Task::GetTimerHandle()
+{
+    TaskTimerHandle* handle = timer_handle_;
+    if (handle)
+        return handle;
+
+    // 超时定时器可能在其他线程上为同一个Task创建, 只保留一个
+    handle = new TaskTimerHandle(this);
+    TaskTimerHandle* expected = nullptr;
+    if (!timer_handle_.compare_exchange_strong(expected, handle)) {
+        delete handle;
+        return expected;
+    }
+    return handle;
+}
+
 void Task::InitLocation(const char* file, int lineno)
 {
     this->location_.Init(file, lineno);
@@ -5,6 +5,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <limits>
 #include "config.h"
 #include "context.h"
 #include "ts_queue.h"
@@ -33,6 +34,34 @@ typedef std::function<void()> TaskF;
 
 class BlockObject;
 class Processer;
+struct Task;
+
+// sys_blockȴʱBlockObjectȴеĽڵ
+// TaskHookֿ, ʱʱȴӵȴժ.
+struct BlockWaitNode
+    : public TSQueueHook
+{
+    Task* tk_ = nullptr;
+};
+
+// ʱʱеTask, ʱӳTask(Эջ).
+// Taskʱlock_ÿtk_, ʱصͨRunTask.
+struct TaskTimerHandle
+    : public RefObject
+{
+    LFLock lock_;
+    Task* tk_;
+
+    explicit TaskTimerHandle(Task* tk) : tk_(tk) {}
+
+    // Taskʱִfn(tk), ִڼTaskᱻ
+    template <typename F>
+    void Run(F const& fn)
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        if (tk_) fn(tk_);
+    }
+};
 
 struct Task
     : public TSQueueHook, public RefObject
@@ -51,13 +80,24 @@ struct Task
     // shared_ptr̰߳ȫ, ֻЭкSchedulerSwitchʹ.
     IoSentryPtr io_sentry_;     
 
+    // fdio_blockȴ(readwritehook)IoSentry, ȴ״̬.
+    // io_sentry_ΪʱSchedulerSwitchַʽ, IoWait::PrepareTaskWait.
+    uint32_t io_sequence_ = 0;          // ȴ, ڹ˹ʱĻ
+    std::atomic<uint64_t> io_state_{ 0 };   // 32λΪio_sequence_, λΪȴ״̬ʹ¼, 볬ʱͨCAS
+    std::atomic<long long> io_deadline_{ 0 };   // εȴĽֹʱ(steady_clock)
+    std::atomic<long long> io_timer_at_{ (std::numeric_limits<long long>::max)() }; // õĳʱʱĴʱ
+
     BlockObject* block_ = nullptr;      // sys_blockȴblock
     uint32_t block_sequence_ = 0;       // sys_blockȴ(ʱУ)
-    CoTimerPtr block_timer_;         // sys_blockʱȴõtimer
     MininumTimeDurationType block_timeout_{ 0 }; // sys_blockʱʱ
-    bool is_block_timeout_ = false;     // sys_blockĵȴǷʱ
+    BlockWaitNode block_node_;          // sys_blockȴеĽڵ
+    std::atomic<uint64_t> block_state_{ 0 }; // 32λΪblock_sequence_, λΪȴ״̬, 볬ʱͨCAS
+    std::atomic<long long> block_deadline_{ 0 };  // sys_blockȴĽֹʱ(steady_clock)
+    std::atomic<long long> block_timer_at_{ (std::numeric_limits<long long>::max)() }; // õĳʱʱĴʱ
 
-    int sleep_ms_ = 0;                  // ˯ʱ
+    MininumTimeDurationType sleep_timeout_{ 0 }; // ˯ʱ
+
+    std::atomic<TaskTimerHandle*> timer_handle_{ nullptr }; // ʱʱʹõ, һöʱʱ
 
     explicit Task(TaskF const& fn, std::size_t stack_size,
             const char* file, int lineno);
@@ -65,6 +105,9 @@ struct Task
 
     void InitLocation(const char* file, int lineno);
 
+    // Ҫ֤Taskڵڼ䲻
+    TaskTimerHandle* GetTimerHandle();
+
     bool SwapIn();
     bool SwapOut();
 
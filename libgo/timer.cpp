@@ -2,14 +2,15 @@
 #include <mutex>
 #include <limits>
 #include <algorithm>
+#include <iterator>
 
 namespace co
 {
 
 std::atomic<uint64_t> CoTimer::s_id{0};
 
-CoTimer::CoTimer(fn_t const& fn)
-    : id_(++s_id), fn_(fn), active_(true), token_state_(e_token_state::none)
+CoTimer::CoTimer(fn_t const& fn, MininumTimeDurationType slack)
+    : id_(++s_id), fn_(fn), slack_(slack), active_(true), token_state_(e_token_state::none)
 {}
 
 uint64_t CoTimer::GetId()
@@ -20,16 +21,46 @@ uint64_t CoTimer::GetId()
 void CoTimer::operator()()
 {
     std::unique_lock<LFLock> lock(fn_lock_, std::defer_lock);
-    if (!lock.try_lock()) return ;
+    if (!lock.try_lock()) {
+        // 周期定时器的上一次回调还没执行完, 跳过本次触发.
+        if (IsPeriodic()) {
+            ++skipped_ticks_;
+            DebugPrint(dbg_timer, "periodic timer %llu skip a tick, callback is still running",
+                    (long long unsigned)id_);
+        }
+        return ;
+    }
 
     // below statement was locked.
+    if (IsPeriodic()) {
+        if (periodic_stopped_) return ;
+        fn_();
+        if (periodic_mode_ == ePeriodicMode::fixed_delay)
+            mgr_->Reschedule(shared_from_this());
+        return ;
+    }
+
     if (!active_) return ;
     active_ = false;
     fn_();
 }
 
+uint64_t CoTimer::GetSkippedTicks()
+{
+    return skipped_ticks_;
+}
+
+bool CoTimer::IsPeriodic()
+{
+    return period_.count() != 0;
+}
+
 bool CoTimer::Cancel()
 {
+    // 周期定时器可以在回调函数内部取消自己, 所以不能依赖fn_lock_.
+    if (IsPeriodic())
+        return !periodic_stopped_.exchange(true);
+
     std::unique_lock<LFLock> lock(fn_lock_, std::defer_lock);
     if (!lock.try_lock()) return false;
 
@@ -41,6 +72,13 @@ bool CoTimer::Cancel()
 
 bool CoTimer::BlockCancel()
 {
+    if (IsPeriodic()) {
+        bool ok = !periodic_stopped_.exchange(true);
+        // 等待正在执行的回调结束
+        std::unique_lock<LFLock> lock(fn_lock_);
+        return ok;
+    }
+
     std::unique_lock<LFLock> lock(fn_lock_);
 
     // below statement was locked.
@@ -56,28 +94,64 @@ CoTimerMgr::CoTimerMgr()
 }
 
 CoTimerPtr CoTimerMgr::ExpireAt(SystemTimePoint const& time_point,
-        CoTimer::fn_t const& fn)
+        CoTimer::fn_t const& fn, MininumTimeDurationType slack)
 {
     std::unique_lock<LFLock> lock(lock_);
-    CoTimerPtr sptr(new CoTimer(fn));
-    if (system_deadlines_.empty() && steady_deadlines_.empty())
-        SetNextTriggerTime(time_point);
-    sptr->token_state_ = CoTimer::e_token_state::system;
-    sptr->system_token_ = system_deadlines_.insert(std::make_pair(time_point, sptr));
+    CoTimerPtr sptr(new CoTimer(fn, slack));
+    Insert(time_point, sptr);
     return sptr;
 }
 CoTimerPtr CoTimerMgr::ExpireAt(SteadyTimePoint const& time_point,
-        CoTimer::fn_t const& fn)
+        CoTimer::fn_t const& fn, MininumTimeDurationType slack)
 {
     std::unique_lock<LFLock> lock(lock_);
-    CoTimerPtr sptr(new CoTimer(fn));
-    if (system_deadlines_.empty() && steady_deadlines_.empty())
-        SetNextTriggerTime(time_point);
-    sptr->token_state_ = CoTimer::e_token_state::steady;
-    sptr->steady_token_ = steady_deadlines_.insert(std::make_pair(time_point, sptr));
+    CoTimerPtr sptr(new CoTimer(fn, slack));
+    Insert(time_point, sptr);
     return sptr;
 }
 
+CoTimerPtr CoTimerMgr::ExpireEvery(SteadyTimePoint const& first_time_point,
+        MininumTimeDurationType period, CoTimer::fn_t const& fn, ePeriodicMode mode,
+        MininumTimeDurationType slack)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    CoTimerPtr sptr(new CoTimer(fn, slack));
+    sptr->period_ = (std::max)(period, MininumTimeDurationType(1));
+    sptr->periodic_mode_ = mode;
+    sptr->mgr_ = this;
+    Insert(first_time_point, sptr);
+    return sptr;
+}
+
+void CoTimerMgr::Insert(SystemTimePoint const& time_point, CoTimerPtr const& co_timer_ptr)
+{
+    SystemTimePoint slack_deadline = std::chrono::time_point_cast<SystemTimePoint::duration>(
+            time_point + co_timer_ptr->slack_);
+    if (system_deadlines_.empty() || std::chrono::time_point_cast<MininumTimeDurationType>(slack_deadline)
+            .time_since_epoch().count() < system_next_trigger_time_)
+        SetNextTriggerTime(slack_deadline);
+    co_timer_ptr->token_state_ = CoTimer::e_token_state::system;
+    co_timer_ptr->system_token_ = system_deadlines_.insert(std::make_pair(time_point, co_timer_ptr));
+}
+void CoTimerMgr::Insert(SteadyTimePoint const& time_point, CoTimerPtr const& co_timer_ptr)
+{
+    SteadyTimePoint slack_deadline = std::chrono::time_point_cast<SteadyTimePoint::duration>(
+            time_point + co_timer_ptr->slack_);
+    if (steady_deadlines_.empty() || std::chrono::time_point_cast<MininumTimeDurationType>(slack_deadline)
+            .time_since_epoch().count() < steady_next_trigger_time_)
+        SetNextTriggerTime(slack_deadline);
+    co_timer_ptr->token_state_ = CoTimer::e_token_state::steady;
+    co_timer_ptr->steady_token_ = steady_deadlines_.insert(std::make_pair(time_point, co_timer_ptr));
+}
+
+void CoTimerMgr::Reschedule(CoTimerPtr const& co_timer_ptr)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    // 与__Cancel互斥, 取消后不会再被加入.
+    if (co_timer_ptr->periodic_stopped_) return ;
+    Insert(SteadyNow() + co_timer_ptr->period_, co_timer_ptr);
+}
+
 bool CoTimerMgr::Cancel(CoTimerPtr co_timer_ptr)
 {
     if (!co_timer_ptr->Cancel()) return false;
@@ -112,50 +186,84 @@ void CoTimerMgr::__Cancel(CoTimerPtr co_timer_ptr)
     co_timer_ptr->token_state_ = CoTimer::e_token_state::none;
 }
 
-long long CoTimerMgr::GetExpired(std::list<CoTimerPtr> &result, uint32_t n)
+MininumTimeDurationType CoTimerMgr::GetExpired(std::list<CoTimerPtr> &result, uint32_t n)
 {
     std::unique_lock<LFLock> lock(lock_, std::defer_lock);
     if (!lock.try_lock()) return GetNextTriggerTime();
 
-    {
-        SystemTimePoint now = SystemNow();
-        auto it = system_deadlines_.begin();
-        for (; it != system_deadlines_.end() && n > 0; --n, ++it)
-        {
-            if (it->first > now) {
-                break;
-            }
+    PopExpired(system_deadlines_, result, n);
+    if (system_deadlines_.empty())
+        system_next_trigger_time_ = std::numeric_limits<long long>::max();
+    else
+        SetNextTriggerTime(GetSlackDeadline(system_deadlines_));
 
-            it->second->token_state_ = CoTimer::e_token_state::none;
-            result.push_back(it->second);
-        }
-        if (it != system_deadlines_.end())
-            SetNextTriggerTime(it->first);
-        else
-            system_next_trigger_time_ = std::numeric_limits<long long>::max();
-        system_deadlines_.erase(system_deadlines_.begin(), it);
-    }
+    PopExpired(steady_deadlines_, result, n);
+    if (steady_deadlines_.empty())
+        steady_next_trigger_time_ = std::numeric_limits<long long>::max();
+    else
+        SetNextTriggerTime(GetSlackDeadline(steady_deadlines_));
 
+    return GetNextTriggerTime();
+}
+
+// 弹出所有已到期的定时器.
+// 带松弛时间的定时器可能晚于deadline才被处理, 同一批中每多一个不同的deadline,
+// 就相当于省下了一次唤醒.
+template <typename DeadLines>
+void CoTimerMgr::PopExpired(DeadLines & deadlines, std::list<CoTimerPtr> &result, uint32_t & n)
+{
+    typedef typename DeadLines::key_type time_point_t;
+    time_point_t now = time_point_t::clock::now();
+    std::vector<std::pair<time_point_t, CoTimerPtr>> rescheduled;
+    auto it = deadlines.begin();
+    for (; it != deadlines.end() && n > 0; --n, ++it)
     {
-        SteadyTimePoint now = SteadyNow();
-        auto it = steady_deadlines_.begin();
-        for (; it != steady_deadlines_.end() && n > 0; --n, ++it)
-        {
-            if (it->first > now) {
-                break;
-            }
+        if (it->first > now) {
+            break;
+        }
+
+        if (it != deadlines.begin() && it->second->slack_.count() &&
+                std::prev(it)->first != it->first)
+            ++saved_wakeups_;
+
+        it->second->token_state_ = CoTimer::e_token_state::none;
+        result.push_back(it->second);
 
-            it->second->token_state_ = CoTimer::e_token_state::none;
-            result.push_back(it->second);
+        // fixed_rate模式的周期定时器按最初的时间表计算下次触发时间,
+        // 已经错过的周期不再补发, 计入skipped_ticks_.
+        CoTimerPtr const& sp = it->second;
+        if (sp->IsPeriodic() && sp->periodic_mode_ == ePeriodicMode::fixed_rate
+                && !sp->periodic_stopped_) {
+            time_point_t next = it->first + std::chrono::duration_cast<typename time_point_t::duration>(sp->period_);
+            if (next <= now) {
+                auto behind = (now - next) / sp->period_ + 1;
+                next += std::chrono::duration_cast<typename time_point_t::duration>(sp->period_ * behind);
+                sp->skipped_ticks_ += behind;
+                DebugPrint(dbg_timer, "periodic timer %llu fall behind, skip %lld ticks",
+                        (long long unsigned)sp->GetId(), (long long)behind);
+            }
+            rescheduled.push_back(std::make_pair(next, sp));
         }
-        if (it != steady_deadlines_.end())
-            SetNextTriggerTime(it->first);
-        else
-            steady_next_trigger_time_ = std::numeric_limits<long long>::max();
-        steady_deadlines_.erase(steady_deadlines_.begin(), it);
     }
+    deadlines.erase(deadlines.begin(), it);
 
-    return GetNextTriggerTime();
+    for (auto & kv : rescheduled)
+        Insert(kv.first, kv.second);
+}
+
+// 计算最早的(deadline + slack).
+// deadlines按deadline排序, 所以只需要扫描deadline早于当前结果的部分.
+template <typename DeadLines>
+typename DeadLines::key_type CoTimerMgr::GetSlackDeadline(DeadLines & deadlines)
+{
+    typedef typename DeadLines::key_type time_point_t;
+    auto it = deadlines.begin();
+    time_point_t result = std::chrono::time_point_cast<typename time_point_t::duration>(
+            it->first + it->second->slack_);
+    for (++it; it != deadlines.end() && it->first < result; ++it)
+        result = (std::min)(result, std::chrono::time_point_cast<typename time_point_t::duration>(
+                    it->first + it->second->slack_));
+    return result;
 }
 
 std::size_t CoTimerMgr::Size()
@@ -164,6 +272,11 @@ std::size_t CoTimerMgr::Size()
     return system_deadlines_.size() + steady_deadlines_.size();
 }
 
+uint64_t CoTimerMgr::GetSavedWakeups()
+{
+    return saved_wakeups_;
+}
+
 SystemTimePoint CoTimerMgr::SystemNow()
 {
     return SystemTimePoint::clock::now();
@@ -173,25 +286,25 @@ SteadyTimePoint CoTimerMgr::SteadyNow()
     return SteadyTimePoint::clock::now();
 }
 
-long long CoTimerMgr::GetNextTriggerTime()
+MininumTimeDurationType CoTimerMgr::GetNextTriggerTime()
 {
-    long long sys_now = std::chrono::time_point_cast<std::chrono::milliseconds>(SystemNow()).time_since_epoch().count();
-    long long sdy_now = std::chrono::time_point_cast<std::chrono::milliseconds>(SteadyNow()).time_since_epoch().count();
-	
+    long long sys_now = std::chrono::time_point_cast<MininumTimeDurationType>(SystemNow()).time_since_epoch().count();
+    long long sdy_now = std::chrono::time_point_cast<MininumTimeDurationType>(SteadyNow()).time_since_epoch().count();
+
     long long sys_delta = (std::max)(system_next_trigger_time_ - sys_now, (long long)0);
     long long sdy_delta = (std::max)(steady_next_trigger_time_ - sdy_now, (long long)0);
 
-    return (std::min)(sys_delta, sdy_delta);
+    return MininumTimeDurationType((std::min)(sys_delta, sdy_delta));
 }
 
 void CoTimerMgr::SetNextTriggerTime(SystemTimePoint const& sys_tp)
 {
-    system_next_trigger_time_ = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_tp).time_since_epoch().count();
+    system_next_trigger_time_ = std::chrono::time_point_cast<MininumTimeDurationType>(sys_tp).time_since_epoch().count();
 }
 
 void CoTimerMgr::SetNextTriggerTime(SteadyTimePoint const& sdy_tp)
 {
-    steady_next_trigger_time_ = std::chrono::time_point_cast<std::chrono::milliseconds>(sdy_tp).time_since_epoch().count();
+    steady_next_trigger_time_ = std::chrono::time_point_cast<MininumTimeDurationType>(sdy_tp).time_since_epoch().count();
 }
 
 } //namespace co
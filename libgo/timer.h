@@ -11,12 +11,20 @@ namespace co
 {
 
 class CoTimer;
+class CoTimerMgr;
 typedef std::shared_ptr<CoTimer> CoTimerPtr;
 
 typedef std::chrono::time_point<std::chrono::system_clock> SystemTimePoint;
 typedef std::chrono::time_point<std::chrono::steady_clock> SteadyTimePoint;
 
-class CoTimer
+// 周期定时器的调度方式
+enum class ePeriodicMode : uint8_t
+{
+    fixed_rate,     // 按最初的时间表触发: 第n次触发时间为first + n * period, 落后时跳过错过的周期
+    fixed_delay,    // 上一次回调执行完毕后, 再间隔period触发
+};
+
+class CoTimer : public std::enable_shared_from_this<CoTimer>
 {
 public:
     typedef std::function<void()> fn_t;
@@ -26,11 +34,16 @@ public:
     uint64_t GetId();
     void operator()();
 
+    // 周期定时器因为处理不及时而跳过的触发次数
+    uint64_t GetSkippedTicks();
+
 private:
-    explicit CoTimer(fn_t const& fn);
+    CoTimer(fn_t const& fn, MininumTimeDurationType slack);
     bool Cancel();
     bool BlockCancel();
 
+    bool IsPeriodic();
+
     enum class e_token_state
     {
         none,
@@ -42,7 +55,16 @@ private:
     uint64_t id_;
     static std::atomic<uint64_t> s_id;
     fn_t fn_;
+    MininumTimeDurationType slack_;     // 允许推迟触发的时长, 用于合并唤醒
     bool active_;
+
+    // 周期定时器, period_为0表示一次性定时器
+    MininumTimeDurationType period_{0};
+    ePeriodicMode periodic_mode_ = ePeriodicMode::fixed_rate;
+    std::atomic<bool> periodic_stopped_{false};
+    std::atomic<uint64_t> skipped_ticks_{0};
+    CoTimerMgr *mgr_ = nullptr;
+
     LFLock fn_lock_;
     SystemToken system_token_;
     SteadyToken steady_token_;
@@ -61,34 +83,64 @@ public:
 
     CoTimerMgr();
 
-    CoTimerPtr ExpireAt(SystemTimePoint const& time_point, CoTimer::fn_t const& fn);
+    // @slack: 定时器可以在[time_point, time_point + slack]区间内的任意时刻触发.
+    //         松弛窗口重叠的定时器会在同一次唤醒中一起处理.
+    CoTimerPtr ExpireAt(SystemTimePoint const& time_point, CoTimer::fn_t const& fn,
+            MininumTimeDurationType slack = MininumTimeDurationType(0));
 
-    CoTimerPtr ExpireAt(SteadyTimePoint const& time_point, CoTimer::fn_t const& fn);
+    CoTimerPtr ExpireAt(SteadyTimePoint const& time_point, CoTimer::fn_t const& fn,
+            MininumTimeDurationType slack = MininumTimeDurationType(0));
 
     template <typename Duration>
-    CoTimerPtr ExpireAt(Duration const& duration, CoTimer::fn_t const& fn)
+    CoTimerPtr ExpireAt(Duration const& duration, CoTimer::fn_t const& fn,
+            MininumTimeDurationType slack = MininumTimeDurationType(0))
     {
-        return ExpireAt(SteadyNow() + duration, fn);
+        return ExpireAt(SteadyNow() + duration, fn, slack);
     }
 
+    // 周期定时器, 首次在first_time_point触发, 之后每个period触发一次, 直到被Cancel.
+    // 每次触发复用同一个CoTimer对象.
+    CoTimerPtr ExpireEvery(SteadyTimePoint const& first_time_point, MininumTimeDurationType period,
+            CoTimer::fn_t const& fn, ePeriodicMode mode = ePeriodicMode::fixed_rate,
+            MininumTimeDurationType slack = MininumTimeDurationType(0));
+
     bool Cancel(CoTimerPtr co_timer_ptr);
     bool BlockCancel(CoTimerPtr co_timer_ptr);
 
-    long long GetExpired(std::list<CoTimerPtr> &result, uint32_t n = 1);
+    // @returns: duration until the next timer expires.
+    MininumTimeDurationType GetExpired(std::list<CoTimerPtr> &result, uint32_t n = 1);
 
     std::size_t Size();
 
+    // 因为松弛窗口合并而省下的唤醒次数
+    uint64_t GetSavedWakeups();
+
 private:
     static SystemTimePoint SystemNow();
     static SteadyTimePoint SteadyNow();
 
     void __Cancel(CoTimerPtr co_timer_ptr);
 
-    long long GetNextTriggerTime();
+    // 以下函数需要在lock_保护下调用
+    void Insert(SystemTimePoint const& time_point, CoTimerPtr const& co_timer_ptr);
+    void Insert(SteadyTimePoint const& time_point, CoTimerPtr const& co_timer_ptr);
+
+    // fixed_delay模式的周期定时器在回调执行完毕后重新加入
+    void Reschedule(CoTimerPtr const& co_timer_ptr);
+
+    MininumTimeDurationType GetNextTriggerTime();
 
     void SetNextTriggerTime(SystemTimePoint const& sys_tp);
     void SetNextTriggerTime(SteadyTimePoint const& sdy_tp);
 
+    template <typename DeadLines>
+    typename DeadLines::key_type GetSlackDeadline(DeadLines & deadlines);
+
+    template <typename DeadLines>
+    void PopExpired(DeadLines & deadlines, std::list<CoTimerPtr> &result, uint32_t & n);
+
+    friend class CoTimer;
+
 private:
     SystemDeadLines system_deadlines_;
     SteadyDeadLines steady_deadlines_;
@@ -96,6 +148,8 @@ private:
 
     std::atomic<long long> system_next_trigger_time_;
     std::atomic<long long> steady_next_trigger_time_;
+
+    std::atomic<uint64_t> saved_wakeups_{0};
 };
 
 } //namespace co
@@ -10,7 +10,7 @@ void IoWait::SchedulerSwitch(Task* tk)
 	(void)tk;
 }
 
-int IoWait::WaitLoop(int)
+int IoWait::WaitLoop(MininumTimeDurationType)
 {
 	return -1;
 }
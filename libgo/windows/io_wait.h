@@ -12,7 +12,7 @@ namespace co
     public:
         void SchedulerSwitch(Task* tk);
 
-        int WaitLoop(int);
+        int WaitLoop(MininumTimeDurationType);
     };
 
 } //namespace co
@@ -54,19 +54,25 @@ void show_status()
 {
     static int show_title = 0;
     static long unsigned last_sendbytes = 0, last_recvbytes = 0;
+    static uint64_t last_epoll_ctl = 0;
     static auto start_time = system_clock::now();
     static auto last_time = system_clock::now();
     auto now = system_clock::now();
     if (show_title++ % 10 == 0) {
-        printf("thread:%d, qdata:%d\n", thread_count, qdata);
-        printf("  conn   send(KB)   recv(KB)     qps   AverageQps  time_delta(ms)\n");
+        printf("thread:%d, qdata:%d, backend:%s\n", thread_count, qdata,
+                co_sched.GetOptions().io_backend == co::eIoBackend::io_uring ? "io_uring" :
+                co_sched.GetOptions().epoll_edge_triggered ? "epoll_et" : "epoll");
+        printf("  conn   send(KB)   recv(KB)     qps   AverageQps  time_delta(ms)  epoll_ctl/req\n");
     }
-    printf("%6d  %9lu  %9lu  %7d  %7d    %7d\n",
+    uint64_t epoll_ctl = co_debugger.GetEpollCtlCount();
+    printf("%6d  %9lu  %9lu  %7d  %7d    %7d         %6.3f\n",
             (int)session_count, (g_sendbytes - last_sendbytes) / 1024, (g_recvbytes - last_recvbytes) / 1024,
             (int)((double)(g_recvbytes - last_recvbytes) / qdata),
             (int)((double)g_recvbytes / qdata / std::max<int>(1, duration_cast<seconds>(now - start_time).count() + 1)),
-            (int)duration_cast<milliseconds>(now - last_time).count()
+            (int)duration_cast<milliseconds>(now - last_time).count(),
+            (double)(epoll_ctl - last_epoll_ctl) / std::max<double>(1, (double)(g_recvbytes - last_recvbytes) / qdata)
             );
+    last_epoll_ctl = epoll_ctl;
     last_time = now;
     last_sendbytes = g_sendbytes;
     last_recvbytes = g_recvbytes;
@@ -77,10 +83,10 @@ int main(int argc, char **argv)
     sigignore(SIGPIPE);
     if (argc > 1) 
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-            printf("\n    Usage: %s [ThreadCount] [Connection_Count] [QueryDataLength]\n", argv[0]);
-            printf("\n    Default: %s 4 1024 4\n", argv[0]);
-            printf("\n    For example:\n        %s 2 1000 32\n", argv[0]);
-            printf("\n    That's means: start client with 2 threads, create 1000 tcp connection to server, and per data-package is 32 bytes.\n\n");
+            printf("\n    Usage: %s [ThreadCount] [Connection_Count] [QueryDataLength] [IoBackend(epoll|epoll_et|io_uring)]\n", argv[0]);
+            printf("\n    Default: %s 4 1024 4 epoll\n", argv[0]);
+            printf("\n    For example:\n        %s 2 1000 32 epoll_et\n", argv[0]);
+            printf("\n    That's means: start client with 2 threads, create 1000 tcp connection to server, per data-package is 32 bytes, and use edge-triggered epoll.\n\n");
             exit(1);
         }
 
@@ -91,6 +97,10 @@ int main(int argc, char **argv)
         conn_count = atoi(argv[2]);
     if (argc > 3)
         qdata = atoi(argv[3]);
+    if (argc > 4 && strcmp(argv[4], "io_uring") == 0)
+        co_sched.GetOptions().io_backend = co::eIoBackend::io_uring;
+    if (argc > 4 && strcmp(argv[4], "epoll_et") == 0)
+        co_sched.GetOptions().epoll_edge_triggered = true;
 
     rlimit of = {65536, 65536};
     if (-1 == setrlimit(RLIMIT_NOFILE, &of)) {
@@ -32,8 +32,11 @@ void echo_server()
     ret = listen(accept_fd, 100);
     assert(ret == 0);
 
-    printf("Coroutine server startup, thread:%d, qdata:%d, listen %s:%d\n",
-            thread_count, qdata, g_ip, g_port);
+    printf("Coroutine server startup, thread:%d, qdata:%d, backend:%s, listen %s:%d\n",
+            thread_count, qdata,
+            co_sched.GetOptions().io_backend == co::eIoBackend::io_uring ? "io_uring" :
+                co_sched.GetOptions().epoll_edge_triggered ? "epoll_et" : "epoll",
+            g_ip, g_port);
     for (;;) {
         socklen_t addr_len = sizeof(addr);
         int sock_fd = accept(accept_fd, (sockaddr*)&addr, &addr_len);
@@ -100,10 +103,10 @@ int main(int argc, char **argv)
 
     if (argc > 1) 
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-            printf("\n    Usage: %s [ThreadCount] [QueryDataLength]\n", argv[0]);
-            printf("\n    Default: %s 4 4\n", argv[0]);
-            printf("\n    For example:\n         %s 2 32\n", argv[0]);
-            printf("\n    That's means: start server with 2 threads, and per data-package is 32 bytes.\n\n");
+            printf("\n    Usage: %s [ThreadCount] [QueryDataLength] [IoBackend(epoll|epoll_et|io_uring)]\n", argv[0]);
+            printf("\n    Default: %s 4 4 epoll\n", argv[0]);
+            printf("\n    For example:\n         %s 2 32 io_uring\n", argv[0]);
+            printf("\n    That's means: start server with 2 threads, per data-package is 32 bytes, and use io_uring backend.\n\n");
             exit(1);
         }
 
@@ -113,6 +116,10 @@ int main(int argc, char **argv)
         thread_count = atoi(argv[1]);
     if (argc > 2)
         qdata = atoi(argv[2]);
+    if (argc > 3 && strcmp(argv[3], "io_uring") == 0)
+        co_sched.GetOptions().io_backend = co::eIoBackend::io_uring;
+    if (argc > 3 && strcmp(argv[3], "epoll_et") == 0)
+        co_sched.GetOptions().epoll_edge_triggered = true;
 
     rlimit of = {65536, 65536};
     if (-1 == setrlimit(RLIMIT_NOFILE, &of)) {
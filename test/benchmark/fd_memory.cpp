@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <vector>
+#include "coroutine.h"
+#include <libgo/linux_glibc_hook.h>
+
+// 空闲连接的用户态内存: 创建大量socket, 统计每个socket在进程RSS中占用的字节数.
+// 分别统计 创建fd上下文后 和 一个协程poll等待全部socket(每个fd上都有一个等待者)时 的增量.
+// socket本身和epoll注册项的内存在内核中, 不计入RSS.
+// 受RLIMIT_NOFILE限制时按能打开的数量统计.
+
+static long rss_bytes()
+{
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [SocketCount]\n", argv[0]);
+            printf("\n    Default: %s 1000000\n\n", argv[0]);
+            exit(1);
+        }
+
+    long count = 1000000;
+    if (argc > 1)
+        count = atol(argv[1]);
+
+    rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    if ((long)lim.rlim_cur < count + 64) {
+        lim.rlim_cur = (std::min)((rlim_t)(count + 64), lim.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &lim);
+        getrlimit(RLIMIT_NOFILE, &lim);
+    }
+    if ((long)lim.rlim_cur < count + 64) {
+        printf("RLIMIT_NOFILE is %ld, use %ld sockets\n", (long)lim.rlim_cur, (long)lim.rlim_cur - 64);
+        count = (long)lim.rlim_cur - 64;
+    }
+    count &= ~1L;
+
+    std::vector<pollfd> fds;
+    fds.reserve(count);
+    go [&] {
+        // 先让调度器、fd表等完成初始化
+        int tmp[2];
+        socketpair(AF_LOCAL, SOCK_STREAM, 0, tmp);
+        co::initialize_socket_async_methods(tmp[0]);
+        close(tmp[0]);
+        close(tmp[1]);
+
+        long base = rss_bytes();
+        for (long i = 0; i < count; i += 2) {
+            int sv[2];
+            if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sv) != 0) {
+                perror("socketpair");
+                exit(1);
+            }
+            co::initialize_socket_async_methods(sv[0]);
+            co::initialize_socket_async_methods(sv[1]);
+            fds.push_back(pollfd{sv[0], POLLIN, 0});
+            fds.push_back(pollfd{sv[1], POLLIN, 0});
+        }
+        long created = rss_bytes();
+
+        // 所有socket都加入epoll并挂上一个等待者, 等待期间由另一个协程统计
+        long waiting = 0;
+        go [&] {
+            co_sleep(100);
+            waiting = rss_bytes();
+        };
+        int n = poll(&fds[0], fds.size(), 200);
+        long pollfd_bytes = (long)(fds.size() * sizeof(pollfd));   // IoSentry中的副本
+
+        printf("sockets: %ld, poll returns %d\n", count, n);
+        printf("fd context: %.1f bytes/socket\n", (double)(created - base) / count);
+        printf("fd context + waiter: %.1f bytes/socket (excluding %ld bytes of pollfd copy)\n",
+                (double)(waiting - base - pollfd_bytes) / count, pollfd_bytes);
+
+        for (auto & pfd : fds)
+            close(pfd.fd);
+    };
+    g_Scheduler.RunUntilNoTask();
+    return 0;
+}
@@ -10,23 +10,50 @@
 #include <fcntl.h>
 #include <assert.h>
 #include <signal.h>
+#include <vector>
+#include <chrono>
 #include "coroutine.h"
+using namespace std::chrono;
 
 static const char* g_ip = "127.0.0.1";
 static const uint16_t g_port = 43333;
 int thread_count = 4;
 int client_count = 50000;
+int ping_interval_ms = 180 * 1000;
 static boost::shared_ptr<int> conn_count_p(new int);
 static std::atomic<uint64_t> g_ping;
 static std::atomic<uint64_t> g_pong;
 
+// ping-pong往返延迟的分布, 每个桶10us, 超过100ms的计入最后一个桶. show_status时取出并清零.
+static const int kLatencyBucketUs = 10;
+static const int kLatencyBuckets = 10000;
+static std::atomic<uint32_t> g_latency[kLatencyBuckets];
+
+static void add_latency(long long us)
+{
+    int i = (std::min)((int)(us / kLatencyBucketUs), kLatencyBuckets - 1);
+    ++g_latency[i];
+}
+
+// 第p分位的延迟(us)
+static long long percentile(std::vector<uint32_t> const& counts, uint64_t total, double p)
+{
+    uint64_t target = (uint64_t)(total * p), sum = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+        sum += counts[i];
+        if (sum > target)
+            return (long long)(i + 1) * kLatencyBucketUs;
+    }
+    return (long long)kLatencyBuckets * kLatencyBucketUs;
+}
+
 #pragma pack(push)
 #pragma pack(1)
 struct Ping
 {
     int next_ping_seconds;
     Ping() {
-        next_ping_seconds = htonl(180);
+        next_ping_seconds = htonl(ping_interval_ms / 1000 + 60);
     }
 };
 struct Pong
@@ -35,7 +62,7 @@ struct Pong
 };
 #pragma pack(pop)
 
-static Ping sping;
+static Ping *sping;
 
 void client();
 struct client_end
@@ -69,11 +96,11 @@ void client()
 
     for (;;)
     {
-        co_sleep(180 * 1000);
-        //co_sleep(180);
+        co_sleep(ping_interval_ms);
+        auto start = steady_clock::now();
         ssize_t wpos = 0;
 retry_write:
-        ssize_t wn = ::write(s, (char*)&sping + wpos, sizeof(sping) - wpos);
+        ssize_t wn = ::write(s, (char*)sping + wpos, sizeof(*sping) - wpos);
         if (wn < 0) {
            if (errno == EINTR)
                goto retry_write;
@@ -81,9 +108,9 @@ retry_write:
                return ;
         }
         wpos += wn;
-        if ((std::size_t)wpos < sizeof(sping))
+        if ((std::size_t)wpos < sizeof(*sping))
             goto retry_write;
-        printf("ping\n");
+        ++g_ping;
 
         Pong pong;
         ssize_t rpos = 0;
@@ -101,18 +128,30 @@ retry_read:
         rpos += rn;
         if ((std::size_t)rpos < sizeof(pong))
             goto retry_read;
-        printf("pong\n");
+        ++g_pong;
+        add_latency(duration_cast<microseconds>(steady_clock::now() - start).count());
     }
 }
 
 void show_status()
 {
     static int s_show_index = 0;
+    static uint64_t s_last_pong = 0;
     if (s_show_index++ % 10 == 0) {
-        printf("  index    conn \n");
+        printf("  index    conn    pong/s   p50(us)   p99(us)  p999(us)\n");
     }
 
-    printf("%6d %6ld\n", s_show_index, conn_count_p.use_count() - 1);
+    std::vector<uint32_t> counts(kLatencyBuckets);
+    uint64_t total = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i)
+        total += counts[i] = g_latency[i].exchange(0);
+
+    uint64_t pong = g_pong;
+    printf("%6d %6ld %9lu %9lld %9lld %9lld\n", s_show_index, conn_count_p.use_count() - 1,
+            (long unsigned)(pong - s_last_pong),
+            percentile(counts, total, 0.5), percentile(counts, total, 0.99),
+            percentile(counts, total, 0.999));
+    s_last_pong = pong;
 }
 
 int main(int argc, char **argv)
@@ -120,8 +159,8 @@ int main(int argc, char **argv)
     sigignore(SIGPIPE);
     if (argc > 1) 
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-            printf("\n    Usage: %s [ip] [ThreadCount] [ClientCount]\n", argv[0]);
-            printf("\n    Default: %s 127.0.0.1 4 50000\n", argv[0]);
+            printf("\n    Usage: %s [ip] [ThreadCount] [ClientCount] [PingIntervalMs]\n", argv[0]);
+            printf("\n    Default: %s 127.0.0.1 4 50000 180000\n", argv[0]);
             exit(1);
         }
 
@@ -131,6 +170,9 @@ int main(int argc, char **argv)
         thread_count = atoi(argv[2]);
     if (argc > 3)
         client_count = atoi(argv[3]);
+    if (argc > 4)
+        ping_interval_ms = atoi(argv[4]);
+    sping = new Ping;
 
     rlimit of = {100000, 100000};
 //    rlimit of = {RLIM_INFINITY, RLIM_INFINITY};
@@ -15,6 +15,7 @@
 static const char* g_ip = "0.0.0.0";
 static const uint16_t g_port = 43333;
 int thread_count = 4;
+int netpoller_threads = 0;
 static boost::shared_ptr<int> conn_count_p(new int);
 static std::atomic<uint64_t> g_ping;
 static std::atomic<uint64_t> g_pong;
@@ -121,11 +122,15 @@ retry_write:
 void show_status()
 {
     static int s_show_index = 0;
+    static uint64_t s_last_ping = 0;
     if (s_show_index++ % 10 == 0) {
-        printf("  index    conn \n");
+        printf("  index    conn    ping/s\n");
     }
 
-    printf("%6d %6ld\n", s_show_index, conn_count_p.use_count() - 1);
+    uint64_t ping = g_ping;
+    printf("%6d %6ld %9lu\n", s_show_index, conn_count_p.use_count() - 1,
+            (long unsigned)(ping - s_last_ping));
+    s_last_ping = ping;
 }
 
 int main(int argc, char **argv)
@@ -133,13 +138,19 @@ int main(int argc, char **argv)
     sigignore(SIGPIPE);
     if (argc > 1) 
         if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-            printf("\n    Usage: %s [ThreadCount]\n", argv[0]);
-            printf("\n    Default: %s 4\n", argv[0]);
+            printf("\n    Usage: %s [ThreadCount] [NetpollerThreads]\n", argv[0]);
+            printf("\n    Default: %s 4 0\n", argv[0]);
+            printf("\n    NetpollerThreads: 0 means every ThreadCount thread calls epoll_wait in Run,\n"
+                   "                      1-4 starts dedicated threads blocking in epoll_wait.\n\n");
             exit(1);
         }
 
     if (argc > 1)
         thread_count = atoi(argv[1]);
+    if (argc > 2)
+        netpoller_threads = atoi(argv[2]);
+    g_Scheduler.GetOptions().netpoller_threads = netpoller_threads;
+    printf("threads:%d, netpoller_threads:%d\n", thread_count, netpoller_threads);
 
     rlimit of = {1000000, 1000000};
     if (-1 == setrlimit(RLIMIT_NOFILE, &of)) {
@@ -0,0 +1,93 @@
+#include <boost/thread.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include "coroutine.h"
+#include <libgo/linux_glibc_hook.h>
+using namespace std::chrono;
+
+// hook的额外开销: 每个协程在自己的socketpair上循环 write 1字节 + read 1字节,
+// 数据总是已经就绪, 不会挂起协程. 分别调用hook后的read/write和原始的read_f/write_f,
+// 两者每次调用的耗时之差即为hook的开销(查找fd上下文、检查状态等).
+// 系统调用本身的耗时波动较大, 交替执行多轮, 各取最快的一轮.
+
+std::atomic<long long unsigned> g_calls{0};
+
+template <typename R, typename W>
+void pingpong(int count, R r, W w)
+{
+    go [=] {
+        int fds[2];
+        socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+        char c = 'x';
+        for (int i = 0; i < count; ++i) {
+            if (w(fds[1], &c, 1) != 1 || r(fds[0], &c, 1) != 1) {
+                perror("pingpong");
+                exit(1);
+            }
+        }
+        g_calls += count * 2;
+        close(fds[0]);
+        close(fds[1]);
+    };
+}
+
+double run(bool hooked, int thread_count, int co_count, int count)
+{
+    g_calls = 0;
+    for (int i = 0; i < co_count; ++i)
+        if (hooked)
+            pingpong(count, ::read, ::write);
+        else
+            pingpong(count,
+                    [](int fd, void* buf, size_t n) { return read_f(fd, buf, n); },
+                    [](int fd, const void* buf, size_t n) { return write_f(fd, buf, n); });
+
+    auto start = steady_clock::now();
+    boost::thread_group tg;
+    for (int i = 0; i < thread_count; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    long long cost = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    double per_call = (double)cost / (std::max)((long long unsigned)g_calls, 1llu);
+    return per_call;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [ThreadCount] [CoroutineCount] [CallsPerCoroutine] [Rounds]\n", argv[0]);
+            printf("\n    Default: %s 1 4 200000 5\n\n", argv[0]);
+            exit(1);
+        }
+
+    int thread_count = 1;
+    int co_count = 4;
+    int count = 200000;
+    int rounds = 5;
+    if (argc > 1)
+        thread_count = atoi(argv[1]);
+    if (argc > 2)
+        co_count = atoi(argv[2]);
+    if (argc > 3)
+        count = atoi(argv[3]);
+    if (argc > 4)
+        rounds = atoi(argv[4]);
+
+    printf("threads:%d, coroutines:%d, calls per coroutine:%d\n", thread_count, co_count, count * 2);
+    double raw = 1e18, hooked = 1e18;
+    for (int i = 0; i < rounds; ++i) {
+        double r = run(false, thread_count, co_count, count);
+        double h = run(true, thread_count, co_count, count);
+        printf("round %d: raw %.1f ns/call, hooked %.1f ns/call\n", i, r, h);
+        raw = (std::min)(raw, r);
+        hooked = (std::min)(hooked, h);
+    }
+    printf("best: raw %.1f ns/call, hooked %.1f ns/call, hook overhead: %.1f ns/call\n",
+            raw, hooked, hooked - raw);
+    return 0;
+}
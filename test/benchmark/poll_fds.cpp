@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <vector>
+#include <chrono>
+#include "coroutine.h"
+using namespace std::chrono;
+
+// hook后的poll监听大量fd: 一个协程循环poll全部eventfd, 另一个协程每轮写入其中一个.
+// 每次poll只有一个fd就绪, 统计每次poll的耗时和reactor调用epoll_ctl的次数.
+// 受RLIMIT_NOFILE限制时按能打开的数量统计.
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [FdCount] [Rounds]\n", argv[0]);
+            printf("\n    Default: %s 10000 1000\n\n", argv[0]);
+            exit(1);
+        }
+
+    long count = 10000;
+    int rounds = 1000;
+    if (argc > 1)
+        count = atol(argv[1]);
+    if (argc > 2)
+        rounds = atoi(argv[2]);
+
+    rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    if ((long)lim.rlim_cur < count + 64) {
+        lim.rlim_cur = (std::min)((rlim_t)(count + 64), lim.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &lim);
+        getrlimit(RLIMIT_NOFILE, &lim);
+    }
+    if ((long)lim.rlim_cur < count + 64) {
+        printf("RLIMIT_NOFILE is %ld, use %ld fds\n", (long)lim.rlim_cur, (long)lim.rlim_cur - 64);
+        count = (long)lim.rlim_cur - 64;
+    }
+
+    std::vector<pollfd> fds;
+    for (long i = 0; i < count; ++i) {
+        int efd = eventfd(0, EFD_NONBLOCK);
+        if (efd == -1) {
+            perror("eventfd");
+            exit(1);
+        }
+        fds.push_back(pollfd{efd, POLLIN, 0});
+    }
+
+    co_chan<int> round_done;
+    go [&] {
+        // 第一次poll时全部fd都需要注册到epoll, 不计入统计
+        uint64_t v = 1;
+        write(fds[0].fd, &v, sizeof(v));
+        for (int r = 0; r <= rounds; ++r) {
+            int n = poll(&fds[0], fds.size(), -1);
+            for (auto & pfd : fds)
+                if (pfd.revents & POLLIN)
+                    read(pfd.fd, &v, sizeof(v));
+            if (n != 1)
+                printf("poll returns %d\n", n);
+            round_done << r;
+        }
+    };
+    go [&] {
+        int r = 0;
+        round_done >> r;
+
+        uint64_t epoll_ctl = co_debugger.GetEpollCtlCount();
+        auto start = steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            uint64_t v = 1;
+            write(fds[rand() % fds.size()].fd, &v, sizeof(v));
+            round_done >> r;
+        }
+        auto cost = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        epoll_ctl = co_debugger.GetEpollCtlCount() - epoll_ctl;
+
+        printf("fds: %ld, rounds: %d\n", count, rounds);
+        printf("poll: %.1f us/call, epoll_ctl: %.1f /call\n",
+                (double)cost / rounds / 1000, (double)epoll_ctl / rounds);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    for (auto & pfd : fds)
+        close(pfd.fd);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include "coroutine.h"
+using namespace std::chrono;
+
+// 测量协程中10us~1ms的睡眠精度.
+// 每一轮启动sleep_count个协程, 每个协程连续睡眠loop次, 统计实际睡眠时长与期望值的偏差.
+
+enum class sleep_type
+{
+    co_sleep_switch,
+    syscall_usleep,
+    syscall_nanosleep,
+};
+
+static const char* sleep_type_name(sleep_type type)
+{
+    switch (type) {
+        case sleep_type::co_sleep_switch: return "SleepSwitch";
+        case sleep_type::syscall_usleep: return "usleep";
+        case sleep_type::syscall_nanosleep: return "nanosleep";
+    }
+    return "";
+}
+
+static void do_sleep(sleep_type type, long long us)
+{
+    switch (type) {
+        case sleep_type::co_sleep_switch:
+            g_Scheduler.SleepSwitch(microseconds(us));
+            break;
+
+        case sleep_type::syscall_usleep:
+            usleep(us);
+            break;
+
+        case sleep_type::syscall_nanosleep:
+            {
+                timespec ts{(time_t)(us / 1000000), (long)(us % 1000000) * 1000};
+                nanosleep(&ts, NULL);
+            }
+            break;
+    }
+}
+
+static void bench(sleep_type type, long long us, int sleep_count, int loop)
+{
+    std::vector<long long> costs;
+    costs.reserve(sleep_count * loop);
+
+    for (int i = 0; i < sleep_count; ++i)
+        go [&] {
+            for (int j = 0; j < loop; ++j) {
+                auto start = steady_clock::now();
+                do_sleep(type, us);
+                costs.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+            }
+        };
+    g_Scheduler.RunUntilNoTask();
+
+    std::sort(costs.begin(), costs.end());
+    long long sum = 0;
+    for (auto c : costs) sum += c;
+    double avg = (double)sum / costs.size() / 1000;
+    printf("%-12s %6lld us  avg:%9.1f us  min:%9.1f us  p50:%9.1f us  p99:%9.1f us  max:%9.1f us  avg_error:%8.1f us\n",
+            sleep_type_name(type), us, avg,
+            costs.front() / 1000.0, costs[costs.size() / 2] / 1000.0,
+            costs[costs.size() * 99 / 100] / 1000.0, costs.back() / 1000.0,
+            avg - us);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [CoroutineCount] [LoopCount]\n", argv[0]);
+            printf("\n    Default: %s 1 1000\n\n", argv[0]);
+            exit(1);
+        }
+
+    int sleep_count = 1;
+    int loop = 1000;
+    if (argc > 1)
+        sleep_count = atoi(argv[1]);
+    if (argc > 2)
+        loop = atoi(argv[2]);
+
+    // 让线程内创建epoll, Run时走epoll等待的路径.
+    go [] {
+        int fds[2];
+        socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+        pollfd pfd = {fds[0], POLLIN, 0};
+        poll(&pfd, 1, 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    long long durations[] = {10, 20, 50, 100, 200, 500, 1000};
+    sleep_type types[] = {sleep_type::co_sleep_switch, sleep_type::syscall_usleep,
+        sleep_type::syscall_nanosleep};
+    printf("coroutines:%d, loop:%d\n", sleep_count, loop);
+    for (auto type : types)
+        for (auto us : durations)
+            bench(type, us, sleep_count, loop);
+    return 0;
+}
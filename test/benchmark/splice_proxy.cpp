@@ -0,0 +1,115 @@
+#include <boost/thread.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <vector>
+#include "coroutine.h"
+#include <libgo/linux_glibc_hook.h>
+using namespace std::chrono;
+
+// 代理转发吞吐: 每一路由 客户端 -> 代理 -> 服务端 三个协程组成, 两段连接都是socketpair.
+// copy模式下代理用read/write经过用户空间的缓冲区搬运, splice模式下使用co::splice_proxy.
+
+std::atomic<long long unsigned> g_bytes{0};
+
+// 从from读到EOF, 全部写入to
+static void copy_proxy(int from, int to, int buf_size)
+{
+    std::vector<char> buf(buf_size);
+    for (;;) {
+        ssize_t n = read(from, &buf[0], buf.size());
+        if (n <= 0) break;
+        ssize_t pos = 0;
+        while (pos < n) {
+            ssize_t m = write(to, &buf[pos], n - pos);
+            if (m <= 0) return;
+            pos += m;
+        }
+    }
+}
+
+void proxy_pair(bool use_splice, long long total, int buf_size)
+{
+    int in[2], out[2];
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, in);
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, out);
+
+    go [=] {
+        std::vector<char> buf(buf_size, 'x');
+        long long sent = 0;
+        while (sent < total) {
+            ssize_t n = write(in[0], &buf[0], (std::min<long long>)(buf.size(), total - sent));
+            if (n <= 0) break;
+            sent += n;
+        }
+        shutdown(in[0], SHUT_WR);
+    };
+
+    go [=] {
+        if (use_splice)
+            co::splice_proxy(in[1], out[0]);
+        else
+            copy_proxy(in[1], out[0], buf_size);
+        close(out[0]);
+        close(in[1]);
+    };
+
+    go [=] {
+        std::vector<char> buf(buf_size);
+        for (;;) {
+            ssize_t n = read(out[1], &buf[0], buf.size());
+            if (n <= 0) break;
+            g_bytes += n;
+        }
+        close(out[1]);
+        close(in[0]);
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [copy|splice] [ThreadCount] [PairCount] [MBPerPair] [BufferKB]\n", argv[0]);
+            printf("\n    Default: %s splice 1 4 256 64\n\n", argv[0]);
+            exit(1);
+        }
+
+    bool use_splice = true;
+    int thread_count = 1;
+    int pair_count = 4;
+    int mb = 256;
+    int buf_kb = 64;
+    if (argc > 1)
+        use_splice = strcmp(argv[1], "copy") != 0;
+    if (argc > 2)
+        thread_count = atoi(argv[2]);
+    if (argc > 3)
+        pair_count = atoi(argv[3]);
+    if (argc > 4)
+        mb = atoi(argv[4]);
+    if (argc > 5)
+        buf_kb = atoi(argv[5]);
+
+    for (int i = 0; i < pair_count; ++i)
+        proxy_pair(use_splice, (long long)mb << 20, buf_kb << 10);
+
+    uint64_t start_syscalls = co_debugger.GetHookSyscallCount();
+    auto start = steady_clock::now();
+    boost::thread_group tg;
+    for (int i = 0; i < thread_count; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    long long cost = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    uint64_t syscalls = co_debugger.GetHookSyscallCount() - start_syscalls;
+
+    printf("mode:%s, threads:%d, pairs:%d, %d MB per pair, buffer:%d KB\n",
+            use_splice ? "splice" : "copy", thread_count, pair_count, mb, buf_kb);
+    printf("forwarded: %llu bytes, hooked syscalls: %lu, cost: %lld ms, %.1f MB/s\n",
+            (long long unsigned)g_bytes, (long unsigned)syscalls, (long long)cost,
+            g_bytes / 1048576.0 * 1000.0 / (std::max)(cost, (long long)1));
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <boost/thread.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include "coroutine.h"
+using namespace std::chrono;
+
+// 大量带超时的channel收发: 每一对协程通过一个无缓冲channel乒乓传递消息,
+// 每次TimedPop都会带一个较长的超时时间, 但几乎都会在超时前被唤醒.
+// 用于衡量BlockObject带超时等待的开销.
+
+std::atomic<long unsigned> g_pop_count{0};
+std::atomic<long unsigned> g_timeout_count{0};
+
+void pair_pingpong(int messages)
+{
+    co_chan<int> ping(1), pong(1);
+    go [=] {
+        int v;
+        for (int i = 0; i < messages; ++i) {
+            ping << i;
+            while (!pong.TimedPop(v, seconds(1)))
+                ++g_timeout_count;
+            ++g_pop_count;
+        }
+    };
+
+    go [=] {
+        int v;
+        for (int i = 0; i < messages; ++i) {
+            while (!ping.TimedPop(v, seconds(1)))
+                ++g_timeout_count;
+            ++g_pop_count;
+            pong << v;
+        }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [ThreadCount] [PairCount] [MessagesPerPair]\n", argv[0]);
+            printf("\n    Default: %s 4 1000 1000\n\n", argv[0]);
+            exit(1);
+        }
+
+    int thread_count = 4;
+    int pair_count = 1000;
+    int messages = 1000;
+    if (argc > 1)
+        thread_count = atoi(argv[1]);
+    if (argc > 2)
+        pair_count = atoi(argv[2]);
+    if (argc > 3)
+        messages = atoi(argv[3]);
+
+    for (int i = 0; i < pair_count; ++i)
+        pair_pingpong(messages);
+
+    auto start = steady_clock::now();
+    boost::thread_group tg;
+    for (int i = 0; i < thread_count; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    long long cost = duration_cast<milliseconds>(steady_clock::now() - start).count();
+
+    printf("threads:%d, pairs:%d, messages:%d\n", thread_count, pair_count, messages);
+    printf("TimedPop: %lu, timeout: %lu, cost: %lld ms, %.0f pops/s\n",
+            (long unsigned)g_pop_count, (long unsigned)g_timeout_count,
+            (long long)cost, g_pop_count * 1000.0 / (std::max)(cost, (long long)1));
+    return 0;
+}
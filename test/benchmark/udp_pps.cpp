@@ -0,0 +1,135 @@
+#include <boost/thread.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <vector>
+#include "coroutine.h"
+using namespace std::chrono;
+
+// 回环地址上的UDP收发包速率: 每一对协程通过一对UDP socket单向发送定长报文,
+// Batch为1时逐个sendto/recvfrom, 大于1时用sendmmsg/recvmmsg每次收发Batch个报文.
+// 发送方不做流控, 接收不及时的报文会被内核丢弃, 只统计接收到的报文.
+
+std::atomic<long unsigned> g_sent{0};
+std::atomic<long unsigned> g_received{0};
+std::atomic<bool> g_stop{false};
+
+struct Batch
+{
+    std::vector<char> buf;
+    std::vector<iovec> iovs;
+    std::vector<mmsghdr> msgs;
+
+    Batch(int batch, int payload)
+        : buf(batch * payload), iovs(batch), msgs(batch)
+    {
+        for (int i = 0; i < batch; ++i) {
+            iovs[i] = {&buf[i * payload], (size_t)payload};
+            memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+};
+
+void udp_pair(int batch, int payload)
+{
+    int rfd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(rfd, (sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(rfd, (sockaddr*)&addr, &len);
+
+    int sfd = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(sfd, (sockaddr*)&addr, sizeof(addr));
+
+    go [=] {
+        Batch b(batch, payload);
+        while (!g_stop) {
+            int n;
+            if (batch == 1)
+                n = send(sfd, &b.buf[0], payload, 0) == payload ? 1 : -1;
+            else
+                n = sendmmsg(sfd, &b.msgs[0], batch, 0);
+            if (n > 0)
+                g_sent += n;
+
+            // 回环上的UDP发送几乎不会阻塞, 每次发送后让出给接收方
+            co_yield;
+        }
+        close(sfd);
+    };
+
+    go [=] {
+        // 定期超时以检查g_stop
+        timeval tv = {0, 100 * 1000};
+        setsockopt(rfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        Batch b(batch, payload);
+        while (!g_stop) {
+            int n;
+            if (batch == 1)
+                n = recvfrom(rfd, &b.buf[0], payload, 0, nullptr, nullptr) > 0 ? 1 : -1;
+            else
+                n = recvmmsg(rfd, &b.msgs[0], batch, 0, nullptr);
+            if (n > 0)
+                g_received += n;
+        }
+        close(rfd);
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [ThreadCount] [PairCount] [Batch] [Seconds] [PayloadSize]\n", argv[0]);
+            printf("\n    Default: %s 1 1 32 3 64\n\n", argv[0]);
+            exit(1);
+        }
+
+    int thread_count = 1;
+    int pair_count = 1;
+    int batch = 32;
+    int seconds = 3;
+    int payload = 64;
+    if (argc > 1)
+        thread_count = atoi(argv[1]);
+    if (argc > 2)
+        pair_count = atoi(argv[2]);
+    if (argc > 3)
+        batch = (std::max)(atoi(argv[3]), 1);
+    if (argc > 4)
+        seconds = atoi(argv[4]);
+    if (argc > 5)
+        payload = atoi(argv[5]);
+
+    for (int i = 0; i < pair_count; ++i)
+        udp_pair(batch, payload);
+
+    go [=] {
+        co_sleep(seconds * 1000);
+        g_stop = true;
+    };
+
+    uint64_t start_syscalls = co_debugger.GetHookSyscallCount();
+    auto start = steady_clock::now();
+    boost::thread_group tg;
+    for (int i = 0; i < thread_count; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    long long cost = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    uint64_t syscalls = co_debugger.GetHookSyscallCount() - start_syscalls;
+
+    printf("threads:%d, pairs:%d, batch:%d, payload:%d bytes\n",
+            thread_count, pair_count, batch, payload);
+    printf("sent: %lu, received: %lu, hooked syscalls: %lu, cost: %lld ms, %.0f pkts/s\n",
+            (long unsigned)g_sent, (long unsigned)g_received, (long unsigned)syscalls,
+            (long long)cost, g_received * 1000.0 / (std::max)(cost, (long long)1));
+    return 0;
+}
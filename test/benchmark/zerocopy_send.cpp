@@ -0,0 +1,115 @@
+#include <boost/thread.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <vector>
+#include "coroutine.h"
+using namespace std::chrono;
+
+// 大块发送吞吐: 每一对协程通过127.0.0.1上的tcp连接发送, 依次测试64KB到4MB的单次发送大小.
+// copy模式下普通send, zerocopy模式下以MSG_ZEROCOPY发送, 每次send都等到内核通知完成才返回.
+// 回环地址上内核会回退为复制, 首次完成通知之后的发送按普通send处理.
+
+std::atomic<long long unsigned> g_bytes{0};
+
+static int g_listen_fd = -1;
+static sockaddr_in g_addr;
+
+void send_pair(bool zerocopy, long long total, int payload, co_chan<int> done)
+{
+    go [=] {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&g_addr, sizeof(g_addr)) != 0) {
+            perror("connect");
+            exit(1);
+        }
+
+        std::vector<char> buf(payload, 'x');
+        long long sent = 0;
+        while (sent < total) {
+            ssize_t n = send(fd, &buf[0], (std::min<long long>)(buf.size(), total - sent),
+                    zerocopy ? MSG_ZEROCOPY : 0);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(fd);
+    };
+
+    go [=] {
+        int fd = accept(g_listen_fd, nullptr, nullptr);
+        std::vector<char> buf(256 * 1024);
+        for (;;) {
+            ssize_t n = read(fd, &buf[0], buf.size());
+            if (n <= 0) break;
+            g_bytes += n;
+        }
+        close(fd);
+        done << 1;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+            printf("\n    Usage: %s [copy|zerocopy] [ThreadCount] [PairCount] [MBPerPair]\n", argv[0]);
+            printf("\n    Default: %s zerocopy 1 4 256\n\n", argv[0]);
+            exit(1);
+        }
+
+    bool zerocopy = true;
+    int thread_count = 1;
+    int pair_count = 4;
+    int mb = 256;
+    if (argc > 1)
+        zerocopy = strcmp(argv[1], "copy") != 0;
+    if (argc > 2)
+        thread_count = atoi(argv[2]);
+    if (argc > 3)
+        pair_count = atoi(argv[3]);
+    if (argc > 4)
+        mb = atoi(argv[4]);
+
+    g_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    g_addr.sin_family = AF_INET;
+    g_addr.sin_port = 0;
+    g_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(g_listen_fd, (sockaddr*)&g_addr, sizeof(g_addr));
+    listen(g_listen_fd, 1024);
+    socklen_t len = sizeof(g_addr);
+    getsockname(g_listen_fd, (sockaddr*)&g_addr, &len);
+
+    printf("mode:%s, threads:%d, pairs:%d, %d MB per pair\n",
+            zerocopy ? "zerocopy" : "copy", thread_count, pair_count, mb);
+
+    // 各个大小依次测试, 全部在同一组调度线程中执行
+    go [=] {
+        for (int payload = 64 * 1024; payload <= 4 * 1024 * 1024; payload *= 4) {
+            g_bytes = 0;
+            co_chan<int> done(pair_count);
+            auto start = steady_clock::now();
+            for (int i = 0; i < pair_count; ++i)
+                send_pair(zerocopy, (long long)mb << 20, payload, done);
+            for (int i = 0; i < pair_count; ++i) {
+                int v;
+                done >> v;
+            }
+            long long cost = duration_cast<milliseconds>(steady_clock::now() - start).count();
+
+            printf("payload:%5d KB, received: %llu bytes, cost: %lld ms, %.1f MB/s\n",
+                    payload >> 10, (long long unsigned)g_bytes, (long long)cost,
+                    g_bytes / 1048576.0 * 1000.0 / (std::max)(cost, (long long)1));
+        }
+        close(g_listen_fd);
+    };
+
+    boost::thread_group tg;
+    for (int i = 0; i < thread_count; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    return 0;
+}
@@ -4,7 +4,9 @@
 #include <vector>
 #include <list>
 #include <atomic>
+#include <thread>
 #include "coroutine.h"
+#include "block_object.h"
 #include "gtest_exit.h"
 using namespace std::chrono;
 using namespace co;
@@ -531,3 +533,113 @@ TEST(Channel, capacity0Timed)
         g_Scheduler.RunUntilNoTask();
     }
 }
+
+TEST(Channel, timedWaitReuse)
+{
+    // 被唤醒的超时等待不取消定时器; 之后更短的超时等待仍然要按时超时,
+    // 更长的超时等待不能被之前的定时器提前唤醒.
+    co_chan<int> ch;
+    go [=] {
+        int v;
+        EXPECT_TRUE(ch.TimedPop(v, seconds(1)));
+
+        auto s = system_clock::now();
+        EXPECT_FALSE(ch.TimedPop(v, milliseconds(50)));
+        auto c = duration_cast<milliseconds>(system_clock::now() - s).count();
+        EXPECT_GT(c, 49);
+        EXPECT_LT(c, 83);
+
+        s = system_clock::now();
+        EXPECT_FALSE(ch.TimedPop(v, milliseconds(200)));
+        c = duration_cast<milliseconds>(system_clock::now() - s).count();
+        EXPECT_GT(c, 199);
+        EXPECT_LT(c, 233);
+    };
+    go [=] {
+        ch << 1;
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(Channel, timedRace)
+{
+    // 超时与唤醒并发竞争时, 消息既不能丢失也不能重复.
+    co_chan<int> ch;
+    std::atomic<int> received{0}, timeouts{0};
+    const int producers = 10, messages = 1000, consumers = 20;
+    std::atomic<int> done_producers{0};
+    for (int i = 0; i < producers; ++i)
+        go [=, &done_producers] {
+            for (int j = 0; j < messages; ++j) {
+                ch << j;
+                if (j % 10 == 0) co_sleep(1);
+            }
+            ++done_producers;
+        };
+
+    for (int i = 0; i < consumers; ++i)
+        go [=, &received, &timeouts, &done_producers] {
+            int v;
+            while (done_producers < producers || !ch.empty()) {
+                if (ch.TimedPop(v, microseconds(500)))
+                    ++received;
+                else
+                    ++timeouts;
+            }
+        };
+
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    EXPECT_EQ(received, producers * messages);
+    EXPECT_GT(timeouts, 0);
+}
+
+TEST(Channel, timedWaitReleasesTask)
+{
+    // 被唤醒后结束的协程立即释放, 不等到超时定时器触发
+    co_chan<int> ch;
+    go [=] {
+        int v;
+        EXPECT_TRUE(ch.TimedPop(v, seconds(30)));
+    };
+    go [=] {
+        co_sleep(1);
+        ch << 1;
+    };
+    auto s = system_clock::now();
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_LT(duration_cast<seconds>(system_clock::now() - s).count(), 10);
+    EXPECT_EQ(Task::GetTaskCount(), 0u);
+}
+
+// 协程已经置为sys_block、还未切出时, 在另一个线程中写入channel
+static co_chan<int>* s_push_chan = nullptr;
+static void push_before_switch_out(BlockObject*)
+{
+    BlockObject::switch_out_hook = nullptr;
+    std::thread t([]{ *s_push_chan << 1; });
+    t.join();
+}
+
+TEST(Channel, wakeupBeforeSwitchOut)
+{
+    // 切出前已经被唤醒, 协程直接恢复运行,
+    // 之后的co_yield不能再被当作sys_block处理
+    co_chan<int> ch(1);
+    s_push_chan = &ch;
+    bool done = false;
+    go [&] {
+        BlockObject::switch_out_hook = &push_before_switch_out;
+        int v = 0;
+        ch >> v;
+        EXPECT_EQ(v, 1);
+        EXPECT_TRUE(BlockObject::switch_out_hook == nullptr);
+        co_yield;
+        done = true;
+    };
+    g_Scheduler.RunUntilNoTask();
+    BlockObject::switch_out_hook = nullptr;
+    EXPECT_TRUE(done);
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include "coroutine.h"
+#include "co_net.h"
+#include "linux_glibc_hook.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// DISABLE_HOOK编译时read_f就是libc的read
+static bool io_hooked()
+{
+    g_Scheduler.GetCurrentTaskID();     // 初始化hook
+    return read_f != &::read;
+}
+
+// 同一组操作分别使用co::net接口和被hook的libc函数执行
+struct NetApi
+{
+    const char* name;
+    ssize_t (*read)(int, void*, size_t);
+    ssize_t (*readv)(int, const struct iovec*, int);
+    ssize_t (*recv)(int, void*, size_t, int);
+    ssize_t (*write)(int, const void*, size_t);
+    ssize_t (*writev)(int, const struct iovec*, int);
+    ssize_t (*send)(int, const void*, size_t, int);
+    int (*accept)(int, struct sockaddr*, socklen_t*);
+    int (*connect)(int, const struct sockaddr*, socklen_t);
+    int (*poll)(struct pollfd*, nfds_t, int);
+    int (*close)(int);
+};
+
+static const NetApi s_net_api = {
+    "co::net",
+    [](int fd, void* buf, size_t n) { return net::read(fd, buf, n); },
+    [](int fd, const struct iovec* iov, int cnt) { return net::readv(fd, iov, cnt); },
+    [](int fd, void* buf, size_t n, int flags) { return net::recv(fd, buf, n, flags); },
+    [](int fd, const void* buf, size_t n) { return net::write(fd, buf, n); },
+    [](int fd, const struct iovec* iov, int cnt) { return net::writev(fd, iov, cnt); },
+    [](int fd, const void* buf, size_t n, int flags) { return net::send(fd, buf, n, flags); },
+    [](int fd, struct sockaddr* addr, socklen_t* len) { return net::accept(fd, addr, len); },
+    [](int fd, const struct sockaddr* addr, socklen_t len) { return net::connect(fd, addr, len); },
+    [](struct pollfd* fds, nfds_t n, int timeout) { return net::poll(fds, n, timeout); },
+    [](int fd) { return net::close(fd); },
+};
+
+static const NetApi s_hook_api = {
+    "hook", &::read, &::readv, &::recv, &::write, &::writev, &::send,
+    &::accept, &::connect, &::poll, &::close,
+};
+
+static int listen_local(sockaddr_in & addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, (sockaddr*)&addr, len) || listen(fd, 16)
+            || getsockname(fd, (sockaddr*)&addr, &len))
+        return -1;
+    return fd;
+}
+
+// 同一线程上的服务端和客户端协程互相等待, 阻塞任何一个都会死锁
+static void echo(NetApi const& api)
+{
+    cout << "api: " << api.name << endl;
+    sockaddr_in addr;
+    int lfd = listen_local(addr);
+    ASSERT_GE(lfd, 0);
+
+    const int loops = 100;
+    go [&] {
+        int fd = api.accept(lfd, nullptr, nullptr);
+        ASSERT_GE(fd, 0);
+        char buf[16];
+        for (;;) {
+            ssize_t n = api.recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            EXPECT_EQ(api.send(fd, buf, n, 0), n);
+        }
+        api.close(fd);
+    };
+    go [&] {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(api.connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+        for (int i = 0; i < loops; ++i) {
+            char head[2] = {'a', (char)('0' + i % 10)}, tail[3] = "bc";
+            iovec out[2] = {{head, 2}, {tail, 2}};
+            EXPECT_EQ(api.writev(fd, out, 2), 4);
+
+            pollfd pfd = {fd, POLLIN, 0};
+            EXPECT_EQ(api.poll(&pfd, 1, 1000), 1);
+            EXPECT_TRUE(pfd.revents & POLLIN);
+
+            char buf[4];
+            iovec in[2] = {{buf, 2}, {buf + 2, 2}};
+            ssize_t n = api.readv(fd, in, 2);
+            while (n > 0 && n < 4) {
+                ssize_t r = api.read(fd, buf + n, 4 - n);
+                if (r <= 0) break;
+                n += r;
+            }
+            EXPECT_EQ(n, 4);
+            EXPECT_EQ(buf[1], head[1]);
+            EXPECT_EQ(buf[2], 'b');
+        }
+        EXPECT_EQ(api.write(fd, "z", 1), 1);
+        char c = 0;
+        EXPECT_EQ(api.read(fd, &c, 1), 1);
+        EXPECT_EQ(c, 'z');
+        api.close(fd);
+    };
+    g_Scheduler.RunUntilNoTask();
+    api.close(lfd);
+}
+
+TEST(CoNet, Echo)
+{
+    echo(s_net_api);
+    if (io_hooked())
+        echo(s_hook_api);
+}
+
+TEST(CoNet, Timeout)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    sockaddr_in addr;
+    int lfd = listen_local(addr);
+    ASSERT_GE(lfd, 0);
+
+    int ticks = 0;
+    bool done = false;
+    go [&] {
+        char c;
+        auto start = steady_clock::now();
+        EXPECT_EQ(net::read(fds[0], &c, 1, 50), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 45);
+
+        // 等待期间同一线程上的其他协程继续运行
+        EXPECT_GT(ticks, 0);
+
+        // 0表示不等待
+        EXPECT_EQ(net::recv(fds[0], &c, 1, 0, 0), -1);
+        EXPECT_EQ(errno, EAGAIN);
+
+        EXPECT_EQ(net::accept(lfd, nullptr, nullptr, 20), -1);
+        EXPECT_EQ(errno, EAGAIN);
+
+        pollfd pfd = {fds[0], POLLIN, 0};
+        EXPECT_EQ(net::poll(&pfd, 1, 20), 0);
+
+        // 超时不影响之后的读写
+        EXPECT_EQ(net::write(fds[1], "x", 1, 20), 1);
+        EXPECT_EQ(net::read(fds[0], &c, 1, 20), 1);
+        EXPECT_EQ(c, 'x');
+        done = true;
+    };
+    go [&] {
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    net::close(fds[0]);
+    net::close(fds[1]);
+    net::close(lfd);
+}
+
+TEST(CoNet, ConnectRefused)
+{
+    sockaddr_in addr;
+    int lfd = listen_local(addr);
+    ASSERT_GE(lfd, 0);
+    net::close(lfd);
+
+    go [&] {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_EQ(net::connect(fd, (sockaddr*)&addr, sizeof(addr), 1000), -1);
+        EXPECT_EQ(errno, ECONNREFUSED);
+        net::close(fd);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(CoNet, NotInCoroutine)
+{
+    // 不在协程中时等同于libc
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    EXPECT_EQ(net::write(fds[1], "y", 1), 1);
+    char c = 0;
+    EXPECT_EQ(net::read(fds[0], &c, 1), 1);
+    EXPECT_EQ(c, 'y');
+    pollfd pfd = {fds[0], POLLIN, 0};
+    EXPECT_EQ(net::poll(&pfd, 1, 0), 0);
+    net::close(fds[0]);
+    net::close(fds[1]);
+}
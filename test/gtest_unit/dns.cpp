@@ -0,0 +1,556 @@
+#include <iostream>
+#include <unistd.h>
+#include <string.h>
+#include <netdb.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <ifaddrs.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include "coroutine.h"
+#include "dns_resolver.h"
+#include "file_io.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 本地的DNS服务器: 在普通线程中按表应答A/AAAA查询, 统计收到的查询数.
+// UDP和TCP监听同一个端口, 设置truncate后UDP应答只带TC标志, 设置drop_tcp后TCP连接不应答.
+struct StubDns
+{
+    int udp_fd_ = -1, tcp_fd_ = -1;
+    int port_ = 0;
+    std::map<std::string, std::vector<std::string>> records_;   // name -> addresses
+    uint32_t ttl_ = 60;
+    std::atomic<int> queries_{0};
+    std::atomic<int> tcp_queries_{0};
+    std::atomic<int> delay_ms_{0};
+    std::atomic<bool> truncate_{false};
+    std::atomic<bool> drop_tcp_{false};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+
+    StubDns()
+    {
+        udp_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(bind(udp_fd_, (sockaddr*)&addr, sizeof(addr)), 0);
+        socklen_t len = sizeof(addr);
+        getsockname(udp_fd_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+
+        tcp_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int v = 1;
+        setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &v, sizeof(v));
+        EXPECT_EQ(bind(tcp_fd_, (sockaddr*)&addr, sizeof(addr)), 0);
+        listen(tcp_fd_, 16);
+
+        thread_ = std::thread([this]{ Run(); });
+    }
+
+    ~StubDns()
+    {
+        stop_ = true;
+        thread_.join();
+        close(udp_fd_);
+        close(tcp_fd_);
+    }
+
+    std::string Server()
+    {
+        return "127.0.0.1:" + std::to_string(port_);
+    }
+
+    void Run()
+    {
+        while (!stop_) {
+            pollfd pfds[2] = {{udp_fd_, POLLIN, 0}, {tcp_fd_, POLLIN, 0}};
+            if (poll(pfds, 2, 20) <= 0)
+                continue;
+
+            if (pfds[0].revents & POLLIN) {
+                char buf[512];
+                sockaddr_in from;
+                socklen_t len = sizeof(from);
+                ssize_t n = recvfrom(udp_fd_, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+                if (n < 12) continue;
+                ++queries_;
+                if (delay_ms_)
+                    std::this_thread::sleep_for(milliseconds(delay_ms_));
+                std::string reply = Answer(std::string(buf, n), truncate_);
+                sendto(udp_fd_, reply.data(), reply.size(), 0, (sockaddr*)&from, len);
+            }
+
+            if (pfds[1].revents & POLLIN) {
+                int fd = accept(tcp_fd_, nullptr, nullptr);
+                if (fd == -1) continue;
+                if (drop_tcp_) {
+                    close(fd);
+                    continue;
+                }
+                unsigned char len_buf[2];
+                char buf[512];
+                if (recv(fd, len_buf, 2, MSG_WAITALL) == 2) {
+                    size_t len = len_buf[0] << 8 | len_buf[1];
+                    if (len <= sizeof(buf) && recv(fd, buf, len, MSG_WAITALL) == (ssize_t)len) {
+                        ++tcp_queries_;
+                        std::string reply = Answer(std::string(buf, len), false);
+                        std::string msg;
+                        msg.push_back((char)(reply.size() >> 8));
+                        msg.push_back((char)reply.size());
+                        msg += reply;
+                        send(fd, msg.data(), msg.size(), 0);
+                    }
+                }
+                close(fd);
+            }
+        }
+    }
+
+    static void Put16(std::string & s, uint16_t v)
+    {
+        s.push_back((char)(v >> 8));
+        s.push_back((char)v);
+    }
+
+    static void Put32(std::string & s, uint32_t v)
+    {
+        Put16(s, v >> 16);
+        Put16(s, v & 0xffff);
+    }
+
+    std::string Answer(std::string const& query, bool truncate)
+    {
+        // 问题部分: 域名和qtype, qclass
+        std::string name;
+        size_t pos = 12;
+        while (pos < query.size() && query[pos]) {
+            int len = (unsigned char)query[pos];
+            if (!name.empty()) name += ".";
+            name += query.substr(pos + 1, len);
+            pos += 1 + len;
+        }
+        pos += 1;
+        uint16_t qtype = (unsigned char)query[pos] << 8 | (unsigned char)query[pos + 1];
+        std::string question = query.substr(12, pos + 4 - 12);
+
+        std::vector<std::string> answers;
+        auto it = records_.find(name);
+        if (it != records_.end())
+            for (auto & s : it->second) {
+                char buf[16];
+                if (qtype == 1 && inet_pton(AF_INET, s.c_str(), buf) == 1)
+                    answers.push_back(std::string(buf, 4));
+                else if (qtype == 28 && inet_pton(AF_INET6, s.c_str(), buf) == 1)
+                    answers.push_back(std::string(buf, 16));
+            }
+        if (truncate)
+            answers.clear();
+
+        std::string reply = query.substr(0, 2);
+        uint16_t flags = 0x8180 | (it == records_.end() ? 3 : 0);   // NXDOMAIN
+        if (truncate) flags |= 0x0200;
+        Put16(reply, flags);
+        Put16(reply, 1);
+        Put16(reply, answers.size());
+        Put16(reply, it == records_.end() ? 1 : 0);
+        Put16(reply, 0);
+        reply += question;
+        for (auto & rdata : answers) {
+            Put16(reply, 0xC00C);
+            Put16(reply, qtype);
+            Put16(reply, 1);
+            Put32(reply, ttl_);
+            Put16(reply, rdata.size());
+            reply += rdata;
+        }
+        if (it == records_.end()) {
+            // SOA: 否定应答缓存2秒
+            Put16(reply, 0xC00C);
+            Put16(reply, 6);
+            Put16(reply, 1);
+            Put32(reply, 2);
+            Put16(reply, 2 + 20);
+            reply.push_back('\0');
+            reply.push_back('\0');
+            for (int i = 0; i < 4; ++i)
+                Put32(reply, 100);
+            Put32(reply, 2);
+        }
+        return reply;
+    }
+};
+
+// 写入nsswitch.conf的hosts配置, 返回文件路径
+static std::string WriteNsswitch(std::string const& hosts)
+{
+    std::string path = "/tmp/libgo_dns_nsswitch.conf";
+    FILE* f = fopen(path.c_str(), "w");
+    fprintf(f, "passwd: files\nhosts: %s\n", hosts.c_str());
+    fclose(f);
+    return path;
+}
+
+// 启用内置的DNS客户端, 只查询stub
+static void ResetResolver(StubDns & dns)
+{
+    g_Scheduler.GetOptions().enable_dns_resolver = true;
+    DnsResolver::getInstance().SetConfigFiles("/nonexistent/resolv.conf", "/nonexistent/hosts",
+            WriteNsswitch("files dns"));
+    ASSERT_TRUE(DnsResolver::getInstance().SetNameServers({dns.Server()}));
+    DnsResolver::getInstance().ClearCache();
+}
+
+static std::string AddrString(const sockaddr* sa)
+{
+    char buf[INET6_ADDRSTRLEN] = "";
+    if (sa->sa_family == AF_INET)
+        inet_ntop(AF_INET, &((sockaddr_in*)sa)->sin_addr, buf, sizeof(buf));
+    else
+        inet_ntop(AF_INET6, &((sockaddr_in6*)sa)->sin6_addr, buf, sizeof(buf));
+    return buf;
+}
+
+TEST(Dns, Getaddrinfo)
+{
+    StubDns dns;
+    dns.records_["www.example.test"] = {"10.0.0.1", "10.0.0.2", "2001:db8::1"};
+    ResetResolver(dns);
+
+    go [&] {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        ASSERT_EQ(getaddrinfo("www.example.test", "80", &hints, &res), 0);
+
+        std::vector<std::string> addrs;
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            EXPECT_EQ(ai->ai_socktype, SOCK_STREAM);
+            EXPECT_EQ(ntohs(((sockaddr_in*)ai->ai_addr)->sin_port), 80);
+            addrs.push_back(AddrString(ai->ai_addr));
+        }
+        freeaddrinfo(res);
+        EXPECT_EQ(addrs, (std::vector<std::string>{"10.0.0.1", "10.0.0.2", "2001:db8::1"}));
+        EXPECT_EQ(dns.queries_, 2);     // A + AAAA
+
+        // 命中缓存, 域名不区分大小写
+        ASSERT_EQ(getaddrinfo("WWW.Example.test", "80", &hints, &res), 0);
+        freeaddrinfo(res);
+        EXPECT_EQ(dns.queries_, 2);
+
+        hostent* ent = gethostbyname("www.example.test");
+        ASSERT_TRUE(ent != nullptr);
+        EXPECT_EQ(ent->h_addrtype, AF_INET);
+        int n = 0;
+        while (ent->h_addr_list[n]) ++n;
+        EXPECT_EQ(n, 2);
+        EXPECT_EQ(dns.queries_, 3);     // 只查询A
+
+        // 数字地址不查询
+        ASSERT_EQ(getaddrinfo("127.0.0.1", "http", &hints, &res), 0);
+        EXPECT_EQ(ntohs(((sockaddr_in*)res->ai_addr)->sin_port), 80);
+        freeaddrinfo(res);
+        EXPECT_EQ(dns.queries_, 3);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(Dns, NxDomainAndTtl)
+{
+    StubDns dns;
+    dns.records_["short.example.test"] = {"10.0.0.3"};
+    dns.ttl_ = 1;
+    ResetResolver(dns);
+
+    go [&] {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        addrinfo* res = nullptr;
+        EXPECT_EQ(getaddrinfo("none.example.test", nullptr, &hints, &res), EAI_NONAME);
+        EXPECT_EQ(getaddrinfo("none.example.test", nullptr, &hints, &res), EAI_NONAME);
+        EXPECT_EQ(dns.queries_, 1);
+
+        ASSERT_EQ(getaddrinfo("short.example.test", nullptr, &hints, &res), 0);
+        freeaddrinfo(res);
+        EXPECT_EQ(dns.queries_, 2);
+
+        // 记录的TTL是1秒, 否定应答的SOA是2秒
+        co_sleep(1100);
+        ASSERT_EQ(getaddrinfo("short.example.test", nullptr, &hints, &res), 0);
+        freeaddrinfo(res);
+        EXPECT_EQ(getaddrinfo("none.example.test", nullptr, &hints, &res), EAI_NONAME);
+        EXPECT_EQ(dns.queries_, 3);
+
+        co_sleep(1000);
+        EXPECT_EQ(getaddrinfo("none.example.test", nullptr, &hints, &res), EAI_NONAME);
+        EXPECT_EQ(dns.queries_, 4);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(Dns, Coalesce)
+{
+    StubDns dns;
+    dns.records_["slow.example.test"] = {"10.0.0.4"};
+    dns.delay_ms_ = 100;
+    ResetResolver(dns);
+    uint64_t coalesced = DnsResolver::getInstance().GetStat().coalesced;
+
+    // 同时解析同一个域名只发出一次查询, 等待期间线程上的其他协程继续运行
+    std::atomic<int> ok{0}, ticks{0};
+    for (int i = 0; i < 20; ++i)
+        go [&] {
+            addrinfo hints = {};
+            hints.ai_family = AF_INET;
+            addrinfo* res = nullptr;
+            if (getaddrinfo("slow.example.test", "443", &hints, &res) == 0) {
+                EXPECT_EQ(AddrString(res->ai_addr), "10.0.0.4");
+                freeaddrinfo(res);
+                ++ok;
+            }
+        };
+    go [&] {
+        for (int i = 0; i < 5; ++i) {
+            co_sleep(10);
+            ++ticks;
+        }
+        EXPECT_EQ(ok, 0);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(ok, 20);
+    EXPECT_EQ(ticks, 5);
+    EXPECT_EQ(dns.queries_, 1);
+    EXPECT_EQ(DnsResolver::getInstance().GetStat().coalesced - coalesced, 19u);
+}
+
+TEST(Dns, HostsAndSearch)
+{
+    StubDns dns;
+    dns.records_["www.example.test"] = {"10.0.0.1"};
+
+    char hosts[] = "/tmp/libgo_dns_hosts_XXXXXX";
+    char resolv[] = "/tmp/libgo_dns_resolv_XXXXXX";
+    int fd = mkstemp(hosts);
+    std::string text = "# comment\n10.9.8.7 myhost.test MyAlias\n::1 myhost.test\n";
+    ASSERT_EQ(write(fd, text.data(), text.size()), (ssize_t)text.size());
+    close(fd);
+    fd = mkstemp(resolv);
+    text = "search example.test\noptions ndots:1 timeout:1 attempts:1\nnameserver 127.0.0.1\n";
+    ASSERT_EQ(write(fd, text.data(), text.size()), (ssize_t)text.size());
+    close(fd);
+
+    DnsResolver::getInstance().SetConfigFiles(resolv, hosts);
+    ASSERT_TRUE(DnsResolver::getInstance().SetNameServers({dns.Server()}));
+    DnsResolver::getInstance().ClearCache();
+
+    go [&] {
+        std::vector<DnsAddress> addrs;
+        ASSERT_EQ(DnsResolver::getInstance().Resolve("myalias", AF_INET, addrs), 0);
+        ASSERT_EQ(addrs.size(), 1u);
+        char buf[INET_ADDRSTRLEN];
+        EXPECT_STREQ(inet_ntop(AF_INET, &addrs[0].v4, buf, sizeof(buf)), "10.9.8.7");
+        ASSERT_EQ(DnsResolver::getInstance().Resolve("myhost.test", AF_UNSPEC, addrs), 0);
+        EXPECT_EQ(addrs.size(), 2u);
+        EXPECT_EQ(dns.queries_, 0);
+
+        // 点数少于ndots, 先加上search域
+        ASSERT_EQ(DnsResolver::getInstance().Resolve("www", AF_INET, addrs), 0);
+        ASSERT_EQ(addrs.size(), 1u);
+        EXPECT_STREQ(inet_ntop(AF_INET, &addrs[0].v4, buf, sizeof(buf)), "10.0.0.1");
+        EXPECT_EQ(dns.queries_, 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    unlink(hosts);
+    unlink(resolv);
+}
+
+TEST(Dns, TruncatedAndTimeout)
+{
+    StubDns dns;
+    dns.records_["big.example.test"] = {"10.0.0.5"};
+    dns.truncate_ = true;
+    ResetResolver(dns);
+
+    go [&] {
+        // UDP应答被截断, 改用TCP
+        std::vector<DnsAddress> addrs;
+        ASSERT_EQ(DnsResolver::getInstance().Resolve("big.example.test", AF_INET, addrs), 0);
+        EXPECT_EQ(addrs.size(), 1u);
+        EXPECT_EQ(dns.tcp_queries_, 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    // TCP重新查询失败, 直接换下一个nameserver, 不等到超时
+    dns.drop_tcp_ = true;
+    StubDns backup;
+    backup.records_["big.example.test"] = {"10.0.0.6"};
+    ASSERT_TRUE(DnsResolver::getInstance().SetNameServers({dns.Server(), backup.Server()}));
+    DnsResolver::getInstance().ClearCache();
+    go [&] {
+        std::vector<DnsAddress> addrs;
+        auto start = steady_clock::now();
+        ASSERT_EQ(DnsResolver::getInstance().Resolve("big.example.test", AF_INET, addrs), 0);
+        EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - start).count(), 1000);
+        ASSERT_EQ(addrs.size(), 1u);
+        EXPECT_EQ(addrs[0].v4.s_addr, inet_addr("10.0.0.6"));
+        EXPECT_EQ(backup.queries_, 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    // nameserver不应答
+    int silent = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(silent, (sockaddr*)&addr, sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    getsockname(silent, (sockaddr*)&addr, &len);
+
+    char resolv[] = "/tmp/libgo_dns_resolv_XXXXXX";
+    int fd = mkstemp(resolv);
+    std::string text = "options timeout:1 attempts:1\n";
+    ASSERT_EQ(write(fd, text.data(), text.size()), (ssize_t)text.size());
+    close(fd);
+    DnsResolver::getInstance().SetConfigFiles(resolv, "/nonexistent/hosts");
+    ASSERT_TRUE(DnsResolver::getInstance().SetNameServers({"127.0.0.1:" + std::to_string(ntohs(addr.sin_port))}));
+
+    int ticks = 0;
+    bool done = false;
+    go [&] {
+        std::vector<DnsAddress> addrs;
+        auto start = steady_clock::now();
+        EXPECT_EQ(DnsResolver::getInstance().Resolve("lost.example.test", AF_INET, addrs), EAI_AGAIN);
+        auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        EXPECT_GE(ms, 990);
+        EXPECT_LT(ms, 1500);
+
+        // 等待应答时只挂起当前协程(DISABLE_HOOK时也是如此)
+        EXPECT_GT(ticks, 0);
+        done = true;
+    };
+    go [&] {
+        while (!done) {
+            ++ticks;
+            co_sleep(10);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(silent);
+    unlink(resolv);
+
+    DnsResolver::getInstance().SetConfigFiles("/etc/resolv.conf", "/etc/hosts");
+    DnsResolver::getInstance().SetNameServers({});
+    DnsResolver::getInstance().ClearCache();
+    g_Scheduler.GetOptions().enable_dns_resolver = false;
+}
+
+TEST(Dns, NssFallback)
+{
+    StubDns dns;
+    ResetResolver(dns);
+
+    // 不使用内置的客户端时, 在线程池中调用glibc的原函数, 经过NSS查找/etc/hosts
+    auto expect_nss = [&] {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        addrinfo* res = nullptr;
+        ASSERT_EQ(getaddrinfo("localhost", nullptr, &hints, &res), 0);
+        EXPECT_EQ(AddrString(res->ai_addr), "127.0.0.1");
+        freeaddrinfo(res);
+        EXPECT_GT(FileIoPool::getInstance().GetThreadCount(), 0u);
+
+        hostent* ent = gethostbyname("localhost");
+        ASSERT_TRUE(ent != nullptr);
+        EXPECT_EQ(ent->h_addrtype, AF_INET);
+        EXPECT_EQ(dns.queries_, 0);
+    };
+
+    g_Scheduler.GetOptions().enable_dns_resolver = false;
+    go expect_nss;
+    g_Scheduler.RunUntilNoTask();
+
+    // 开启了选项, 但nsswitch.conf中还有其他数据源
+    g_Scheduler.GetOptions().enable_dns_resolver = true;
+    DnsResolver::getInstance().SetConfigFiles("/nonexistent/resolv.conf", "/nonexistent/hosts",
+            WriteNsswitch("files mdns4_minimal [NOTFOUND=return] dns"));
+    go expect_nss;
+    g_Scheduler.RunUntilNoTask();
+
+    // hosts恰好为"files dns"时使用内置的客户端: hosts文件不存在, 查询stub
+    DnsResolver::getInstance().SetConfigFiles("/nonexistent/resolv.conf", "/nonexistent/hosts",
+            WriteNsswitch("files dns"));
+    go [&] {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        addrinfo* res = nullptr;
+        EXPECT_EQ(getaddrinfo("localhost", nullptr, &hints, &res), EAI_NONAME);
+        EXPECT_EQ(dns.queries_, 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    DnsResolver::getInstance().SetConfigFiles("/etc/resolv.conf", "/etc/hosts");
+    DnsResolver::getInstance().SetNameServers({});
+    DnsResolver::getInstance().ClearCache();
+    g_Scheduler.GetOptions().enable_dns_resolver = false;
+}
+
+TEST(Dns, AddrConfig)
+{
+    StubDns dns;
+    dns.records_["dual.example.test"] = {"10.0.0.8", "2001:db8::8"};
+    ResetResolver(dns);
+
+    // 与glibc一致, 回环地址不算
+    bool has_v4 = false, has_v6 = false;
+    ifaddrs* ifa = nullptr;
+    ASSERT_EQ(getifaddrs(&ifa), 0);
+    for (ifaddrs* p = ifa; p; p = p->ifa_next) {
+        if (!p->ifa_addr) continue;
+        if (p->ifa_addr->sa_family == AF_INET)
+            has_v4 |= ((sockaddr_in*)p->ifa_addr)->sin_addr.s_addr != htonl(INADDR_LOOPBACK);
+        else if (p->ifa_addr->sa_family == AF_INET6)
+            has_v6 |= !IN6_IS_ADDR_LOOPBACK(&((sockaddr_in6*)p->ifa_addr)->sin6_addr);
+    }
+    freeifaddrs(ifa);
+    cout << "configured: ipv4=" << has_v4 << " ipv6=" << has_v6 << endl;
+
+    go [&] {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_ADDRCONFIG;
+        addrinfo* res = nullptr;
+        ASSERT_EQ(getaddrinfo("dual.example.test", "80", &hints, &res), 0);
+        bool got_v4 = false, got_v6 = false;
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            got_v4 |= ai->ai_family == AF_INET;
+            got_v6 |= ai->ai_family == AF_INET6;
+        }
+        freeaddrinfo(res);
+        // 两种地址都有或都没有时不做限制
+        EXPECT_EQ(got_v4, has_v4 || !has_v6);
+        EXPECT_EQ(got_v6, has_v6 || !has_v4);
+
+        hints.ai_family = AF_INET6;
+        int err = getaddrinfo("dual.example.test", "80", &hints, &res);
+        if (has_v6) {
+            ASSERT_EQ(err, 0);
+            freeaddrinfo(res);
+        } else {
+            EXPECT_EQ(err, EAI_NONAME);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    DnsResolver::getInstance().SetConfigFiles("/etc/resolv.conf", "/etc/hosts");
+    DnsResolver::getInstance().SetNameServers({});
+    DnsResolver::getInstance().ClearCache();
+    g_Scheduler.GetOptions().enable_dns_resolver = false;
+}
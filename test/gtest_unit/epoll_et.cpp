@@ -0,0 +1,116 @@
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// socketpair上乒乓收发count次, 返回期间调用epoll_ctl的次数
+static uint64_t pingpong(int count)
+{
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    uint64_t start = co_debugger.GetEpollCtlCount();
+    go [=] {
+        char buf[16];
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 4);
+            EXPECT_EQ(write(fds[0], buf, 4), 4);
+        }
+    };
+    go [=] {
+        char buf[16];
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(write(fds[1], "ping", 4), 4);
+            EXPECT_EQ(read(fds[1], buf, sizeof(buf)), 4);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    uint64_t ctl = co_debugger.GetEpollCtlCount() - start;
+    close(fds[0]);
+    close(fds[1]);
+    return ctl;
+}
+
+TEST(EpollET, CtlCount)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+    uint64_t lt = pingpong(100);
+    cout << "level-triggered epoll_ctl: " << lt << endl;
+    EXPECT_GE(lt, 200u);
+
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    uint64_t et = pingpong(100);
+    cout << "edge-triggered epoll_ctl: " << et << endl;
+    EXPECT_LE(et, 2u);  // 每个socket只注册一次
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+TEST(EpollET, ReadyBeforeWait)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    go [=] {
+        char buf[16];
+        // 第一次等待时注册到epoll
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+
+        // 没有协程等待时到来的可读事件, 之后的poll可以立即返回
+        co_sleep(30);
+        pollfd pfd = {fds[0], POLLIN, 0};
+        EXPECT_EQ(poll(&pfd, 1, 1000), 1);
+        EXPECT_EQ(pfd.revents, POLLIN);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+
+        // 对端关闭
+        auto start = steady_clock::now();
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 0);
+        EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - start).count(), 500);
+    };
+    go [=] {
+        co_sleep(10);
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        co_sleep(10);
+        EXPECT_EQ(write(fds[1], "b", 1), 1);
+        co_sleep(50);
+        close(fds[1]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+TEST(EpollET, Timeout)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    go [] {
+        int fds[2];
+        int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+        EXPECT_EQ(res, 0);
+
+        char buf[16];
+        for (int i = 0; i < 3; ++i) {
+            pollfd pfd = {fds[0], POLLIN, 0};
+            auto start = steady_clock::now();
+            EXPECT_EQ(poll(&pfd, 1, 50), 0);
+            EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 49);
+        }
+
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        pollfd pfd = {fds[0], POLLIN, 0};
+        EXPECT_EQ(poll(&pfd, 1, 50), 1);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+        close(fds[0]);
+        close(fds[1]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 仿照libevent的事件循环: 在自己的epoll fd上注册fd和回调, 循环epoll_wait并分发.
+struct MiniEventLoop
+{
+    int epfd_;
+    std::map<int, std::function<void()>> handlers_;
+    bool stop_ = false;
+
+    MiniEventLoop() : epfd_(epoll_create1(0)) {}
+    ~MiniEventLoop() { close(epfd_); }
+
+    void add(int fd, std::function<void()> cb)
+    {
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev), 0);
+        handlers_[fd] = cb;
+    }
+
+    void del(int fd)
+    {
+        EXPECT_EQ(epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr), 0);
+        handlers_.erase(fd);
+    }
+
+    // @return: 分发的事件数
+    int dispatch(int timeout)
+    {
+        epoll_event evs[16];
+        int n = epoll_wait(epfd_, evs, 16, timeout);
+        EXPECT_GE(n, 0);
+        for (int i = 0; i < n; ++i) {
+            auto it = handlers_.find(evs[i].data.fd);
+            if (it == handlers_.end())
+                continue;
+
+            auto cb = it->second;   // 回调中可能del自己
+            cb();
+        }
+        return n;
+    }
+
+    void run()
+    {
+        while (!stop_ && !handlers_.empty())
+            dispatch(1000);
+    }
+};
+
+TEST(EpollWait, Timeout)
+{
+    go [] {
+        int epfd = epoll_create1(0);
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[0];
+        ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), 0);
+
+        // 等待期间同一线程上的其他协程继续运行
+        std::atomic<int> ticks{0};
+        go [&] {
+            for (int i = 0; i < 5; ++i) {
+                co_sleep(10);
+                ++ticks;
+            }
+        };
+
+        epoll_event evs[4];
+        auto start = steady_clock::now();
+        EXPECT_EQ(epoll_wait(epfd, evs, 4, 100), 0);
+        auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        EXPECT_GE(ms, 99);
+        EXPECT_LT(ms, 200);
+        EXPECT_EQ(ticks, 5);
+
+        // 超时为0时不挂起
+        EXPECT_EQ(epoll_wait(epfd, evs, 4, 0), 0);
+
+        // 事件就绪时唤醒
+        go [=] {
+            co_sleep(20);
+            EXPECT_EQ(write(fds[1], "a", 1), 1);
+        };
+        start = steady_clock::now();
+        sigset_t mask;
+        sigemptyset(&mask);
+        ASSERT_EQ(epoll_pwait(epfd, evs, 4, 1000, &mask), 1);
+        EXPECT_EQ(evs[0].data.fd, fds[0]);
+        EXPECT_TRUE(evs[0].events & EPOLLIN);
+        EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - start).count(), 500);
+
+        close(fds[0]);
+        close(fds[1]);
+        close(epfd);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(EpollWait, CloseWhileWaiting)
+{
+    int epfd = epoll_create1(0);
+    go [=] {
+        epoll_event evs[4];
+        EXPECT_EQ(epoll_wait(epfd, evs, 4, -1), -1);
+        EXPECT_EQ(errno, EBADF);
+    };
+    go [=] {
+        co_sleep(20);
+        close(epfd);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(EpollWait, MultiThreadEventLoops)
+{
+    // 每个协程运行一个事件循环, 分别由其他协程写入消息; 循环中的epoll_wait不阻塞线程.
+    const int loops = 8, conns = 4, msgs = 50;
+    std::atomic<int> received{0};
+    for (int l = 0; l < loops; ++l)
+        go [&] {
+            MiniEventLoop loop;
+            std::vector<int> peers;
+            for (int c = 0; c < conns; ++c) {
+                int fds[2];
+                ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+                peers.push_back(fds[1]);
+                int fd = fds[0];
+                auto count = std::make_shared<int>(0);
+                loop.add(fd, [&loop, &received, fd, count, msgs] {
+                    char buf[64];
+                    ssize_t n = read(fd, buf, sizeof(buf));
+                    if (n <= 0) {
+                        loop.del(fd);
+                        close(fd);
+                        EXPECT_EQ(*count, msgs);
+                        return ;
+                    }
+                    *count += n;
+                    received += n;
+                });
+            }
+
+            for (int fd : peers)
+                go [=] {
+                    for (int i = 0; i < msgs; ++i) {
+                        EXPECT_EQ(write(fd, "m", 1), 1);
+                        if (i % 10 == 0)
+                            co_sleep(1);
+                        else
+                            co_yield;
+                    }
+                    close(fd);
+                };
+
+            loop.run();
+        };
+
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    EXPECT_EQ(received, loops * conns * msgs);
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+TEST(FdTable, BigFd)
+{
+    rlimit lim;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &lim), 0);
+    int big = (int)(std::min)(lim.rlim_cur, (rlim_t)(1 << 30)) - 1;
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    // 不经过hook的dup, 大fd使用自己的上下文
+    ASSERT_EQ(syscall(SYS_dup3, fds[0], big, 0), big);
+    close(fds[0]);
+
+    go [=] {
+        // 大fd与其他fd一样挂起协程等待
+        char buf[8];
+        auto start = steady_clock::now();
+        EXPECT_EQ(read(big, buf, sizeof(buf)), 1);
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 40);
+    };
+    go [=] {
+        co_sleep(50);
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(big);
+    close(fds[1]);
+}
+
+TEST(FdTable, ConcurrentCloseAndLookup)
+{
+    // 多个线程同时创建、读写、关闭fd, 复用的fd号不会拿到旧的上下文
+    std::atomic<int> done{0};
+    const int loops = 2000;
+    for (int i = 0; i < 8; ++i)
+        go [&] {
+            for (int j = 0; j < loops; ++j) {
+                int fds[2];
+                ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+                char c = 'x';
+                EXPECT_EQ(write(fds[1], &c, 1), 1);
+                EXPECT_EQ(read(fds[0], &c, 1), 1);
+                close(fds[0]);
+                close(fds[1]);
+                if (j % 100 == 0)
+                    co_yield;
+            }
+            ++done;
+        };
+
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    EXPECT_EQ(done, 8);
+}
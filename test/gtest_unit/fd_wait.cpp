@@ -0,0 +1,145 @@
+#include <iostream>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 统计期间的内存分配次数. 不内联, 避免编译器把malloc/free与new/delete当作不匹配.
+static std::atomic<bool> g_count_alloc{false};
+static std::atomic<long> g_alloc_count{0};
+
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    if (g_count_alloc)
+        ++g_alloc_count;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+    free(p);
+}
+
+static void pingpong(int loops)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    go [=] {
+        char c;
+        for (int i = 0; i < loops; ++i) {
+            EXPECT_EQ(read(fds[0], &c, 1), 1);
+            EXPECT_EQ(write(fds[0], &c, 1), 1);
+        }
+    };
+    go [=] {
+        char c = 'x';
+        for (int i = 0; i < loops; ++i) {
+            EXPECT_EQ(write(fds[1], &c, 1), 1);
+            EXPECT_EQ(read(fds[1], &c, 1), 1);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(FdWait, NoAllocation)
+{
+    // 预热: 创建fd上下文、reactor、协程栈等
+    pingpong(100);
+
+    // 每次read都要挂起等待对端写入, 单fd等待不再分配内存(只剩下创建协程的开销)
+    const int loops = 1000;
+    g_alloc_count = 0;
+    g_count_alloc = true;
+    pingpong(loops);
+    g_count_alloc = false;
+    cout << "allocations: " << g_alloc_count << " for " << loops * 2 << " waits" << endl;
+    EXPECT_LT(g_alloc_count, loops / 10);
+}
+
+TEST(FdWait, RepeatedTimeout)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    go [=] {
+        timeval tv = {0, 30 * 1000};
+        ASSERT_EQ(setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)), 0);
+
+        // 超时定时器在多次等待间复用, 每次仍然按各自的截止时间超时
+        char c;
+        for (int i = 0; i < 5; ++i) {
+            auto start = steady_clock::now();
+            EXPECT_EQ(read(fds[0], &c, 1), -1);
+            EXPECT_EQ(errno, EAGAIN);
+            auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+            EXPECT_GE(ms, 29);
+            EXPECT_LT(ms, 80);
+        }
+
+        // 超时后的等待可以正常被唤醒
+        go [=] {
+            co_sleep(10);
+            EXPECT_EQ(write(fds[1], "a", 1), 1);
+        };
+        auto start = steady_clock::now();
+        EXPECT_EQ(read(fds[0], &c, 1), 1);
+        EXPECT_LT(duration_cast<milliseconds>(steady_clock::now() - start).count(), 29);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(FdWait, CloseWhileWaiting)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    go [=] {
+        char c;
+        EXPECT_EQ(read(fds[0], &c, 1), -1);
+        EXPECT_EQ(errno, EBADF);
+    };
+    go [=] {
+        co_sleep(20);
+        // 等待中的协程也计入等待epoll的协程数量
+        EXPECT_EQ(co_debugger.GetEpollWaitCount(), 1u);
+        close(fds[0]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(co_debugger.GetEpollWaitCount(), 0u);
+    close(fds[1]);
+}
+
+TEST(FdWait, TimedWaitReleasesTask)
+{
+    // 带SO_RCVTIMEO的读被唤醒后, 结束的协程立即释放, 不等到超时定时器触发
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    go [=] {
+        timeval tv = {30, 0};
+        ASSERT_EQ(setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)), 0);
+        char c;
+        EXPECT_EQ(read(fds[0], &c, 1), 1);
+    };
+    go [=] {
+        co_sleep(1);
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(Task::GetTaskCount(), 0u);
+    close(fds[0]);
+    close(fds[1]);
+}
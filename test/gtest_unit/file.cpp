@@ -4,7 +4,12 @@
 #include <gtest/gtest.h>
 #include <poll.h>
 #include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <stdlib.h>
 #include <chrono>
+#include <vector>
 #include "coroutine.h"
 #include <libgo/linux_glibc_hook.h>
 using namespace std;
@@ -61,3 +66,173 @@ TEST(HOOK, filefd)
     };
     co_sched.RunUntilNoTask();
 }
+
+// 读端阻塞时挂起协程, 期间其他协程可以继续执行
+static void expect_wait_readable(int rfd, int wfd, const char* name)
+{
+    int ticks = 0;
+    bool done = false;
+    go [&]{
+        char buf[16] = {};
+        ssize_t n = read(rfd, buf, sizeof(buf));
+        EXPECT_EQ(n, 8) << name;
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u) << name;
+        done = true;
+    };
+    go [&]{
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    go [&]{
+        co_sleep(50);
+        uint64_t v = 1;
+        EXPECT_EQ(write(wfd, &v, sizeof(v)), 8) << name;
+    };
+    co_sched.RunUntilNoTask();
+    EXPECT_TRUE(done) << name;
+    EXPECT_GE(ticks, 5) << name;
+}
+
+// 管道、FIFO、eventfd可以通过epoll等待
+TEST(HOOK, pipefd)
+{
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    expect_wait_readable(fds[0], fds[1], "pipe");
+
+    // 用户视角仍是阻塞的fd
+    go [=]{
+        EXPECT_FALSE(is_nonblock(fds[0]));
+        EXPECT_TRUE(origin_is_nonblock(fds[0]));
+    };
+    co_sched.RunUntilNoTask();
+
+    // 同一线程上的两个协程通过管道传递超过管道容量的数据
+    const int total = 1024 * 1024;
+    go [=]{
+        std::vector<char> buf(total, 'a');
+        int n = 0;
+        while (n < total) {
+            // 与socket一样, 非阻塞写可能只写入一部分
+            ssize_t res = write(fds[1], buf.data() + n, total - n);
+            ASSERT_GT(res, 0);
+            n += res;
+        }
+    };
+    go [=]{
+        std::vector<char> buf(total);
+        int n = 0;
+        while (n < total) {
+            ssize_t res = read(fds[0], buf.data() + n, total - n);
+            ASSERT_GT(res, 0);
+            n += res;
+        }
+        EXPECT_EQ(buf[total - 1], 'a');
+    };
+    co_sched.RunUntilNoTask();
+
+    // 写端关闭后读到EOF
+    go [=]{
+        char buf[16];
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 0);
+    };
+    go [=]{
+        co_sleep(20);
+        close(fds[1]);
+    };
+    co_sched.RunUntilNoTask();
+    close(fds[0]);
+
+    const char* fifo = "/tmp/libgo_test_fifo";
+    unlink(fifo);
+    ASSERT_EQ(mkfifo(fifo, 0600), 0);
+    int ffd = open(fifo, O_RDWR);
+    ASSERT_GE(ffd, 0);
+    expect_wait_readable(ffd, ffd, "fifo");
+    close(ffd);
+    unlink(fifo);
+}
+
+TEST(HOOK, eventfd)
+{
+    int efd = eventfd(0, 0);
+    ASSERT_GE(efd, 0);
+    expect_wait_readable(efd, efd, "eventfd");
+    close(efd);
+
+    // 其他库创建的非阻塞eventfd保持非阻塞的语义
+    efd = eventfd(0, EFD_NONBLOCK);
+    go [=]{
+        uint64_t v;
+        EXPECT_EQ(read(efd, &v, sizeof(v)), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        EXPECT_EQ(co_sched.GetCurrentTaskYieldCount(), 0u);
+        EXPECT_TRUE(is_nonblock(efd));
+    };
+    co_sched.RunUntilNoTask();
+    close(efd);
+}
+
+TEST(HOOK, timerfd)
+{
+    int tfd = timerfd_create(CLOCK_MONOTONIC, 0);
+    ASSERT_GE(tfd, 0);
+    int ticks = 0;
+    go [&]{
+        itimerspec its = {};
+        its.it_value.tv_nsec = 50 * 1000 * 1000;
+        EXPECT_EQ(timerfd_settime(tfd, 0, &its, nullptr), 0);
+        uint64_t expirations = 0;
+        EXPECT_EQ(read(tfd, &expirations, sizeof(expirations)), 8);
+        EXPECT_EQ(expirations, 1u);
+        EXPECT_GE(ticks, 5);
+    };
+    go [&]{
+        for (int i = 0; i < 5; ++i) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    co_sched.RunUntilNoTask();
+    close(tfd);
+}
+
+// 终端与其他进程共享O_NONBLOCK标志, 等待就绪时不修改它
+TEST(HOOK, ttyfd)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        cout << "pty not available, skip." << endl;
+        return ;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    ASSERT_GE(slave, 0);
+
+    int ticks = 0;
+    bool done = false;
+    go [&]{
+        char buf[16] = {};
+        EXPECT_EQ(read(slave, buf, sizeof(buf)), 3);
+        EXPECT_EQ(string(buf, 3), "hi\n");
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        EXPECT_FALSE(origin_is_nonblock(slave));
+        done = true;
+    };
+    go [&]{
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    go [&]{
+        co_sleep(50);
+        EXPECT_EQ(write(master, "hi\n", 3), 3);
+    };
+    co_sched.RunUntilNoTask();
+    EXPECT_TRUE(done);
+    EXPECT_GE(ticks, 5);
+    close(slave);
+    close(master);
+}
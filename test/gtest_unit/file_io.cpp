@@ -0,0 +1,241 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "coroutine.h"
+#include "linux/file_io.h"
+#include "linux/uring_wait.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 切换普通文件读写的处理方式, 离开作用域时恢复为blocking
+struct FileIoModeGuard
+{
+    explicit FileIoModeGuard(eFileIoMode mode) { g_Scheduler.GetOptions().file_io_mode = mode; }
+    ~FileIoModeGuard() { g_Scheduler.GetOptions().file_io_mode = eFileIoMode::blocking; }
+};
+
+static int open_temp_file()
+{
+    char path[] = "/tmp/libgo_file_io_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    return fd;
+}
+
+static void read_write(eFileIoMode mode)
+{
+    FileIoModeGuard guard(mode);
+    go [] {
+        int fd = open_temp_file();
+        ASSERT_GE(fd, 0);
+
+        EXPECT_EQ(write(fd, "hello ", 6), 6);
+        iovec wv[2] = {{(void*)"wor", 3}, {(void*)"ld", 2}};
+        EXPECT_EQ(writev(fd, wv, 2), 5);
+        EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 11);
+        EXPECT_EQ(pwrite(fd, "W", 1, 6), 1);
+        EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 11);  // pwrite不改变文件偏移
+
+        char buf[32] = {};
+        EXPECT_EQ(pread(fd, buf, sizeof(buf), 0), 11);
+        EXPECT_EQ(string(buf, 11), "hello World");
+
+        EXPECT_EQ(lseek(fd, 0, SEEK_SET), 0);
+        EXPECT_EQ(read(fd, buf, 6), 6);
+        EXPECT_EQ(string(buf, 6), "hello ");
+        char a[3], b[8];
+        iovec rv[2] = {{a, 3}, {b, 8}};
+        EXPECT_EQ(readv(fd, rv, 2), 5);
+        EXPECT_EQ(string(a, 3), "Wor");
+        EXPECT_EQ(string(b, 2), "ld");
+        EXPECT_EQ(read(fd, buf, sizeof(buf)), 0);   // EOF
+
+        close(fd);
+        EXPECT_EQ(read(fd, buf, sizeof(buf)), -1);
+        EXPECT_EQ(errno, EBADF);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(FileIo, ReadWriteBlocking)
+{
+    read_write(eFileIoMode::blocking);
+}
+
+TEST(FileIo, ReadWriteAsync)
+{
+    cout << "io_uring supported: " << IoUring::IsSupported() << endl;
+    read_write(eFileIoMode::async);
+}
+
+TEST(FileIo, ReadWriteThreadPool)
+{
+    read_write(eFileIoMode::thread_pool);
+    EXPECT_EQ(FileIoPool::getInstance().GetThreadCount(), 4u);
+}
+
+// 大块文件读写期间, 同一调度线程上的另一个协程每1ms tick一次.
+// @return: 从读写开始到结束, 相邻两次tick(含开始和结束时刻)的最大间隔(ms)
+static long long max_tick_gap(eFileIoMode mode, int *ticks)
+{
+    FileIoModeGuard guard(mode);
+    const size_t block = 32 * 1024 * 1024;
+    std::atomic<bool> done{false};
+    steady_clock::time_point io_start, io_end;
+    std::vector<steady_clock::time_point> tick_times;
+
+    go [&] {
+        io_start = steady_clock::now();
+        int fd = open_temp_file();
+        std::vector<char> buf(block, 'a');
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_EQ(pwrite(fd, &buf[0], block, 0), (ssize_t)block);
+            EXPECT_EQ(pread(fd, &buf[0], block, 0), (ssize_t)block);
+        }
+        close(fd);
+        io_end = steady_clock::now();
+        done = true;
+    };
+    go [&] {
+        while (!done) {
+            co_sleep(1);
+            tick_times.push_back(steady_clock::now());
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    long long max_gap = 0;
+    auto last = io_start;
+    *ticks = 0;
+    for (auto & t : tick_times) {
+        if (t > io_end) break;
+        max_gap = (std::max<long long>)(max_gap, duration_cast<milliseconds>(t - last).count());
+        last = t;
+        ++*ticks;
+    }
+    return (std::max<long long>)(max_gap, duration_cast<milliseconds>(io_end - last).count());
+}
+
+TEST(FileIo, OtherTasksProgress)
+{
+    int blocking_ticks, pool_ticks, async_ticks;
+    long long blocking_gap = max_tick_gap(eFileIoMode::blocking, &blocking_ticks);
+    long long pool_gap = max_tick_gap(eFileIoMode::thread_pool, &pool_ticks);
+    long long async_gap = max_tick_gap(eFileIoMode::async, &async_ticks);
+    cout << "blocking: ticks=" << blocking_ticks << " max_gap=" << blocking_gap << "ms" << endl;
+    cout << "thread_pool: ticks=" << pool_ticks << " max_gap=" << pool_gap << "ms" << endl;
+    cout << "async: ticks=" << async_ticks << " max_gap=" << async_gap << "ms" << endl;
+
+    // blocking模式下读写协程从不让出, 另一个协程要等到全部读写完成
+    EXPECT_EQ(blocking_ticks, 0);
+    EXPECT_GT(pool_ticks, 1);
+    EXPECT_GT(async_ticks, 1);
+    EXPECT_LT(pool_gap, blocking_gap);
+    EXPECT_LT(async_gap, blocking_gap);
+}
+
+TEST(FileIo, MetaOps)
+{
+    FileIoModeGuard guard(eFileIoMode::thread_pool);
+    FileIoPool & pool = FileIoPool::getInstance();
+    uint64_t open_calls = pool.GetStat(eFileOp::open).calls;
+    uint64_t fsync_calls = pool.GetStat(eFileOp::fsync).calls;
+    uint64_t readdir_calls = pool.GetStat(eFileOp::readdir).calls;
+
+    go [] {
+        char dir[] = "/tmp/libgo_file_meta_XXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != nullptr);
+        string a = string(dir) + "/a", b = string(dir) + "/b";
+
+        int fd = open(a.c_str(), O_CREAT | O_RDWR, 0600);
+        ASSERT_GE(fd, 0);
+        EXPECT_EQ(write(fd, "abc", 3), 3);
+        EXPECT_EQ(fsync(fd), 0);
+        EXPECT_EQ(fdatasync(fd), 0);
+        close(fd);
+
+        struct stat st;
+        EXPECT_EQ(stat(a.c_str(), &st), 0);
+        EXPECT_EQ(st.st_size, 3);
+        EXPECT_EQ(st.st_mode & 0777, 0600u);
+
+        EXPECT_EQ(rename(a.c_str(), b.c_str()), 0);
+        EXPECT_EQ(stat(a.c_str(), &st), -1);
+        EXPECT_EQ(errno, ENOENT);
+        EXPECT_EQ(open(a.c_str(), O_RDONLY), -1);
+        EXPECT_EQ(errno, ENOENT);
+
+        DIR *d = opendir(dir);
+        ASSERT_TRUE(d != nullptr);
+        std::vector<string> names;
+        errno = 0;
+        while (struct dirent *ent = readdir(d))
+            names.push_back(ent->d_name);
+        EXPECT_EQ(errno, 0);    // 读到结尾不修改errno
+        closedir(d);
+        EXPECT_EQ(names.size(), 3u);
+        EXPECT_TRUE(std::find(names.begin(), names.end(), "b") != names.end());
+
+        EXPECT_EQ(unlink(b.c_str()), 0);
+        EXPECT_EQ(unlink(b.c_str()), -1);
+        EXPECT_EQ(errno, ENOENT);
+        EXPECT_EQ(opendir(b.c_str()), nullptr);
+        EXPECT_EQ(errno, ENOENT);
+        rmdir(dir);
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    EXPECT_EQ(pool.GetStat(eFileOp::open).calls, open_calls + 2);
+    EXPECT_EQ(pool.GetStat(eFileOp::fsync).calls, fsync_calls + 1);
+    EXPECT_EQ(pool.GetStat(eFileOp::readdir).calls, readdir_calls + 4);
+
+    // 不在协程中时不统计
+    int fd = open("/dev/null", O_RDONLY);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    EXPECT_EQ(pool.GetStat(eFileOp::open).calls, open_calls + 2);
+    cout << co_debugger.GetFileOpInfo() << endl;
+}
+
+// 以只读方式open一个fifo会阻塞到有写端打开为止.
+// 交给线程池执行时, 同一调度线程上的另一个协程可以继续执行并打开写端.
+TEST(FileIo, BlockingOpen)
+{
+    FileIoModeGuard guard(eFileIoMode::thread_pool);
+    char dir[] = "/tmp/libgo_file_fifo_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    string path = string(dir) + "/fifo";
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+    uint64_t max_us = FileIoPool::getInstance().GetStat(eFileOp::open).max_us;
+
+    std::atomic<bool> opened{false};
+    go [&] {
+        int fd = open(path.c_str(), O_RDONLY);
+        EXPECT_GE(fd, 0);
+        opened = true;
+        close(fd);
+    };
+    go [&] {
+        co_sleep(50);
+        EXPECT_FALSE(opened);
+        int fd = open(path.c_str(), O_WRONLY);
+        EXPECT_GE(fd, 0);
+        close(fd);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_TRUE(opened);
+    EXPECT_GE(FileIoPool::getInstance().GetStat(eFileOp::open).max_us, (std::max<uint64_t>)(max_us, 49000));
+    unlink(path.c_str());
+    rmdir(dir);
+}
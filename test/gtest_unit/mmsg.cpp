@@ -0,0 +1,155 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include <chrono>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 绑定到127.0.0.1的随机端口
+static int bind_any(int type, sockaddr_in & addr)
+{
+    int fd = socket(AF_INET, type, 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(fd, (sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    return fd;
+}
+
+TEST(Mmsg, RecvSend)
+{
+    sockaddr_in addr;
+    int rfd = bind_any(SOCK_DGRAM, addr);
+    int sfd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_EQ(connect(sfd, (sockaddr*)&addr, sizeof(addr)), 0);
+
+    const int count = 8;
+    int ticks = 0;
+    bool done = false;
+    go [&]{
+        char bufs[16][32];
+        iovec iovs[16];
+        mmsghdr msgs[16];
+        int received = 0;
+        while (received < count) {
+            for (int i = 0; i < 16; ++i) {
+                iovs[i] = {bufs[i], sizeof(bufs[i])};
+                msgs[i] = {};
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            // 没有报文时挂起协程, 到达后一次取走已经到达的全部报文
+            int n = recvmmsg(rfd, msgs, 16, 0, nullptr);
+            ASSERT_GT(n, 0);
+            for (int i = 0; i < n; ++i) {
+                EXPECT_EQ(msgs[i].msg_len, 4u);
+                EXPECT_EQ(string(bufs[i], 4), "pkt" + to_string(received + i));
+            }
+            received += n;
+        }
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        done = true;
+    };
+    go [&]{
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    go [&]{
+        co_sleep(50);
+        char bufs[count][8];
+        iovec iovs[count];
+        mmsghdr msgs[count];
+        for (int i = 0; i < count; ++i) {
+            snprintf(bufs[i], sizeof(bufs[i]), "pkt%d", i);
+            iovs[i] = {bufs[i], 4};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        EXPECT_EQ(sendmmsg(sfd, msgs, count, 0), count);
+    };
+    co_sched.RunUntilNoTask();
+    EXPECT_TRUE(done);
+    EXPECT_GE(ticks, 5);
+    close(rfd);
+    close(sfd);
+}
+
+TEST(Mmsg, RecvTimeout)
+{
+    sockaddr_in addr;
+    int rfd = bind_any(SOCK_DGRAM, addr);
+    go [=]{
+        timeval tv = {0, 50 * 1000};
+        EXPECT_EQ(setsockopt(rfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)), 0);
+
+        char buf[16];
+        iovec iov = {buf, sizeof(buf)};
+        mmsghdr msg = {};
+        msg.msg_hdr.msg_iov = &iov;
+        msg.msg_hdr.msg_iovlen = 1;
+        auto start = steady_clock::now();
+        EXPECT_EQ(recvmmsg(rfd, &msg, 1, 0, nullptr), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 49);
+    };
+    co_sched.RunUntilNoTask();
+    close(rfd);
+}
+
+TEST(Mmsg, Accept4)
+{
+    sockaddr_in addr;
+    int listen_fd = bind_any(SOCK_STREAM, addr);
+    ASSERT_EQ(listen(listen_fd, 16), 0);
+
+    go [=]{
+        sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept4(listen_fd, (sockaddr*)&peer, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        ASSERT_GE(fd, 0);
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        EXPECT_EQ(peer.sin_addr.s_addr, addr.sin_addr.s_addr);
+        EXPECT_TRUE(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+        EXPECT_TRUE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+
+        // 用户要求的非阻塞语义: 没有数据时立即返回EAGAIN
+        char buf[16];
+        EXPECT_EQ(read(fd, buf, sizeof(buf)), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        close(fd);
+
+        // 不带flags时与accept一致
+        fd = accept4(listen_fd, nullptr, nullptr, 0);
+        ASSERT_GE(fd, 0);
+        EXPECT_FALSE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+        EXPECT_EQ(read(fd, buf, sizeof(buf)), 5);
+        close(fd);
+    };
+    go [=]{
+        for (int i = 0; i < 2; ++i) {
+            co_sleep(20);
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            EXPECT_EQ(connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+            if (i == 1) {
+                co_sleep(20);
+                EXPECT_EQ(write(fd, "hello", 5), 5);
+            }
+            co_sleep(20);
+            close(fd);
+        }
+    };
+    co_sched.RunUntilNoTask();
+    close(listen_fd);
+}
@@ -0,0 +1,213 @@
+#include <iostream>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 启动count个调度线程, 析构时等待它们退出.
+struct Workers
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+
+    explicit Workers(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            threads.emplace_back([this]{
+                    while (!stop) g_Scheduler.Run();
+                    });
+    }
+    ~Workers()
+    {
+        stop = true;
+        for (auto & t : threads)
+            t.join();
+    }
+};
+
+static int reactor_of(int fd)
+{
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+    return fd_ctx ? fd_ctx->reactor() : -1;
+}
+
+static bool is_netpoller(int reactor)
+{
+    return reactor >= (int)IoWait::kMaxReactors
+        && reactor < (int)(IoWait::kMaxReactors + IoWait::kMaxNetpollers);
+}
+
+static int listen_any(sockaddr_in & addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(fd, (sockaddr*)&addr, sizeof(addr));
+    listen(fd, 128);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    return fd;
+}
+
+TEST(Netpoller, PingPong)
+{
+    g_Scheduler.GetOptions().netpoller_threads = 2;
+    Workers workers(2);
+
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    std::atomic<int> done{0};
+    go [&] {
+        char buf[16];
+        for (int i = 0; i < 1000; ++i) {
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 4);
+            EXPECT_EQ(write(fds[0], buf, 4), 4);
+        }
+        ++done;
+    };
+    go [&] {
+        char buf[16];
+        for (int i = 0; i < 1000; ++i) {
+            EXPECT_EQ(write(fds[1], "ping", 4), 4);
+            EXPECT_EQ(read(fds[1], buf, sizeof(buf)), 4);
+        }
+        ++done;
+    };
+
+    while (done < 2) usleep(10 * 1000);
+    EXPECT_EQ(g_Scheduler.GetIoWait().GetNetpollerCount(), 2u);
+    EXPECT_TRUE(is_netpoller(reactor_of(fds[0])));
+    EXPECT_TRUE(is_netpoller(reactor_of(fds[1])));
+    cout << co_debugger.GetReactorInfo() << endl;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(Netpoller, AcceptSpread)
+{
+    g_Scheduler.GetOptions().netpoller_threads = 2;
+    Workers workers(2);
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    ASSERT_GE(listen_fd, 0);
+
+    const int conn_count = 8;
+    std::atomic<int> echoed{0};
+    std::mutex mtx;
+    std::set<int> reactors;
+    go [&] {
+        for (int i = 0; i < conn_count; ++i) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            EXPECT_GE(fd, 0);
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                reactors.insert(reactor_of(fd));
+            }
+            go [fd] {
+                char buf[16];
+                ssize_t n = read(fd, buf, sizeof(buf));
+                EXPECT_EQ(n, 4);
+                EXPECT_EQ(write(fd, buf, n), n);
+                close(fd);
+            };
+        }
+    };
+
+    for (int i = 0; i < conn_count; ++i)
+        go [&] {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            EXPECT_EQ(connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+            EXPECT_EQ(write(fd, "ping", 4), 4);
+            char buf[16];
+            EXPECT_EQ(read(fd, buf, sizeof(buf)), 4);
+            ++echoed;
+            close(fd);
+        };
+
+    while (echoed < conn_count) usleep(10 * 1000);
+    EXPECT_EQ(reactors.size(), 2u);
+    for (int r : reactors)
+        EXPECT_TRUE(is_netpoller(r));
+    close(listen_fd);
+}
+
+// 休眠中的调度线程被轮询线程及时唤醒, 不需要等到max_sleep_ms超时.
+TEST(Netpoller, WakeSleepingWorker)
+{
+    g_Scheduler.GetOptions().netpoller_threads = 2;
+    uint8_t max_sleep_ms = g_Scheduler.GetOptions().max_sleep_ms;
+    g_Scheduler.GetOptions().max_sleep_ms = 200;
+    Workers workers(1);
+
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    std::atomic<int> done{0};
+    std::atomic<bool> started{false};
+    go [&] {
+        started = true;
+        char buf[16];
+        for (int i = 0; i < 5; ++i) {
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+            ++done;
+        }
+    };
+    while (!started) usleep(1000);
+
+    for (int i = 0; i < 5; ++i) {
+        usleep(300 * 1000);     // 调度线程进入休眠
+        auto start = steady_clock::now();
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        while (done <= i) usleep(1000);
+        auto c = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        EXPECT_LT(c, 50);
+    }
+    g_Scheduler.GetOptions().max_sleep_ms = max_sleep_ms;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(Netpoller, Timeout)
+{
+    g_Scheduler.GetOptions().netpoller_threads = 2;
+    std::atomic<bool> done{false};
+    go [&] {
+        int fds[2];
+        int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+        EXPECT_EQ(res, 0);
+
+        timeval tv = {0, 100 * 1000};
+        res = setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        EXPECT_EQ(res, 0);
+
+        char buf[16];
+        auto start = steady_clock::now();
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        auto c = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        EXPECT_GE(c, 99);
+        EXPECT_LT(c, 150);
+
+        // 超时后fd仍然可用
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+        close(fds[0]);
+        close(fds[1]);
+        done = true;
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_TRUE(done);
+}
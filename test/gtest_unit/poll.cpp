@@ -604,3 +604,66 @@ TEST(Poll, MultiThreads)
         g_Scheduler.RunUntilNoTask();
     EXPECT_EQ(Task::GetTaskCount(), 0);
 }
+
+TEST(Poll, ReuseRegistration)
+{
+    // 循环poll同一批fd: 等待结束后fd留在epoll中, 之后每次poll只有就绪的fd需要重新注册.
+    const int count = 100;
+    go [] {
+        std::vector<int> socks;
+        std::vector<pollfd> pfds;
+        for (int i = 0; i < count; ++i) {
+            int fds[2];
+            ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+            socks.push_back(fds[1]);
+            pfds.push_back(pollfd{fds[0], POLLIN, 0});
+        }
+
+        go [=] {
+            co_sleep(20);
+            EXPECT_EQ(write(socks[0], "a", 1), 1);
+        };
+        EXPECT_EQ(poll(&pfds[0], pfds.size(), 1000), 1);
+        EXPECT_EQ(pfds[0].revents, POLLIN);
+        char c;
+        EXPECT_EQ(read(pfds[0].fd, &c, 1), 1);
+
+        uint64_t epoll_ctl = co_debugger.GetEpollCtlCount();
+        for (int i = 1; i < 6; ++i) {
+            go [=] {
+                co_sleep(20);
+                EXPECT_EQ(write(socks[i], "a", 1), 1);
+            };
+            EXPECT_EQ(poll(&pfds[0], pfds.size(), 1000), 1);
+            EXPECT_EQ(pfds[i].revents, POLLIN);
+            EXPECT_EQ(read(pfds[i].fd, &c, 1), 1);
+        }
+        EXPECT_LE(co_debugger.GetEpollCtlCount() - epoll_ctl, 10u);
+
+        // 超时返回后也不必重新注册(只有上一次就绪的fd需要)
+        epoll_ctl = co_debugger.GetEpollCtlCount();
+        EXPECT_EQ(poll(&pfds[0], pfds.size(), 20), 0);
+        EXPECT_LE(co_debugger.GetEpollCtlCount() - epoll_ctl, 1u);
+        epoll_ctl = co_debugger.GetEpollCtlCount();
+        EXPECT_EQ(poll(&pfds[0], pfds.size(), 20), 0);
+        EXPECT_EQ(co_debugger.GetEpollCtlCount() - epoll_ctl, 0u);
+
+        // 没有等待者时就绪的fd可以被其他协程正常等待
+        EXPECT_EQ(write(socks[10], "a", 1), 1);
+        co_sleep(20);
+        EXPECT_EQ(read(pfds[10].fd, &c, 1), 1);
+        go [=] {
+            co_sleep(20);
+            EXPECT_EQ(write(socks[10], "b", 1), 1);
+        };
+        EXPECT_EQ(read(pfds[10].fd, &c, 1), 1);
+        EXPECT_EQ(c, 'b');
+
+        for (int i = 0; i < count; ++i) {
+            close(pfds[i].fd);
+            close(socks[i]);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(Task::GetTaskCount(), 0);
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <unistd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include "coroutine.h"
+#include "signal_channel.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 子进程中不使用被hook的sleep
+static pid_t fork_child(int sleep_ms, int exit_code)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        timespec ts = {sleep_ms / 1000, sleep_ms % 1000 * 1000000L};
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, nullptr);
+        _exit(exit_code);
+    }
+    return pid;
+}
+
+TEST(Process, Waitpid)
+{
+    std::atomic<int> ticks{0};
+    go [&] {
+        pid_t pid = fork_child(100, 3);
+        ASSERT_GT(pid, 0);
+
+        // 等待期间同一线程上的其他协程继续运行
+        go [&] {
+            for (int i = 0; i < 5; ++i) {
+                co_sleep(10);
+                ++ticks;
+            }
+        };
+
+        int status = 0;
+        auto start = steady_clock::now();
+        EXPECT_EQ(waitpid(pid, &status, 0), pid);
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 90);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 3);
+        EXPECT_EQ(ticks, 5);
+
+        // 已经被回收
+        EXPECT_EQ(waitpid(pid, &status, 0), -1);
+        EXPECT_EQ(errno, ECHILD);
+
+        // 任意子进程
+        pid_t a = fork_child(30, 1), b = fork_child(60, 2);
+        int codes = 0;
+        for (int i = 0; i < 2; ++i) {
+            pid_t r = wait(&status);
+            EXPECT_TRUE(r == a || r == b);
+            codes += WEXITSTATUS(status);
+        }
+        EXPECT_EQ(codes, 3);
+        EXPECT_EQ(wait(&status), -1);
+        EXPECT_EQ(errno, ECHILD);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(Process, SystemAndPopen)
+{
+    go [] {
+        int status = system("exit 7");
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 7);
+        EXPECT_NE(system(nullptr), 0);
+
+        FILE* f = popen("echo hello; exit 2", "r");
+        ASSERT_TRUE(f != nullptr);
+        char buf[64] = "";
+        EXPECT_TRUE(fgets(buf, sizeof(buf), f) != nullptr);
+        EXPECT_STREQ(buf, "hello\n");
+        status = pclose(f);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 2);
+
+        f = popen("read line; test \"$line\" = world", "w");
+        ASSERT_TRUE(f != nullptr);
+        fputs("world\n", f);
+        EXPECT_EQ(pclose(f), 0);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(Process, ManyChildren)
+{
+    // 多个线程上的协程同时执行大量短时间的子进程
+    const int tasks = 16, loops = 20;
+    std::atomic<int> done{0};
+    for (int i = 0; i < tasks; ++i)
+        go [&, i] {
+            for (int j = 0; j < loops; ++j) {
+                if (j % 2) {
+                    pid_t pid = fork_child(1, (i + j) % 100);
+                    int status = 0;
+                    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+                    EXPECT_EQ(WEXITSTATUS(status), (i + j) % 100);
+                } else {
+                    EXPECT_EQ(WEXITSTATUS(system("exit 5")), 5);
+                }
+                ++done;
+            }
+        };
+
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    EXPECT_EQ(done, tasks * loops);
+}
+
+TEST(Process, SignalChannel)
+{
+    // 测试进程中只有当前线程在运行调度, 在这里阻塞信号即可
+    auto sigs = std::make_shared<SignalChannel>(std::initializer_list<int>{SIGUSR1, SIGUSR2});
+    go [sigs] {
+        int signo = 0;
+        *sigs >> signo;
+        EXPECT_EQ(signo, SIGUSR1);
+        *sigs >> signo;
+        EXPECT_EQ(signo, SIGUSR2);
+        EXPECT_FALSE(sigs->TimedPop(signo, milliseconds(20)));
+
+        // 停止后后台协程退出, RunUntilNoTask可以返回
+        sigs->Close();
+    };
+    go [] {
+        co_sleep(20);
+        kill(getpid(), SIGUSR1);
+        co_sleep(20);
+        kill(getpid(), SIGUSR2);
+    };
+    g_Scheduler.RunUntilNoTask();
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include "coroutine.h"
+#include "linux_glibc_hook.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 静态链接时没有hook pthread, 同一线程上的协程互相等待会死锁
+static bool pthread_hooked()
+{
+    g_Scheduler.GetCurrentTaskID();     // 初始化hook
+    if (pthread_mutex_lock_f == &pthread_mutex_lock) {
+        cout << "pthread is not hooked, skip." << endl;
+        return false;
+    }
+    return true;
+}
+
+struct PthreadHookEnabler
+{
+    PthreadHookEnabler() { g_Scheduler.GetOptions().enable_pthread_hook = true; }
+    ~PthreadHookEnabler() { g_Scheduler.GetOptions().enable_pthread_hook = false; }
+};
+
+TEST(PthreadHook, MutexOnOneThread)
+{
+    if (!pthread_hooked()) return ;
+    PthreadHookEnabler enabler;
+
+    // 持有锁的协程切出后, 同一线程上的另一个协程等待这把锁
+    std::mutex mtx;
+    int value = 0;
+    go [&] {
+        std::unique_lock<std::mutex> lock(mtx);
+        co_sleep(20);
+        value = 1;
+    };
+    go [&] {
+        co_yield;
+        std::unique_lock<std::mutex> lock(mtx);
+        EXPECT_EQ(value, 1);
+        value = 2;
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(value, 2);
+}
+
+TEST(PthreadHook, CondPingPong)
+{
+    if (!pthread_hooked()) return ;
+    PthreadHookEnabler enabler;
+
+    const int rounds = 1000;
+    std::mutex mtx;
+    std::condition_variable cv;
+    int turn = 0;
+    for (int id = 0; id < 2; ++id)
+        go [&, id] {
+            for (int i = 0; i < rounds; ++i) {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]{ return turn % 2 == id; });
+                ++turn;
+                cv.notify_one();
+            }
+        };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(turn, rounds * 2);
+}
+
+TEST(PthreadHook, CondTimeout)
+{
+    if (!pthread_hooked()) return ;
+    PthreadHookEnabler enabler;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    int ticks = 0;
+    bool done = false;
+    go [&] {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto start = steady_clock::now();
+        EXPECT_EQ(cv.wait_for(lock, milliseconds(50)), std::cv_status::timeout);
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - start).count(), 45);
+        EXPECT_TRUE(lock.owns_lock());
+
+        // 等待期间同一线程上的其他协程继续运行
+        EXPECT_GT(ticks, 0);
+
+        // system_clock使用pthread_cond_timedwait
+        EXPECT_EQ(cv.wait_until(lock, system_clock::now() + milliseconds(10)), std::cv_status::timeout);
+        done = true;
+    };
+    go [&] {
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+}
+
+TEST(PthreadHook, MixedWithThreads)
+{
+    if (!pthread_hooked()) return ;
+    PthreadHookEnabler enabler;
+
+    // 多个调度线程上的协程和普通线程竞争同一把锁, 协程在临界区中切出
+    const int tasks = 100, loops = 100, thread_loops = 10000;
+    std::mutex mtx;
+    std::condition_variable cv;
+    long counter = 0;
+    int finished = 0;
+    for (int i = 0; i < tasks; ++i)
+        go [&, i] {
+            for (int j = 0; j < loops; ++j) {
+                std::unique_lock<std::mutex> lock(mtx);
+                ++counter;
+                if ((i + j) % 10 == 0)
+                    co_yield;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            ++finished;
+            cv.notify_all();
+        };
+
+    // 普通线程等待协程发出的通知
+    std::thread waiter([&]{
+        for (int j = 0; j < thread_loops; ++j) {
+            std::unique_lock<std::mutex> lock(mtx);
+            ++counter;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]{ return finished == tasks; });
+    });
+
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([] { g_Scheduler.RunUntilNoTask(); });
+    tg.join_all();
+    waiter.join();
+    EXPECT_EQ(counter, (long)tasks * loops + thread_loops);
+    EXPECT_EQ(finished, tasks);
+}
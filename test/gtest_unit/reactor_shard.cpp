@@ -0,0 +1,199 @@
+#include <iostream>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <set>
+#include <atomic>
+#include "coroutine.h"
+using namespace std;
+using namespace co;
+
+// 启动count个调度线程, 析构时等待它们退出.
+struct Workers
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+
+    explicit Workers(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            threads.emplace_back([this]{
+                    while (!stop) g_Scheduler.Run();
+                    });
+        usleep(50 * 1000);  // 等待各线程的reactor开始epoll_wait
+    }
+    ~Workers()
+    {
+        stop = true;
+        for (auto & t : threads)
+            t.join();
+    }
+};
+
+static int reactor_of(int fd)
+{
+    FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+    return fd_ctx ? fd_ctx->reactor() : -1;
+}
+
+static int listen_any(sockaddr_in & addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(fd, (sockaddr*)&addr, sizeof(addr));
+    listen(fd, 128);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    return fd;
+}
+
+TEST(ReactorShard, AcceptSpread)
+{
+    Workers workers(3);
+    sockaddr_in addr;
+    int listen_fd = listen_any(addr);
+    ASSERT_GE(listen_fd, 0);
+
+    const int conn_count = 16;
+    std::atomic<int> echoed{0};
+    std::mutex mtx;
+    std::set<int> reactors;
+    go [&] {
+        for (int i = 0; i < conn_count; ++i) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            EXPECT_GE(fd, 0);
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                reactors.insert(reactor_of(fd));
+            }
+            go [fd] {
+                char buf[16];
+                for (int j = 0; j < 10; ++j) {
+                    ssize_t n = read(fd, buf, sizeof(buf));
+                    EXPECT_EQ(n, 4);
+                    EXPECT_EQ(write(fd, buf, n), n);
+                }
+                close(fd);
+            };
+        }
+    };
+
+    for (int i = 0; i < conn_count; ++i)
+        go [&] {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            EXPECT_EQ(connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+            char buf[16];
+            for (int j = 0; j < 10; ++j) {
+                EXPECT_EQ(write(fd, "ping", 4), 4);
+                EXPECT_EQ(read(fd, buf, sizeof(buf)), 4);
+            }
+            ++echoed;
+            close(fd);
+        };
+    g_Scheduler.RunUntilNoTask();
+    close(listen_fd);
+    EXPECT_EQ(echoed, conn_count);
+
+    // 新连接轮流分配给4个调度线程的reactor
+    cout << co_debugger.GetReactorInfo() << endl;
+    EXPECT_EQ(reactors.size(), 4u);
+}
+
+TEST(ReactorShard, Rebalance)
+{
+    Workers workers(1);
+    const int pair_count = 4;
+    int fds[pair_count][2];
+    std::atomic<int> done{0};
+
+    // 所有fd都归属于当前线程的reactor, 制造一个热点.
+    size_t hot = g_Scheduler.GetIoWait().GetCurrentReactor();
+    for (int i = 0; i < pair_count; ++i) {
+        ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds[i]), 0);
+        for (int fd : fds[i]) {
+            FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fd);
+            ASSERT_TRUE(fd_ctx->set_reactor(hot));
+        }
+    }
+
+    auto pingpong = [&](int rounds) {
+        for (int i = 0; i < pair_count; ++i) {
+            int a = fds[i][0], b = fds[i][1];
+            go [=, &done] {
+                char buf[16];
+                for (int j = 0; j < rounds; ++j) {
+                    EXPECT_EQ(read(a, buf, sizeof(buf)), 4);
+                    EXPECT_EQ(write(a, buf, 4), 4);
+                }
+                ++done;
+            };
+            go [=, &done] {
+                char buf[16];
+                for (int j = 0; j < rounds; ++j) {
+                    EXPECT_EQ(write(b, "ping", 4), 4);
+                    EXPECT_EQ(read(b, buf, sizeof(buf)), 4);
+                }
+                ++done;
+            };
+        }
+        g_Scheduler.RunUntilNoTask();
+    };
+
+    g_Scheduler.GetIoWait().Rebalance();    // 清零之前的统计
+    pingpong(100);
+    EXPECT_EQ(done, pair_count * 2);
+
+    size_t moved = g_Scheduler.GetIoWait().Rebalance();
+    cout << "moved: " << moved << endl << co_debugger.GetReactorInfo() << endl;
+    EXPECT_GT(moved, 0u);
+    std::set<int> reactors;
+    for (int i = 0; i < pair_count; ++i)
+        for (int fd : fds[i])
+            reactors.insert(reactor_of(fd));
+    EXPECT_EQ(reactors.size(), 2u);
+
+    // 迁移之后收发正常
+    done = 0;
+    pingpong(100);
+    EXPECT_EQ(done, pair_count * 2);
+
+    for (int i = 0; i < pair_count; ++i) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+}
+
+TEST(ReactorShard, DeadReactor)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+    // 归属于一个已经退出的线程的reactor
+    {
+        Workers workers(1);
+        size_t dead = g_Scheduler.GetIoWait().GetReactorCount() - 1;
+        FdCtxPtr fd_ctx = FdManager::getInstance().get_fd_ctx(fds[0]);
+        ASSERT_TRUE(fd_ctx->set_reactor(dead));
+    }
+
+    g_Scheduler.Run();
+    EXPECT_GE(g_Scheduler.GetIoWait().Rebalance(), 1u);
+    EXPECT_EQ((size_t)reactor_of(fds[0]), g_Scheduler.GetIoWait().GetCurrentReactor());
+
+    go [=] {
+        char buf[16];
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+    };
+    go [=] {
+        co_sleep(10);
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
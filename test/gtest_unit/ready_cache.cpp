@@ -0,0 +1,158 @@
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <atomic>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 通过co_debugger.GetHookSyscallCount()统计hook中实际发起的系统调用次数,
+// 不需要strace.
+
+// socketpair上乒乓收发count次, 返回期间hook发起的系统调用次数
+static uint64_t pingpong(int count)
+{
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    uint64_t start = co_debugger.GetHookSyscallCount();
+    go [=] {
+        char buf[16];
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 4);
+            EXPECT_EQ(write(fds[0], buf, 4), 4);
+        }
+    };
+    go [=] {
+        char buf[16];
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(write(fds[1], "ping", 4), 4);
+            EXPECT_EQ(read(fds[1], buf, sizeof(buf)), 4);
+        }
+    };
+    g_Scheduler.RunUntilNoTask();
+    uint64_t n = co_debugger.GetHookSyscallCount() - start;
+    close(fds[0]);
+    close(fds[1]);
+    return n;
+}
+
+TEST(ReadyCache, NoProbeAfterEAGAIN)
+{
+    // 每个来回: 两端各一次write, 最多各一次返回EAGAIN的read和一次成功的read.
+    // 返回EAGAIN后直接挂起, 不再做poll(0)探测.
+    for (bool et : {false, true}) {
+        g_Scheduler.GetOptions().epoll_edge_triggered = et;
+        uint64_t n = pingpong(100);
+        cout << (et ? "edge" : "level") << "-triggered syscalls: " << n << endl;
+        EXPECT_LE(n, 600u);
+    }
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+// 带SO_RCVTIMEO的socket上反复超时读, 返回read的系统调用次数
+static uint64_t timed_reads(int count)
+{
+    uint64_t n = 0;
+    go [=, &n] {
+        int fds[2];
+        int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+        EXPECT_EQ(res, 0);
+
+        timeval tv = {0, 10 * 1000};
+        res = setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        EXPECT_EQ(res, 0);
+
+        char buf[16];
+        uint64_t start = co_debugger.GetHookSyscallCount();
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), -1);
+            EXPECT_EQ(errno, EAGAIN);
+        }
+        n = co_debugger.GetHookSyscallCount() - start;
+
+        // 缓存的未就绪状态不能丢掉之后到来的数据
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+        close(fds[0]);
+        close(fds[1]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    return n;
+}
+
+TEST(ReadyCache, SkipKnownNotReady)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+    EXPECT_EQ(timed_reads(5), 5u);
+
+    // 第一次read返回EAGAIN后注册到epoll, 之后已知未就绪, 直接挂起.
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    EXPECT_EQ(timed_reads(5), 1u);
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+TEST(ReadyCache, PollThenRead)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    go [=] {
+        char buf[16];
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);  // 注册到epoll
+
+        // poll探测到未就绪后清除缓存, 不会返回过期的就绪事件
+        for (int i = 0; i < 3; ++i) {
+            pollfd pfd = {fds[0], POLLIN, 0};
+            EXPECT_EQ(poll(&pfd, 1, 10), 0);
+        }
+
+        pollfd pfd = {fds[0], POLLIN, 0};
+        EXPECT_EQ(poll(&pfd, 1, 1000), 1);
+        EXPECT_EQ(pfd.revents, POLLIN);
+        EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+    };
+    go [=] {
+        co_sleep(50);
+        EXPECT_EQ(write(fds[1], "b", 1), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+TEST(ReadyCache, MultiReaders)
+{
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    int fds[2];
+    int res = socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    EXPECT_EQ(res, 0);
+
+    // 一次就绪事件唤醒两个读协程, 没读到数据的那个不能错过下一次事件.
+    std::atomic<int> done{0};
+    for (int i = 0; i < 2; ++i)
+        go [=, &done] {
+            char buf[1];
+            EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 1);
+            ++done;
+        };
+    go [=] {
+        co_sleep(20);
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        co_sleep(20);
+        EXPECT_EQ(write(fds[1], "b", 1), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(done, 2);
+    close(fds[0]);
+    close(fds[1]);
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
@@ -297,3 +297,68 @@ TEST(Select, MultiThreads)
         g_Scheduler.RunUntilNoTask();
     EXPECT_EQ(Task::GetTaskCount(), 0);
 }
+
+TEST(Select, WakeupResult)
+{
+    go [] {
+        int rfds[2], wfds[2];
+        ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, rfds), 0);
+        ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, wfds), 0);
+
+        // 写满wfds[0]的发送缓冲区, 使它不可写
+        int flags = fcntl(wfds[0], F_GETFL);
+        fcntl(wfds[0], F_SETFL, flags | O_NONBLOCK);
+        static char buf[10240];
+        while (write(wfds[0], buf, sizeof(buf)) > 0) ;
+        fcntl(wfds[0], F_SETFL, flags);
+
+        // 等待中rfds[0]变为可读: 只返回它的可读事件
+        go [=] {
+            co_sleep(20);
+            EXPECT_EQ(write(rfds[1], "a", 1), 1);
+        };
+        fd_set rd, wr;
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        FD_SET(rfds[0], &rd);
+        FD_SET(wfds[0], &rd);
+        FD_SET(wfds[0], &wr);
+        uint64_t yield_count = g_Scheduler.GetCurrentTaskYieldCount();
+        int n = select(FD_NFDS(&rd, &wr), &rd, &wr, NULL, gc_new timeval{1, 0});
+        EXPECT_EQ(n, 1);
+        EXPECT_EQ(FD_SIZE(&rd), 1);
+        EXPECT_TRUE(FD_ISSET(rfds[0], &rd));
+        EXPECT_TRUE(FD_ISZERO(&wr));
+        EXPECT_EQ(g_Scheduler.GetCurrentTaskYieldCount(), yield_count + 1);
+
+        // 同一个fd同时等待读写, 对端关闭时可读可写都返回
+        go [=] {
+            co_sleep(20);
+            close(wfds[1]);
+        };
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        FD_SET(wfds[0], &rd);
+        FD_SET(wfds[0], &wr);
+        n = select(FD_NFDS(&rd, &wr), &rd, &wr, NULL, gc_new timeval{1, 0});
+        EXPECT_GE(n, 1);
+        EXPECT_TRUE(FD_ISSET(wfds[0], &rd));
+
+        // 无效的fd: 即使其他fd已就绪也返回EBADF, 且不修改fd_set
+        FD_ZERO(&rd);
+        FD_SET(rfds[0], &rd);
+        FD_SET(rfds[1], &rd);
+        close(rfds[1]);
+        n = select(FD_NFDS(&rd), &rd, NULL, NULL, gc_new timeval{1, 0});
+        EXPECT_EQ(n, -1);
+        EXPECT_EQ(errno, EBADF);
+        EXPECT_EQ(FD_SIZE(&rd), 2);
+        EXPECT_TRUE(FD_ISSET(rfds[0], &rd));
+        EXPECT_TRUE(FD_ISSET(rfds[1], &rd));
+
+        close(rfds[0]);
+        close(wfds[0]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    EXPECT_EQ(Task::GetTaskCount(), 0);
+}
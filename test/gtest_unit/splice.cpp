@@ -0,0 +1,182 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include "coroutine.h"
+#include <libgo/linux_glibc_hook.h>
+using namespace std;
+using namespace co;
+
+static const int kTotal = 4 * 1024 * 1024;
+
+static std::vector<char> make_data(int size)
+{
+    std::vector<char> data(size);
+    for (int i = 0; i < size; ++i)
+        data[i] = (char)(i * 7 + i / 4096);
+    return data;
+}
+
+// 从fd读取size字节并与data比较
+static void read_expect(int fd, std::vector<char> const& data)
+{
+    std::vector<char> buf(data.size());
+    size_t n = 0;
+    while (n < buf.size()) {
+        ssize_t res = read(fd, &buf[n], buf.size() - n);
+        ASSERT_GT(res, 0);
+        n += res;
+    }
+    EXPECT_TRUE(buf == data);
+}
+
+// 同一线程上: sendfile受socket发送缓冲区限制时挂起协程, 分多次完成
+TEST(Splice, Sendfile)
+{
+    std::vector<char> data = make_data(kTotal);
+    char path[] = "/tmp/libgo_sendfile_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_GE(file_fd, 0);
+    unlink(path);
+    ASSERT_EQ(write(file_fd, &data[0], kTotal), kTotal);
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+    go [&]{
+        off_t offset = 0;
+        int calls = 0;
+        while (offset < kTotal) {
+            ssize_t n = sendfile(fds[0], file_fd, &offset, kTotal - offset);
+            ASSERT_GT(n, 0);
+            ++calls;
+        }
+        EXPECT_GT(calls, 1);
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        close(fds[0]);
+    };
+    go [&]{
+        read_expect(fds[1], data);
+    };
+    co_sched.RunUntilNoTask();
+    close(fds[1]);
+    close(file_fd);
+}
+
+// socket -> 管道 -> socket 零拷贝转发
+TEST(Splice, Proxy)
+{
+    std::vector<char> data = make_data(kTotal);
+    int in[2], out[2];
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, in), 0);
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, out), 0);
+
+    go [&]{
+        EXPECT_EQ(splice_proxy(in[1], out[0]), kTotal);
+        close(out[0]);
+    };
+    go [&]{
+        int n = 0;
+        while (n < kTotal) {
+            ssize_t res = write(in[0], &data[n], kTotal - n);
+            ASSERT_GT(res, 0);
+            n += res;
+        }
+        shutdown(in[0], SHUT_WR);
+    };
+    go [&]{
+        read_expect(out[1], data);
+        char c;
+        EXPECT_EQ(read(out[1], &c, 1), 0);
+    };
+    co_sched.RunUntilNoTask();
+    close(in[0]);
+    close(in[1]);
+    close(out[1]);
+}
+
+// 源端没有数据时挂起, 其他协程继续执行
+TEST(Splice, WaitReadable)
+{
+    int p[2], fds[2];
+    ASSERT_EQ(pipe(p), 0);
+    ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+    int ticks = 0;
+    bool done = false;
+    go [&]{
+        EXPECT_EQ(splice(p[0], nullptr, fds[0], nullptr, 1024, 0), 5);
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        done = true;
+    };
+    go [&]{
+        while (!done) {
+            ++ticks;
+            co_sleep(5);
+        }
+    };
+    go [&]{
+        co_sleep(50);
+        EXPECT_EQ(write(p[1], "hello", 5), 5);
+        char buf[16];
+        EXPECT_EQ(read(fds[1], buf, sizeof(buf)), 5);
+    };
+    co_sched.RunUntilNoTask();
+    EXPECT_TRUE(done);
+    EXPECT_GE(ticks, 5);
+
+    // 用户指定SPLICE_F_NONBLOCK时立即返回
+    go [&]{
+        EXPECT_EQ(splice(p[0], nullptr, fds[0], nullptr, 1024, SPLICE_F_NONBLOCK), -1);
+        EXPECT_EQ(errno, EAGAIN);
+        EXPECT_EQ(co_sched.GetCurrentTaskYieldCount(), 0u);
+    };
+    co_sched.RunUntilNoTask();
+
+    for (int fd : {p[0], p[1], fds[0], fds[1]})
+        close(fd);
+}
+
+TEST(Splice, TeeVmsplice)
+{
+    std::vector<char> data = make_data(1024 * 1024);
+    int p1[2], p2[2];
+    ASSERT_EQ(pipe(p1), 0);
+    ASSERT_EQ(pipe(p2), 0);
+
+    // 超过管道容量的vmsplice, 写满时挂起直到读端取走
+    go [&]{
+        size_t n = 0;
+        while (n < data.size()) {
+            iovec iov = {&data[n], data.size() - n};
+            ssize_t res = vmsplice(p1[1], &iov, 1, 0);
+            ASSERT_GT(res, 0);
+            n += res;
+        }
+        EXPECT_GT(co_sched.GetCurrentTaskYieldCount(), 0u);
+        close(p1[1]);
+    };
+
+    // tee复制p1中的数据到p2, 然后从p1中取走
+    go [&]{
+        std::vector<char> buf(64 * 1024);
+        for (;;) {
+            ssize_t n = tee(p1[0], p2[1], buf.size(), 0);
+            ASSERT_GE(n, 0);
+            if (n == 0) break;
+            ASSERT_EQ(read(p1[0], &buf[0], n), n);
+        }
+        close(p2[1]);
+    };
+
+    go [&]{
+        read_expect(p2[0], data);
+    };
+    co_sched.RunUntilNoTask();
+    close(p1[0]);
+    close(p2[0]);
+}
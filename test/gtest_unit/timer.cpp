@@ -170,3 +170,134 @@ TEST(Timer, wait_resolution)
         g_Scheduler.Run();
     EXPECT_LT(second_duration(start), 0.627 + 0.005);   // 误差不超过5ms
 }
+
+TEST(Timer, slack)
+{
+    g_Scheduler.GetOptions().debug = dbg_none;
+
+    // 100个相隔1ms的定时器, 松弛时间100ms, 应当合并在少数几次唤醒中处理.
+    uint64_t saved = CoDebugger::getInstance().GetTimerSavedWakeups();
+    auto start = std::chrono::steady_clock::now();
+    int c = 100;
+    for (int i = 0; i < 100; ++i)
+        co_timer_add(std::chrono::milliseconds(100 + i), [&, i]{
+                --c;
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                EXPECT_GE(elapsed, std::chrono::milliseconds(100 + i));
+                EXPECT_LT(elapsed, std::chrono::milliseconds(100 + i + 100 + 10));
+                }, std::chrono::milliseconds(100));
+
+    while (c)
+        g_Scheduler.Run();
+    EXPECT_GT(CoDebugger::getInstance().GetTimerSavedWakeups() - saved, 50u);
+
+    // 不带松弛时间的定时器不计入合并次数.
+    saved = CoDebugger::getInstance().GetTimerSavedWakeups();
+    c = 10;
+    for (int i = 0; i < 10; ++i)
+        co_timer_add(std::chrono::milliseconds(i), [&]{ --c; });
+    while (c)
+        g_Scheduler.Run();
+    EXPECT_EQ(CoDebugger::getInstance().GetTimerSavedWakeups(), saved);
+}
+
+TEST(Timer, coroutine_callback)
+{
+    g_Scheduler.GetOptions().debug = dbg_none;
+
+    // 回调在协程中执行, 可以阻塞, 不影响同一线程的其他定时器.
+    std::atomic<int> c{0};
+    bool inline_timer = false;
+    // 回调协程记录的是添加定时器的位置
+    std::string location = std::string("{file:") + __FILE__ + ", line:" + std::to_string(__LINE__ + 1) + "}";
+    co_timer_add_go(std::chrono::milliseconds(10), [&]{
+                EXPECT_TRUE(g_Scheduler.IsCoroutine());
+                EXPECT_NE(std::string(g_Scheduler.GetCurrentTaskDebugInfo()).find(location),
+                    std::string::npos);
+                co_sleep(200);
+                ++c;
+            });
+    co_timer_add(std::chrono::milliseconds(20), [&]{
+                EXPECT_FALSE(g_Scheduler.IsCoroutine());
+                EXPECT_EQ(c, 0);
+                inline_timer = true;
+            });
+
+    auto start = std::chrono::system_clock::now();
+    while (c < 1)
+        g_Scheduler.Run();
+    EXPECT_TRUE(inline_timer);
+    EXPECT_LT(std::abs(0.21 - second_duration(start)), 0.05);
+
+    // 分派到多个线程执行
+    std::atomic<bool> stop{false};
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([&]{
+                while (!stop) g_Scheduler.Run();
+                });
+
+    c = 0;
+    for (int i = 0; i < 100; ++i)
+        co_timer_add_go(std::chrono::milliseconds(10), [&]{
+                    co_sleep(10);
+                    ++c;
+                }, egod_robin);
+    while (c < 100)
+        usleep(1000);
+    stop = true;
+    tg.join_all();
+}
+
+TEST(Timer, periodic)
+{
+    g_Scheduler.GetOptions().debug = dbg_none;
+
+    // fixed_rate: 按最初的时间表触发, 不会因为回调耗时而漂移.
+    auto start = std::chrono::system_clock::now();
+    int c = 0;
+    TimerId id;
+    id = co_timer_add_periodic(std::chrono::milliseconds(10), [&]{
+                usleep(3000);
+                if (++c == 20) {
+                    EXPECT_TRUE(co_timer_cancel(id));
+                }
+            });
+    while (c < 20)
+        g_Scheduler.Run();
+    EXPECT_LT(std::abs(0.2 - second_duration(start)), 0.015);
+    EXPECT_EQ(id->GetSkippedTicks(), 0u);
+    EXPECT_EQ(g_Scheduler.Run(), 0u);
+    EXPECT_FALSE(co_timer_cancel(id));
+
+    // fixed_rate: 回调耗时超过周期时跳过错过的触发.
+    start = std::chrono::system_clock::now();
+    c = 0;
+    id = co_timer_add_periodic(std::chrono::milliseconds(10), [&]{
+                usleep(25000);
+                ++c;
+            });
+    while (c < 4)
+        g_Scheduler.Run();
+    EXPECT_TRUE(co_timer_cancel(id));
+    EXPECT_GE(id->GetSkippedTicks(), 4u);
+    EXPECT_LT(second_duration(start), 0.15);
+
+    // fixed_delay: 回调执行完毕后再间隔一个周期.
+    start = std::chrono::system_clock::now();
+    c = 0;
+    id = co_timer_add_periodic(std::chrono::milliseconds(10), [&]{
+                usleep(5000);
+                ++c;
+            }, ePeriodicMode::fixed_delay);
+    while (c < 10)
+        g_Scheduler.Run();
+    EXPECT_TRUE(co_timer_cancel(id));
+    EXPECT_GE(second_duration(start), 0.145);
+    EXPECT_EQ(id->GetSkippedTicks(), 0u);
+    for (int i = 0; i < 3; ++i) {
+        usleep(10000);
+        g_Scheduler.Run();
+    }
+    EXPECT_EQ(c, 10);
+}
@@ -0,0 +1,239 @@
+#include <iostream>
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <gtest/gtest.h>
+#include <vector>
+#include <chrono>
+#include "coroutine.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// 建立一对127.0.0.1上的tcp连接
+static void tcp_pair(int fds[2])
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    bind(lfd, (sockaddr*)&addr, sizeof(addr));
+    listen(lfd, 1);
+    socklen_t len = sizeof(addr);
+    getsockname(lfd, (sockaddr*)&addr, &len);
+
+    fds[1] = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(connect(fds[1], (sockaddr*)&addr, sizeof(addr)), 0);
+    fds[0] = accept(lfd, nullptr, nullptr);
+    EXPECT_GE(fds[0], 0);
+    close(lfd);
+}
+
+static int get_zerocopy(int fd)
+{
+    int v = -1;
+    socklen_t len = sizeof(v);
+    getsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &v, &len);
+    return v;
+}
+
+// 读出错误队列中的一条, 返回它的来源, 队列为空时返回-1
+static int read_errqueue(int fd, sock_extended_err *out = nullptr)
+{
+    char control[256];
+    msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (-1 == recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT))
+        return -1;
+
+    for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) {
+            sock_extended_err *serr = (sock_extended_err*)CMSG_DATA(cm);
+            if (out) *out = *serr;
+            return serr->ee_origin;
+        }
+    return 0;
+}
+
+// 每次send返回后立即改写缓冲区, 接收端收到的数据不受影响
+static void send_and_verify(size_t chunk, int count)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    go [=] {
+        vector<char> buf(chunk);
+        for (int i = 0; i < count; ++i) {
+            size_t off = 0;
+            while (off < chunk) {
+                ssize_t n = recv(fds[0], &buf[off], chunk - off, 0);
+                ASSERT_GT(n, 0);
+                off += n;
+            }
+            for (size_t j = 0; j < chunk; ++j)
+                if (buf[j] != (char)i) {
+                    ADD_FAILURE() << "chunk " << i << " corrupted at " << j;
+                    break;
+                }
+        }
+    };
+
+    go [=] {
+        vector<char> buf(chunk);
+        for (int i = 0; i < count; ++i) {
+            memset(&buf[0], i, chunk);
+            size_t off = 0;
+            while (off < chunk) {
+                ssize_t n = send(fds[1], &buf[off], chunk - off, MSG_ZEROCOPY);
+                ASSERT_GT(n, 0);
+                off += n;
+            }
+        }
+        memset(&buf[0], 0xff, chunk);
+
+        // 完成通知已经从错误队列中读走, 不会表现为socket上的错误
+        pollfd pfd = {fds[1], POLLIN, 0};
+        EXPECT_EQ(poll(&pfd, 1, 50), 0);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ZeroCopy, BufferReuse)
+{
+    send_and_verify(256 * 1024, 32);
+
+    g_Scheduler.GetOptions().epoll_edge_triggered = true;
+    send_and_verify(256 * 1024, 32);
+    g_Scheduler.GetOptions().epoll_edge_triggered = false;
+}
+
+TEST(ZeroCopy, Threshold)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    go [=] {
+        char buf[1024] = {};
+        // 小于zerocopy_threshold时按普通发送处理
+        EXPECT_EQ(send(fds[1], buf, sizeof(buf), MSG_ZEROCOPY), (ssize_t)sizeof(buf));
+        EXPECT_EQ(get_zerocopy(fds[1]), 0);
+
+        vector<char> big(g_Scheduler.GetOptions().zerocopy_threshold);
+        EXPECT_GT(send(fds[1], &big[0], big.size(), MSG_ZEROCOPY), 0);
+        EXPECT_EQ(get_zerocopy(fds[1]), 1);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ZeroCopy, Sendmsg)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    const size_t chunk = 64 * 1024;
+    go [=] {
+        vector<char> a(chunk, 'a'), b(chunk, 'b');
+        iovec iov[2] = {{&a[0], chunk}, {&b[0], chunk}};
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        ssize_t n = sendmsg(fds[1], &msg, MSG_ZEROCOPY);
+        EXPECT_EQ(n, (ssize_t)chunk * 2);
+        a.assign(chunk, 'x');
+        b.assign(chunk, 'x');
+        shutdown(fds[1], SHUT_WR);
+    };
+    go [=] {
+        vector<char> buf(chunk * 2);
+        size_t off = 0;
+        ssize_t n;
+        while ((n = read(fds[0], &buf[off], buf.size() - off)) > 0)
+            off += n;
+        EXPECT_EQ(off, chunk * 2);
+        EXPECT_EQ(string(&buf[0], chunk), string(chunk, 'a'));
+        EXPECT_EQ(string(&buf[chunk], chunk), string(chunk, 'b'));
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ZeroCopy, CloseWhileWaiting)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    // 对端不读取, 发送缓冲区写满后在close时返回
+    go [=] {
+        vector<char> buf(1024 * 1024);
+        ssize_t n;
+        while ((n = send(fds[1], &buf[0], buf.size(), MSG_ZEROCOPY)) > 0)
+            ;
+        EXPECT_EQ(n, -1);
+        EXPECT_EQ(errno, EBADF);
+    };
+    go [=] {
+        co_sleep(100);
+        close(fds[1]);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+}
+
+TEST(ZeroCopy, UserErrqueue)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    go [=] {
+        int ts = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        EXPECT_EQ(setsockopt(fds[1], SOL_SOCKET, SO_TIMESTAMPING, &ts, sizeof(ts)), 0);
+
+        // 发送时间戳留给用户, 不会被当作零拷贝通知读走
+        vector<char> buf(32 * 1024);
+        EXPECT_EQ(send(fds[1], &buf[0], buf.size(), MSG_ZEROCOPY), (ssize_t)buf.size());
+        pollfd pfd = {fds[1], 0, 0};
+        EXPECT_EQ(poll(&pfd, 1, 1000), 1);
+        EXPECT_EQ(read_errqueue(fds[1]), SO_EE_ORIGIN_TIMESTAMPING);
+    };
+    g_Scheduler.RunUntilNoTask();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ZeroCopy, SendOutsideCoroutine)
+{
+    int fds[2];
+    tcp_pair(fds);
+
+    // 不在协程中的零拷贝发送, 完成通知由用户读取
+    int one = 1;
+    EXPECT_EQ(setsockopt(fds[1], SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)), 0);
+    vector<char> buf(32 * 1024);
+    EXPECT_EQ(send(fds[1], &buf[0], buf.size(), MSG_ZEROCOPY), (ssize_t)buf.size());
+    pollfd pfd = {fds[1], 0, 0};
+    EXPECT_EQ(poll(&pfd, 1, 1000), 1);
+
+    // 计数与内核的通知序号不一致, 协程中的发送不再等待, 也不会读走用户的通知
+    go [=] {
+        vector<char> buf(32 * 1024);
+        EXPECT_EQ(send(fds[1], &buf[0], buf.size(), MSG_ZEROCOPY), (ssize_t)buf.size());
+    };
+    g_Scheduler.RunUntilNoTask();
+
+    sock_extended_err serr = {};
+    EXPECT_EQ(read_errqueue(fds[1], &serr), SO_EE_ORIGIN_ZEROCOPY);
+    EXPECT_EQ(serr.ee_info, 0u);
+    EXPECT_EQ(serr.ee_data, 0u);
+    close(fds[0]);
+    close(fds[1]);
+}